@@ -0,0 +1,327 @@
+#include "AudioFingerprint.h"
+#include "VideoProcessingUtils.h"
+
+#include <array>
+#include <cmath>
+#include <numbers>
+#include <type_traits>
+
+extern "C" {
+#include <libavutil/channel_layout.h>
+#include <libavutil/mem.h>
+#include <libavutil/samplefmt.h>
+#include <libavutil/tx.h>
+}
+
+namespace audiofp {
+
+namespace {
+
+using vpu::CtxPtr;
+using vpu::FmtPtr;
+using vpu::FrmPtr;
+using vpu::PktPtr;
+
+constexpr double kLowHz = 300.0;
+constexpr double kHighHz = 2000.0;
+constexpr float kSilence = 1e-6f; // mean square, about -60 dBFS
+
+struct AvFree {
+    void operator()(void* p) const noexcept { av_free(p); }
+};
+struct TxFree {
+    void operator()(AVTXContext* p) const noexcept { av_tx_uninit(&p); }
+};
+
+// FFT bin where each band starts; band m is [edge[m], edge[m + 1]).
+std::array<std::size_t, kBands + 1> const& band_edges()
+{
+    static auto const edges = [] {
+        std::array<std::size_t, kBands + 1> e {};
+        for (std::size_t k = 0; k <= kBands; ++k) {
+            double const hz = kLowHz * std::pow(kHighHz / kLowHz, static_cast<double>(k) / kBands);
+            e[k] = static_cast<std::size_t>(std::lround(hz * kFrame / kSampleRate));
+        }
+        return e;
+    }();
+    return edges;
+}
+
+std::array<float, kFrame> const& hann()
+{
+    static auto const window = [] {
+        std::array<float, kFrame> w {};
+        for (std::size_t i = 0; i < kFrame; ++i)
+            w[i] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * std::numbers::pi * i / kFrame));
+        return w;
+    }();
+    return window;
+}
+
+// Streams mono kSampleRate samples into sub-fingerprints.
+class Fingerprinter {
+public:
+    Fingerprinter()
+        : in_(static_cast<float*>(av_malloc((kFrame + 2) * sizeof(float))))
+        , out_(static_cast<AVComplexFloat*>(av_malloc((kFrame / 2 + 1) * sizeof(AVComplexFloat))))
+    {
+        AVTXContext* tx = nullptr;
+        float const scale = 1.0f;
+        if (in_ && out_ && av_tx_init(&tx, &fft_, AV_TX_FLOAT_RDFT, 0, static_cast<int>(kFrame), &scale, 0) >= 0)
+            tx_.reset(tx);
+        else
+            spdlog::error("[audio] could not set up a {}-point FFT", kFrame);
+        pending_.reserve(2 * kFrame);
+    }
+
+    void push(std::span<float const> samples)
+    {
+        if (!tx_)
+            return;
+        pending_.insert(pending_.end(), samples.begin(), samples.end());
+        std::size_t start = 0;
+        for (; start + kFrame <= pending_.size(); start += kHop)
+            frame(pending_.data() + start);
+        pending_.erase(pending_.begin(), pending_.begin() + static_cast<std::ptrdiff_t>(start));
+    }
+
+    std::vector<std::uint32_t> take() { return std::move(subs_); }
+
+private:
+    void frame(float const* samples)
+    {
+        auto const& window = hann();
+        float power = 0.0f;
+        for (std::size_t i = 0; i < kFrame; ++i) {
+            power += samples[i] * samples[i];
+            in_[i] = samples[i] * window[i];
+        }
+        bool const silent = power < kSilence * kFrame;
+        fft_(tx_.get(), out_.get(), in_.get(), sizeof(float));
+
+        auto const& edges = band_edges();
+        std::array<float, kBands> energy {};
+        for (std::size_t m = 0; m < kBands; ++m)
+            for (std::size_t b = edges[m]; b < edges[m + 1]; ++b)
+                energy[m] += out_[b].re * out_[b].re + out_[b].im * out_[b].im;
+
+        if (havePrev_) {
+            std::uint32_t sub = 0;
+            if (!silent && !prevSilent_)
+                for (std::size_t m = 0; m + 1 < kBands; ++m)
+                    if (energy[m] - energy[m + 1] - (prev_[m] - prev_[m + 1]) > 0.0f)
+                        sub |= std::uint32_t { 1 } << m;
+            subs_.push_back(sub);
+        }
+        prev_ = energy;
+        prevSilent_ = silent;
+        havePrev_ = true;
+    }
+
+    std::unique_ptr<float[], AvFree> in_;
+    std::unique_ptr<AVComplexFloat[], AvFree> out_;
+    std::unique_ptr<AVTXContext, TxFree> tx_;
+    av_tx_fn fft_ = nullptr;
+    std::vector<float> pending_;
+    std::array<float, kBands> prev_ {};
+    bool prevSilent_ = true;
+    bool havePrev_ = false;
+    std::vector<std::uint32_t> subs_;
+};
+
+// Box-filter decimation to kSampleRate: each output sample is the mean of
+// the input samples since the previous one.
+class Decimator {
+public:
+    explicit Decimator(int inRate)
+        : inRate_(inRate)
+    {
+    }
+
+    int inRate() const { return inRate_; }
+
+    void push(std::span<float const> in, std::vector<float>& out)
+    {
+        for (float x : in) {
+            acc_ += x;
+            ++n_;
+            phase_ += kSampleRate;
+            if (phase_ < inRate_)
+                continue;
+            // upsampling (inputs under kSampleRate) repeats the sample
+            float const mean = acc_ / static_cast<float>(n_);
+            for (; phase_ >= inRate_; phase_ -= inRate_)
+                out.push_back(mean);
+            acc_ = 0.0f;
+            n_ = 0;
+        }
+    }
+
+private:
+    int inRate_;
+    int phase_ = 0;
+    float acc_ = 0.0f;
+    int n_ = 0;
+};
+
+template <class T>
+float to_float(T v)
+{
+    if constexpr (std::is_same_v<T, std::uint8_t>)
+        return (static_cast<int>(v) - 128) / 128.0f;
+    else if constexpr (std::is_same_v<T, std::int16_t>)
+        return v / 32768.0f;
+    else if constexpr (std::is_same_v<T, std::int32_t>)
+        return static_cast<float>(v / 2147483648.0);
+    else
+        return static_cast<float>(v);
+}
+
+template <class T>
+void downmix_as(AVFrame const* f, int channels, bool planar, std::vector<float>& out)
+{
+    out.resize(static_cast<std::size_t>(f->nb_samples));
+    float const scale = 1.0f / static_cast<float>(channels);
+    for (int i = 0; i < f->nb_samples; ++i) {
+        float s = 0.0f;
+        for (int c = 0; c < channels; ++c)
+            s += planar ? to_float(reinterpret_cast<T const*>(f->extended_data[c])[i])
+                        : to_float(reinterpret_cast<T const*>(f->extended_data[0])[i * channels + c]);
+        out[static_cast<std::size_t>(i)] = s * scale;
+    }
+}
+
+// Mean of the frame's channels as floats in [-1, 1]; false for sample
+// formats no decoder we meet produces.
+bool downmix(AVFrame const* f, std::vector<float>& out)
+{
+    int const channels = f->ch_layout.nb_channels;
+    if (channels <= 0)
+        return false;
+    auto const format = static_cast<AVSampleFormat>(f->format);
+    bool const planar = av_sample_fmt_is_planar(format);
+    switch (av_get_packed_sample_fmt(format)) {
+    case AV_SAMPLE_FMT_U8:
+        downmix_as<std::uint8_t>(f, channels, planar, out);
+        return true;
+    case AV_SAMPLE_FMT_S16:
+        downmix_as<std::int16_t>(f, channels, planar, out);
+        return true;
+    case AV_SAMPLE_FMT_S32:
+        downmix_as<std::int32_t>(f, channels, planar, out);
+        return true;
+    case AV_SAMPLE_FMT_FLT:
+        downmix_as<float>(f, channels, planar, out);
+        return true;
+    case AV_SAMPLE_FMT_DBL:
+        downmix_as<double>(f, channels, planar, out);
+        return true;
+    default:
+        return false;
+    }
+}
+
+} // namespace
+
+std::vector<std::uint32_t> fingerprint(std::span<float const> samples)
+{
+    Fingerprinter fp;
+    fp.push(samples);
+    return fp.take();
+}
+
+std::optional<std::vector<std::uint32_t>> extract(std::string const& path, int timeBudgetSec)
+{
+    vpu::DecodeBudget budget(std::chrono::seconds(timeBudgetSec), 0);
+
+    FmtPtr fmt;
+    {
+        AVFormatContext* raw = nullptr;
+        if (int rc = budget.open_input(raw, path.c_str(), nullptr); rc < 0) {
+            spdlog::warn("[audio] cannot open '{}': {}", path, vpu::err2str(rc));
+            return std::nullopt;
+        }
+        fmt.reset(raw);
+    }
+    budget.enter("probe");
+    if (int rc = avformat_find_stream_info(fmt.get(), nullptr); rc < 0) {
+        spdlog::warn("[audio] cannot probe '{}': {}", path, vpu::err2str(rc));
+        return std::nullopt;
+    }
+
+    AVCodec const* dec = nullptr;
+    int const aStream = av_find_best_stream(fmt.get(), AVMEDIA_TYPE_AUDIO, -1, -1, &dec, 0);
+    if (aStream == AVERROR_STREAM_NOT_FOUND)
+        return std::vector<std::uint32_t> {};
+    if (aStream < 0 || !dec) {
+        spdlog::warn("[audio] no decodable audio stream in '{}'", path);
+        return std::nullopt;
+    }
+    // the demuxer still reads the video packets, but hands none of them out
+    for (unsigned i = 0; i < fmt->nb_streams; ++i)
+        if (static_cast<int>(i) != aStream)
+            fmt->streams[i]->discard = AVDISCARD_ALL;
+
+    CtxPtr decCtx { avcodec_alloc_context3(dec) };
+    if (!decCtx
+        || avcodec_parameters_to_context(decCtx.get(), fmt->streams[aStream]->codecpar) < 0
+        || avcodec_open2(decCtx.get(), dec, nullptr) < 0) {
+        spdlog::warn("[audio] cannot open the {} decoder for '{}'", dec->name, path);
+        return std::nullopt;
+    }
+
+    PktPtr pkt { av_packet_alloc() };
+    FrmPtr frm { av_frame_alloc() };
+    std::optional<Decimator> decimate;
+    Fingerprinter fp;
+    std::vector<float> mono, resampled;
+    bool unsupported = false;
+
+    auto receive_frames = [&] {
+        while (avcodec_receive_frame(decCtx.get(), frm.get()) >= 0) {
+            if (frm->sample_rate <= 0 || !downmix(frm.get(), mono)) {
+                unsupported = true;
+            } else {
+                if (!decimate || decimate->inRate() != frm->sample_rate)
+                    decimate.emplace(frm->sample_rate);
+                resampled.clear();
+                decimate->push(mono, resampled);
+                fp.push(resampled);
+            }
+            av_frame_unref(frm.get());
+        }
+    };
+
+    budget.enter("decode");
+    while (av_read_frame(fmt.get(), pkt.get()) >= 0) {
+        // a corrupt packet costs a few sub-fingerprints, not the file
+        if (pkt->stream_index == aStream && avcodec_send_packet(decCtx.get(), pkt.get()) >= 0)
+            receive_frames();
+        av_packet_unref(pkt.get());
+    }
+    if (budget.exceeded()) {
+        spdlog::warn("[audio] gave up on '{}' after {} s", path, timeBudgetSec);
+        return std::nullopt;
+    }
+    avcodec_send_packet(decCtx.get(), nullptr);
+    receive_frames();
+
+    if (unsupported)
+        spdlog::warn("[audio] '{}' has frames in a sample format that is not handled; skipped them", path);
+    return fp.take();
+}
+
+HashGroup hash_group(int videoId, std::span<std::uint32_t const> subs)
+{
+    HashGroup g;
+    g.fk_hash_video = videoId;
+    g.bits = 64;
+    for (std::size_t i = 0; i + 1 < subs.size(); ++i)
+        if (subs[i] && subs[i + 1])
+            g.hashes.push_back(std::uint64_t { subs[i] } | std::uint64_t { subs[i + 1] } << 32);
+    if (g.hashes.size() < kMinHashes)
+        g.hashes.clear();
+    return g;
+}
+
+} // namespace audiofp
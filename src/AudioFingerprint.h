@@ -0,0 +1,49 @@
+#pragma once
+
+#include "Hash.h"
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+// Audio fingerprints: a second similarity channel for copies whose picture
+// was cropped, overlaid or re-graded but whose soundtrack was only
+// re-encoded.
+//
+// The first audio stream is decoded, downmixed to mono and brought down to
+// kSampleRate by a box-filter decimator (the bands used sit far below the
+// new Nyquist, and both sides of a comparison go through the same filter).
+// Every kHop samples a Hann-windowed kFrame-sample window goes through a
+// real FFT (libavutil's av_tx, which has SIMD kernels), its energy is
+// summed into kBands log-spaced bands between 300 and 2000 Hz, and bit m
+// of the 32-bit sub-fingerprint is the sign of the band-energy difference
+// E(m) - E(m+1) minus the same difference one frame earlier.  Silent
+// frames give 0.
+//
+// For searching, two consecutive sub-fingerprints make one 64-bit word so
+// audio goes through the same MatchIndex as 64-bit pHashes (hash_group).
+namespace audiofp
+{
+    constexpr int         kSampleRate = 5512;
+    constexpr std::size_t kFrame = 4096; // ~0.74 s
+    constexpr std::size_t kHop = 2048;   // ~2.7 sub-fingerprints per second
+    constexpr std::size_t kBands = 33;
+    // fewer searchable words than this (~6 s of sound) are too few to tell
+    // one track from another; such tracks take no part in matching
+    constexpr std::size_t kMinHashes = 16;
+
+    // Sub-fingerprints of mono samples at kSampleRate, one per hop after
+    // the first frame.
+    std::vector<std::uint32_t>         fingerprint(std::span<float const> samples);
+
+    // Sub-fingerprints of the file's first audio stream; empty if it has
+    // none, nullopt if it could not be decoded within timeBudgetSec
+    // (0 = unlimited).
+    std::optional<std::vector<std::uint32_t>> extract(std::string const& path, int timeBudgetSec);
+
+    // Searchable 64-bit words (sub-fingerprints i and i+1) of one video;
+    // pairs touching silence are left out, and short tracks give none.
+    HashGroup                          hash_group(int videoId, std::span<std::uint32_t const> subs);
+} // namespace audiofp
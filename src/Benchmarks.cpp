@@ -0,0 +1,433 @@
+#include "Benchmarks.h"
+#include "Hash.h"
+#include "LshIndex.h"
+#include "MatchIndex.h"
+#include "MpmcRing.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <hft/hftrie.hpp>
+#include <mutex>
+#include <numeric>
+#include <random>
+#include <stop_token>
+#include <string>
+#include <thread>
+
+namespace bench {
+
+namespace {
+
+// The queue SlowVideoProcessor used before MpmcRing, kept as the baseline.
+template<class T>
+class LockedQueue {
+public:
+    explicit LockedQueue(std::size_t cap) : cap_(cap) {}
+
+    bool push(T&& v, std::stop_token const& tk) {
+        std::unique_lock lk(m_);
+        cv_not_full_.wait(lk, [&] { return q_.size() < cap_ || tk.stop_requested(); });
+        if (tk.stop_requested())
+            return false;
+        q_.emplace_back(std::move(v));
+        cv_not_empty_.notify_one();
+        return true;
+    }
+
+    bool pop(T& out, std::stop_token const& tk) {
+        std::unique_lock lk(m_);
+        cv_not_empty_.wait(lk, [&] { return !q_.empty() || tk.stop_requested(); });
+        if (tk.stop_requested())
+            return false;
+        out = std::move(q_.front());
+        q_.pop_front();
+        cv_not_full_.notify_one();
+        return true;
+    }
+
+private:
+    std::mutex m_;
+    std::condition_variable cv_not_empty_, cv_not_full_;
+    std::deque<T> q_;
+    std::size_t const cap_;
+};
+
+struct Params {
+    int producers = 1;
+    int consumers = 8;
+    std::uint64_t items = 2'000'000;
+    std::size_t capacity = 64;
+};
+
+struct Result {
+    double seconds = 0;
+    std::uint64_t checksum = 0;
+};
+
+template<class Fn>
+Result timed(Fn&& body)
+{
+    std::atomic<std::uint64_t> sum { 0 };
+    auto const t0 = std::chrono::steady_clock::now();
+    body(sum);
+    auto const t1 = std::chrono::steady_clock::now();
+    return { std::chrono::duration<double>(t1 - t0).count(), sum.load() };
+}
+
+// Items are 1..N split across producers; 0 is the consumers' stop value.
+Result bench_locked(Params const& p)
+{
+    return timed([&](std::atomic<std::uint64_t>& sum) {
+        LockedQueue<std::uint64_t> q { p.capacity };
+        std::vector<std::jthread> cons;
+        for (int c = 0; c < p.consumers; ++c) {
+            cons.emplace_back([&] {
+                std::uint64_t local = 0, v = 0;
+                while (q.pop(v, {}) && v != 0)
+                    local += v;
+                sum += local;
+            });
+        }
+        {
+            std::vector<std::jthread> prod;
+            for (int i = 0; i < p.producers; ++i) {
+                prod.emplace_back([&, i] {
+                    for (std::uint64_t v = 1 + i; v <= p.items; v += p.producers)
+                        q.push(std::uint64_t { v }, {});
+                });
+            }
+        }
+        for (int c = 0; c < p.consumers; ++c)
+            q.push(0, {});
+    });
+}
+
+Result bench_ring(Params const& p, std::size_t batch)
+{
+    return timed([&](std::atomic<std::uint64_t>& sum) {
+        MpmcRing<std::uint64_t> q { p.capacity };
+        std::vector<std::jthread> cons;
+        for (int c = 0; c < p.consumers; ++c) {
+            cons.emplace_back([&] {
+                std::vector<std::uint64_t> buf(batch);
+                std::uint64_t local = 0;
+                while (std::size_t const n = q.pop_bulk(buf.data(), batch, {}))
+                    for (std::size_t i = 0; i < n; ++i)
+                        local += buf[i];
+                sum += local;
+            });
+        }
+        {
+            std::vector<std::jthread> prod;
+            for (int i = 0; i < p.producers; ++i) {
+                prod.emplace_back([&, i] {
+                    for (std::uint64_t v = 1 + i; v <= p.items; v += p.producers)
+                        q.push(std::uint64_t { v }, {});
+                });
+            }
+        }
+        q.close();
+    });
+}
+
+template<class T>
+bool parse_arg(std::vector<std::string_view> const& args, std::size_t i, T& out)
+{
+    if (i >= args.size())
+        return true;
+    auto const sv = args[i];
+    auto const [ptr, ec] = std::from_chars(sv.data(), sv.data() + sv.size(), out);
+    return ec == std::errc {} && ptr == sv.data() + sv.size() && out > 0;
+}
+
+// Clustered like a real library: each base hash has a few copies at up to
+// 24 bits' distance (re-encodes), and every query is a fresh perturbation of
+// a random base, so each radius has true neighbours to find.
+struct LshData {
+    std::size_t words;
+    std::vector<std::uint64_t> stored;  // words per hash
+    std::vector<std::uint64_t> queries; // words per query
+};
+
+void flip_bits(std::uint64_t* h, unsigned bits, unsigned count, std::mt19937_64& rng)
+{
+    std::uniform_int_distribution<unsigned> pos(0, bits - 1);
+    std::uint64_t done[4] {};
+    while (count) {
+        unsigned const b = pos(rng);
+        if (done[b >> 6] >> (b & 63) & 1)
+            continue;
+        done[b >> 6] |= std::uint64_t { 1 } << (b & 63);
+        h[b >> 6] ^= std::uint64_t { 1 } << (b & 63);
+        --count;
+    }
+}
+
+LshData make_lsh_data(std::size_t hashes, std::size_t queries, unsigned bits)
+{
+    constexpr std::size_t kCopies = 8;
+    std::mt19937_64 rng(0x6e6476);
+    std::uniform_int_distribution<unsigned> dist(0, 24);
+    LshData d { bits / 64u, {}, {} };
+    std::size_t const bases = std::max<std::size_t>(1, hashes / kCopies);
+    std::vector<std::uint64_t> base(bases * d.words);
+    for (auto& w : base)
+        w = rng();
+
+    d.stored.resize(hashes * d.words);
+    for (std::size_t i = 0; i < hashes; ++i) {
+        std::uint64_t* h = d.stored.data() + i * d.words;
+        std::copy_n(base.data() + (i % bases) * d.words, d.words, h);
+        flip_bits(h, bits, dist(rng), rng);
+    }
+    d.queries.resize(queries * d.words);
+    std::uniform_int_distribution<std::size_t> pick(0, bases - 1);
+    for (std::size_t i = 0; i < queries; ++i) {
+        std::uint64_t* q = d.queries.data() + i * d.words;
+        std::copy_n(base.data() + pick(rng) * d.words, d.words, q);
+        flip_bits(q, bits, dist(rng), rng);
+    }
+    return d;
+}
+
+std::size_t brute_force(unsigned bits, std::uint64_t const* q, LshData const& d, unsigned radius,
+    std::vector<std::uint32_t>& idx)
+{
+    std::size_t const n = d.stored.size() / d.words;
+    idx.resize(n);
+    switch (bits) {
+    case 128:
+        return simd::hamming_within128(q, d.stored.data(), n, radius, idx.data());
+    case 256:
+        return simd::hamming_within256(q, d.stored.data(), n, radius, idx.data());
+    default:
+        return simd::hamming_within(q[0], d.stored.data(), n, radius, idx.data());
+    }
+}
+
+template<class Fn>
+double seconds_for(Fn&& body)
+{
+    auto const t0 = std::chrono::steady_clock::now();
+    body();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+}
+
+// Query groups of `perVideo` hashes out of make_lsh_data's queries, the
+// shape of a daemon query for one file.
+std::vector<HashGroup> make_query_groups(LshData const& d, unsigned bits, std::size_t perVideo)
+{
+    std::size_t const stride = perVideo * d.words;
+    std::vector<HashGroup> groups;
+    for (std::size_t at = 0; at + stride <= d.queries.size(); at += stride) {
+        HashGroup& g = groups.emplace_back();
+        g.fk_hash_video = -1;
+        g.bits = bits;
+        g.hashes.assign(d.queries.begin() + static_cast<std::ptrdiff_t>(at),
+            d.queries.begin() + static_cast<std::ptrdiff_t>(at + stride));
+    }
+    return groups;
+}
+
+struct Latency {
+    double mean = 0, p50 = 0, p99 = 0; // ms per matches() call
+};
+
+Latency summarize(std::vector<double>& ms)
+{
+    if (ms.empty())
+        return {};
+    std::ranges::sort(ms);
+    auto const at = [&](double q) { return ms[static_cast<std::size_t>(q * static_cast<double>(ms.size() - 1))]; };
+    return { std::accumulate(ms.begin(), ms.end(), 0.0) / static_cast<double>(ms.size()), at(0.50), at(0.99) };
+}
+
+// Every group queried once by each of `threads` threads at the same time,
+// as the daemon's connections do under its shared lock.
+Latency time_matches(MatchIndex const& index, std::vector<HashGroup> const& groups,
+    MatchIndex::Criteria const& c, unsigned threads, std::size_t& found)
+{
+    std::vector<std::vector<double>> perThread(threads);
+    std::atomic<std::size_t> total { 0 };
+    {
+        std::vector<std::jthread> pool;
+        for (unsigned t = 0; t < threads; ++t) {
+            pool.emplace_back([&, t] {
+                std::size_t local = 0;
+                for (auto const& g : groups)
+                    perThread[t].push_back(seconds_for([&] { local += index.matches(g, c).size(); }) * 1e3);
+                total += local;
+            });
+        }
+    }
+    std::vector<double> ms;
+    for (auto const& v : perThread)
+        ms.insert(ms.end(), v.begin(), v.end());
+    found = total / threads;
+    return summarize(ms);
+}
+
+} // namespace
+
+int runQueueBenchmark(std::vector<std::string_view> const& args)
+{
+    Params p;
+    if (!parse_arg(args, 0, p.producers) || !parse_arg(args, 1, p.consumers)
+        || !parse_arg(args, 2, p.items) || !parse_arg(args, 3, p.capacity)) {
+        spdlog::error("[bench] usage: --bench-queue [producers] [consumers] [items] [capacity]");
+        return 2;
+    }
+
+    std::uint64_t const expected = p.items * (p.items + 1) / 2;
+    spdlog::info("[bench] queue: {} producer(s), {} consumer(s), {} items, capacity {}",
+        p.producers, p.consumers, p.items, p.capacity);
+
+    auto report = [&](char const* name, Result const& r) {
+        double const nsPerItem = r.seconds * 1e9 / static_cast<double>(p.items);
+        spdlog::info("[bench] {:<22} {:8.3f} s  {:8.1f} ns/item  {:6.2f} Mitems/s{}",
+            name, r.seconds, nsPerItem, p.items / r.seconds / 1e6,
+            r.checksum == expected ? "" : "  CHECKSUM MISMATCH");
+        return r.checksum == expected;
+    };
+
+    bool ok = true;
+    ok &= report("mutex+condvar deque", bench_locked(p));
+    ok &= report("MpmcRing pop", bench_ring(p, 1));
+    ok &= report("MpmcRing pop_bulk(8)", bench_ring(p, 8));
+    return ok ? 0 : 1;
+}
+
+int runLshBenchmark(std::vector<std::string_view> const& args)
+{
+    std::size_t hashes = 1'000'000, queries = 2'000;
+    unsigned bits = 64;
+    double target = 0.95;
+    if (!parse_arg(args, 0, hashes) || !parse_arg(args, 1, queries) || !parse_arg(args, 2, bits)
+        || !parse_arg(args, 3, target) || !valid_hash_bits(bits) || target >= 1.0) {
+        spdlog::error("[bench] usage: --bench-lsh [hashes] [queries] [64|128|256] [target recall, e.g. 0.95]");
+        return 2;
+    }
+
+    spdlog::info("[bench] lsh: {} {}-bit hashes, {} queries, target recall {:.3f}", hashes, bits, queries, target);
+    auto const d = make_lsh_data(hashes, queries, bits);
+
+    // the exact index as MatchIndex builds it: word 0 in the trie, wider
+    // hashes confirmed over their full width
+    hft::HFTrie trie;
+    double const trieBuild = seconds_for([&] {
+        for (std::size_t i = 0; i < hashes; ++i)
+            trie.Insert({ static_cast<int>(i), d.stored[i * d.words] });
+    });
+    spdlog::info("[bench] trie built in {:.2f} s", trieBuild);
+
+    bool ok = true;
+    std::vector<std::uint32_t> idx;
+    for (unsigned radius : { 8u, 12u, 16u }) {
+        std::size_t truth = 0, viaTrie = 0, viaLsh = 0, candidates = 0;
+        double const bruteSecs = seconds_for([&] {
+            for (std::size_t q = 0; q < queries; ++q)
+                truth += brute_force(bits, d.queries.data() + q * d.words, d, radius, idx);
+        });
+
+        double const trieSecs = seconds_for([&] {
+            for (std::size_t q = 0; q < queries; ++q) {
+                std::uint64_t const* qh = d.queries.data() + q * d.words;
+                for (auto const& r : trie.RangeSearchFast(qh[0], static_cast<int>(radius))) {
+                    std::uint64_t const* h = d.stored.data() + static_cast<std::size_t>(r.id) * d.words;
+                    unsigned dist = 0;
+                    for (std::size_t w = 0; w < d.words; ++w)
+                        dist += static_cast<unsigned>(std::popcount(qh[w] ^ h[w]));
+                    viaTrie += dist <= radius;
+                }
+            }
+        });
+
+        auto const params = LshIndex::for_recall(bits, radius, target);
+        LshIndex lsh(bits, params);
+        double const lshBuild = seconds_for([&] {
+            for (std::size_t i = 0; i < hashes; ++i)
+                lsh.insert(static_cast<int>(i), d.stored.data() + i * d.words);
+        });
+        std::vector<int> found;
+        double const lshSecs = seconds_for([&] {
+            for (std::size_t q = 0; q < queries; ++q) {
+                found.clear();
+                candidates += lsh.search(d.queries.data() + q * d.words, radius, found);
+                viaLsh += found.size();
+            }
+        });
+
+        double const recall = truth ? static_cast<double>(viaLsh) / static_cast<double>(truth) : 1.0;
+        auto const perQuery = [&](double secs) { return secs * 1e3 / static_cast<double>(queries); };
+        spdlog::info("[bench] radius {:>2}: {} neighbours; LSH {} tables x {} bits{} (built in {:.2f} s), "
+                     "recall {:.3f} (expected >= {:.3f}), {:.0f} candidates/query",
+            radius, truth, params.tables, params.sampleBits, lsh.scans() ? ", scanning" : "", lshBuild, recall,
+            LshIndex::recall(bits, radius, params), static_cast<double>(candidates) / static_cast<double>(queries));
+        spdlog::info("[bench]            brute force {:8.3f} ms/q   trie {:8.3f} ms/q   LSH {:8.3f} ms/q"
+                     "   ({:.1f}x vs trie, {:.1f}x vs brute force){}",
+            perQuery(bruteSecs), perQuery(trieSecs), perQuery(lshSecs),
+            trieSecs / lshSecs, bruteSecs / lshSecs, viaTrie == truth ? "" : "  TRIE MISMATCH");
+        ok &= viaTrie == truth && viaLsh <= truth;
+    }
+    return ok ? 0 : 1;
+}
+
+int runMatchBenchmark(std::vector<std::string_view> const& args)
+{
+    std::size_t hashes = 10'000'000, perVideo = 600, queries = 200;
+    unsigned bits = 64;
+    std::uint64_t radius = 4;
+    if (!parse_arg(args, 0, hashes) || !parse_arg(args, 1, perVideo) || !parse_arg(args, 2, queries)
+        || !parse_arg(args, 3, bits) || !parse_arg(args, 4, radius) || !valid_hash_bits(bits) || radius > bits) {
+        spdlog::error("[bench] usage: --bench-match [hashes] [hashes per video] [queries] [64|128|256] [radius]");
+        return 2;
+    }
+
+    spdlog::info("[bench] match: {} {}-bit hashes in videos of {}, {} queries at radius {}",
+        hashes, bits, perVideo, queries, radius);
+    auto const d = make_lsh_data(hashes, queries * perVideo, bits);
+    auto const groups = make_query_groups(d, bits, perVideo);
+    MatchIndex::Criteria c;
+    c.searchRange = radius;
+
+    unsigned const threads = std::max(2u, std::thread::hardware_concurrency());
+    auto run = [&](char const* name, std::optional<LshIndex::Params> approximate) {
+        MatchIndex index(bits, approximate);
+        double const build = seconds_for([&] {
+            HashGroup v;
+            v.bits = bits;
+            for (std::size_t first = 0; first < hashes; first += perVideo) {
+                std::size_t const n = std::min(perVideo, hashes - first);
+                v.fk_hash_video = static_cast<int>(first / perVideo);
+                v.hashes.assign(d.stored.begin() + static_cast<std::ptrdiff_t>(first * d.words),
+                    d.stored.begin() + static_cast<std::ptrdiff_t>((first + n) * d.words));
+                index.add(v);
+            }
+        });
+        std::size_t found = 0;
+        Latency const one = time_matches(index, groups, c, 1, found);
+        std::size_t foundShared = 0;
+        Latency const shared = time_matches(index, groups, c, threads, foundShared);
+        spdlog::info("[bench] {:<26} built in {:6.2f} s, {:.1f} matches/query", name, build,
+            static_cast<double>(found) / static_cast<double>(groups.size()));
+        spdlog::info("[bench]   1 thread:   mean {:8.3f} ms  p50 {:8.3f} ms  p99 {:8.3f} ms  ({:.2f} us/hash)",
+            one.mean, one.p50, one.p99, one.mean * 1e3 / static_cast<double>(perVideo));
+        spdlog::info("[bench]   {:>2} threads: mean {:8.3f} ms  p50 {:8.3f} ms  p99 {:8.3f} ms{}",
+            threads, shared.mean, shared.p50, shared.p99, foundShared == found ? "" : "  RESULT MISMATCH");
+        return foundShared == found;
+    };
+
+    bool ok = run("exact (trie)", std::nullopt);
+    auto const params = LshIndex::for_recall(bits, static_cast<unsigned>(radius), 0.95);
+    ok &= run(fmt::format("LSH {}x{} (recall 0.95)", params.tables, params.sampleBits).c_str(), params);
+    return ok ? 0 : 1;
+}
+
+} // namespace bench
@@ -0,0 +1,23 @@
+#pragma once
+#include <string_view>
+#include <vector>
+
+// Micro-benchmarks run from the command line; each returns an exit code.
+namespace bench
+{
+    // Lock-free MpmcRing against the old mutex + condvar queue.
+    //   --bench-queue [producers] [consumers] [items] [capacity]
+    int                                runQueueBenchmark(std::vector<std::string_view> const& args);
+
+    // Bit-sampling LSH against the trie and a brute-force scan, on clustered
+    // synthetic hashes: recall versus brute force and speed-up at radius 8,
+    // 12 and 16.
+    //   --bench-lsh [hashes] [queries] [bits] [target recall]
+    int                                runLshBenchmark(std::vector<std::string_view> const& args);
+
+    // MatchIndex::matches latency for one file's worth of query hashes, the
+    // work behind a daemon query, on the exact and the LSH index: mean, p50
+    // and p99 from one thread, then from every core at once.
+    //   --bench-match [hashes] [hashes per video] [queries] [bits] [radius]
+    int                                runMatchBenchmark(std::vector<std::string_view> const& args);
+} // namespace bench
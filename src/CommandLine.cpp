@@ -0,0 +1,41 @@
+#include "CommandLine.h"
+#include "Benchmarks.h"
+#include "GoldenHashes.h"
+#include "HashWorker.h"
+#include "MatchDaemon.h"
+#include "MatchQuery.h"
+
+#include <spdlog/spdlog.h>
+
+#include <string_view>
+#include <vector>
+
+namespace cli {
+
+std::optional<int> runHeadless(int argc, char* argv[])
+{
+    if (argc < 2)
+        return std::nullopt;
+
+    std::string_view const cmd = argv[1];
+    std::vector<std::string_view> const args(argv + 2, argv + argc);
+
+    if (cmd == "--bench-queue")
+        return bench::runQueueBenchmark(args);
+    if (cmd == "--bench-lsh")
+        return bench::runLshBenchmark(args);
+    if (cmd == "--bench-match")
+        return bench::runMatchBenchmark(args);
+    if (cmd == "--verify-hashes")
+        return golden::runVerifyHashes(args);
+    if (cmd == "--hash-worker")
+        return worker::runHashWorker(args);
+    if (cmd == "--daemon")
+        return matchd::runDaemon(args);
+    if (cmd == "--query")
+        return query::runQuery(args);
+
+    return std::nullopt;
+}
+
+} // namespace cli
@@ -0,0 +1,10 @@
+#pragma once
+#include <optional>
+
+// Headless entry points selected by the first argument (--bench-queue, …).
+// They run before QApplication is created.
+namespace cli
+{
+    // Exit code if argv named a headless command, std::nullopt otherwise.
+    std::optional<int>                 runHeadless(int argc, char* argv[]);
+} // namespace cli
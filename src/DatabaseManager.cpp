@@ -1,5 +1,6 @@
 #include "DatabaseManager.h"
 #include "Hash.h"
+#include "HashBlob.h"
 #include "SearchSettings.h"
 #include "VideoInfo.h"
 
@@ -9,6 +10,8 @@
 #include <spdlog/spdlog.h>
 #include <sqlite3.h>
 
+#include <charconv>
+#include <cstring>
 #include <memory>
 #include <nlohmann/json.hpp>
 #include <optional>
@@ -37,6 +40,66 @@ void checkRc(int rc, sqlite3* db, std::string const& context)
     }
 }
 
+// A modified_at column: ns since the epoch.  Databases from before that
+// hold formatted local-time text, which reads as 0 (unknown) and so never
+// equals a file's current mtime; a column declared TEXT there keeps the
+// new values as digit strings.
+std::int64_t mtimeColumn(sqlite3_stmt* stmt, int col)
+{
+    if (sqlite3_column_type(stmt, col) == SQLITE_INTEGER)
+        return sqlite3_column_int64(stmt, col);
+    auto const* t = reinterpret_cast<char const*>(sqlite3_column_text(stmt, col));
+    std::string_view const text = t ? t : "";
+    std::int64_t ns = 0;
+    auto const [end, ec] = std::from_chars(text.data(), text.data() + text.size(), ns);
+    return ec == std::errc {} && end == text.data() + text.size() ? ns : 0;
+}
+
+// Words of a hash / variant blob column in either hashblob::Format;
+// std::nullopt if the column is empty or does not decode.
+std::optional<std::vector<uint64_t>> readHashWords(sqlite3_stmt* stmt, int col, hashblob::Format format)
+{
+    auto const* data = static_cast<std::uint8_t const*>(sqlite3_column_blob(stmt, col));
+    int const bytes = sqlite3_column_bytes(stmt, col);
+    if (!data || bytes <= 0)
+        return std::nullopt;
+    if (format == hashblob::Format::Packed)
+        return hashblob::unpack({ data, static_cast<std::size_t>(bytes) });
+    if (format != hashblob::Format::Raw || bytes % sizeof(uint64_t) != 0)
+        return std::nullopt;
+    std::vector<uint64_t> words(bytes / sizeof(uint64_t));
+    std::memcpy(words.data(), data, static_cast<std::size_t>(bytes));
+    return words;
+}
+
+// One hash row (video_id, hashes, variants, bits, blob_format), where a
+// packed row's packed_blob / packed_variants stand in for the raw columns;
+// std::nullopt if empty, undecodable or not a whole number of hashes of
+// its width.
+std::optional<HashGroup> readHashGroup(sqlite3_stmt* stmt)
+{
+    int vid = sqlite3_column_int(stmt, 0);
+    HashGroup grp;
+    grp.fk_hash_video = vid;
+    if (sqlite3_column_type(stmt, 3) != SQLITE_NULL)
+        grp.bits = static_cast<unsigned>(sqlite3_column_int(stmt, 3));
+    auto const format = static_cast<hashblob::Format>(sqlite3_column_int(stmt, 4)); // NULL reads as Raw
+
+    auto hashes = readHashWords(stmt, 1, format);
+    if (!hashes || hashes->empty())
+        return std::nullopt;
+    if (!valid_hash_bits(grp.bits) || hashes->size() % grp.words() != 0) {
+        spdlog::warn("skipping hash row of video {}: {} words at {} bits", vid, hashes->size(), grp.bits);
+        return std::nullopt;
+    }
+    grp.hashes = std::move(*hashes);
+
+    auto variants = readHashWords(stmt, 2, format);
+    if (variants && variants->size() == grp.hashes.size() * (kPHashOrientations - 1))
+        grp.variants = std::move(*variants);
+    return grp;
+}
+
 } // namespace
 
 DatabaseManager::DatabaseManager(std::string const& dbPath)
@@ -81,7 +144,7 @@ std::optional<int> DatabaseManager::insertVideo(VideoInfo& video)
     try {
         auto stmt = prepareStatement(m_db, sql);
         checkRc(sqlite3_bind_text(stmt.get(), 1, video.path.c_str(), -1, SQLITE_TRANSIENT), m_db, "bind path");
-        checkRc(sqlite3_bind_text(stmt.get(), 2, video.modified_at.c_str(), -1, SQLITE_TRANSIENT), m_db, "bind modified_at");
+        checkRc(sqlite3_bind_int64(stmt.get(), 2, video.modified_at), m_db, "bind modified_at");
         checkRc(sqlite3_bind_text(stmt.get(), 3, video.video_codec.c_str(), -1, SQLITE_TRANSIENT), m_db, "bind video_codec");
         checkRc(sqlite3_bind_text(stmt.get(), 4, video.audio_codec.c_str(), -1, SQLITE_TRANSIENT), m_db, "bind audio_codec");
         checkRc(sqlite3_bind_text(stmt.get(), 5, video.pix_fmt.c_str(), -1, SQLITE_TRANSIENT), m_db, "bind pix_fmt");
@@ -90,7 +153,7 @@ std::optional<int> DatabaseManager::insertVideo(VideoInfo& video)
         checkRc(sqlite3_bind_int(stmt.get(), 8, video.width), m_db, "bind width");
         checkRc(sqlite3_bind_int(stmt.get(), 9, video.height), m_db, "bind height");
         checkRc(sqlite3_bind_int(stmt.get(), 10, video.duration), m_db, "bind duration");
-        checkRc(sqlite3_bind_int(stmt.get(), 11, video.size), m_db, "bind size");
+        checkRc(sqlite3_bind_int64(stmt.get(), 11, video.size), m_db, "bind size");
         checkRc(sqlite3_bind_int(stmt.get(), 12, video.bit_rate), m_db, "bind bit_rate");
         checkRc(sqlite3_bind_int(stmt.get(), 13, video.num_hard_links), m_db, "bind num_hard_links");
         checkRc(sqlite3_bind_int64(stmt.get(), 14, static_cast<sqlite3_int64>(video.inode)), m_db, "bind inode");
@@ -112,27 +175,63 @@ std::optional<int> DatabaseManager::insertVideo(VideoInfo& video)
     }
 }
 
-bool DatabaseManager::insertAllHashes(int video_id, std::vector<uint64_t> const& pHashes)
+bool DatabaseManager::insertAllHashes(int video_id, std::vector<uint64_t> const& pHashes,
+    bool withVariants, unsigned bits)
 {
     if (pHashes.empty())
         return true;
 
+    // pHashes holds kPHashOrientations entries per frame when withVariants is
+    // set; the originals (the searched ones) and the others are stored apart.
+    // Raw rows use hash_blob / variant_blob, which every version reads.
+    // Packed rows use packed_blob / packed_variants, which readers from
+    // before blob_format never select, and leave hash_blob empty, a row
+    // those readers skip.
+    auto const group = make_hash_group(video_id, pHashes, withVariants, bits);
+    if (!group) {
+        spdlog::error("insertAllHashes: {} words is not a whole number of {}-bit frames ({} orientations)",
+            pHashes.size(), bits, withVariants ? kPHashOrientations : 1);
+        return false;
+    }
+    auto const& hashBlob = group->hashes;
+    auto const& variants = group->variants;
+
+    // packed unless that comes out larger (unrelated frames, e.g. cuts only)
+    std::size_t const stride = group->words();
+    auto const packedHashes = hashblob::pack(hashBlob, stride);
+    auto const packedVariants = variants.empty()
+        ? std::vector<std::uint8_t> {}
+        : hashblob::pack(variants, stride * (kPHashOrientations - 1));
+    bool const packed = packedHashes.size() + packedVariants.size()
+        < (hashBlob.size() + variants.size()) * sizeof(uint64_t);
+    auto const format = packed ? hashblob::Format::Packed : hashblob::Format::Raw;
+
     static constexpr auto sql = R"(
-        INSERT INTO hash (video_id, hash_blob) VALUES (?,?);
+        INSERT OR REPLACE INTO hash (video_id, hash_blob, variant_blob, packed_blob, packed_variants,
+                                     bits, blob_format, algo_version)
+        VALUES (?,?,?,?,?,?,?,?);
     )";
 
     try {
         auto stmt = prepareStatement(m_db, sql);
+        // empty → NULL, except hash_blob (NOT NULL), which gets a zero-length blob
+        auto bindBlob = [&](int col, void const* data, std::size_t bytes, char const* what) {
+            int const rc = bytes > 0
+                ? sqlite3_bind_blob(stmt.get(), col, data, static_cast<int>(bytes), SQLITE_TRANSIENT)
+                : col == 2 ? sqlite3_bind_zeroblob(stmt.get(), col, 0)
+                           : sqlite3_bind_null(stmt.get(), col);
+            checkRc(rc, m_db, what);
+        };
+        std::size_t const rawBytes = packed ? 0 : hashBlob.size() * sizeof(uint64_t);
+        std::size_t const rawVariantBytes = packed ? 0 : variants.size() * sizeof(uint64_t);
         checkRc(sqlite3_bind_int(stmt.get(), 1, video_id), m_db, "bind video_id");
-        checkRc(
-            sqlite3_bind_blob(
-                stmt.get(),
-                2,
-                reinterpret_cast<void const*>(pHashes.data()),
-                static_cast<int>(pHashes.size() * sizeof(uint64_t)),
-                SQLITE_TRANSIENT),
-            m_db,
-            "bind hash_blob");
+        bindBlob(2, hashBlob.data(), rawBytes, "bind hash_blob");
+        bindBlob(3, variants.data(), rawVariantBytes, "bind variant_blob");
+        bindBlob(4, packedHashes.data(), packed ? packedHashes.size() : 0, "bind packed_blob");
+        bindBlob(5, packedVariants.data(), packed ? packedVariants.size() : 0, "bind packed_variants");
+        checkRc(sqlite3_bind_int(stmt.get(), 6, static_cast<int>(group->bits)), m_db, "bind bits");
+        checkRc(sqlite3_bind_int(stmt.get(), 7, static_cast<int>(format)), m_db, "bind blob_format");
+        checkRc(sqlite3_bind_int(stmt.get(), 8, kPHashAlgoVersion), m_db, "bind algo_version");
         checkRc(sqlite3_step(stmt.get()), m_db, "execute insertAllHashes");
         return true;
     } catch (std::exception const& ex) {
@@ -161,7 +260,7 @@ std::vector<VideoInfo> DatabaseManager::getAllVideos() const
                 VideoInfo v;
                 v.id = sqlite3_column_int(stmt.get(), 0);
                 v.path = reinterpret_cast<char const*>(sqlite3_column_text(stmt.get(), 1));
-                v.modified_at = reinterpret_cast<char const*>(sqlite3_column_text(stmt.get(), 2));
+                v.modified_at = mtimeColumn(stmt.get(), 2);
                 v.video_codec = reinterpret_cast<char const*>(sqlite3_column_text(stmt.get(), 3));
                 v.audio_codec = reinterpret_cast<char const*>(sqlite3_column_text(stmt.get(), 4));
                 v.pix_fmt = reinterpret_cast<char const*>(sqlite3_column_text(stmt.get(), 5));
@@ -170,7 +269,7 @@ std::vector<VideoInfo> DatabaseManager::getAllVideos() const
                 v.width = sqlite3_column_int(stmt.get(), 8);
                 v.height = sqlite3_column_int(stmt.get(), 9);
                 v.duration = sqlite3_column_int(stmt.get(), 10);
-                v.size = sqlite3_column_int(stmt.get(), 11);
+                v.size = sqlite3_column_int64(stmt.get(), 11);
                 v.bit_rate = sqlite3_column_int(stmt.get(), 12);
                 v.num_hard_links = sqlite3_column_int(stmt.get(), 13);
                 v.inode = static_cast<long>(sqlite3_column_int64(stmt.get(), 14));
@@ -209,24 +308,18 @@ std::vector<VideoInfo> DatabaseManager::getAllVideos() const
 
 std::vector<HashGroup> DatabaseManager::getAllHashGroups() const
 {
-    static constexpr auto sql = "SELECT video_id, hash_blob FROM hash;";
+    static constexpr auto sql = R"(
+        SELECT video_id, IFNULL(packed_blob, hash_blob), IFNULL(packed_variants, variant_blob),
+               bits, blob_format FROM hash;
+    )";
     std::vector<HashGroup> results;
     try {
         auto stmt = prepareStatement(m_db, sql);
         while (true) {
             int rc = sqlite3_step(stmt.get());
             if (rc == SQLITE_ROW) {
-                int vid = sqlite3_column_int(stmt.get(), 0);
-                auto blobPtr = sqlite3_column_blob(stmt.get(), 1);
-                int bytes = sqlite3_column_bytes(stmt.get(), 1);
-                if (blobPtr && bytes > 0) {
-                    size_t count = bytes / sizeof(uint64_t);
-                    auto const* raw = static_cast<uint64_t const*>(blobPtr);
-                    HashGroup grp;
-                    grp.fk_hash_video = vid;
-                    grp.hashes.assign(raw, raw + count);
-                    results.push_back(std::move(grp));
-                }
+                if (auto grp = readHashGroup(stmt.get()))
+                    results.push_back(std::move(*grp));
             } else if (rc == SQLITE_DONE) {
                 break;
             } else {
@@ -240,6 +333,315 @@ std::vector<HashGroup> DatabaseManager::getAllHashGroups() const
     return results;
 }
 
+std::optional<HashGroup> DatabaseManager::getHashGroup(int videoId) const
+{
+    static constexpr auto sql = R"(
+        SELECT video_id, IFNULL(packed_blob, hash_blob), IFNULL(packed_variants, variant_blob),
+               bits, blob_format FROM hash
+        WHERE video_id = ?;
+    )";
+    try {
+        auto stmt = prepareStatement(m_db, sql);
+        checkRc(sqlite3_bind_int(stmt.get(), 1, videoId), m_db, "bind video_id");
+        if (sqlite3_step(stmt.get()) != SQLITE_ROW)
+            return std::nullopt;
+        return readHashGroup(stmt.get());
+    } catch (std::exception const& ex) {
+        spdlog::error("getHashGroup failed: {}", ex.what());
+        return std::nullopt;
+    }
+}
+
+std::vector<int> DatabaseManager::getHashedVideoIds() const
+{
+    static constexpr auto sql = "SELECT video_id FROM hash;";
+    std::vector<int> ids;
+    try {
+        auto stmt = prepareStatement(m_db, sql);
+        int rc;
+        while ((rc = sqlite3_step(stmt.get())) == SQLITE_ROW)
+            ids.push_back(sqlite3_column_int(stmt.get(), 0));
+        checkRc(rc, m_db, "step getHashedVideoIds");
+    } catch (std::exception const& ex) {
+        spdlog::error("getHashedVideoIds failed: {}", ex.what());
+    }
+    return ids;
+}
+
+std::unordered_map<int, unsigned> DatabaseManager::getHashBits() const
+{
+    static constexpr auto sql = "SELECT video_id, bits FROM hash;";
+    std::unordered_map<int, unsigned> bits;
+    try {
+        auto stmt = prepareStatement(m_db, sql);
+        int rc;
+        while ((rc = sqlite3_step(stmt.get())) == SQLITE_ROW)
+            bits.emplace(sqlite3_column_int(stmt.get(), 0),
+                sqlite3_column_type(stmt.get(), 1) == SQLITE_NULL
+                    ? 64u
+                    : static_cast<unsigned>(sqlite3_column_int(stmt.get(), 1)));
+        checkRc(rc, m_db, "step getHashBits");
+    } catch (std::exception const& ex) {
+        spdlog::error("getHashBits failed: {}", ex.what());
+    }
+    return bits;
+}
+
+std::unordered_set<int> DatabaseManager::getStaleHashIds(unsigned bits) const
+{
+    static constexpr auto sql = R"(
+        SELECT video_id FROM hash
+        WHERE IFNULL(bits, 64) != ? OR IFNULL(algo_version, 0) != ?;
+    )";
+    std::unordered_set<int> ids;
+    try {
+        auto stmt = prepareStatement(m_db, sql);
+        checkRc(sqlite3_bind_int(stmt.get(), 1, static_cast<int>(bits)), m_db, "bind bits");
+        checkRc(sqlite3_bind_int(stmt.get(), 2, kPHashAlgoVersion), m_db, "bind algo_version");
+        int rc;
+        while ((rc = sqlite3_step(stmt.get())) == SQLITE_ROW)
+            ids.insert(sqlite3_column_int(stmt.get(), 0));
+        checkRc(rc, m_db, "step getStaleHashIds");
+    } catch (std::exception const& ex) {
+        spdlog::error("getStaleHashIds failed: {}", ex.what());
+    }
+    return ids;
+}
+
+std::int64_t DatabaseManager::dataVersion() const
+{
+    try {
+        auto stmt = prepareStatement(m_db, "PRAGMA data_version;");
+        if (sqlite3_step(stmt.get()) == SQLITE_ROW)
+            return sqlite3_column_int64(stmt.get(), 0);
+    } catch (std::exception const& ex) {
+        spdlog::error("dataVersion failed: {}", ex.what());
+    }
+    return -1;
+}
+
+bool DatabaseManager::storeKeyframeIndex(int videoId, KeyframeIndex const& index)
+{
+    static constexpr auto sql = R"(
+        INSERT OR REPLACE INTO keyframe_index (video_id, index_blob) VALUES (?,?);
+    )";
+
+    try {
+        auto const blob = index.serialize();
+        auto stmt = prepareStatement(m_db, sql);
+        checkRc(sqlite3_bind_int(stmt.get(), 1, videoId), m_db, "bind video_id");
+        checkRc(sqlite3_bind_blob(stmt.get(), 2, blob.data(), static_cast<int>(blob.size()),
+                    SQLITE_TRANSIENT),
+            m_db, "bind index_blob");
+        checkRc(sqlite3_step(stmt.get()), m_db, "execute storeKeyframeIndex");
+        return true;
+    } catch (std::exception const& ex) {
+        spdlog::error("storeKeyframeIndex failed: {}", ex.what());
+        return false;
+    }
+}
+
+std::optional<KeyframeIndex> DatabaseManager::loadKeyframeIndex(int videoId) const
+{
+    static constexpr auto sql = R"(
+        SELECT index_blob FROM keyframe_index WHERE video_id = ?;
+    )";
+
+    try {
+        auto stmt = prepareStatement(m_db, sql);
+        checkRc(sqlite3_bind_int(stmt.get(), 1, videoId), m_db, "bind video_id");
+        if (sqlite3_step(stmt.get()) != SQLITE_ROW)
+            return std::nullopt;
+        auto const* data = static_cast<std::uint8_t const*>(sqlite3_column_blob(stmt.get(), 0));
+        int const bytes = sqlite3_column_bytes(stmt.get(), 0);
+        auto idx = KeyframeIndex::deserialize({ data, static_cast<std::size_t>(bytes) });
+        if (!idx)
+            spdlog::warn("[DB] keyframe index of video {} is corrupt, ignoring it", videoId);
+        return idx;
+    } catch (std::exception const& ex) {
+        spdlog::error("loadKeyframeIndex failed: {}", ex.what());
+        return std::nullopt;
+    }
+}
+
+std::shared_ptr<KeyframeIndex> DatabaseManager::keyframesFor(VideoInfo const& stored, VideoInfo const& current) const
+{
+    auto index = std::make_shared<KeyframeIndex>();
+    bool const unchanged = stored.id > 0 && stored.size == current.size
+        && stored.modified_at != 0 && stored.modified_at == current.modified_at;
+    if (unchanged) {
+        if (auto loaded = loadKeyframeIndex(stored.id))
+            *index = std::move(*loaded);
+    }
+    return index;
+}
+
+bool DatabaseManager::storeAudioFingerprint(int videoId, std::vector<std::uint32_t> const& subs)
+{
+    static constexpr auto sql = R"(
+        INSERT OR REPLACE INTO audio_fingerprint (video_id, fp_blob) VALUES (?,?);
+    )";
+
+    try {
+        auto stmt = prepareStatement(m_db, sql);
+        checkRc(sqlite3_bind_int(stmt.get(), 1, videoId), m_db, "bind video_id");
+        // an empty row records "no audio" so the next scan does not decode again
+        if (subs.empty())
+            checkRc(sqlite3_bind_zeroblob(stmt.get(), 2, 0), m_db, "bind fp_blob");
+        else
+            checkRc(sqlite3_bind_blob(stmt.get(), 2, subs.data(),
+                        static_cast<int>(subs.size() * sizeof(std::uint32_t)), SQLITE_TRANSIENT),
+                m_db, "bind fp_blob");
+        checkRc(sqlite3_step(stmt.get()), m_db, "execute storeAudioFingerprint");
+        return true;
+    } catch (std::exception const& ex) {
+        spdlog::error("storeAudioFingerprint failed: {}", ex.what());
+        return false;
+    }
+}
+
+std::unordered_map<int, std::vector<std::uint32_t>> DatabaseManager::getAudioFingerprints() const
+{
+    static constexpr auto sql = "SELECT video_id, fp_blob FROM audio_fingerprint;";
+    std::unordered_map<int, std::vector<std::uint32_t>> fps;
+    try {
+        auto stmt = prepareStatement(m_db, sql);
+        int rc;
+        while ((rc = sqlite3_step(stmt.get())) == SQLITE_ROW) {
+            auto const* data = sqlite3_column_blob(stmt.get(), 1);
+            auto const bytes = static_cast<std::size_t>(sqlite3_column_bytes(stmt.get(), 1));
+            std::vector<std::uint32_t> subs(bytes / sizeof(std::uint32_t));
+            if (!subs.empty())
+                std::memcpy(subs.data(), data, subs.size() * sizeof(std::uint32_t));
+            fps.emplace(sqlite3_column_int(stmt.get(), 0), std::move(subs));
+        }
+        checkRc(rc, m_db, "step getAudioFingerprints");
+    } catch (std::exception const& ex) {
+        spdlog::error("getAudioFingerprints failed: {}", ex.what());
+    }
+    return fps;
+}
+
+std::vector<int> DatabaseManager::getAudioFingerprintedIds() const
+{
+    static constexpr auto sql = "SELECT video_id FROM audio_fingerprint;";
+    std::vector<int> ids;
+    try {
+        auto stmt = prepareStatement(m_db, sql);
+        int rc;
+        while ((rc = sqlite3_step(stmt.get())) == SQLITE_ROW)
+            ids.push_back(sqlite3_column_int(stmt.get(), 0));
+        checkRc(rc, m_db, "step getAudioFingerprintedIds");
+    } catch (std::exception const& ex) {
+        spdlog::error("getAudioFingerprintedIds failed: {}", ex.what());
+    }
+    return ids;
+}
+
+void DatabaseManager::recordDecodeOutcome(VideoInfo const& v, bool ok, std::string_view stage)
+{
+    // hw_ok stays 0: nothing decodes on the GPU yet
+    static constexpr auto sql = R"(
+        INSERT INTO hardware_filter (
+            path, codec, pix_fmt, profile, level, sw_ok,
+            size, modified_at, stage, failures, updated_at
+        ) VALUES (?,?,?,?,?,?,?,?,?,?,CURRENT_TIMESTAMP)
+        ON CONFLICT(path) DO UPDATE SET
+            codec       = excluded.codec,
+            pix_fmt     = excluded.pix_fmt,
+            profile     = excluded.profile,
+            level       = excluded.level,
+            sw_ok       = excluded.sw_ok,
+            size        = excluded.size,
+            modified_at = excluded.modified_at,
+            stage       = excluded.stage,
+            failures    = CASE WHEN excluded.sw_ok THEN 0
+                               ELSE IFNULL(hardware_filter.failures, 0) + 1 END,
+            updated_at  = CURRENT_TIMESTAMP;
+    )";
+
+    try {
+        std::string const level = std::to_string(v.level);
+        std::string const stageStr(stage);
+        auto stmt = prepareStatement(m_db, sql);
+        checkRc(sqlite3_bind_text(stmt.get(), 1, v.path.c_str(), -1, SQLITE_TRANSIENT), m_db, "bind path");
+        checkRc(sqlite3_bind_text(stmt.get(), 2, v.video_codec.c_str(), -1, SQLITE_TRANSIENT), m_db, "bind codec");
+        checkRc(sqlite3_bind_text(stmt.get(), 3, v.pix_fmt.c_str(), -1, SQLITE_TRANSIENT), m_db, "bind pix_fmt");
+        checkRc(sqlite3_bind_text(stmt.get(), 4, v.profile.c_str(), -1, SQLITE_TRANSIENT), m_db, "bind profile");
+        checkRc(sqlite3_bind_text(stmt.get(), 5, level.c_str(), -1, SQLITE_TRANSIENT), m_db, "bind level");
+        checkRc(sqlite3_bind_int(stmt.get(), 6, ok ? 1 : 0), m_db, "bind sw_ok");
+        checkRc(sqlite3_bind_int64(stmt.get(), 7, v.size), m_db, "bind size");
+        checkRc(sqlite3_bind_int64(stmt.get(), 8, v.modified_at), m_db, "bind modified_at");
+        checkRc(sqlite3_bind_text(stmt.get(), 9, stageStr.c_str(), -1, SQLITE_TRANSIENT), m_db, "bind stage");
+        checkRc(sqlite3_bind_int(stmt.get(), 10, ok ? 0 : 1), m_db, "bind failures");
+        checkRc(sqlite3_step(stmt.get()), m_db, "execute recordDecodeOutcome");
+    } catch (std::exception const& ex) {
+        spdlog::error("recordDecodeOutcome failed: {}", ex.what());
+    }
+}
+
+std::unordered_map<std::string, FailedFile> DatabaseManager::getFailedFiles() const
+{
+    static constexpr auto sql = R"(
+        SELECT path, size, modified_at, stage, failures
+        FROM hardware_filter
+        WHERE sw_ok = 0;
+    )";
+
+    std::unordered_map<std::string, FailedFile> out;
+    try {
+        auto stmt = prepareStatement(m_db, sql);
+        auto text = [&](int col) {
+            auto* t = reinterpret_cast<char const*>(sqlite3_column_text(stmt.get(), col));
+            return std::string(t ? t : "");
+        };
+        while (sqlite3_step(stmt.get()) == SQLITE_ROW) {
+            FailedFile f;
+            f.size = sqlite3_column_int64(stmt.get(), 1);
+            f.modified_at = mtimeColumn(stmt.get(), 2);
+            f.stage = text(3);
+            f.failures = sqlite3_column_int(stmt.get(), 4);
+            out.emplace(text(0), std::move(f));
+        }
+    } catch (std::exception const& ex) {
+        spdlog::error("getFailedFiles failed: {}", ex.what());
+    }
+    return out;
+}
+
+std::vector<CodecOutcome> DatabaseManager::getCodecOutcomes() const
+{
+    static constexpr auto sql = R"(
+        SELECT codec, pix_fmt, profile, level,
+               SUM(sw_ok = 1), SUM(sw_ok = 0)
+        FROM hardware_filter
+        WHERE stage = 'decode' OR sw_ok = 1
+        GROUP BY codec, pix_fmt, profile, level;
+    )";
+
+    std::vector<CodecOutcome> out;
+    try {
+        auto stmt = prepareStatement(m_db, sql);
+        auto text = [&](int col) {
+            auto* t = reinterpret_cast<char const*>(sqlite3_column_text(stmt.get(), col));
+            return std::string(t ? t : "");
+        };
+        while (sqlite3_step(stmt.get()) == SQLITE_ROW) {
+            CodecOutcome c;
+            c.codec = text(0);
+            c.pix_fmt = text(1);
+            c.profile = text(2);
+            c.level = text(3);
+            c.ok = sqlite3_column_int(stmt.get(), 4);
+            c.failed = sqlite3_column_int(stmt.get(), 5);
+            out.push_back(std::move(c));
+        }
+    } catch (std::exception const& ex) {
+        spdlog::error("getCodecOutcomes failed: {}", ex.what());
+    }
+    return out;
+}
+
 void DatabaseManager::deleteVideo(int videoId)
 {
     static constexpr auto sql = "DELETE FROM video WHERE id = ?;";
@@ -333,7 +735,7 @@ void DatabaseManager::updateVideoInfo(VideoInfo const& v)
     try {
         auto stmt = prepareStatement(m_db, sql);
         checkRc(sqlite3_bind_text(stmt.get(), 1, v.path.c_str(), -1, SQLITE_TRANSIENT), m_db, "bind path");
-        checkRc(sqlite3_bind_text(stmt.get(), 2, v.modified_at.c_str(), -1, SQLITE_TRANSIENT), m_db, "bind modified_at");
+        checkRc(sqlite3_bind_int64(stmt.get(), 2, v.modified_at), m_db, "bind modified_at");
         checkRc(sqlite3_bind_text(stmt.get(), 3, v.video_codec.c_str(), -1, SQLITE_TRANSIENT), m_db, "bind video_codec");
         checkRc(sqlite3_bind_text(stmt.get(), 4, v.audio_codec.c_str(), -1, SQLITE_TRANSIENT), m_db, "bind audio_codec");
         checkRc(sqlite3_bind_text(stmt.get(), 5, v.pix_fmt.c_str(), -1, SQLITE_TRANSIENT), m_db, "bind pix_fmt");
@@ -342,7 +744,7 @@ void DatabaseManager::updateVideoInfo(VideoInfo const& v)
         checkRc(sqlite3_bind_int(stmt.get(), 8, v.width), m_db, "bind width");
         checkRc(sqlite3_bind_int(stmt.get(), 9, v.height), m_db, "bind height");
         checkRc(sqlite3_bind_int(stmt.get(), 10, v.duration), m_db, "bind duration");
-        checkRc(sqlite3_bind_int(stmt.get(), 11, v.size), m_db, "bind size");
+        checkRc(sqlite3_bind_int64(stmt.get(), 11, v.size), m_db, "bind size");
         checkRc(sqlite3_bind_int(stmt.get(), 12, v.bit_rate), m_db, "bind bit_rate");
         checkRc(sqlite3_bind_int(stmt.get(), 13, v.num_hard_links), m_db, "bind num_hard_links");
         checkRc(sqlite3_bind_int64(stmt.get(), 14, static_cast<sqlite3_int64>(v.inode)), m_db, "bind inode");
@@ -466,7 +868,7 @@ void DatabaseManager::initDatabase()
         CREATE TABLE IF NOT EXISTS video (
             id INTEGER PRIMARY KEY AUTOINCREMENT,
             path TEXT NOT NULL,
-            modified_at DATETIME,
+            modified_at INTEGER,
             video_codec TEXT,
             audio_codec TEXT,
             pix_fmt TEXT,
@@ -527,12 +929,53 @@ void DatabaseManager::initDatabase()
             sw_ok    INTEGER DEFAULT 0
         );
     )";
+    static constexpr auto createKeyframeIndexTableSQL = R"(
+        CREATE TABLE IF NOT EXISTS keyframe_index (
+            video_id   INTEGER PRIMARY KEY,
+            index_blob BLOB NOT NULL,
+            FOREIGN KEY(video_id) REFERENCES video(id) ON DELETE CASCADE
+        );
+    )";
+    static constexpr auto createAudioFingerprintTableSQL = R"(
+        CREATE TABLE IF NOT EXISTS audio_fingerprint (
+            video_id INTEGER PRIMARY KEY,
+            fp_blob  BLOB NOT NULL,
+            FOREIGN KEY(video_id) REFERENCES video(id) ON DELETE CASCADE
+        );
+    )";
     execStatement(createVideoTableSQL);
     execStatement(createHashTableSQL);
     execStatement(createDupGroupTable);
     execStatement(createDupGroupMapTable);
     execStatement(createSettingsTableSQL);
     execStatement(createHardwareFilterTableSQL);
+    execStatement(createKeyframeIndexTableSQL);
+    execStatement(createAudioFingerprintTableSQL);
+
+    // columns added after the first release
+    ensureColumn("hash", "variant_blob", "BLOB");
+    ensureColumn("hash", "bits", "INTEGER DEFAULT 64");
+    ensureColumn("hash", "blob_format", "INTEGER DEFAULT 0"); // hashblob::Format
+    ensureColumn("hash", "packed_blob", "BLOB");              // Format::Packed rows
+    ensureColumn("hash", "packed_variants", "BLOB");
+    ensureColumn("hash", "algo_version", "INTEGER DEFAULT 0"); // kPHashAlgoVersion
+    ensureColumn("hardware_filter", "size", "INTEGER");
+    ensureColumn("hardware_filter", "modified_at", "INTEGER");
+    ensureColumn("hardware_filter", "stage", "TEXT");
+    ensureColumn("hardware_filter", "failures", "INTEGER DEFAULT 0");
+    ensureColumn("hardware_filter", "updated_at", "DATETIME");
+}
+
+void DatabaseManager::ensureColumn(std::string const& table, std::string const& column,
+    std::string const& decl)
+{
+    auto stmt = prepareStatement(m_db, "PRAGMA table_info(" + table + ");");
+    while (sqlite3_step(stmt.get()) == SQLITE_ROW) {
+        auto* name = reinterpret_cast<char const*>(sqlite3_column_text(stmt.get(), 1));
+        if (name && column == name)
+            return;
+    }
+    execStatement("ALTER TABLE " + table + " ADD COLUMN " + column + " " + decl + ";");
 }
 
 void DatabaseManager::execStatement(std::string const& sql)
@@ -2,14 +2,35 @@
 
 #include "SearchSettings.h"
 #include "Hash.h"
+#include "KeyframeIndex.h"
 #include "VideoInfo.h"
 
 #include <sqlite3.h>
 #include <QString>
 
 #include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <cstdint>
+#include <memory>
+
+// Last probe/decode of a file failed (hardware_filter row with sw_ok = 0);
+// the file is skipped while its size and mtime stay the same.
+struct FailedFile {
+    std::int64_t size = 0;
+    std::int64_t modified_at = 0;
+    std::string stage; // "probe", "decode" or "budget:<stage>"
+    int failures = 0;  // consecutive
+};
+
+// Decode outcomes of all files sharing a codec / pix_fmt / profile / level.
+struct CodecOutcome {
+    std::string codec, pix_fmt, profile, level;
+    int ok = 0;
+    int failed = 0;
+};
 
  class DatabaseManager {
  public:
@@ -20,10 +41,22 @@
      DatabaseManager& operator=(DatabaseManager const&) = delete;
  
     std::optional<int> insertVideo(VideoInfo& video);
-    bool insertAllHashes(int video_id, std::vector<uint64_t> const& pHashes);
+    // Replaces any earlier row of the video (e.g. at another width).
+    bool insertAllHashes(int video_id, std::vector<uint64_t> const& pHashes,
+                         bool withVariants = false, unsigned bits = 64);
  
      std::vector<VideoInfo> getAllVideos() const;
      std::vector<HashGroup> getAllHashGroups() const;
+    std::optional<HashGroup> getHashGroup(int videoId) const;
+    std::vector<int> getHashedVideoIds() const;
+    std::unordered_map<int, unsigned> getHashBits() const; // video id → hash width
+    // Videos whose hash row is at another width or from an older
+    // kPHashAlgoVersion, i.e. not comparable with hashes made now.
+    std::unordered_set<int> getStaleHashIds(unsigned bits) const;
+
+    // Changes whenever another connection commits (PRAGMA data_version);
+    // lets a long-lived reader notice writes by the GUI or a scan.
+    std::int64_t dataVersion() const;
  
      void deleteVideo(int videoId);
      void copyMetadataExceptPath(int targetId, int destinationId);
@@ -37,6 +70,24 @@
      void storeDuplicateGroups(std::vector<std::vector<VideoInfo>> const& groups);
      std::vector<std::vector<VideoInfo>> loadDuplicateGroups() const;
 
+    // negative cache (hardware_filter)
+    void recordDecodeOutcome(VideoInfo const& v, bool ok, std::string_view stage);
+    std::unordered_map<std::string, FailedFile> getFailedFiles() const;
+    std::vector<CodecOutcome> getCodecOutcomes() const;
+
+    bool storeKeyframeIndex(int videoId, KeyframeIndex const& index);
+    std::optional<KeyframeIndex> loadKeyframeIndex(int videoId) const;
+    // Index to decode `current` with: the one stored for `stored` (the DB
+    // row of the same path) while the file keeps its size and mtime, an
+    // empty one otherwise.  Never null.
+    std::shared_ptr<KeyframeIndex> keyframesFor(VideoInfo const& stored, VideoInfo const& current) const;
+
+    // audiofp sub-fingerprints (AudioFingerprint.h); empty for videos
+    // without an audio track
+    bool storeAudioFingerprint(int videoId, std::vector<std::uint32_t> const& subs);
+    std::unordered_map<int, std::vector<std::uint32_t>> getAudioFingerprints() const;
+    std::vector<int> getAudioFingerprintedIds() const;
+
     SearchSettings loadSettings() const; 
     void saveSettings(SearchSettings const&);
  
@@ -47,5 +98,7 @@
  
      void initDatabase();
      void execStatement(std::string const& sql);
+     void ensureColumn(std::string const& table, std::string const& column,
+                       std::string const& decl);
  };
 
@@ -0,0 +1,282 @@
+#include "DecodeProfile.h"
+#include "GoldenCorpus.h"
+#include "VideoProcessingUtils.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <format>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/pixdesc.h>
+}
+
+namespace decode {
+
+namespace {
+
+constexpr int kTolerance = 4;       // bits, per frame, against the golden hash
+constexpr int kValidateW = 640;     // big enough that lowres=2 still leaves
+constexpr int kValidateH = 360;     // a short side >= kPHashTile
+constexpr int kRepeats = 3;         // frames per image, so B-frames exist
+constexpr int kPanStep = 12;        // px the view pans right per frame
+constexpr int kMaxLowres = 2;
+
+struct Sample {
+    std::vector<uint64_t> golden; // one per encoded frame, of the source picture
+    std::unique_ptr<AVCodecParameters, vpu::CDeleter<&avcodec_parameters_free>> par;
+    std::vector<vpu::PktPtr> packets;
+};
+
+// 8-bit planar YUV the encoder accepts, or AV_PIX_FMT_NONE.
+AVPixelFormat pick_pix_fmt(AVCodec const* enc)
+{
+    AVPixelFormat const* fmts = nullptr;
+#if LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(61, 13, 100)
+    void const* cfg = nullptr;
+    if (avcodec_get_supported_config(nullptr, enc, AV_CODEC_CONFIG_PIX_FORMAT, 0, &cfg, nullptr) >= 0)
+        fmts = static_cast<AVPixelFormat const*>(cfg);
+#else
+    fmts = enc->pix_fmts;
+#endif
+    if (!fmts)
+        return AV_PIX_FMT_YUV420P;
+    for (; *fmts != AV_PIX_FMT_NONE; ++fmts) {
+        AVPixFmtDescriptor const* d = av_pix_fmt_desc_get(*fmts);
+        if (d && d->nb_components == 3 && (d->flags & AV_PIX_FMT_FLAG_PLANAR)
+            && !(d->flags & (AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_HWACCEL))
+            && d->comp[0].depth == 8)
+            return *fmts;
+    }
+    return AV_PIX_FMT_NONE;
+}
+
+// Encode the golden corpus with the codec's own encoder, in memory.  Each
+// image is held for kRepeats frames while the view pans across it, so the
+// B-frames carry motion and residual rather than repeating their
+// references; a static clip would let skip-bidir-idct pass unseen.
+std::optional<Sample> encode_sample(AVCodecID id)
+{
+    AVCodec const* enc = avcodec_find_encoder(id);
+    if (!enc)
+        return std::nullopt;
+    AVPixelFormat const pixFmt = pick_pix_fmt(enc);
+    if (pixFmt == AV_PIX_FMT_NONE)
+        return std::nullopt;
+
+    vpu::CtxPtr ctx { avcodec_alloc_context3(enc) };
+    if (!ctx)
+        return std::nullopt;
+    ctx->width = kValidateW;
+    ctx->height = kValidateH;
+    ctx->pix_fmt = pixFmt;
+    ctx->time_base = { 1, 25 };
+    ctx->framerate = { 25, 1 };
+    ctx->gop_size = 2 * kRepeats;
+    ctx->max_b_frames = 2;
+    ctx->thread_count = 1;
+    ctx->strict_std_compliance = FF_COMPLIANCE_UNOFFICIAL;
+    if (avcodec_open2(ctx.get(), enc, nullptr) < 0)
+        return std::nullopt;
+
+    Sample s;
+    s.par.reset(avcodec_parameters_alloc());
+    if (!s.par || avcodec_parameters_from_context(s.par.get(), ctx.get()) < 0)
+        return std::nullopt;
+
+    vpu::FrmPtr frm { av_frame_alloc() };
+    frm->format = pixFmt;
+    frm->width = kValidateW;
+    frm->height = kValidateH;
+    if (av_frame_get_buffer(frm.get(), 0) < 0)
+        return std::nullopt;
+
+    int cw = 0, ch = 0;
+    av_pix_fmt_get_chroma_sub_sample(pixFmt, &cw, &ch);
+    int const chromaW = AV_CEIL_RSHIFT(kValidateW, cw);
+    int const chromaH = AV_CEIL_RSHIFT(kValidateH, ch);
+
+    auto drain = [&]() -> bool {
+        for (;;) {
+            vpu::PktPtr pkt { av_packet_alloc() };
+            int r = avcodec_receive_packet(ctx.get(), pkt.get());
+            if (r == AVERROR(EAGAIN) || r == AVERROR_EOF)
+                return true;
+            if (r < 0)
+                return false;
+            s.packets.push_back(std::move(pkt));
+        }
+    };
+
+    constexpr int imgW = kValidateW + kPanStep * (kRepeats - 1);
+    int64_t pts = 0;
+    for (golden::GoldenFrame const& g : golden::frames()) {
+        auto const img = golden::render(g.pattern, imgW, kValidateH, g.seed);
+
+        for (int rep = 0; rep < kRepeats; ++rep) {
+            if (av_frame_make_writable(frm.get()) < 0)
+                return std::nullopt;
+            std::size_t const x0 = static_cast<std::size_t>(rep) * kPanStep;
+            for (int y = 0; y < kValidateH; ++y)
+                std::memcpy(frm->data[0] + static_cast<std::ptrdiff_t>(y) * frm->linesize[0],
+                    img.data() + static_cast<std::size_t>(y) * imgW + x0, kValidateW);
+            for (int p = 1; p <= 2; ++p)
+                for (int y = 0; y < chromaH; ++y)
+                    std::memset(frm->data[p] + static_cast<std::ptrdiff_t>(y) * frm->linesize[p], 128, chromaW);
+
+            // reference: the production hash of the picture before encoding
+            bool fatal = false;
+            auto const h = vpu::hash_frame(frm.get(), false, fatal);
+            s.golden.push_back(h ? h->words[0] : 0);
+
+            frm->pts = pts++;
+            if (avcodec_send_frame(ctx.get(), frm.get()) < 0 || !drain())
+                return std::nullopt;
+        }
+    }
+    if (avcodec_send_frame(ctx.get(), nullptr) < 0 || !drain())
+        return std::nullopt;
+    return s;
+}
+
+// Decode the sample with `p`; worst distance of a frame to its source
+// picture's hash, or 64 if the decoder failed or dropped frames.
+int score(Sample const& s, AVCodec const* dec, Profile const& p)
+{
+    vpu::CtxPtr ctx { avcodec_alloc_context3(dec) };
+    if (!ctx || avcodec_parameters_to_context(ctx.get(), s.par.get()) < 0)
+        return 64;
+    ctx->thread_count = 1;
+    ctx->skip_loop_filter = AVDISCARD_ALL; // as the processors decode
+    ctx->flags2 |= AV_CODEC_FLAG2_FAST;
+    apply_profile(ctx.get(), dec, p);
+    if (avcodec_open2(ctx.get(), dec, nullptr) < 0)
+        return 64;
+
+    vpu::FrmPtr frm { av_frame_alloc() };
+    std::size_t const expected = s.golden.size();
+    std::size_t got = 0;
+    int worst = 0;
+    bool fatal = false;
+
+    auto receive = [&]() -> bool {
+        for (;;) {
+            int r = avcodec_receive_frame(ctx.get(), frm.get());
+            if (r == AVERROR(EAGAIN) || r == AVERROR_EOF)
+                return true;
+            if (r < 0)
+                return false;
+            int64_t const pts = frm->best_effort_timestamp != AV_NOPTS_VALUE
+                ? frm->best_effort_timestamp
+                : static_cast<int64_t>(got);
+            std::size_t const i = std::min<std::size_t>(static_cast<std::size_t>(std::max<int64_t>(pts, 0)),
+                s.golden.size() - 1);
+            auto const h = vpu::hash_frame(frm.get(), false, fatal);
+            worst = std::max(worst, h ? std::popcount(h->words[0] ^ s.golden[i]) : 64);
+            ++got;
+            av_frame_unref(frm.get());
+        }
+    };
+
+    for (auto const& pkt : s.packets)
+        if (avcodec_send_packet(ctx.get(), pkt.get()) < 0 || !receive())
+            return 64;
+    if (avcodec_send_packet(ctx.get(), nullptr) < 0 || !receive())
+        return 64;
+    return got == expected && !fatal ? worst : 64;
+}
+
+Profile validate(AVCodec const* dec)
+{
+    auto const sample = encode_sample(dec->id);
+    if (!sample) {
+        spdlog::info("[decode] {}: no usable encoder to validate with, full decoding", dec->name);
+        return {};
+    }
+
+    int const full = score(*sample, dec, {});
+    if (full > kTolerance) {
+        spdlog::warn("[decode] {}: full decode is already {} bits off the golden hashes, "
+                     "not reducing", dec->name, full);
+        return {};
+    }
+
+    // Most aggressive first; the first one that holds the tolerance wins.
+    for (int lr = std::min<int>(dec->max_lowres, kMaxLowres); lr >= 0; --lr) {
+        for (bool skipIdct : { true, false }) {
+            Profile const p { true, lr, skipIdct };
+            int const d = score(*sample, dec, p);
+            if (d <= kTolerance) {
+                spdlog::info("[decode] {}: {} (max {} bits, full decode {})",
+                    dec->name, describe(p), d, full);
+                return p;
+            }
+        }
+    }
+    spdlog::info("[decode] {}: no reduced profile within {} bits, full decoding", dec->name, kTolerance);
+    return {};
+}
+
+} // namespace
+
+std::string describe(Profile const& p)
+{
+    if (!p.reduced())
+        return "full";
+    std::string s;
+    auto add = [&](std::string_view part) {
+        if (!s.empty())
+            s += '+';
+        s += part;
+    };
+    if (p.gray)
+        add("gray");
+    if (p.lowres > 0)
+        add(std::format("lowres={}", p.lowres));
+    if (p.skipBidirIdct)
+        add("skip-bidir-idct");
+    return s;
+}
+
+Profile const& profile_for(AVCodec const* dec)
+{
+    static std::mutex m;
+    static std::unordered_map<int, Profile> cache; // AVCodecID → profile
+
+    {
+        std::lock_guard lk(m);
+        if (auto it = cache.find(dec->id); it != cache.end())
+            return it->second;
+    }
+    // Validate unlocked so other codecs are not held up; two threads racing
+    // on the same codec both validate and the first to publish wins.
+    Profile const p = validate(dec);
+    std::lock_guard lk(m);
+    return cache.try_emplace(dec->id, p).first->second;
+}
+
+void apply_profile(AVCodecContext* ctx, AVCodec const* dec, Profile const& p)
+{
+    if (p.gray)
+        ctx->flags |= AV_CODEC_FLAG_GRAY;
+
+    int lowres = std::min<int>(p.lowres, dec->max_lowres);
+    int const shortSide = std::min(ctx->width, ctx->height);
+    while (lowres > 0 && shortSide > 0 && (shortSide >> lowres) < kPHashTile)
+        --lowres;
+    ctx->lowres = lowres;
+
+    if (p.skipBidirIdct)
+        ctx->skip_idct = std::max(ctx->skip_idct, AVDISCARD_BIDIR);
+}
+
+} // namespace decode
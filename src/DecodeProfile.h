@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string>
+
+struct AVCodec;
+struct AVCodecContext;
+
+// Reduced-work decoder settings for hash-only decoding.  Hashing reads
+// nothing but luma at kPHashTile², so a decoder may skip chroma
+// (AV_CODEC_FLAG_GRAY), decode at 1/2 or 1/4 resolution (lowres, MPEG-4 /
+// MJPEG and friends) and skip the IDCT of B-frames – as long as the hashes
+// stay within tolerance.  Which of those a codec gets is decided once per
+// process: the golden corpus (GoldenCorpus.h), panned so B-frames carry
+// motion, is encoded with the codec's own encoder, decoded with each
+// candidate profile and compared against the hashes of the source frames.
+// Codecs this FFmpeg build cannot encode keep full decoding.
+namespace decode {
+
+struct Profile {
+    bool gray = false;          // AV_CODEC_FLAG_GRAY
+    int lowres = 0;             // log2 down-scale, capped per file by apply_profile
+    bool skipBidirIdct = false; // skip_idct >= AVDISCARD_BIDIR
+
+    bool reduced() const { return gray || lowres > 0 || skipBidirIdct; }
+};
+
+std::string describe(Profile const& p);
+
+// Validated profile for `dec`, computed on first use and cached.  Thread-safe;
+// the first caller for a codec pays for the validation (a few dozen frames),
+// outside the cache lock, so other codecs' lookups are not held up.
+Profile const& profile_for(AVCodec const* dec);
+
+// Apply `p` to a context that has its parameters but is not yet open.
+// lowres is lowered so the decoded short side stays >= kPHashTile, and
+// skip_idct is only ever raised.
+void apply_profile(AVCodecContext* ctx, AVCodec const* dec, Profile const& p);
+
+} // namespace decode
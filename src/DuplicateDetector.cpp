@@ -1,11 +1,11 @@
 #include "Hash.h"
+#include "MatchIndex.h"
 #include "UnionFind.h"
 #include "VideoInfo.h"
-#include <cmath>
-#include <hft/hftrie.hpp>
+#include "VideoSignature.h"
+#include <algorithm>
 #include <spdlog/spdlog.h>
 #include <unordered_map>
-#include <unordered_set>
 #include <vector>
 
 /*!
@@ -13,7 +13,7 @@
  * Detects duplicate videos by comparing their pHashes.
  *
  * This function works by first building a searchable structure
- *   (HFTrie) of all pHashes from all videos. Then, for each video, it
+ *   (MatchIndex, an HFTrie) of all pHashes from all videos. Then, for each video, it
  *   queries this structure to find other videos that have a
  *   significant number of "close" pHashes. Videos with enough matching
  *   pHashes are then grouped together as duplicates using a Union-Find
@@ -25,7 +25,9 @@
  *
  * \param hashGroups A list where each `HashGroup` contains a
  *   video's ID (`fk_hash_video`) and a collection of its
- *   pHashes (`hashes`).
+ *   pHashes (`hashes`). Groups that also carry flipped/rotated
+ *   `variants` query the trie once per orientation, and a
+ *   candidate's match count is the best count over orientations.
  *
  * \param searchRange The maximum Hamming distance allowed when
  *   searching for similar pHashes in the HFTrie.
@@ -45,6 +47,24 @@
  *   (as defined by `searchRange`) two videos must share to be
  *   considered potential duplicates of each other.
  *
+ * \param hashBits Width of the hashes to compare (64, 128 or 256).
+ *   Groups stored at another width take no part in the pass.
+ *
+ * \param approximate LSH parameters to match with instead of the exact
+ *   trie (see LshIndex.h); some near pairs may then go unmatched.
+ *
+ * \param twoStage Index one coarse signature per video instead of every
+ *   pHash (see VideoSignature.h) and count matching pHashes only for the
+ *   pairs whose signatures are close.  Counts and thresholds are those of
+ *   the one-stage search; pairs the shortlist misses go unmatched.
+ *   Takes precedence over `approximate`.
+ *
+ * \param audioGroups Each video's audio fingerprint as 64-bit words (see
+ *   AudioFingerprint.h), matched in an index of their own.  Two videos
+ *   whose soundtracks meet `audioCriteria` are duplicates whatever their
+ *   pHashes say, so a re-encode with a crop or an overlay still joins its
+ *   original's group.
+ *
  * \return A vector of vectors, where each inner vector contains
  *   `VideoInfo` objects for a group of videos identified as
  *   duplicates of each other.
@@ -62,18 +82,37 @@ findDuplicates(std::vector<VideoInfo> videos,
     uint64_t searchRange,
     bool usePercentThreshold,
     double percentThreshold,
-    std::uint64_t numberThreshold)
+    std::uint64_t numberThreshold,
+    unsigned hashBits,
+    std::optional<LshIndex::Params> approximate,
+    bool twoStage,
+    std::vector<HashGroup> const& audioGroups,
+    MatchIndex::Criteria const& audioCriteria)
 {
     if (g_duplicateDebugEnabled)
         spdlog::info("[DuplicateDetector] start: videos={}, hashGroups={}",
             videos.size(), hashGroups.size());
 
-    // --- Build HFTrie from all pHashes ---
-    hft::HFTrie trie;
-    for (auto const& group : hashGroups) {
-        for (auto h : group.hashes) {
-            trie.Insert({ group.fk_hash_video, h });
+    // --- Build the HFTrie index from all pHashes (two-stage: from signatures) ---
+    std::unordered_map<int, HashGroup> signatures;
+    std::unordered_map<int, HashGroup const*> groupById;
+    MatchIndex index(hashBits, twoStage ? std::nullopt : approximate);
+    if (twoStage) {
+        std::size_t centroids = 0, hashes = 0;
+        for (auto const& group : hashGroups) {
+            if (group.bits != hashBits || group.hashes.empty())
+                continue;
+            auto& sig = signatures[group.fk_hash_video] = make_signature(group);
+            groupById[group.fk_hash_video] = &group;
+            centroids += sig.count();
+            hashes += group.count();
+            index.add(sig);
         }
+        spdlog::info("[DuplicateDetector] two-stage: {} signatures, {} centroids for {} hashes",
+            signatures.size(), centroids, hashes);
+    } else {
+        for (auto const& group : hashGroups)
+            index.add(group);
     }
 
     // --- Build an id->index map for union-find ---
@@ -83,11 +122,8 @@ findDuplicates(std::vector<VideoInfo> videos,
         idToIndex[videos[i].id] = i;
     }
 
-    // Map video-id -> number of hashes (for percentage threshold)
-    std::unordered_map<int, std::size_t> hashCount;
-    hashCount.reserve(hashGroups.size());
-    for (auto const& g : hashGroups)
-        hashCount[g.fk_hash_video] = g.hashes.size();
+    MatchIndex::Criteria const criteria { searchRange, usePercentThreshold,
+        percentThreshold, numberThreshold };
 
     if (g_duplicateDebugEnabled)
         spdlog::info("[DuplicateDetector] built id→index map ({} entries)", idToIndex.size());
@@ -95,6 +131,26 @@ findDuplicates(std::vector<VideoInfo> videos,
     // --- Collect edges in a vector of (indexOfVideoA, indexOfVideoB) ---
     std::vector<std::pair<int, int>> duplicates;
 
+    // Two-stage: videos whose signatures come close, confirmed hash by hash
+    std::uint64_t const coarseRadius = signature_radius(hashBits, searchRange);
+    std::size_t shortlisted = 0;
+    auto confirmShortlist = [&](HashGroup const& group) {
+        std::vector<MatchIndex::Match> out;
+        auto sig = signatures.find(group.fk_hash_video);
+        if (sig == signatures.end())
+            return out;
+        for (auto const& [videoId, hits] : index.matchCounts(sig->second, coarseRadius)) {
+            if (videoId == group.fk_hash_video)
+                continue;
+            ++shortlisted;
+            HashGroup const& other = *groupById.at(videoId);
+            int const count = count_pair_matches(group, other, searchRange);
+            if (count >= static_cast<int>(MatchIndex::requiredMatches(criteria, group.count(), other.count())))
+                out.push_back({ videoId, count });
+        }
+        return out;
+    };
+
     // For each HashGroup => do the range search => build match counts => store edges
     for (auto const& group : hashGroups) {
         if (g_duplicateDebugEnabled) {
@@ -105,47 +161,45 @@ findDuplicates(std::vector<VideoInfo> videos,
                 group.fk_hash_video, hashesStr);
         }
 
-        std::unordered_map<int, int> matchCounts;
-
-        for (auto h : group.hashes) {
-            auto results = trie.RangeSearchFast(h, searchRange);
-            for (auto const& r : results) {
-                // 'r.id' is the fk_hash_video from insertion
-                matchCounts[r.id]++;
-            }
-        }
-
-        std::unordered_set<int> likelyMatches;
-        for (auto const& [videoId, count] : matchCounts) {
-            if (videoId == group.fk_hash_video)
-                continue;
-
-            std::size_t required;
-            if (usePercentThreshold) {
-                std::size_t longer = std::max(hashCount[group.fk_hash_video],
-                    hashCount[videoId]);
-                required = static_cast<std::size_t>(
-                    std::ceil(longer * percentThreshold / 100.0));
-            } else {
-                required = numberThreshold;
-            }
-
-            if (count >= static_cast<int>(required))
-                likelyMatches.insert(videoId);
-        }
+        auto const likelyMatches = twoStage ? confirmShortlist(group) : index.matches(group, criteria);
 
         // store edges in duplicates vector for union-find
-        // group.fk_hash_video is the "primary" video, each matchId is a duplicate
+        // group.fk_hash_video is the "primary" video, each match is a duplicate
         int mainIndex = idToIndex[group.fk_hash_video];
-        for (auto matchId : likelyMatches) {
-            int matchIndex = idToIndex[matchId];
+        for (auto const& m : likelyMatches) {
+            int matchIndex = idToIndex[m.videoId];
             if (g_duplicateDebugEnabled)
                 spdlog::info("[DuplicateDetector] duplicate edge {} ↔ {}",
-                    group.fk_hash_video, matchId);
+                    group.fk_hash_video, m.videoId);
             duplicates.push_back({ mainIndex, matchIndex });
         }
     }
 
+    // --- Audio: matching soundtracks are edges of their own ---
+    if (!audioGroups.empty()) {
+        MatchIndex audioIndex;
+        for (auto const& group : audioGroups)
+            audioIndex.add(group);
+        std::size_t audioEdges = 0;
+        for (auto const& group : audioGroups) {
+            auto const main = idToIndex.find(group.fk_hash_video);
+            if (main == idToIndex.end())
+                continue;
+            for (auto const& m : audioIndex.matches(group, audioCriteria)) {
+                auto const match = idToIndex.find(m.videoId);
+                if (match == idToIndex.end())
+                    continue;
+                duplicates.push_back({ main->second, match->second });
+                ++audioEdges;
+            }
+        }
+        spdlog::info("[DuplicateDetector] audio: {} words of {} tracks, {} edges",
+            audioIndex.hashes(), audioIndex.videos(), audioEdges);
+    }
+
+    if (twoStage)
+        spdlog::info("[DuplicateDetector] two-stage: {} of {} ordered pairs shortlisted", shortlisted,
+            signatures.size() * (signatures.size() ? signatures.size() - 1 : 0));
     if (g_duplicateDebugEnabled)
         spdlog::info("[DuplicateDetector] total duplicate edges={}", duplicates.size());
 
@@ -1,7 +1,10 @@
 #pragma once
 
+#include <optional>
 #include <vector>
 #include "Hash.h"
+#include "LshIndex.h"
+#include "MatchIndex.h"
 #include "VideoInfo.h"
 #include <hft/hftrie.hpp>
 
@@ -11,4 +14,9 @@ findDuplicates(std::vector<VideoInfo> videos,
                uint64_t searchRange,
                bool    usePercentThreshold,
                double  percentThreshold,          // 1-100
-               std::uint64_t numberThreshold);    // absolute count
+               std::uint64_t numberThreshold,     // absolute count
+               unsigned hashBits = 64,            // groups of other widths are ignored
+               std::optional<LshIndex::Params> approximate = std::nullopt, // LSH instead of the trie
+               bool twoStage = false,             // shortlist by per-video signature first
+               std::vector<HashGroup> const& audioGroups = {}, // audiofp::hash_group per video
+               MatchIndex::Criteria const& audioCriteria = {});
@@ -1,5 +1,8 @@
 // FastVideoProcessor.cpp
 #include "FastVideoProcessor.h"
+#include "DecodeProfile.h"
+#include "KeyframeIndex.h"
+#include "Prefetcher.h"
 #include "Hash.h"
 #include "VideoProcessingUtils.h"
 using namespace vpu;
@@ -66,14 +69,16 @@ static constexpr int KANALYZEUSEC = 10 * 1'000'000;
 // desired timestamp. therefore this function decodes from the keyframe until
 // the frame that is at the desired timestamp to ensure consistent pHashes
 // across videos regardless of keyframe placement
-static std::optional<uint64_t> decode_until_timestamp(
+static std::optional<PHashFrame> decode_until_timestamp(
     AVFormatContext* fmt,
     AVCodecContext* codec_ctx,
     int vstream,
     int64_t target_pts,
     FrameRAII& frame,
     PktPtr& pkt,
-    std::vector<uint8_t>& grayBuf,
+    bool toneMapHdr,
+    unsigned hashBits,
+    KeyframeIndex* keyframes,
     bool& fatal_error)
 {
     while (!fatal_error && av_read_frame(fmt, pkt.get()) >= 0) {
@@ -81,6 +86,8 @@ static std::optional<uint64_t> decode_until_timestamp(
             av_packet_unref(pkt.get());
             continue;
         }
+        if (keyframes)
+            keyframes->observe(fmt, pkt.get());
 
         int s;
         while ((s = avcodec_send_packet(codec_ctx, pkt.get())) == AVERROR(EAGAIN)) {
@@ -102,7 +109,7 @@ static std::optional<uint64_t> decode_until_timestamp(
                 : frame.get()->best_effort_timestamp;
 
             if (pts >= target_pts) {
-                auto hash = hash_frame(frame.get(), grayBuf, fatal_error);
+                auto hash = hash_frame(frame.get(), toneMapHdr, fatal_error, hashBits);
                 frame.unref();
                 return hash;
             }
@@ -116,7 +123,7 @@ static std::optional<uint64_t> decode_until_timestamp(
             ? frame.get()->pts
             : frame.get()->best_effort_timestamp;
         if (pts >= target_pts) {
-            auto hash = hash_frame(frame.get(), grayBuf, fatal_error);
+            auto hash = hash_frame(frame.get(), toneMapHdr, fatal_error, hashBits);
             frame.unref();
             return hash;
         }
@@ -162,6 +169,9 @@ FastVideoProcessor::decodeAndHash(
     static std::once_flag ffOnce;
     std::call_once(ffOnce, [] { av_log_set_level(AV_LOG_WARNING); });
 
+    // a read cut short by the budget surfaces as BudgetExceeded, not as {}
+    auto budget = DecodeBudget::for_file(cfg.fileTimeBudgetSec, cfg.fileReadBudgetPct, v.size);
+
     // --- open demuxer ---
     FmtPtr fmt;
     {
@@ -169,15 +179,18 @@ FastVideoProcessor::decodeAndHash(
         av_dict_set_int(&o, "probesize", KPROBESIZE, 0);
         av_dict_set_int(&o, "analyzeduration", KANALYZEUSEC, 0);
         AVFormatContext* raw = nullptr;
-        int e = avformat_open_input(&raw, v.path.c_str(), nullptr, &o);
+        int e = budget.open_input(raw, v.path.c_str(), &o);
         av_dict_free(&o);
         if (e < 0) {
+            budget.throw_if_exceeded();
             spdlog::error("[ffmpeg-sw] avformat_open_input: {}", ff_err2str(e));
             return {};
         }
         fmt.reset(raw);
     }
+    budget.enter("probe");
     if (int e = avformat_find_stream_info(fmt.get(), nullptr); e < 0) {
+        budget.throw_if_exceeded();
         spdlog::error("[ffmpeg-sw] stream_info: {}", ff_err2str(e));
         return {};
     }
@@ -188,6 +201,9 @@ FastVideoProcessor::decodeAndHash(
         return {};
     }
     AVStream* st = fmt->streams[vstream];
+    KeyframeIndex* keyframes = v.keyframes.get();
+    if (keyframes)
+        keyframes->prime(fmt.get(), vstream);
 
     // --- decoder open ---
     AVCodec const* dec = avcodec_find_decoder(st->codecpar->codec_id);
@@ -217,6 +233,8 @@ FastVideoProcessor::decodeAndHash(
     unsigned requested_threads = tc ? tc : 1; // enforce ≥1
     codec_ctx->thread_count = requested_threads;
     codec_ctx->skip_loop_filter = AVDISCARD_ALL;
+    if (cfg.reducedDecode)
+        decode::apply_profile(codec_ctx.get(), dec, decode::profile_for(dec));
 
     spdlog::info(">>> about to open decoder");
     int err = avcodec_open2(codec_ctx.get(), dec, nullptr);
@@ -238,7 +256,9 @@ FastVideoProcessor::decodeAndHash(
         }
 
         int flags = keyframeOnly ? AVSEEK_FLAG_ANY : AVSEEK_FLAG_BACKWARD;
-        if (av_seek_frame(fmt.get(), vstream, pts, flags) < 0) {
+        int rc = keyframes ? keyframes->seek(fmt.get(), vstream, pts, flags)
+                           : av_seek_frame(fmt.get(), vstream, pts, flags);
+        if (rc < 0) {
             spdlog::warn("[seek] failed to {:.1f}s", pts * av_q2d(st->time_base));
             return false;
         }
@@ -251,8 +271,6 @@ FastVideoProcessor::decodeAndHash(
     FrameRAII frame;
     PktPtr pkt { av_packet_alloc() };
 
-    std::vector<uint8_t> grayBuf; // scratch for full-res GRAY8 frames
-
     /*
     std::filesystem::path dumpDir;
     if constexpr (KDUMPFRAMES) {
@@ -262,41 +280,43 @@ FastVideoProcessor::decodeAndHash(
     */
     bool fatal_error = false;
 
-    // --- main decode / hash loop : exactly 2 hashes ---
+    // --- main decode / hash loop : one hash per target ---
     std::vector<uint64_t> hashes;
-    hashes.reserve(2);
-    std::array<double, 2> const targetsPct = { 0.30, 0.70 };
+    hashes.reserve(kFastHashTargets.size() * kPHashOrientations);
+    std::size_t framesHashed = 0;
 
-    for (double pct : targetsPct) {
+    for (double pct : kFastHashTargets) {
         if (v.duration <= 0) {
             fatal_error = true;
             break;
         }
 
         int64_t target_pts = sec_to_pts(pct * v.duration, st->time_base);
+        budget.enter("seek");
         if (!seek_to_pts(target_pts, cfg.fastHash.useKeyframesOnly)) {
             fatal_error = true;
             break;
         }
 
-        std::optional<uint64_t> hash;
+        budget.enter("decode");
+        std::optional<PHashFrame> hash;
         if (cfg.fastHash.useKeyframesOnly) {
             // In keyframe mode, try to use the keyframe directly first
             AVFrame* tmp = frame.get();
             int rc = avcodec_receive_frame(codec_ctx.get(), tmp);
             if (rc >= 0) {
                 // We got a keyframe directly
-                hash = hash_frame(tmp, grayBuf, fatal_error);
+                hash = hash_frame(tmp, cfg.toneMapHdr, fatal_error, cfg.hashBits);
                 frame.unref();
             } else {
                 // Need to decode at least one frame
                 hash = decode_until_timestamp(fmt.get(), codec_ctx.get(), vstream,
                     std::numeric_limits<int64_t>::min(), // accept first decoded frame
-                    frame, pkt, grayBuf, fatal_error);
+                    frame, pkt, cfg.toneMapHdr, cfg.hashBits, keyframes, fatal_error);
             }
         } else {
             hash = decode_until_timestamp(fmt.get(), codec_ctx.get(), vstream,
-                target_pts, frame, pkt, grayBuf, fatal_error);
+                target_pts, frame, pkt, cfg.toneMapHdr, cfg.hashBits, keyframes, fatal_error);
         }
 
         if (!hash) {
@@ -304,15 +324,20 @@ FastVideoProcessor::decodeAndHash(
             break;
         }
 
-        hashes.push_back(*hash);
+        append_phash(hashes, *hash, cfg.matchFlipsRotations);
+        ++framesHashed;
     }
 
-    spdlog::info("[sw] finished: {} hashes generated{}", hashes.size(),
+    if (keyframes)
+        keyframes->capture(fmt.get(), vstream);
+
+    spdlog::info("[sw] finished: {} hashes generated{}", framesHashed,
         fatal_error ? " (fatal error)" : "");
 
     // Only return results if we got exactly the expected number of hashes
     // and no fatal errors occurred
-    if (fatal_error || hashes.size() != targetsPct.size()) {
+    if (fatal_error || framesHashed != kFastHashTargets.size()) {
+        budget.throw_if_exceeded();
         spdlog::error("[sw] Failed to generate all required hashes");
         return {};
     }
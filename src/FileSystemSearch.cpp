@@ -5,6 +5,7 @@
 #include <algorithm>
 #include <array>
 #include <cctype>
+#include <cstdint>
 #include <filesystem>
 #include <iostream>
 #include <regex>
@@ -29,8 +30,10 @@ static constexpr std::array<std::string_view, 47> video_extensions = {
 
 namespace {
 
+// modified_at is the mtime in ns since the Unix epoch: no formatting (and
+// no thread-unsafe localtime) per file, and the cache compares integers.
 #ifdef _WIN32
-bool get_file_identity(const std::filesystem::path& path, long& inode, long& device, int& nlinks, std::string& modified_at)
+bool get_file_identity(const std::filesystem::path& path, long& inode, long& device, int& nlinks, std::int64_t& modified_at)
 {
     HANDLE hFile = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
         nullptr);
@@ -39,41 +42,24 @@ bool get_file_identity(const std::filesystem::path& path, long& inode, long& dev
 
     BY_HANDLE_FILE_INFORMATION fileInfo;
     bool success = GetFileInformationByHandle(hFile, &fileInfo);
-    if (!success) {
-        CloseHandle(hFile);
+    CloseHandle(hFile);
+    if (!success)
         return false;
-    }
 
     inode = (static_cast<uint64_t>(fileInfo.nFileIndexHigh) << 32) | fileInfo.nFileIndexLow;
     device = static_cast<long>(fileInfo.dwVolumeSerialNumber);
     nlinks = static_cast<int>(fileInfo.nNumberOfLinks);
 
-    // Convert last write time (modification time) to SYSTEMTIME
-    FILETIME localFileTime;
-    if (!FileTimeToLocalFileTime(&fileInfo.ftLastWriteTime, &localFileTime)) {
-        CloseHandle(hFile);
-        return false;
-    }
-
-    SYSTEMTIME systemTime;
-    if (!FileTimeToSystemTime(&localFileTime, &systemTime)) {
-        CloseHandle(hFile);
-        return false;
-    }
-
-    // Format SYSTEMTIME to string
-    char buffer[20]; // "YYYY-MM-DD HH:MM:SS" + null terminator
-    std::snprintf(buffer, sizeof(buffer), "%04d-%02d-%02d %02d:%02d:%02d",
-        systemTime.wYear, systemTime.wMonth, systemTime.wDay,
-        systemTime.wHour, systemTime.wMinute, systemTime.wSecond);
-
-    modified_at = buffer;
+    // FILETIME counts 100 ns ticks since 1601-01-01
+    constexpr std::int64_t kTicksTo1970 = 116'444'736'000'000'000;
+    std::int64_t const ticks = (static_cast<std::int64_t>(fileInfo.ftLastWriteTime.dwHighDateTime) << 32)
+        | fileInfo.ftLastWriteTime.dwLowDateTime;
+    modified_at = (ticks - kTicksTo1970) * 100;
 
-    CloseHandle(hFile);
     return true;
 }
 #elif defined(__unix__)
-bool get_file_identity(const std::filesystem::path& path, long& inode, long& device, int& nlinks, std::string& modified_at)
+bool get_file_identity(const std::filesystem::path& path, long& inode, long& device, int& nlinks, std::int64_t& modified_at)
 {
     struct stat st;
     if (stat(path.c_str(), &st) != 0)
@@ -82,20 +68,12 @@ bool get_file_identity(const std::filesystem::path& path, long& inode, long& dev
     inode = static_cast<long>(st.st_ino);
     device = static_cast<long>(st.st_dev);
     nlinks = static_cast<int>(st.st_nlink);
-
-    std::time_t mtime = st.st_mtime;
-
-    // not thread safe
-    std::tm* tm = std::localtime(&mtime);
-
-    std::ostringstream oss;
-    oss << std::put_time(tm, "%Y-%m-%d %H:%M:%S");
-    modified_at = oss.str();
+    modified_at = static_cast<std::int64_t>(st.st_mtim.tv_sec) * 1'000'000'000 + st.st_mtim.tv_nsec;
 
     return true;
 }
 #else
-bool get_file_identity(const std::filesystem::path&, long&, long&, int&)
+bool get_file_identity(const std::filesystem::path&, long&, long&, int&, std::int64_t&)
 {
     return false; // Not supported
 }
@@ -117,7 +95,8 @@ static bool matchAny(std::string const& text,
 //   device
 //   num_hard_links
 std::vector<VideoInfo>
-getVideosFromPath(std::filesystem::path const& root, SearchSettings const& cfg)
+getVideosFromPath(std::filesystem::path const& root, SearchSettings const& cfg,
+    ProgressAggregator* progress)
 {
     std::vector<VideoInfo> out;
     std::error_code ec;
@@ -239,7 +218,7 @@ getVideosFromPath(std::filesystem::path const& root, SearchSettings const& cfg)
             return;
 
         video.path = absPath.lexically_normal().string();
-        video.size = static_cast<int>(sz);
+        video.size = static_cast<int64_t>(sz);
 
         if (!get_file_identity(absPath, video.inode, video.device, video.num_hard_links, video.modified_at)) {
             spdlog::debug("Failed to get file identify, rejecting: {}", path.string());
@@ -248,6 +227,8 @@ getVideosFromPath(std::filesystem::path const& root, SearchSettings const& cfg)
 
         spdlog::debug("Accepted: {}", video.path);
         out.push_back(std::move(video));
+        if (progress)
+            progress->advance();
     };
 
     if (recurse) {
@@ -280,3 +261,21 @@ bool validate_directory(std::filesystem::path const& root)
     }
     return true;
 }
+
+std::optional<VideoInfo> getVideoFromFile(std::filesystem::path const& file)
+{
+    std::error_code ec;
+    auto absPath = std::filesystem::absolute(file, ec);
+    if (ec || !std::filesystem::is_regular_file(absPath, ec))
+        return std::nullopt;
+    auto const sz = std::filesystem::file_size(absPath, ec);
+    if (ec)
+        return std::nullopt;
+
+    VideoInfo video;
+    video.path = absPath.lexically_normal().string();
+    video.size = static_cast<int64_t>(sz);
+    if (!get_file_identity(absPath, video.inode, video.device, video.num_hard_links, video.modified_at))
+        return std::nullopt;
+    return video;
+}
@@ -2,12 +2,20 @@
 
 #include "VideoInfo.h"
 #include "SearchSettings.h"
+#include "ProgressAggregator.h"
 #include <filesystem>
+#include <optional>
 #include <unordered_set>
 #include <vector>
 
+// Each video found is counted on `progress` as the walk goes.
 std::vector<VideoInfo>
 getVideosFromPath(std::filesystem::path const& root,
-                  SearchSettings const& cfg);
+                  SearchSettings const& cfg,
+                  ProgressAggregator* progress = nullptr);
+
+// One file, no filters applied; the same fields as getVideosFromPath.
+std::optional<VideoInfo>
+getVideoFromFile(std::filesystem::path const& file);
 
 bool validate_directory(std::filesystem::path const& root);
@@ -0,0 +1,150 @@
+#include "GoldenCorpus.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+namespace golden {
+
+namespace {
+
+// Small LCG so the frames do not depend on the standard library's engines.
+struct Lcg {
+    std::uint32_t s;
+    std::uint32_t next()
+    {
+        s = s * 1664525u + 1013904223u;
+        return s >> 8;
+    }
+    double unit() { return (next() & 0xffffff) / double(0x1000000); }
+};
+
+std::uint8_t clamp8(double v)
+{
+    return static_cast<std::uint8_t>(std::clamp(std::lround(v), 0L, 255L));
+}
+
+// clang-format off
+constexpr GoldenFrame kFrames[] = {
+    { "hgradient-320x240",  Pattern::HGradient, 320,  240,  1, { 0x2185dc70ce4f7336ULL, 0x76dc89259b1a2e62ULL, 0x93852873b38d8f4aULL, 0x8add7724651bd862ULL, 0x38d1832798dda51eULL }, 0x2185dc70ce4f7336ULL },
+    { "vgradient-640x360",  Pattern::VGradient, 640,  360,  2, { 0x74826d89a24f1cfeULL, 0x21d738dcb71249aaULL, 0x61e61e06533a1bceULL, 0xdbd6c6dd0112b2aaULL, 0xcab2a552f866b09aULL }, 0x74826d89e24e1cfeULL },
+    { "diagonal-1280x720",  Pattern::Diagonal,  1280, 720,  3, { 0x5c941be88d2b2b96ULL, 0x09c146bdd87e76c2ULL, 0x7be675789628870aULL, 0xf7c0b0bc267f80c2ULL, 0xd0b2de2c3d386c4eULL }, 0xdc943be80d2b2396ULL },
+    { "checker-320x240",    Pattern::Checker,   320,  240,  4, { 0x706489db8e53c678ULL, 0x2531dd8edb07932cULL, 0x6130fad67f07c168ULL, 0xdb302387a5076f2cULL, 0xee745182d4736a3cULL }, 0x706489db8e53c678ULL },
+    { "checker-97x61",      Pattern::Checker,   97,   61,   5, { 0x343035cbca356abeULL, 0x6565609e9f601f64ULL, 0x6165609e9f631d62ULL, 0x9b649e9f6161e164ULL, 0xca31cbca3435b634ULL }, 0x1d603cebcb456b2aULL },
+    { "rings-640x480",      Pattern::Rings,     640,  480,  6, { 0x91b01f16ee94cad8ULL, 0xc4e54a43bbc38f8cULL, 0xf4cb43c4bf032f28ULL, 0x3ae4b44247c67d8cULL, 0x5f9fe8901057867cULL }, 0x91b01f16ee94cad8ULL },
+    { "rings-33x47",        Pattern::Rings,     33,   47,   7, { 0x401e156a7da1f3b8ULL, 0x154b403f2af4a6eeULL, 0x7b5a616b83e781e0ULL, 0xcb4aba3ad4f550c0ULL, 0xd00eca3f28b32eb6ULL }, 0x845a1d6a7de073a8ULL },
+    { "blobs-1920x1080",    Pattern::Blobs,     1920, 1080, 8, { 0x5e41e05f53a79472ULL, 0x0b94b50a2ef2c7a6ULL, 0x0918a71e6274fa6eULL, 0xf5114b0bd0f33f22ULL, 0xa2ce0c5ac930d73eULL }, 0x5e41e25f13a79472ULL },
+    { "blobs-320x240",      Pattern::Blobs,     320,  240,  9, { 0x50dd4f89ad27e24cULL, 0x05885adcf872d71cULL, 0x29c0d344d5f78f18ULL, 0xfb89ac5d0e536918ULL, 0x82b47c187ef3264cULL }, 0x50dd4f89ad27e24cULL },
+    { "bars-854x480",       Pattern::Bars,      854,  480, 10, { 0x7886db7886cd3886ULL, 0x2dd30e2dd3886dd2ULL, 0x718e3c783839cf86ULL, 0xd3d2702c2d9993d2ULL, 0xda9a9724936d64d2ULL }, 0x7886db7886cd3886ULL },
+    { "quadrants-320x240",  Pattern::Quadrants, 320,  240, 11, { 0xbc1e054956f6c926ULL, 0xe96b501d03e39c7aULL, 0x6659605ecce08fceULL, 0x174aae1cfda22272ULL, 0xdd0dcb8a67a6249aULL }, 0xbc1e054956f6c926ULL },
+    { "softnoise-480x270",  Pattern::SoftNoise, 480,  270, 12, { 0x9d3e2fb409698694ULL, 0xc86b7ae15c3cd3c0ULL, 0xf8531d9cf68c9390ULL, 0x3e6ac4e2a23d2de0ULL, 0x5327f6e85dd818c4ULL }, 0x9d3e2fb409698694ULL },
+};
+// clang-format on
+
+} // namespace
+
+std::span<GoldenFrame const> frames() { return kFrames; }
+
+std::vector<std::uint8_t> render(Pattern p, int w, int h, std::uint32_t seed)
+{
+    std::vector<double> img(static_cast<std::size_t>(w) * h);
+    Lcg rng { seed * 2654435761u + 1u };
+    auto at = [&](int x, int y) -> double& { return img[static_cast<std::size_t>(y) * w + x]; };
+
+    // Smooth random lattice (9×9 control points, bilinear), used on its own
+    // for SoftNoise and at low amplitude under every other pattern: flat and
+    // perfectly symmetric images put DCT coefficients exactly on the median,
+    // where the hash bit is decided by rounding noise.
+    std::array<double, 81> lattice;
+    for (auto& v : lattice)
+        v = rng.unit();
+    auto texture = [&](int x, int y) {
+        double const fx = 8.0 * x / w, fy = 8.0 * y / h;
+        int const ix = static_cast<int>(fx), iy = static_cast<int>(fy);
+        double const tx = fx - ix, ty = fy - iy;
+        auto L = [&](int i, int j) { return lattice[j * 9 + i]; };
+        double const top = L(ix, iy) * (1 - tx) + L(ix + 1, iy) * tx;
+        double const bot = L(ix, iy + 1) * (1 - tx) + L(ix + 1, iy + 1) * tx;
+        return top * (1 - ty) + bot * ty;
+    };
+
+    switch (p) {
+    case Pattern::HGradient:
+        for (int y = 0; y < h; ++y)
+            for (int x = 0; x < w; ++x)
+                at(x, y) = 255.0 * x / std::max(1, w - 1) * (0.75 + 0.25 * std::sin(y * 6.0 / h));
+        break;
+    case Pattern::VGradient:
+        for (int y = 0; y < h; ++y)
+            for (int x = 0; x < w; ++x)
+                at(x, y) = 255.0 * y / std::max(1, h - 1) * (0.7 + 0.3 * std::cos(x * 5.0 / w));
+        break;
+    case Pattern::Diagonal:
+        for (int y = 0; y < h; ++y)
+            for (int x = 0; x < w; ++x)
+                at(x, y) = 127.5 + 127.5 * std::sin((x * 3.0 / w + y * 2.0 / h) * 3.14159);
+        break;
+    case Pattern::Checker: {
+        int const cells = 3 + static_cast<int>(seed % 4);
+        for (int y = 0; y < h; ++y)
+            for (int x = 0; x < w; ++x) {
+                int const cx = x * cells / w, cy = y * cells / h;
+                at(x, y) = ((cx + cy) & 1) ? 220 : 35;
+            }
+        break;
+    }
+    case Pattern::Rings: {
+        double const ox = w * (0.3 + 0.4 * rng.unit()), oy = h * (0.3 + 0.4 * rng.unit());
+        double const scale = 18.0 / std::max(w, h);
+        for (int y = 0; y < h; ++y)
+            for (int x = 0; x < w; ++x)
+                at(x, y) = 127.5 + 120.0 * std::cos(std::hypot(x - ox, y - oy) * scale);
+        break;
+    }
+    case Pattern::Blobs: {
+        struct Blob { double x, y, r, a; };
+        std::array<Blob, 7> blobs;
+        for (auto& b : blobs)
+            b = { rng.unit() * w, rng.unit() * h, (0.08 + 0.2 * rng.unit()) * std::min(w, h),
+                (rng.unit() - 0.4) * 200.0 };
+        for (int y = 0; y < h; ++y)
+            for (int x = 0; x < w; ++x) {
+                double v = 60.0;
+                for (auto const& b : blobs) {
+                    double const d = std::hypot(x - b.x, y - b.y) / b.r;
+                    v += b.a * std::exp(-d * d);
+                }
+                at(x, y) = v;
+            }
+        break;
+    }
+    case Pattern::Bars: {
+        std::array<std::uint8_t, 9> levels;
+        for (auto& l : levels)
+            l = static_cast<std::uint8_t>(rng.next() & 0xff);
+        for (int y = 0; y < h; ++y)
+            for (int x = 0; x < w; ++x)
+                at(x, y) = y < h * 2 / 3 ? levels[x * 7 / w] : levels[7 + (x * 2 / w)];
+        break;
+    }
+    case Pattern::Quadrants:
+        for (int y = 0; y < h; ++y)
+            for (int x = 0; x < w; ++x)
+                at(x, y) = (x < w / 2 ? 40 : 170) + (y < h / 3 ? 60 : 0);
+        break;
+    case Pattern::SoftNoise:
+        for (int y = 0; y < h; ++y)
+            for (int x = 0; x < w; ++x)
+                at(x, y) = 255.0 * texture(x, y);
+        break;
+    }
+
+    std::vector<std::uint8_t> out(img.size());
+    double const amp = p == Pattern::SoftNoise ? 0.0 : 40.0;
+    for (int y = 0; y < h; ++y)
+        for (int x = 0; x < w; ++x)
+            out[static_cast<std::size_t>(y) * w + x] = clamp8(at(x, y) + amp * (texture(x, y) - 0.5));
+    return out;
+}
+
+} // namespace golden
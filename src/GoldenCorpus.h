@@ -0,0 +1,48 @@
+#pragma once
+
+#include "Hash.h"
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Deterministic synthetic frames with the pHashes the shipped pipeline
+// produced for them when the table was recorded.  The frames are generated
+// in code rather than stored as files so the "corpus" is a few hundred
+// bytes of source, and the hashes pin down everything between a GRAY8 frame
+// and the stored value: tile extraction, down-scale, DCT, median split and
+// the orientation permutations.  See GoldenHashes.h for the checker.
+namespace golden {
+
+enum class Pattern : std::uint8_t {
+    HGradient,
+    VGradient,
+    Diagonal,
+    Checker,
+    Rings,
+    Blobs,
+    Bars,
+    Quadrants,
+    SoftNoise
+};
+
+struct GoldenFrame {
+    char const* name;
+    Pattern pattern;
+    int width;
+    int height;
+    std::uint32_t seed;
+    PHashVariants expected; // PHashOrientation order
+    std::uint64_t video;    // Original hash at kVideoWidth×kVideoHeight
+};
+
+// Size the corpus is rendered at for the encoded-video checks.
+constexpr int kVideoWidth = 320;
+constexpr int kVideoHeight = 240;
+
+std::span<GoldenFrame const> frames();
+
+// Row-major GRAY8, stride == width.
+std::vector<std::uint8_t> render(Pattern p, int w, int h, std::uint32_t seed);
+
+} // namespace golden
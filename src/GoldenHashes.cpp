@@ -0,0 +1,534 @@
+#include "GoldenHashes.h"
+#include "FastVideoProcessor.h"
+#include "GoldenCorpus.h"
+#include "HashBlob.h"
+#include "MatchIndex.h"
+#include "SearchSettings.h"
+#include "SimdKernels.h"
+#include "SlowVideoProcessor.h"
+#include "VideoInfo.h"
+#include "VideoProcessingUtils.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+#include <unistd.h>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/frame.h>
+}
+
+namespace golden {
+
+namespace {
+
+constexpr int kDefaultTolerance = 4;
+constexpr int kFps = 2;          // each corpus image is held for one second
+
+struct Tally {
+    std::string label;
+    bool gating = true; // informational rows never fail the run
+    int total = 0;
+    int exact = 0;
+    int within = 0;
+    int maxDist = 0;
+
+    void add(int d, int k)
+    {
+        ++total;
+        exact += d == 0;
+        within += d <= k;
+        maxDist = std::max(maxDist, d);
+    }
+    bool ok() const { return !gating || within == total; }
+};
+
+int dist(uint64_t a, uint64_t b) { return std::popcount(a ^ b); }
+
+void report(Tally const& t, int k)
+{
+    spdlog::info("[golden] {:<30} {:3}/{:<3} exact  {:3}/{:<3} within {} bits  (max {}){}",
+        t.label, t.exact, t.total, t.within, t.total, k, t.maxDist,
+        t.ok() ? (t.gating ? "" : "  [info]") : "  FAIL");
+}
+
+// ---------------------------------------------------------------------
+// frame helpers
+// ---------------------------------------------------------------------
+vpu::FrmPtr make_frame(AVPixelFormat fmt, int w, int h)
+{
+    vpu::FrmPtr f { av_frame_alloc() };
+    if (!f)
+        throw std::bad_alloc();
+    f->format = fmt;
+    f->width = w;
+    f->height = h;
+    if (int e = av_frame_get_buffer(f.get(), 0); e < 0)
+        throw std::runtime_error(std::format("av_frame_get_buffer: {}", vpu::err2str(e)));
+    return f;
+}
+
+vpu::FrmPtr gray8_frame(std::vector<uint8_t> const& img, int w, int h)
+{
+    vpu::FrmPtr f = make_frame(AV_PIX_FMT_GRAY8, w, h);
+    for (int y = 0; y < h; ++y)
+        std::memcpy(f->data[0] + static_cast<std::ptrdiff_t>(y) * f->linesize[0],
+            img.data() + static_cast<std::size_t>(y) * w, static_cast<std::size_t>(w));
+    return f;
+}
+
+// Same picture as a 10-bit 4:2:0 frame, luma scaled to the 10-bit range.
+vpu::FrmPtr yuv420p10_frame(std::vector<uint8_t> const& img, int w, int h)
+{
+    vpu::FrmPtr f = make_frame(AV_PIX_FMT_YUV420P10LE, w, h);
+    for (int y = 0; y < h; ++y) {
+        auto* row = reinterpret_cast<uint16_t*>(f->data[0] + static_cast<std::ptrdiff_t>(y) * f->linesize[0]);
+        for (int x = 0; x < w; ++x)
+            row[x] = static_cast<uint16_t>(img[static_cast<std::size_t>(y) * w + x] << 2);
+    }
+    for (int p = 1; p <= 2; ++p)
+        for (int y = 0; y < (h + 1) / 2; ++y) {
+            auto* row = reinterpret_cast<uint16_t*>(f->data[p] + static_cast<std::ptrdiff_t>(y) * f->linesize[p]);
+            std::fill_n(row, (w + 1) / 2, uint16_t { 512 });
+        }
+    return f;
+}
+
+// Packed RGB, which extract_luma_tile sends through swscale.
+vpu::FrmPtr rgb24_frame(std::vector<uint8_t> const& img, int w, int h)
+{
+    vpu::FrmPtr f = make_frame(AV_PIX_FMT_RGB24, w, h);
+    for (int y = 0; y < h; ++y) {
+        uint8_t* row = f->data[0] + static_cast<std::ptrdiff_t>(y) * f->linesize[0];
+        for (int x = 0; x < w; ++x)
+            std::fill_n(row + 3 * x, 3, img[static_cast<std::size_t>(y) * w + x]);
+    }
+    return f;
+}
+
+std::optional<PHashVariants> hash_via_tile(AVFrame const* f)
+{
+    uint8_t tile[kPHashTile * kPHashTile];
+    if (!vpu::extract_luma_tile(f, tile, false))
+        return std::nullopt;
+    return compute_phash_from_tile(tile);
+}
+
+std::optional<PHashVariantsT<256>> wide_via_tile(AVFrame const* f)
+{
+    uint8_t tile[kPHashTile * kPHashTile];
+    if (!vpu::extract_luma_tile(f, tile, false))
+        return std::nullopt;
+    return compute_phash_from_tile<256>(tile);
+}
+
+// The 128/256-bit Hamming kernels against PHashT's popcounts; returns the
+// number of queries whose index lists differ.
+template <std::size_t Bits>
+int hamming_kernel_mismatches()
+{
+    constexpr std::size_t kN = 61; // not a multiple of any vector width
+    std::uint64_t state = 0x9e3779b97f4a7c15ULL;
+    auto next = [&] { // xorshift64
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    };
+    std::vector<PHashT<Bits>> hashes(kN);
+    PHashT<Bits> q;
+    for (auto& w : q.w)
+        w = next();
+    for (auto& h : hashes)
+        for (std::size_t i = 0; i < h.w.size(); ++i)
+            h.w[i] = q.w[i] ^ (next() & next() & next()); // ~1/8 of the bits differ
+
+    int bad = 0;
+    std::vector<std::uint32_t> got(kN);
+    constexpr unsigned bits = Bits;
+    for (unsigned const maxDist : { 0u, bits / 16, bits / 8, bits / 4 }) {
+        std::size_t const n = hamming_within(q, hashes.data(), kN, maxDist, got.data());
+        std::size_t k = 0;
+        bool same = true;
+        for (std::size_t i = 0; i < kN; ++i)
+            if (hamming(q, hashes[i]) <= maxDist)
+                same &= k < n && got[k++] == i;
+        bad += !(same && k == n);
+    }
+    return bad;
+}
+
+// Packed hash blobs (all-zero, repeated, sparse and random deltas, odd
+// lengths so every kernel hits its tail) must come back word for word.
+int blob_round_trip_mismatches()
+{
+    std::uint64_t state = 0x2545f4914f6cdd1dULL;
+    auto next = [&] { // xorshift64
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    };
+    int bad = 0;
+    for (std::size_t const stride : { 1u, 2u, 4u, 28u }) {
+        for (std::size_t const n : { 0u, 1u, 7u, 61u, 509u }) {
+            std::vector<std::uint64_t> words(n * stride);
+            for (std::size_t i = 0; i < words.size(); ++i) {
+                std::uint64_t const prev = i >= stride ? words[i - stride] : next();
+                switch (i % 5) {
+                case 0: words[i] = prev; break;
+                case 1: words[i] = prev ^ (next() & next() & next()); break;
+                case 2: words[i] = prev ^ (std::uint64_t { 1 } << (next() & 63)); break;
+                case 3: words[i] = 0; break;
+                default: words[i] = next(); break;
+                }
+            }
+            auto const back = hashblob::unpack(hashblob::pack(words, stride));
+            bad += !back || *back != words;
+        }
+    }
+    return bad;
+}
+
+// A stored video holding many near copies of each query hash must count
+// every query hash once: matched <= the query's length, for the trie at
+// each width and for LSH.  Returns the number of indexes that overcount.
+int match_count_mismatches()
+{
+    std::uint64_t state = 0x853c49e6748fea9bULL;
+    auto next = [&] { // xorshift64
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    };
+    int bad = 0;
+    for (unsigned const bits : { 64u, 128u, 256u }) {
+        for (bool const lsh : { false, true }) {
+            MatchIndex index(bits, lsh ? std::optional { LshIndex::Params { 8, 8 } } : std::nullopt);
+            std::size_t const words = bits / 64;
+            HashGroup query { -1, bits, {}, {} };
+            HashGroup stored { 1, bits, {}, {} };
+            for (int i = 0; i < 3; ++i) {
+                std::vector<std::uint64_t> h(words);
+                for (auto& w : h)
+                    w = next();
+                query.hashes.insert(query.hashes.end(), h.begin(), h.end());
+                for (int copy = 0; copy < 10; ++copy) { // 0-1 bits off
+                    auto near = h;
+                    if (copy)
+                        near[0] ^= std::uint64_t { 1 } << (copy - 1);
+                    stored.hashes.insert(stored.hashes.end(), near.begin(), near.end());
+                }
+            }
+            index.add(stored);
+            auto const counts = index.matchCounts(query, 2);
+            auto const it = counts.find(1);
+            bad += it == counts.end() || it->second != static_cast<int>(query.count());
+        }
+    }
+    return bad;
+}
+
+// ---------------------------------------------------------------------
+// frame corpus, once per SIMD level
+// ---------------------------------------------------------------------
+// wideRef is filled by the first (scalar) pass and compared against after.
+bool verify_frames(simd::Isa isa, int k, std::vector<PHashT<256>>& wideRef)
+{
+    std::string const lvl = simd::isa_name(isa);
+    int const kWide = 4 * k; // same share of the bits
+    Tally tile { lvl + " tile (GRAY8)" };
+    Tally orient { lvl + " orientation variants" };
+    Tally p10 { lvl + " tile (10-bit planar)" };
+    Tally sws { lvl + " tile (swscale, RGB24)", false };
+    Tally full { lvl + " full-resolution path", false };
+    Tally wide { lvl + " 256-bit tile vs scalar" };
+    Tally kernels { lvl + " Hamming / hash blob / match count" };
+
+    for (GoldenFrame const& g : frames()) {
+        auto const img = render(g.pattern, g.width, g.height, g.seed);
+
+        // every frame gets a wide row, so rows line up across levels
+        auto const w = wide_via_tile(gray8_frame(img, g.width, g.height).get());
+        std::size_t const wi = static_cast<std::size_t>(wide.total);
+        if (wideRef.size() <= wi)
+            wideRef.push_back(w ? (*w)[0] : PHashT<256> {});
+        wide.add(w ? static_cast<int>(hamming((*w)[0], wideRef[wi])) : 256, kWide);
+
+        auto const t = hash_via_tile(gray8_frame(img, g.width, g.height).get());
+        if (!t) {
+            spdlog::error("[golden] {}: tile path produced no hash", g.name);
+            tile.add(64, k);
+            continue;
+        }
+        tile.add(dist((*t)[0], g.expected[0]), k);
+        for (std::size_t o = 1; o < kPHashOrientations; ++o)
+            orient.add(dist((*t)[o], g.expected[o]), k);
+
+        auto const h10 = hash_via_tile(yuv420p10_frame(img, g.width, g.height).get());
+        p10.add(h10 ? dist((*h10)[0], g.expected[0]) : 64, k);
+
+        auto const hs = hash_via_tile(rgb24_frame(img, g.width, g.height).get());
+        sws.add(hs ? dist((*hs)[0], g.expected[0]) : 64, k);
+
+        auto const hf = compute_phash_variants(img.data(), g.width, g.height);
+        full.add(hf ? dist((*hf)[0], g.expected[0]) : 64, k);
+
+        if ((*t)[0] != g.expected[0])
+            spdlog::warn("[golden] {} {}: {:016x} != expected {:016x}",
+                lvl, g.name, (*t)[0], g.expected[0]);
+    }
+
+    kernels.add(hamming_kernel_mismatches<128>() ? 64 : 0, 0);
+    kernels.add(hamming_kernel_mismatches<256>() ? 64 : 0, 0);
+    kernels.add(blob_round_trip_mismatches() ? 64 : 0, 0);
+    kernels.add(match_count_mismatches() ? 64 : 0, 0);
+
+    bool ok = true;
+    for (Tally const* r : { &tile, &orient, &p10, &sws, &full }) {
+        report(*r, k);
+        ok &= r->ok();
+    }
+    report(wide, kWide);
+    report(kernels, 0);
+    return ok && wide.ok() && kernels.ok();
+}
+
+// ---------------------------------------------------------------------
+// video corpus
+// ---------------------------------------------------------------------
+bool encode_video(std::filesystem::path const& path, AVCodecID id,
+    std::vector<std::vector<uint8_t>> const& imgs, int w, int h)
+{
+    AVCodec const* enc = avcodec_find_encoder(id);
+    if (!enc) {
+        spdlog::warn("[golden] no {} encoder in this FFmpeg build", avcodec_get_name(id));
+        return false;
+    }
+
+    AVFormatContext* raw = nullptr;
+    std::string const file = path.string();
+    if (avformat_alloc_output_context2(&raw, nullptr, nullptr, file.c_str()) < 0 || !raw)
+        return false;
+    auto closeOut = [](AVFormatContext* c) {
+        if (c->pb)
+            avio_closep(&c->pb);
+        avformat_free_context(c);
+    };
+    std::unique_ptr<AVFormatContext, decltype(closeOut)> oc { raw, closeOut };
+
+    AVStream* st = avformat_new_stream(oc.get(), nullptr);
+    vpu::CtxPtr ctx { avcodec_alloc_context3(enc) };
+    if (!st || !ctx)
+        return false;
+
+    ctx->width = w;
+    ctx->height = h;
+    ctx->pix_fmt = AV_PIX_FMT_YUV420P;
+    ctx->time_base = { 1, kFps };
+    ctx->framerate = { kFps, 1 };
+    ctx->gop_size = kFps; // a keyframe at the start of every image
+    ctx->max_b_frames = 0;
+    if (id == AV_CODEC_ID_MPEG4) {
+        ctx->qmin = 2;
+        ctx->qmax = 4;
+    }
+    if (oc->oformat->flags & AVFMT_GLOBALHEADER)
+        ctx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+
+    if (avcodec_open2(ctx.get(), enc, nullptr) < 0
+        || avcodec_parameters_from_context(st->codecpar, ctx.get()) < 0)
+        return false;
+    st->time_base = ctx->time_base;
+
+    if (avio_open(&oc->pb, file.c_str(), AVIO_FLAG_WRITE) < 0
+        || avformat_write_header(oc.get(), nullptr) < 0)
+        return false;
+
+    vpu::FrmPtr frm = make_frame(AV_PIX_FMT_YUV420P, w, h);
+    vpu::PktPtr pkt { av_packet_alloc() };
+
+    auto drain = [&]() -> bool {
+        for (;;) {
+            int r = avcodec_receive_packet(ctx.get(), pkt.get());
+            if (r == AVERROR(EAGAIN) || r == AVERROR_EOF)
+                return true;
+            if (r < 0)
+                return false;
+            av_packet_rescale_ts(pkt.get(), ctx->time_base, st->time_base);
+            pkt->stream_index = st->index;
+            if (av_interleaved_write_frame(oc.get(), pkt.get()) < 0)
+                return false;
+        }
+    };
+
+    int64_t pts = 0;
+    for (auto const& img : imgs) {
+        for (int rep = 0; rep < kFps; ++rep) {
+            if (av_frame_make_writable(frm.get()) < 0)
+                return false;
+            for (int y = 0; y < h; ++y)
+                std::memcpy(frm->data[0] + static_cast<std::ptrdiff_t>(y) * frm->linesize[0],
+                    img.data() + static_cast<std::size_t>(y) * w, static_cast<std::size_t>(w));
+            for (int p = 1; p <= 2; ++p)
+                for (int y = 0; y < h / 2; ++y)
+                    std::memset(frm->data[p] + static_cast<std::ptrdiff_t>(y) * frm->linesize[p], 128,
+                        static_cast<std::size_t>(w / 2));
+            frm->pts = pts++;
+            if (avcodec_send_frame(ctx.get(), frm.get()) < 0 || !drain())
+                return false;
+        }
+    }
+    if (avcodec_send_frame(ctx.get(), nullptr) < 0 || !drain())
+        return false;
+    return av_write_trailer(oc.get()) == 0;
+}
+
+// Each produced hash is scored against the nearest corpus image: the
+// processors sample by time, so which images they land on is theirs to pick.
+void score(Tally& t, std::vector<uint64_t> const& got,
+    std::vector<uint64_t> const& expected, int k)
+{
+    for (uint64_t h : got) {
+        int best = 64;
+        for (uint64_t e : expected)
+            best = std::min(best, dist(h, e));
+        t.add(best, k);
+    }
+}
+
+bool verify_videos(std::filesystem::path const& dir, int k)
+{
+    // the images as encoded, checked through the production tile path
+    // before they stand in for the decoded frames
+    Tally source { "video images (GRAY8 tile)" };
+    std::vector<std::vector<uint8_t>> imgs;
+    std::vector<uint64_t> expected;
+    for (GoldenFrame const& g : frames()) {
+        imgs.push_back(render(g.pattern, kVideoWidth, kVideoHeight, g.seed));
+        expected.push_back(g.video);
+        auto const h = hash_via_tile(gray8_frame(imgs.back(), kVideoWidth, kVideoHeight).get());
+        source.add(h ? dist((*h)[0], g.video) : 64, k);
+        if (h && (*h)[0] != g.video)
+            spdlog::warn("[golden] {} at {}x{}: {:016x} != expected {:016x}",
+                g.name, kVideoWidth, kVideoHeight, (*h)[0], g.video);
+    }
+    report(source, k);
+
+    struct Encoding {
+        char const* label;
+        AVCodecID id;
+        char const* file;
+        bool lossless;
+    };
+    Encoding const encodings[] = {
+        { "FFV1/mkv", AV_CODEC_ID_FFV1, "golden-ffv1.mkv", true },
+        { "MPEG-4/avi", AV_CODEC_ID_MPEG4, "golden-mpeg4.avi", false },
+    };
+
+    SearchSettings cfg;
+    cfg.fastHash.useKeyframesOnly = false;
+
+    bool ok = source.ok();
+    for (Encoding const& e : encodings) {
+        std::filesystem::path const path = dir / e.file;
+        if (!encode_video(path, e.id, imgs, kVideoWidth, kVideoHeight)) {
+            spdlog::warn("[golden] skipping {}: could not encode {}", e.label, path.string());
+            continue;
+        }
+
+        VideoInfo vi;
+        vi.path = path.string();
+        vi.duration = static_cast<int>(imgs.size());
+
+        // lossy encodes are reported, not gated: the tolerance there is a
+        // property of the encoder, not of our pipeline
+        Tally slow { std::format("{} slow processor", e.label), e.lossless };
+        Tally fast { std::format("{} fast processor", e.label), e.lossless };
+        try {
+            score(slow, SlowVideoProcessor {}.decodeAndHash(vi, cfg), expected, k);
+            score(fast, FastVideoProcessor {}.decodeAndHash(vi, cfg), expected, k);
+        } catch (std::exception const& ex) {
+            spdlog::error("[golden] {}: {}", e.label, ex.what());
+            ok &= !e.lossless;
+            continue;
+        }
+        if (slow.total != static_cast<int>(imgs.size()))
+            spdlog::warn("[golden] {}: slow processor sampled {} frames, expected {}",
+                e.label, slow.total, imgs.size());
+
+        for (Tally const* r : { &slow, &fast }) {
+            report(*r, k);
+            ok &= r->ok() && (r->total > 0 || !r->gating);
+        }
+    }
+    return ok;
+}
+
+} // namespace
+
+int runVerifyHashes(std::vector<std::string_view> const& args)
+{
+    int k = kDefaultTolerance;
+    std::filesystem::path keepDir;
+    for (std::size_t i = 0; i < args.size(); ++i) {
+        if (args[i] == "--keep-videos" && i + 1 < args.size()) {
+            keepDir = std::filesystem::path(args[++i]);
+            continue;
+        }
+        auto const [p, ec] = std::from_chars(args[i].data(), args[i].data() + args[i].size(), k);
+        if (ec != std::errc {} || p != args[i].data() + args[i].size() || k < 0 || k > 64) {
+            spdlog::error("[golden] usage: --verify-hashes [k] [--keep-videos <dir>]");
+            return 2;
+        }
+    }
+
+    av_log_set_level(AV_LOG_ERROR);
+    spdlog::info("[golden] {} corpus frames, tolerance {} bits, CPU supports up to {}",
+        frames().size(), k, simd::isa_name(simd::detected_isa()));
+
+    bool ok = true;
+    simd::Isa const active = simd::active_isa();
+    std::vector<PHashT<256>> wideRef;
+    for (auto isa : { simd::Isa::Scalar, simd::Isa::Sse42, simd::Isa::Avx2, simd::Isa::Avx512 }) {
+        if (!simd::force_isa(isa))
+            continue;
+        ok &= verify_frames(isa, k, wideRef);
+    }
+    simd::force_isa(active);
+
+    std::filesystem::path dir = keepDir;
+    std::error_code ec;
+    if (dir.empty())
+        dir = std::filesystem::temp_directory_path(ec) / std::format("ndv-golden-{}", ::getpid());
+    std::filesystem::create_directories(dir, ec);
+    if (ec) {
+        spdlog::error("[golden] cannot create {}: {}", dir.string(), ec.message());
+        return 1;
+    }
+
+    ok &= verify_videos(dir, k);
+
+    if (keepDir.empty())
+        std::filesystem::remove_all(dir, ec);
+    else
+        spdlog::info("[golden] videos kept in {}", dir.string());
+
+    spdlog::info("[golden] {}", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
+
+} // namespace golden
@@ -0,0 +1,18 @@
+#pragma once
+#include <string_view>
+#include <vector>
+
+// Regression check of the hashing pipeline against the golden corpus
+// (GoldenCorpus.h).  For every SIMD level the CPU supports it hashes the
+// frames through the production tile path, a 10-bit plane, the swscale
+// fallback and the full-resolution path, then encodes the corpus as small
+// lossless (FFV1) and lossy (MPEG-4) videos and runs both video processors
+// over them.  Each line reports bit-exact and within-k agreement; the
+// 256-bit hashes (no golden values) are checked against the scalar level,
+// within 4k bits, and the 128/256-bit Hamming kernels against popcounts.
+//
+//   --verify-hashes [k] [--keep-videos <dir>]
+namespace golden
+{
+    int                                runVerifyHashes(std::vector<std::string_view> const& args);
+} // namespace golden
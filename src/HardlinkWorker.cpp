@@ -141,5 +141,5 @@ void HardlinkWorker::process()
     }
     m_db.commit();
 
-    emit finished(std::move(m_groups), linksMade, errors);
+    emit finished(std::make_shared<DuplicateGroups const>(std::move(m_groups)), linksMade, errors);
 }
@@ -15,7 +15,7 @@ public:
 
 signals:
     void progress(int current, int total);
-    void finished(std::vector<std::vector<VideoInfo>> updatedGroups,
+    void finished(GroupsSnapshot updatedGroups,
                   int linksCreated,
                   int errors);
 
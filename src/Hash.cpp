@@ -1,42 +1,205 @@
 #include "Hash.h"
+#include "ScratchArena.h"
+#include "SimdKernels.h"
 
-#include <immintrin.h> // SSE2/AVX2 intrinsics (SIMD down-scale)
+#include <algorithm>
+#include <array>
+#include <cmath>
 #include <iostream>
 #include <optional>
 #include <vector>
 
-static CImg<float> ph_dct_matrix(int const N)
+// Low-frequency 8×8 block of the 32×32 DCT (rows/cols 1..8), row-major with
+// the horizontal frequency running fastest.  img is 32×32, row-major.
+static void ph_dct_block_from_buffer(float const* img, float* block)
 {
-    CImg<float> matrix(N, N, 1, 1, 1 / sqrt((float)N));
-    float const c1 = sqrt(2.0 / N);
-    for (int x = 0; x < N; x++) {
-        for (int y = 1; y < N; y++) {
-            matrix(x, y) = c1 * cos((cimg::PI / 2 / N) * y * (2 * x + 1));
+    simd::dct_low8x8(img, block);
+}
+
+// Separable 7×7 box sum with clamped edges; same result as
+// CImg::convolve() with an all-ones 7×7 kernel, without its temporaries.
+static void box7(float const* src, int w, int h, float* tmp, float* dst)
+{
+    constexpr int R = 3;
+    for (int y = 0; y < h; ++y) {
+        float const* row = src + static_cast<std::size_t>(y) * w;
+        float* out = tmp + static_cast<std::size_t>(y) * w;
+        for (int x = 0; x < w; ++x) {
+            float acc = 0.f;
+            for (int k = -R; k <= R; ++k)
+                acc += row[std::clamp(x + k, 0, w - 1)];
+            out[x] = acc;
+        }
+    }
+    for (int y = 0; y < h; ++y) {
+        float* out = dst + static_cast<std::size_t>(y) * w;
+        for (int x = 0; x < w; ++x)
+            out[x] = 0.f;
+        for (int k = -R; k <= R; ++k) {
+            float const* in = tmp + static_cast<std::size_t>(std::clamp(y + k, 0, h - 1)) * w;
+            for (int x = 0; x < w; ++x)
+                out[x] += in[x];
         }
     }
-    return matrix;
 }
 
-static CImg<float> const dct_matrix = ph_dct_matrix(32);
-static CImg<float> const kMean7(7, 7, 1, 1, 1.f);
+// Median split of the block, same as CImg::median() on 64 values.
+static uint64_t ph_hash_from_block(float const* block)
+{
+    std::array<float, 64> sorted;
+    std::copy_n(block, 64, sorted.begin());
+    std::nth_element(sorted.begin(), sorted.begin() + 32, sorted.end());
+    float const hi = sorted[32];
+    float const lo = *std::max_element(sorted.begin(), sorted.begin() + 32);
+    float const median = (lo + hi) / 2;
 
-int ph_dct_imagehash_from_buffer(CImg<float> const& img, ulong& hash)
+    uint64_t hash = 0;
+    for (int i = 0; i < 64; i++, hash <<= 1) {
+        if (block[i] > median)
+            hash |= 0x01;
+    }
+    return hash;
+}
+
+// Flipping the image mirrors a DCT basis function of frequency k onto
+// (-1)^k times itself, and transposing the image transposes the block, so
+// every flip/rotation of the frame is a signed permutation of the block.
+static PHashVariants ph_hash_variants_from_block(float const* block)
 {
-    CImg<float> const& C = dct_matrix;
-    CImg<float> Ctransp = C.get_transpose();
+    PHashVariants out {};
+    std::array<float, 64> t;
+    for (std::size_t o = 0; o < kPHashOrientations; ++o) {
+        for (int v = 1; v <= 8; ++v) {
+            for (int u = 1; u <= 8; ++u) {
+                float const same = block[(v - 1) * 8 + (u - 1)];
+                float const transposed = block[(u - 1) * 8 + (v - 1)];
+                float const su = (u & 1) ? -1.f : 1.f;
+                float const sv = (v & 1) ? -1.f : 1.f;
+
+                float c = same;
+                switch (static_cast<PHashOrientation>(o)) {
+                case PHashOrientation::Original:
+                    c = same;
+                    break;
+                case PHashOrientation::FlipH:
+                    c = su * same;
+                    break;
+                case PHashOrientation::Rot90: // transpose, then mirror
+                    c = su * transposed;
+                    break;
+                case PHashOrientation::Rot180:
+                    c = su * sv * same;
+                    break;
+                case PHashOrientation::Rot270: // transpose, then flip
+                    c = sv * transposed;
+                    break;
+                }
+                t[(v - 1) * 8 + (u - 1)] = c;
+            }
+        }
+        out[o] = ph_hash_from_block(t.data());
+    }
+    return out;
+}
 
-    CImg<float> dctImage = (C)*img * Ctransp;
+// Zigzag order of the 16×16 block (by u + v, alternating direction along
+// each anti-diagonal, as in JPEG); the wide hashes take its first Bits
+// coefficients, so word 0 holds the 64 lowest frequencies.
+struct Zigzag16 {
+    std::array<std::uint8_t, 256> idx {}; // v * 16 + u, zero-based
+    Zigzag16()
+    {
+        std::size_t k = 0;
+        for (int s = 0; s <= 30; ++s) {
+            for (int i = 0; i <= s; ++i) {
+                int const v = (s & 1) ? i : s - i;
+                int const u = s - v;
+                if (u < 16 && v < 16)
+                    idx[k++] = static_cast<std::uint8_t>(v * 16 + u);
+            }
+        }
+    }
+};
+static Zigzag16 const kZigzag16;
 
-    CImg<float> subsec = dctImage.crop(1, 1, 8, 8).unroll('x');
+// Below this every coefficient is float round-off: the tile was flat.
+constexpr float kFlatCoefficient = 0.05f;
 
-    float median = subsec.median();
-    hash = 0;
-    for (int i = 0; i < 64; i++, hash <<= 1) {
-        float current = subsec(i);
-        if (current > median)
-            hash |= 0x01;
+// Median split of the first Bits zigzag coefficients, most significant
+// bit first.  Flat blocks hash to zero (see PHashFrame::flat).
+template <std::size_t Bits>
+static PHashT<Bits> ph_wide_hash_from_block(float const* block)
+{
+    std::array<float, Bits> c;
+    float peak = 0.f;
+    for (std::size_t i = 0; i < Bits; ++i) {
+        c[i] = block[kZigzag16.idx[i]];
+        peak = std::max(peak, std::abs(c[i]));
     }
+    PHashT<Bits> hash;
+    if (peak < kFlatCoefficient)
+        return hash;
+
+    std::array<float, Bits> sorted = c;
+    std::nth_element(sorted.begin(), sorted.begin() + Bits / 2, sorted.end());
+    float const hi = sorted[Bits / 2];
+    float const lo = *std::max_element(sorted.begin(), sorted.begin() + Bits / 2);
+    float const median = (lo + hi) / 2;
+
+    for (std::size_t i = 0; i < Bits; ++i)
+        if (c[i] > median)
+            hash.w[i / 64] |= std::uint64_t { 1 } << (63 - i % 64);
+    return hash;
+}
+
+// ph_hash_variants_from_block on the 16×16 block.
+template <std::size_t Bits>
+static PHashVariantsT<Bits> ph_wide_variants_from_block(float const* block)
+{
+    PHashVariantsT<Bits> out {};
+    std::array<float, 256> t;
+    for (std::size_t o = 0; o < kPHashOrientations; ++o) {
+        for (int v = 1; v <= 16; ++v) {
+            for (int u = 1; u <= 16; ++u) {
+                float const same = block[(v - 1) * 16 + (u - 1)];
+                float const transposed = block[(u - 1) * 16 + (v - 1)];
+                float const su = (u & 1) ? -1.f : 1.f;
+                float const sv = (v & 1) ? -1.f : 1.f;
+
+                float c = same;
+                switch (static_cast<PHashOrientation>(o)) {
+                case PHashOrientation::Original:
+                    c = same;
+                    break;
+                case PHashOrientation::FlipH:
+                    c = su * same;
+                    break;
+                case PHashOrientation::Rot90:
+                    c = su * transposed;
+                    break;
+                case PHashOrientation::Rot180:
+                    c = su * sv * same;
+                    break;
+                case PHashOrientation::Rot270:
+                    c = sv * transposed;
+                    break;
+                }
+                t[(v - 1) * 16 + (u - 1)] = c;
+            }
+        }
+        out[o] = ph_wide_hash_from_block<Bits>(t.data());
+    }
+    return out;
+}
+
+int ph_dct_imagehash_from_buffer(CImg<float> const& img, ulong& hash)
+{
+    if (img.width() != 32 || img.height() != 32)
+        return -1;
 
+    float block[64];
+    ph_dct_block_from_buffer(img.data(), block);
+    hash = ph_hash_from_block(block);
     return 0;
 }
 
@@ -80,139 +243,42 @@ compute_phash_from_preprocessed(uint8_t const* gray)
     if (!gray)
         return std::nullopt;
 
-    // Load 32×32 gray buffer into CImg<float>
-    CImg<float> img(gray, 32, 32, 1, 1);
-    img.convolve(kMean7);
+    float img[32 * 32], tmp[32 * 32], smoothed[32 * 32];
+    std::copy_n(gray, 32 * 32, img);
+    box7(img, 32, 32, tmp, smoothed);
 
-    uint64_t h = 0;
-    if (ph_dct_imagehash_from_buffer(img, h) < 0)
-        return std::nullopt;
-
-    return h;
+    float block[64];
+    ph_dct_block_from_buffer(smoothed, block);
+    return ph_hash_from_block(block);
 }
 
 // ---------------------------------------------------------------------
-// Fast 32×32 box-filter down-scale with SIMD.
+// Fast 32×32 box-filter down-scale.
 //  – Pre-computes index/weight tables once per (srcW,srcH) combination.
-//  – Uses separable horizontal+vertical pass, inner loops vectorised.
+//  – Separable horizontal+vertical pass, kernels picked at run time
+//    (see SimdKernels.h).
 // ---------------------------------------------------------------------
 namespace simd_ds {
 
-struct Weights { // pre-computed tables
-    std::vector<int> idx;
-    std::vector<float> w0, w1; // 2-tap box filter
-};
-
 static thread_local int cacheW = 0, cacheH = 0;
-static thread_local Weights wx, wy;
+static thread_local simd::Taps32 wx, wy;
 
-static void build_table(int src, int dst, Weights& tab)
+static void build_table(int src, simd::Taps32& tab)
 {
-    tab.idx.resize(dst);
-    tab.w0.resize(dst);
-    tab.w1.resize(dst);
-
-    double scale = static_cast<double>(src) / dst;
-    for (int d = 0; d < dst; ++d) {
+    double scale = static_cast<double>(src) / 32;
+    for (int d = 0; d < 32; ++d) {
         double s = (d + 0.5) * scale - 0.5;
         int i0 = static_cast<int>(std::floor(s));
         double f = s - i0;
 
         i0 = std::clamp(i0, 0, src - 1);
-        tab.idx[d] = i0;
+        tab.idx0[d] = i0;
+        tab.idx1[d] = std::min(i0 + 1, src - 1); // never read past the edge
         tab.w1[d] = static_cast<float>(f);
         tab.w0[d] = 1.0f - tab.w1[d];
     }
 }
 
-// Horizontal pass: src (float)  → tmp (float)  (dstW = 32)
-static void hpass(float const* src, int srcW, int srcH, int srcStride,
-    float* tmp, Weights const& wx)
-{
-#if defined(__AVX2__)
-    constexpr int W = 32;
-    for (int y = 0; y < srcH; ++y) {
-        float const* row = src + y * srcStride;
-        float* out = tmp + y * W;
-
-        int d = 0;
-        for (; d + 7 < W; d += 8) {
-            __m256 p0 = _mm256_i32gather_ps(row, _mm256_loadu_si256(reinterpret_cast<__m256i const*>(&wx.idx[d])), 4);
-            __m256 p1 = _mm256_i32gather_ps(row, _mm256_loadu_si256(reinterpret_cast<__m256i const*>(&wx.idx[d])) + _mm256_set1_epi32(1), 4);
-            __m256 w0 = _mm256_loadu_ps(&wx.w0[d]);
-            __m256 w1 = _mm256_loadu_ps(&wx.w1[d]);
-            __m256 v = _mm256_fmadd_ps(p1, w1, _mm256_mul_ps(p0, w0));
-            _mm256_storeu_ps(out + d, v);
-        }
-        for (; d < W; ++d) { // tail
-            int i = wx.idx[d];
-            out[d] = row[i] * wx.w0[d] + row[i + 1] * wx.w1[d];
-        }
-    }
-#else // SSE2 fallback (scalar)
-    for (int y = 0; y < srcH; ++y) {
-        float const* row = src + y * srcStride;
-        float* out = tmp + y * 32;
-        for (int d = 0; d < 32; ++d) {
-            int i = wx.idx[d];
-            out[d] = row[i] * wx.w0[d] + row[i + 1] * wx.w1[d];
-        }
-    }
-#endif
-}
-
-// Vertical pass: tmp (srcH × 32) → dst32 (32 × 32)
-static void vpass(float const* tmp, int srcH, float* dst, Weights const& wy)
-{
-#if defined(__AVX2__)
-    constexpr int W = 32;
-    for (int d = 0; d < W; ++d) {
-        float const* col = tmp + d;
-        float* out = dst + d;
-        int y = 0;
-        for (; y + 7 < W; y += 8) {
-            __m256 p0 = _mm256_set_ps(
-                col[(y + 7) * W + wy.idx[y + 7]],
-                col[(y + 6) * W + wy.idx[y + 6]],
-                col[(y + 5) * W + wy.idx[y + 5]],
-                col[(y + 4) * W + wy.idx[y + 4]],
-                col[(y + 3) * W + wy.idx[y + 3]],
-                col[(y + 2) * W + wy.idx[y + 2]],
-                col[(y + 1) * W + wy.idx[y + 1]],
-                col[(y + 0) * W + wy.idx[y + 0]]);
-
-            __m256 p1 = _mm256_set_ps(
-                col[(y + 7) * W + wy.idx[y + 7] + W],
-                col[(y + 6) * W + wy.idx[y + 6] + W],
-                col[(y + 5) * W + wy.idx[y + 5] + W],
-                col[(y + 4) * W + wy.idx[y + 4] + W],
-                col[(y + 3) * W + wy.idx[y + 3] + W],
-                col[(y + 2) * W + wy.idx[y + 2] + W],
-                col[(y + 1) * W + wy.idx[y + 1] + W],
-                col[(y + 0) * W + wy.idx[y + 0] + W]);
-
-            __m256 w0 = _mm256_loadu_ps(&wy.w0[y]);
-            __m256 w1 = _mm256_loadu_ps(&wy.w1[y]);
-            __m256 v = _mm256_fmadd_ps(p1, w1, _mm256_mul_ps(p0, w0));
-            _mm256_storeu_ps(out + y * W, v);
-        }
-        for (; y < W; ++y) { // tail
-            int j = wy.idx[y];
-            out[y * W] = col[j * W] * wy.w0[y] + col[(j + 1) * W] * wy.w1[y];
-        }
-    }
-#else // scalar
-    for (int d = 0; d < 32; ++d) {
-        float const* col = tmp + d;
-        float* out = dst + d;
-        for (int y = 0; y < 32; ++y) {
-            int j = wy.idx[y];
-            out[y * 32] = col[j * 32] * wy.w0[y] + col[(j + 1) * 32] * wy.w1[y];
-        }
-    }
-#endif
-}
-
 // Main entry – srcPtr points to luma (float) with stride = srcW
 // dst must have at least 32*32 float slots.
 static void downscale32x32(float const* src, int srcW, int srcH,
@@ -222,48 +288,131 @@ static void downscale32x32(float const* src, int srcW, int srcH,
     if (srcW != cacheW || srcH != cacheH) {
         cacheW = srcW;
         cacheH = srcH;
-        build_table(srcW, 32, wx);
-        build_table(srcH, 32, wy);
+        build_table(srcW, wx);
+        build_table(srcH, wy);
     }
 
     // Scratch buffer: srcH × 32
-    static thread_local std::vector<float> tmp;
-    tmp.resize(static_cast<size_t>(srcH) * 32);
+    ScratchBuffer tmp = scratch_for<float>(static_cast<size_t>(srcH) * 32);
 
-    hpass(src, srcW, srcH, srcW, tmp.data(), wx);
-    vpass(tmp.data(), srcH, dst, wy);
+    simd::resample_rows32(src, srcH, srcW, tmp.as<float>(), wx);
+    simd::resample_cols32(tmp.as<float>(), dst, wy);
 }
 
 } // namespace simd_ds
 
+// Mean-filter + 32×32 down-scale of a gray buffer, shared by the hash entry points
+static void preprocess_gray(uint8_t const* data, int w, int h, float* downsized)
+{
+    std::size_t const n = static_cast<std::size_t>(w) * h;
+    ScratchBuffer luma = scratch_for<float>(n);
+    ScratchBuffer tmp = scratch_for<float>(n);
+    ScratchBuffer smoothed = scratch_for<float>(n);
+
+    std::copy_n(data, n, luma.as<float>());
+    box7(luma.as<float>(), w, h, tmp.as<float>(), smoothed.as<float>()); // smooth first
+
+    simd_ds::downscale32x32(smoothed.as<float>(), w, h, downsized);
+}
+
 std::optional<uint64_t>
 compute_phash_full(uint8_t const* data, int w, int h)
 {
     if (!data || w <= 0 || h <= 0)
         return std::nullopt;
 
-    // Make CImg copy, then 7×7 mean-filter and resize to 32×32
-    CImg<float> img(data, w, h, 1, 1);
-    auto const& mean7 = kMean7;
+    float downsized[32 * 32]; // stack buffer
+    preprocess_gray(data, w, h, downsized);
 
-    CImg<float> luma;
-    if (img.spectrum() >= 3)
-        luma = img.get_channels(0, 2).RGBtoYCbCr().channel(0);
-    else
-        luma = img.get_channel(0);
+    float block[64];
+    ph_dct_block_from_buffer(downsized, block);
+    return ph_hash_from_block(block);
+}
 
-    luma.convolve(mean7); // smooth first
+std::optional<PHashVariants>
+compute_phash_variants(uint8_t const* data, int w, int h)
+{
+    if (!data || w <= 0 || h <= 0)
+        return std::nullopt;
 
-    float downsized[32 * 32]; // stack buffer
-    simd_ds::downscale32x32(luma.data(), luma.width(), luma.height(),
-        downsized);
+    float downsized[32 * 32];
+    preprocess_gray(data, w, h, downsized);
 
-    // wrap downsized data in CImg<float> without copy
-    CImg<float> small(downsized, 32, 32, 1, 1, true);
+    float block[64];
+    ph_dct_block_from_buffer(downsized, block);
+    return ph_hash_variants_from_block(block);
+}
 
-    uint64_t hash = 0;
-    if (ph_dct_imagehash_from_buffer(small, hash) < 0)
+// 2×2 box of a kPHashTile tile down to 32×32
+static void tile_to_32x32(uint8_t const* tile, float* downsized)
+{
+    static_assert(kPHashTile == 64);
+    for (int y = 0; y < 32; ++y) {
+        uint8_t const* r0 = tile + (2 * y) * kPHashTile;
+        uint8_t const* r1 = r0 + kPHashTile;
+        for (int x = 0; x < 32; ++x) {
+            int const s = r0[2 * x] + r0[2 * x + 1] + r1[2 * x] + r1[2 * x + 1];
+            downsized[y * 32 + x] = s * 0.25f;
+        }
+    }
+}
+
+std::optional<PHashVariants>
+compute_phash_from_tile(uint8_t const* tile)
+{
+    if (!tile)
         return std::nullopt;
 
-    return hash;
+    float downsized[32 * 32];
+    tile_to_32x32(tile, downsized);
+    float block[64];
+    ph_dct_block_from_buffer(downsized, block);
+    return ph_hash_variants_from_block(block);
+}
+
+template <std::size_t Bits>
+std::optional<PHashVariantsT<Bits>>
+compute_phash_from_tile(uint8_t const* tile)
+{
+    if constexpr (Bits == 64) {
+        auto const v = compute_phash_from_tile(tile);
+        if (!v)
+            return std::nullopt;
+        PHashVariantsT<64> out;
+        for (std::size_t o = 0; o < kPHashOrientations; ++o)
+            out[o].w[0] = (*v)[o];
+        return out;
+    } else {
+        if (!tile)
+            return std::nullopt;
+
+        float downsized[32 * 32];
+        tile_to_32x32(tile, downsized);
+        float block[256];
+        simd::dct_low16x16(downsized, block);
+        return ph_wide_variants_from_block<Bits>(block);
+    }
+}
+
+template std::optional<PHashVariantsT<64>> compute_phash_from_tile<64>(uint8_t const*);
+template std::optional<PHashVariantsT<128>> compute_phash_from_tile<128>(uint8_t const*);
+template std::optional<PHashVariantsT<256>> compute_phash_from_tile<256>(uint8_t const*);
+
+std::optional<PHashFrame>
+compute_phash_frame(uint8_t const* tile, unsigned bits)
+{
+    if (!valid_hash_bits(bits))
+        return std::nullopt;
+
+    return visit_hash_bits(bits, [&](auto width) -> std::optional<PHashFrame> {
+        auto const v = compute_phash_from_tile<decltype(width)::value>(tile);
+        if (!v)
+            return std::nullopt;
+        PHashFrame f;
+        f.bits = bits;
+        auto* out = f.words.data();
+        for (auto const& h : *v)
+            out = std::copy(h.w.begin(), h.w.end(), out);
+        return f;
+    });
 }
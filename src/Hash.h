@@ -1,21 +1,196 @@
 #pragma once
 
+#include <array>
+#include <bit>
 #include <vector>
 #include <cstdint>
+#include <cstddef>
 #include <optional>
+#include <type_traits>
 
 #include "CImgWrapper.h"
+#include "SimdKernels.h"
 
 struct Hash {
     uint64_t value = 0;
     int fk_hash_video = -1;
 };
 
+// Orientations whose hashes can be derived from one DCT block.  Original
+// must stay first: it is the only one stored in the searchable index.
+enum class PHashOrientation : std::uint8_t {
+    Original,
+    FlipH,
+    Rot90,
+    Rot180,
+    Rot270
+};
+constexpr std::size_t kPHashOrientations = 5;
+using PHashVariants = std::array<uint64_t, kPHashOrientations>;
+
+// Side of the area-averaged luma tile the decoder hands to hash workers.
+constexpr int kPHashTile = 64;
+
+// Raised whenever the pipeline changes the hashes it produces for the same
+// frame; stored per hash row so a scan can re-hash older rows rather than
+// compare across versions.  0: rows from before the column (7×7 mean
+// filter over the full-resolution luma, then a bilinear resize to 32×32),
+// 1: kPHashTile² area-averaged tile.
+constexpr int kPHashAlgoVersion = 1;
+
+// pHash widths.  64 bits is the classic hash of the 8×8 low-frequency DCT
+// block and the default; 128 and 256 bits take the lowest frequencies of
+// the 16×16 block (zigzag order), which cuts chance collisions within a
+// given radius on large libraries.  The width is chosen per database
+// (SearchSettings::hashBits) and every stored hash row records its own.
+constexpr unsigned kMaxHashBits = 256;
+constexpr std::size_t kMaxHashWords = kMaxHashBits / 64;
+
+constexpr bool valid_hash_bits(unsigned bits)
+{
+    return bits == 64 || bits == 128 || bits == 256;
+}
+
+// A Bits-wide pHash as Bits/64 words.  Word 0 carries the lowest
+// frequencies, and its distance alone is a lower bound on the full one,
+// which is what lets the 64-bit trie prefilter the wider widths.
+template <std::size_t Bits>
+struct PHashT {
+    static_assert(Bits == 64 || Bits == 128 || Bits == 256, "unsupported pHash width");
+    static constexpr std::size_t kWords = Bits / 64;
+
+    std::array<std::uint64_t, kWords> w {};
+
+    friend bool operator==(PHashT const&, PHashT const&) = default;
+};
+static_assert(sizeof(PHashT<256>) == 4 * sizeof(std::uint64_t)); // packed as stored
+
+template <std::size_t Bits>
+inline unsigned hamming(PHashT<Bits> const& a, PHashT<Bits> const& b)
+{
+    if constexpr (Bits == 64) {
+        return std::popcount(a.w[0] ^ b.w[0]);
+    } else if constexpr (Bits == 128) {
+        return std::popcount(a.w[0] ^ b.w[0]) + std::popcount(a.w[1] ^ b.w[1]);
+    } else {
+        return std::popcount(a.w[0] ^ b.w[0]) + std::popcount(a.w[1] ^ b.w[1])
+            + std::popcount(a.w[2] ^ b.w[2]) + std::popcount(a.w[3] ^ b.w[3]);
+    }
+}
+
+// Indices of hashes[i] within maxDist of query (see simd::hamming_within).
+template <std::size_t Bits>
+inline std::size_t hamming_within(PHashT<Bits> const& query, PHashT<Bits> const* hashes,
+    std::size_t n, unsigned maxDist, std::uint32_t* outIdx)
+{
+    auto const* h = hashes ? hashes->w.data() : nullptr;
+    if constexpr (Bits == 64)
+        return simd::hamming_within(query.w[0], h, n, maxDist, outIdx);
+    else if constexpr (Bits == 128)
+        return simd::hamming_within128(query.w.data(), h, n, maxDist, outIdx);
+    else
+        return simd::hamming_within256(query.w.data(), h, n, maxDist, outIdx);
+}
+
+// Calls f(std::integral_constant<std::size_t, Bits>) for a runtime width,
+// so code templated on the width can be reached from settings and rows.
+template <class F>
+decltype(auto) visit_hash_bits(unsigned bits, F&& f)
+{
+    switch (bits) {
+    case 128:
+        return f(std::integral_constant<std::size_t, 128> {});
+    case 256:
+        return f(std::integral_constant<std::size_t, 256> {});
+    default:
+        return f(std::integral_constant<std::size_t, 64> {});
+    }
+}
+
 struct HashGroup {
     int fk_hash_video = -1;
+    unsigned bits = 64; // width of every hash below
+    // count() hashes of words() consecutive words each
     std::vector<uint64_t> hashes;
+    // (kPHashOrientations - 1) per hash, in PHashOrientation order after
+    // Original.  Empty when the video was hashed without variants.
+    std::vector<uint64_t> variants;
+
+    std::size_t words() const { return bits / 64; }
+    std::size_t count() const { return hashes.size() / words(); }
 };
 
+// Splits decodeAndHash output (kPHashOrientations hashes per frame when
+// withVariants is set, see append_phash; each bits/64 words) into originals
+// and variants; std::nullopt if the count is not a whole number of frames.
+inline std::optional<HashGroup> make_hash_group(int videoId,
+    std::vector<uint64_t> const& pHashes, bool withVariants, unsigned bits = 64)
+{
+    if (!valid_hash_bits(bits))
+        return std::nullopt;
+    HashGroup g;
+    g.fk_hash_video = videoId;
+    g.bits = bits;
+    std::size_t const words = g.words();
+    if (!withVariants) {
+        if (pHashes.size() % words != 0)
+            return std::nullopt;
+        g.hashes = pHashes;
+        return g;
+    }
+    std::size_t const perFrame = kPHashOrientations * words;
+    if (pHashes.size() % perFrame != 0)
+        return std::nullopt;
+    std::size_t const frames = pHashes.size() / perFrame;
+    g.hashes.reserve(frames * words);
+    g.variants.reserve(frames * (perFrame - words));
+    for (std::size_t f = 0; f < frames; ++f) {
+        auto const* frame = pHashes.data() + f * perFrame;
+        g.hashes.insert(g.hashes.end(), frame, frame + words);
+        g.variants.insert(g.variants.end(), frame + words, frame + perFrame);
+    }
+    return g;
+}
+
+// Appends one frame's hashes: just the original, or all orientations
+// (original first) when withVariants is set.
+inline void append_phash(std::vector<uint64_t>& out,
+    PHashVariants const& v, bool withVariants)
+{
+    if (withVariants)
+        out.insert(out.end(), v.begin(), v.end());
+    else
+        out.push_back(v[0]);
+}
+
+// One frame's hashes at a runtime width: kPHashOrientations hashes of
+// bits/64 words each, in PHashOrientation order.
+struct PHashFrame {
+    unsigned bits = 64;
+    std::array<std::uint64_t, kPHashOrientations * kMaxHashWords> words {};
+
+    std::size_t hashWords() const { return bits / 64; }
+    std::uint64_t const* hash(PHashOrientation o) const
+    {
+        return words.data() + static_cast<std::size_t>(o) * hashWords();
+    }
+    // Flat tiles hash to all zeroes at every width.
+    bool flat() const
+    {
+        for (std::size_t i = 0; i < hashWords(); ++i)
+            if (words[i])
+                return false;
+        return true;
+    }
+};
+
+inline void append_phash(std::vector<uint64_t>& out,
+    PHashFrame const& f, bool withVariants)
+{
+    std::size_t const n = (withVariants ? kPHashOrientations : 1) * f.hashWords();
+    out.insert(out.end(), f.words.begin(), f.words.begin() + n);
+}
+
 std::vector<uint64_t> generate_pHashes(std::vector<CImg<float>> const&);
 
 void print_pHashes(std::vector<Hash> const& results);
@@ -30,3 +205,30 @@ compute_phash_from_preprocessed(uint8_t const* gray32x32);
 std::optional<uint64_t>
 compute_phash_full(uint8_t const* img, int w, int h);
 
+// Same as compute_phash_full, plus the hashes of the horizontally flipped
+// and 90/180/270-degree rotated frame taken from the same DCT block.
+std::optional<PHashVariants>
+compute_phash_variants(uint8_t const* img, int w, int h);
+
+// Hashes (all orientations) of a kPHashTile×kPHashTile gray tile that was
+// area-averaged from the frame; the averaging stands in for the mean filter.
+std::optional<PHashVariants>
+compute_phash_from_tile(uint8_t const* tile);
+
+// The same at Bits width.  64 is bit-for-bit the function above; the wider
+// widths come from the 16×16 block and hash flat tiles to zero.
+template <std::size_t Bits>
+using PHashVariantsT = std::array<PHashT<Bits>, kPHashOrientations>;
+
+template <std::size_t Bits>
+std::optional<PHashVariantsT<Bits>>
+compute_phash_from_tile(uint8_t const* tile);
+
+extern template std::optional<PHashVariantsT<64>> compute_phash_from_tile<64>(uint8_t const*);
+extern template std::optional<PHashVariantsT<128>> compute_phash_from_tile<128>(uint8_t const*);
+extern template std::optional<PHashVariantsT<256>> compute_phash_from_tile<256>(uint8_t const*);
+
+// Runtime-width entry point for the decode pipeline.
+std::optional<PHashFrame>
+compute_phash_frame(uint8_t const* tile, unsigned bits);
+
@@ -0,0 +1,80 @@
+#include "HashBlob.h"
+#include "SimdKernels.h"
+
+#include <bit>
+#include <cstring>
+
+namespace hashblob {
+
+namespace {
+
+constexpr std::uint8_t kMagic[4] = { 'N', 'D', 'H', 1 };
+constexpr std::size_t kHeader = sizeof kMagic + 2 * sizeof(std::uint32_t);
+
+void put_u32(std::uint8_t* p, std::uint32_t v) { std::memcpy(p, &v, sizeof v); }
+
+std::uint32_t get_u32(std::uint8_t const* p)
+{
+    std::uint32_t v;
+    std::memcpy(&v, p, sizeof v);
+    return v;
+}
+
+std::uint64_t get_u64(std::uint8_t const* p)
+{
+    std::uint64_t v;
+    std::memcpy(&v, p, sizeof v);
+    return v;
+}
+
+} // namespace
+
+std::vector<std::uint8_t> pack(std::span<std::uint64_t const> words, std::size_t stride)
+{
+    std::size_t const n = words.size();
+    std::vector<std::uint8_t> out(kHeader + n);
+    out.reserve(kHeader + n + n * 4);
+    std::memcpy(out.data(), kMagic, sizeof kMagic);
+    put_u32(out.data() + sizeof kMagic, static_cast<std::uint32_t>(n));
+    put_u32(out.data() + sizeof kMagic + 4, static_cast<std::uint32_t>(stride));
+
+    for (std::size_t i = 0; i < n; ++i) {
+        std::uint64_t const d = i >= stride ? words[i] ^ words[i - stride] : words[i];
+        std::uint8_t ctrl = 0;
+        for (unsigned b = 0; b < 8; ++b) {
+            if (auto const byte = static_cast<std::uint8_t>(d >> (8 * b))) {
+                ctrl |= static_cast<std::uint8_t>(1u << b);
+                out.push_back(byte);
+            }
+        }
+        out[kHeader + i] = ctrl;
+    }
+    return out;
+}
+
+std::optional<std::vector<std::uint64_t>> unpack(std::span<std::uint8_t const> blob)
+{
+    if (blob.size() < kHeader || std::memcmp(blob.data(), kMagic, sizeof kMagic) != 0)
+        return std::nullopt;
+    std::size_t const n = get_u32(blob.data() + sizeof kMagic);
+    std::size_t const stride = get_u32(blob.data() + sizeof kMagic + 4);
+    if (stride == 0 || n > blob.size() - kHeader)
+        return std::nullopt;
+
+    std::uint8_t const* ctrl = blob.data() + kHeader;
+    std::size_t packed = 0, i = 0;
+    for (; i + 8 <= n; i += 8) // a word's popcount is its bytes' popcounts summed
+        packed += static_cast<std::size_t>(std::popcount(get_u64(ctrl + i)));
+    for (; i < n; ++i)
+        packed += static_cast<std::size_t>(std::popcount(ctrl[i]));
+    if (packed != blob.size() - kHeader - n)
+        return std::nullopt;
+
+    std::vector<std::uint64_t> words(n);
+    simd::expand_nonzero_bytes(ctrl, n, ctrl + n, packed, words.data());
+    for (i = stride; i < n; ++i)
+        words[i] ^= words[i - stride];
+    return words;
+}
+
+} // namespace hashblob
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+// On-disk encodings of a hash row's hashes and orientation variants;
+// hash.blob_format says which one a row uses.  Raw rows (the only kind
+// written before the column existed) keep hash_blob / variant_blob.
+// Packed rows go to packed_blob / packed_variants and leave hash_blob as a
+// zero-length blob: readers from before blob_format take hash_blob as raw
+// words and skip empty ones, so they see such a video as not hashed
+// rather than misreading packed bytes as pHashes.
+//
+// Packed (format 1): every word is XORed with the word one frame earlier
+// (`stride` words back), which zeroes most bytes of the per-second hashes
+// of one scene, then only the non-zero bytes are kept, each word led by a
+// control byte marking which of its 8 bytes survived.  Decoding is a table
+// shuffle per word (one VPEXPANDB per 8 words on AVX-512 VBMI2) and an XOR.
+//
+//   "NDH" 1 | u32 words | u32 stride | ctrl[words] | packed bytes
+//
+// Integers are little-endian like the raw blobs.
+namespace hashblob
+{
+    enum class Format : int {
+        Raw = 0,    // words as stored in memory
+        Packed = 1, // XOR delta + non-zero bytes, see above
+    };
+
+    // `stride` is the words per frame: the hash width in words for
+    // the hashes, times the orientation count less one for the variants.
+    std::vector<std::uint8_t>          pack(std::span<std::uint64_t const> words, std::size_t stride);
+
+    // nullopt if the blob is truncated or not a packed blob.
+    std::optional<std::vector<std::uint64_t>> unpack(std::span<std::uint8_t const> blob);
+} // namespace hashblob
@@ -0,0 +1,148 @@
+#include "HashWorker.h"
+#include "KeyframeIndex.h"
+#include "SearchSettings.h"
+#include "VideoInfo.h"
+#include "VideoProcessingUtils.h"
+#include "VideoProcessorFactory.h"
+
+#include <nlohmann/json.hpp>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/spdlog.h>
+
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <span>
+#include <stdexcept>
+
+#include <unistd.h>
+
+namespace worker {
+
+namespace {
+
+std::string to_hex(std::span<std::uint8_t const> bytes)
+{
+    static constexpr char kDigits[] = "0123456789abcdef";
+    std::string out;
+    out.reserve(bytes.size() * 2);
+    for (std::uint8_t b : bytes) {
+        out.push_back(kDigits[b >> 4]);
+        out.push_back(kDigits[b & 0xf]);
+    }
+    return out;
+}
+std::string to_hex(std::string_view s)
+{
+    return to_hex({ reinterpret_cast<std::uint8_t const*>(s.data()), s.size() });
+}
+
+std::vector<std::uint8_t> from_hex(std::string_view hex)
+{
+    auto nibble = [](char c) -> int {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        throw std::invalid_argument("bad hex digit");
+    };
+    if (hex.size() % 2)
+        throw std::invalid_argument("odd hex length");
+    std::vector<std::uint8_t> out(hex.size() / 2);
+    for (std::size_t i = 0; i < out.size(); ++i)
+        out[i] = static_cast<std::uint8_t>(nibble(hex[2 * i]) << 4 | nibble(hex[2 * i + 1]));
+    return out;
+}
+
+nlohmann::json handle(std::string const& line)
+{
+    nlohmann::json reply = nlohmann::json::object();
+    try {
+        auto const req = nlohmann::json::parse(line);
+        auto const path = from_hex(req.at("path").get<std::string>());
+
+        VideoInfo v;
+        v.path.assign(path.begin(), path.end());
+        v.size = req.at("size").get<std::int64_t>();
+        v.duration = req.at("duration").get<int>();
+        v.keyframes = std::make_shared<KeyframeIndex>();
+        if (req.contains("keyframes"))
+            if (auto idx = KeyframeIndex::deserialize(from_hex(req.at("keyframes").get<std::string>())))
+                *v.keyframes = std::move(*idx);
+
+        auto cfg = req.at("cfg").get<SearchSettings>();
+        cfg.hashWorkerProcesses = 0;
+        reply["hashes"] = makeVideoProcessor(cfg)->decodeAndHash(v, cfg);
+        if (v.keyframes->dirty())
+            reply["keyframes"] = to_hex(v.keyframes->serialize());
+    } catch (vpu::BudgetExceeded const& ex) {
+        reply = { { "budget", { { "stage", ex.stage }, { "reason", ex.reason } } } };
+    } catch (std::exception const& ex) {
+        reply = { { "error", ex.what() } };
+    }
+    return reply;
+}
+
+} // namespace
+
+std::string encode_request(VideoInfo const& v, SearchSettings const& cfg)
+{
+    nlohmann::json req {
+        { "path", to_hex(v.path) },
+        { "size", v.size },
+        { "duration", v.duration },
+        { "cfg", cfg }
+    };
+    if (v.keyframes && !v.keyframes->empty())
+        req["keyframes"] = to_hex(v.keyframes->serialize());
+    // the path is hex already; a non-UTF-8 directory name in cfg is not used by the worker
+    return req.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace) + '\n';
+}
+
+Reply decode_reply(std::string_view line)
+{
+    auto const j = nlohmann::json::parse(line);
+    Reply r;
+    if (j.contains("budget")) {
+        r.budgetStage = j.at("budget").at("stage").get<std::string>();
+        r.budgetReason = j.at("budget").at("reason").get<std::string>();
+    } else if (j.contains("error")) {
+        r.error = j.at("error").get<std::string>();
+    } else {
+        r.hashes = j.at("hashes").get<std::vector<std::uint64_t>>();
+        if (j.contains("keyframes"))
+            r.keyframes = from_hex(j.at("keyframes").get<std::string>());
+    }
+    return r;
+}
+
+int runHashWorker(std::vector<std::string_view> const& args)
+{
+    if (!args.empty()) {
+        std::fprintf(stderr, "--hash-worker takes no arguments\n");
+        return 2;
+    }
+
+    // keep the real stdout for replies; everything else writes to stderr
+    int const replyFd = ::dup(STDOUT_FILENO);
+    if (replyFd < 0 || ::dup2(STDERR_FILENO, STDOUT_FILENO) < 0)
+        return 1;
+    std::FILE* out = ::fdopen(replyFd, "w");
+    if (!out)
+        return 1;
+    spdlog::set_default_logger(spdlog::stderr_color_mt("hash-worker"));
+
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        if (line.empty())
+            continue;
+        // error text may quote a non-UTF-8 path; don't let that kill the reply
+        std::string const reply = handle(line).dump(-1, ' ', false, nlohmann::json::error_handler_t::replace) + '\n';
+        if (std::fwrite(reply.data(), 1, reply.size(), out) != reply.size() || std::fflush(out) != 0)
+            return 1; // parent went away
+    }
+    std::fclose(out);
+    return 0;
+}
+
+} // namespace worker
@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct SearchSettings;
+struct VideoInfo;
+
+// Child side of WorkerProcessVideoProcessor and the wire format both sides
+// share.  The worker reads one request per line on stdin, hashes the file
+// with the in-process processor the settings select, and answers with one
+// line on the original stdout.  Everything else the process prints
+// (spdlog, FFmpeg, a codec's stray printf) is sent to stderr, so it cannot
+// corrupt a reply.  Requests and replies are JSON; paths and keyframe blobs
+// travel as hex so non-UTF-8 file names survive the encoder.
+//
+//   --hash-worker
+namespace worker
+{
+    struct Reply {
+        std::vector<std::uint64_t>     hashes;
+        std::vector<std::uint8_t>      keyframes;    // serialized index, if the pass added to it
+        std::string                    budgetStage;  // non-empty: vpu::BudgetExceeded
+        std::string                    budgetReason;
+        std::string                    error;        // non-empty: any other exception
+    };
+
+    std::string                        encode_request(VideoInfo const& v, SearchSettings const& cfg);
+    Reply                              decode_reply(std::string_view line);
+
+    int                                runHashWorker(std::vector<std::string_view> const& args);
+} // namespace worker
@@ -4,6 +4,7 @@
 #include "SearchSettings.h"
 
 #include <vector>
+#include <cstddef>
 #include <cstdint>
 
 class IVideoProcessor {
@@ -14,6 +15,9 @@ public:
     decodeAndHash(
         VideoInfo const& video,
         SearchSettings const& cfg) = 0;
+
+    // How many decodeAndHash calls may usefully run at once.
+    virtual std::size_t concurrency() const { return 1; }
 };
 
 inline IVideoProcessor::~IVideoProcessor() = default;
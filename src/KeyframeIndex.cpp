@@ -0,0 +1,171 @@
+#include "KeyframeIndex.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string_view>
+
+extern "C" {
+#include <libavcodec/packet.h>
+#include <libavformat/avformat.h>
+}
+
+namespace {
+
+enum class SeekMode {
+    Native,     // container index is complete, leave it alone
+    PrimeIndex, // demuxer seeks through its own index entries
+    ByteOffset  // demuxer resyncs anywhere; seek by offset ourselves
+};
+
+SeekMode seek_mode(AVFormatContext const* fmt)
+{
+    if (!fmt || !fmt->iformat)
+        return SeekMode::Native;
+    std::string_view const name = fmt->iformat->name;
+    if (name == "mpegts" || name == "mpeg")
+        return (fmt->iformat->flags & AVFMT_NO_BYTE_SEEK) ? SeekMode::Native : SeekMode::ByteOffset;
+    if (name == "avi" || name == "matroska,webm" || name == "flv" || name == "asf")
+        return SeekMode::PrimeIndex;
+    return SeekMode::Native;
+}
+
+constexpr std::uint8_t kMagic[4] = { 'K', 'F', 'I', '1' };
+
+void put_varint(std::vector<std::uint8_t>& out, std::uint64_t v)
+{
+    while (v >= 0x80) {
+        out.push_back(static_cast<std::uint8_t>(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<std::uint8_t>(v));
+}
+
+bool get_varint(std::span<std::uint8_t const>& in, std::uint64_t& v)
+{
+    v = 0;
+    for (int shift = 0; shift < 64 && !in.empty(); shift += 7) {
+        std::uint8_t const b = in.front();
+        in = in.subspan(1);
+        v |= std::uint64_t { b & 0x7fu } << shift;
+        if (!(b & 0x80))
+            return true;
+    }
+    return false;
+}
+
+std::uint64_t zigzag(std::int64_t v) { return (static_cast<std::uint64_t>(v) << 1) ^ static_cast<std::uint64_t>(v >> 63); }
+std::int64_t unzigzag(std::uint64_t v) { return static_cast<std::int64_t>(v >> 1) ^ -static_cast<std::int64_t>(v & 1); }
+
+} // namespace
+
+void KeyframeIndex::add(int stream, std::int64_t pts, std::int64_t pos)
+{
+    if (pts == AV_NOPTS_VALUE || pos < 0)
+        return;
+    if (stream_ < 0)
+        stream_ = stream;
+    else if (stream_ != stream)
+        return;
+
+    // the common case is appending in file order
+    if (entries_.empty() || entries_.back().pts < pts) {
+        entries_.push_back({ pts, pos });
+        dirty_ = true;
+        return;
+    }
+    auto it = std::lower_bound(entries_.begin(), entries_.end(), pts,
+        [](Entry const& e, std::int64_t t) { return e.pts < t; });
+    if (it != entries_.end() && it->pts == pts)
+        return;
+    entries_.insert(it, { pts, pos });
+    dirty_ = true;
+}
+
+KeyframeIndex::Entry const* KeyframeIndex::atOrBefore(std::int64_t pts) const
+{
+    auto it = std::upper_bound(entries_.begin(), entries_.end(), pts,
+        [](std::int64_t t, Entry const& e) { return t < e.pts; });
+    return it == entries_.begin() ? nullptr : &*std::prev(it);
+}
+
+void KeyframeIndex::observe(AVFormatContext const* fmt, AVPacket const* pkt)
+{
+    if (!(pkt->flags & AV_PKT_FLAG_KEY) || seek_mode(fmt) != SeekMode::ByteOffset)
+        return;
+    add(pkt->stream_index, pkt->pts != AV_NOPTS_VALUE ? pkt->pts : pkt->dts, pkt->pos);
+}
+
+void KeyframeIndex::capture(AVFormatContext const* fmt, int stream)
+{
+    if (seek_mode(fmt) != SeekMode::PrimeIndex || stream < 0
+        || static_cast<unsigned>(stream) >= fmt->nb_streams)
+        return;
+    AVStream* st = fmt->streams[stream];
+    int const n = avformat_index_get_entries_count(st);
+    for (int i = 0; i < n; ++i) {
+        AVIndexEntry const* e = avformat_index_get_entry(st, i);
+        if (e && (e->flags & AVINDEX_KEYFRAME))
+            add(stream, e->timestamp, e->pos);
+    }
+}
+
+void KeyframeIndex::prime(AVFormatContext* fmt, int stream) const
+{
+    if (stream != stream_ || entries_.empty() || seek_mode(fmt) != SeekMode::PrimeIndex
+        || static_cast<unsigned>(stream) >= fmt->nb_streams)
+        return;
+    AVStream* st = fmt->streams[stream];
+    for (Entry const& e : entries_)
+        av_add_index_entry(st, e.pos, e.pts, 0, 0, AVINDEX_KEYFRAME);
+}
+
+int KeyframeIndex::seek(AVFormatContext* fmt, int stream, std::int64_t pts, int flags) const
+{
+    if (stream == stream_ && seek_mode(fmt) == SeekMode::ByteOffset) {
+        if (Entry const* e = atOrBefore(pts))
+            if (av_seek_frame(fmt, -1, e->pos, AVSEEK_FLAG_BYTE) >= 0)
+                return 0;
+    }
+    return av_seek_frame(fmt, stream, pts, flags);
+}
+
+std::vector<std::uint8_t> KeyframeIndex::serialize() const
+{
+    std::vector<std::uint8_t> out(std::begin(kMagic), std::end(kMagic));
+    out.reserve(16 + entries_.size() * 4);
+    put_varint(out, zigzag(stream_));
+    put_varint(out, entries_.size());
+    std::int64_t pts = 0, pos = 0;
+    for (Entry const& e : entries_) {
+        put_varint(out, zigzag(e.pts - pts));
+        put_varint(out, zigzag(e.pos - pos));
+        pts = e.pts;
+        pos = e.pos;
+    }
+    return out;
+}
+
+std::optional<KeyframeIndex> KeyframeIndex::deserialize(std::span<std::uint8_t const> blob)
+{
+    if (blob.size() < sizeof kMagic || std::memcmp(blob.data(), kMagic, sizeof kMagic) != 0)
+        return std::nullopt;
+    blob = blob.subspan(sizeof kMagic);
+
+    std::uint64_t stream = 0, count = 0;
+    if (!get_varint(blob, stream) || !get_varint(blob, count) || count > blob.size())
+        return std::nullopt;
+
+    KeyframeIndex idx;
+    idx.stream_ = static_cast<int>(unzigzag(stream));
+    idx.entries_.reserve(count);
+    std::int64_t pts = 0, pos = 0;
+    for (std::uint64_t i = 0; i < count; ++i) {
+        std::uint64_t dPts = 0, dPos = 0;
+        if (!get_varint(blob, dPts) || !get_varint(blob, dPos))
+            return std::nullopt;
+        pts += unzigzag(dPts);
+        pos += unzigzag(dPos);
+        idx.entries_.push_back({ pts, pos });
+    }
+    return idx;
+}
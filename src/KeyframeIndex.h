@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+struct AVFormatContext;
+struct AVPacket;
+
+// Keyframe timestamp → byte-offset table for one video stream, recorded
+// while a file is decoded and stored per video (DatabaseManager), so later
+// seeks do not have to make the demuxer bisect or scan files whose own
+// index is poor or missing (AVI without idx1, MPEG-TS/PS, MKV without
+// cues).  How the table is used depends on the container:
+//
+//   * MPEG-TS / PS resync on any byte, so we seek straight to the offset;
+//   * AVI, Matroska, FLV and ASF seek through their in-memory index, so the
+//     stored entries are handed to the demuxer before the first seek;
+//   * everything else (MP4/MOV, ...) carries a complete index already and
+//     is left alone.
+//
+// Not thread-safe; one decoding pass owns an index at a time.
+class KeyframeIndex {
+public:
+    struct Entry {
+        std::int64_t pts; // stream time base
+        std::int64_t pos; // byte offset in the file
+    };
+
+    // Record a packet if it is a keyframe of the indexed stream.
+    void observe(AVFormatContext const* fmt, AVPacket const* pkt);
+
+    // Pull in whatever keyframes the demuxer indexed on its own during the
+    // pass; call before closing the format context.
+    void capture(AVFormatContext const* fmt, int stream);
+
+    // Hand stored entries to the demuxer (index-seeking containers only).
+    // Call once after avformat_find_stream_info.
+    void prime(AVFormatContext* fmt, int stream) const;
+
+    // av_seek_frame replacement: seeks to the last stored keyframe at or
+    // before `pts` by byte offset where the container allows it, otherwise
+    // falls back to av_seek_frame(fmt, stream, pts, flags).
+    int seek(AVFormatContext* fmt, int stream, std::int64_t pts, int flags) const;
+
+    bool empty() const { return entries_.empty(); }
+    std::size_t size() const { return entries_.size(); }
+    bool dirty() const { return dirty_; }
+    void markClean() { dirty_ = false; }
+    void markDirty() { dirty_ = true; } // e.g. replaced by a worker process's copy
+
+    // Compact blob (varint deltas, ~3-5 bytes per keyframe) for the DB.
+    std::vector<std::uint8_t> serialize() const;
+    static std::optional<KeyframeIndex> deserialize(std::span<std::uint8_t const> blob);
+
+private:
+    void add(int stream, std::int64_t pts, std::int64_t pos);
+    Entry const* atOrBefore(std::int64_t pts) const;
+
+    int stream_ = -1;
+    std::vector<Entry> entries_; // sorted by pts, unique pts
+    bool dirty_ = false;
+};
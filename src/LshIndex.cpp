@@ -0,0 +1,201 @@
+#include "LshIndex.h"
+#include "SimdKernels.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <utility>
+
+namespace {
+
+constexpr unsigned kMaxSampleBits = 32;
+
+// Probability that one table keys two hashes `radius` bits apart alike:
+// its sampleBits distinct positions all miss the differing bits.
+double key_collision(unsigned bits, unsigned radius, unsigned sampleBits)
+{
+    double p = 1.0;
+    for (unsigned i = 0; i < sampleBits && p > 0.0; ++i)
+        p *= radius + i < bits ? static_cast<double>(bits - radius - i) / (bits - i) : 0.0;
+    return p;
+}
+
+std::size_t probe_start(std::uint32_t key, std::size_t mask)
+{
+    // keys are raw bit samples; spread them before masking
+    return static_cast<std::size_t>((key * 0x9e3779b97f4a7c15ULL) >> 32) & mask;
+}
+
+// Tables needed so at least one of them collides with probability `target`.
+unsigned tables_for(double collision, double target)
+{
+    if (collision >= 1.0)
+        return 1;
+    if (collision <= 0.0)
+        return ~0u;
+    double const t = std::ceil(std::log1p(-target) / std::log1p(-collision));
+    return t >= static_cast<double>(~0u) ? ~0u : std::max(1u, static_cast<unsigned>(t));
+}
+
+} // namespace
+
+double LshIndex::recall(unsigned bits, unsigned radius, Params const& p)
+{
+    return 1.0 - std::pow(1.0 - key_collision(bits, radius, p.sampleBits), p.tables);
+}
+
+LshIndex::Params LshIndex::for_recall(unsigned bits, unsigned radius, double targetRecall,
+    unsigned sampleBits, unsigned tables)
+{
+    double const target = std::clamp(targetRecall, 0.5, 0.999);
+    sampleBits = std::min(sampleBits, kMaxSampleBits);
+    tables = std::min(tables, kMaxTables);
+
+    Params p;
+    if (sampleBits) {
+        p.sampleBits = sampleBits;
+        p.tables = tables ? tables
+                          : std::min(kDefaultTableBudget, tables_for(key_collision(bits, radius, sampleBits), target));
+        return p;
+    }
+    unsigned const budget = tables ? tables : kDefaultTableBudget;
+    p.sampleBits = 1;
+    for (unsigned k = kMaxSampleBits; k > 1; --k) {
+        if (tables_for(key_collision(bits, radius, k), target) <= budget) {
+            p.sampleBits = k;
+            break;
+        }
+    }
+    p.tables = tables ? tables
+                      : std::min(budget, tables_for(key_collision(bits, radius, p.sampleBits), target));
+    return p;
+}
+
+LshIndex::LshIndex(unsigned bits, Params const& p, std::uint64_t seed)
+    : bits_(bits)
+    , words_(bits / 64)
+    , p_ { std::clamp(p.sampleBits, 1u, std::min(kMaxSampleBits, bits)), std::clamp(p.tables, 1u, kMaxTables) }
+{
+    // share of unrelated hashes that collide with a query in some table
+    double const randomShare = p_.tables * std::ldexp(1.0, -static_cast<int>(p_.sampleBits));
+    if (randomShare * kCandidateCost >= 1.0)
+        return;
+    tables_.resize(p_.tables);
+
+    std::mt19937_64 rng(seed);
+    std::vector<std::uint16_t> all(bits_);
+    std::iota(all.begin(), all.end(), std::uint16_t { 0 });
+    positions_.reserve(std::size_t { p_.tables } * p_.sampleBits);
+    for (unsigned t = 0; t < p_.tables; ++t) {
+        // partial Fisher-Yates: sampleBits distinct positions per table
+        for (unsigned j = 0; j < p_.sampleBits; ++j) {
+            std::uniform_int_distribution<unsigned> pick(j, bits_ - 1);
+            std::swap(all[j], all[pick(rng)]);
+        }
+        positions_.insert(positions_.end(), all.begin(), all.begin() + p_.sampleBits);
+    }
+}
+
+std::uint32_t LshIndex::key(std::size_t table, std::uint64_t const* hash) const
+{
+    std::uint16_t const* pos = positions_.data() + table * p_.sampleBits;
+    std::uint32_t k = 0;
+    for (unsigned j = 0; j < p_.sampleBits; ++j)
+        k |= static_cast<std::uint32_t>((hash[pos[j] >> 6] >> (pos[j] & 63)) & 1) << j;
+    return k;
+}
+
+std::uint64_t const* LshIndex::find(Table const& t, std::uint32_t key)
+{
+    if (t.heads.empty())
+        return nullptr;
+    std::size_t const mask = t.heads.size() - 1;
+    for (std::size_t i = probe_start(key, mask);; i = (i + 1) & mask) {
+        std::uint64_t const e = t.heads[i];
+        if (e == 0 || e >> 32 == key)
+            return &t.heads[i];
+    }
+}
+
+std::uint64_t* LshIndex::find(Table& t, std::uint32_t key)
+{
+    return const_cast<std::uint64_t*>(find(std::as_const(t), key));
+}
+
+void LshIndex::insert(int id, std::uint64_t const* hash)
+{
+    auto const slot = static_cast<std::uint32_t>(ids_.size());
+    ids_.push_back(id);
+    full_.insert(full_.end(), hash, hash + words_);
+    if (scans())
+        return;
+    next_.resize(next_.size() + tables_.size(), kNone);
+
+    for (std::size_t ti = 0; ti < tables_.size(); ++ti) {
+        Table& t = tables_[ti];
+        if ((t.used + 1) * 4 > t.heads.size() * 3) {
+            // keep the load at most 3/4
+            std::vector<std::uint64_t> old(std::max<std::size_t>(16, t.heads.size() * 2));
+            old.swap(t.heads);
+            for (std::uint64_t e : old)
+                if (e)
+                    *find(t, static_cast<std::uint32_t>(e >> 32)) = e;
+        }
+        std::uint32_t const k = key(ti, hash);
+        std::uint64_t* e = find(t, k);
+        if (*e)
+            next_[std::size_t { slot } * tables_.size() + ti] = static_cast<std::uint32_t>(*e) - 1;
+        else
+            ++t.used;
+        *e = std::uint64_t { k } << 32 | (std::uint64_t { slot } + 1);
+    }
+}
+
+std::size_t LshIndex::search(std::uint64_t const* hash, std::uint64_t radius, std::vector<int>& out) const
+{
+    if (scans()) {
+        unsigned const maxDist = static_cast<unsigned>(std::min<std::uint64_t>(radius, bits_));
+        auto const idx = std::make_unique_for_overwrite<std::uint32_t[]>(ids_.size());
+        std::size_t found;
+        switch (words_) {
+        case 2:
+            found = simd::hamming_within128(hash, full_.data(), ids_.size(), maxDist, idx.get());
+            break;
+        case 4:
+            found = simd::hamming_within256(hash, full_.data(), ids_.size(), maxDist, idx.get());
+            break;
+        default:
+            found = simd::hamming_within(hash[0], full_.data(), ids_.size(), maxDist, idx.get());
+        }
+        for (std::size_t i = 0; i < found; ++i)
+            out.push_back(ids_[idx[i]]);
+        return ids_.size();
+    }
+
+    std::vector<std::uint32_t> candidates;
+    for (std::size_t ti = 0; ti < tables_.size(); ++ti) {
+        std::uint64_t const* e = find(tables_[ti], key(ti, hash));
+        if (!e || !*e)
+            continue;
+        for (auto slot = static_cast<std::uint32_t>(*e) - 1; slot != kNone;
+            slot = next_[std::size_t { slot } * tables_.size() + ti])
+            candidates.push_back(slot);
+    }
+    // a near neighbour usually shares several keys; check it once
+    std::ranges::sort(candidates);
+    auto const last = std::ranges::unique(candidates).begin();
+    candidates.erase(last, candidates.end());
+
+    for (std::uint32_t slot : candidates) {
+        std::uint64_t const* stored = full_.data() + std::size_t { slot } * words_;
+        std::uint64_t d = 0;
+        for (std::size_t w = 0; w < words_; ++w)
+            d += static_cast<unsigned>(std::popcount(hash[w] ^ stored[w]));
+        if (d <= radius)
+            out.push_back(ids_[slot]);
+    }
+    return candidates.size();
+}
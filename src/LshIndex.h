@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Approximate Hamming range search by bit sampling.  Each of `tables` hash
+// tables keys a stored hash by `sampleBits` of its bits at fixed random
+// positions.  Two hashes r bits apart agree on one table's key with
+// probability P ~ (1 - r/width)^sampleBits (exactly: none of the r differing
+// bits is among the sampled ones), so a neighbour at the design radius is
+// found by at least one table with probability 1 - (1 - P)^tables.
+// Candidates from all tables are confirmed over the full width, so results
+// are a subset of the exact ones: neighbours can be missed, never invented.
+// Unlike the trie, the work per query does not grow with the radius, which
+// is what makes radii above ~10 usable on large libraries.
+//
+// Parameters whose keys are so short that a query would compare a sizeable
+// share of the library anyway build no tables: the index then scans every
+// stored hash with the SIMD Hamming kernels, which is exact and faster than
+// following that many candidates.
+//
+// Searches are const and may run concurrently; insert needs exclusive access.
+class LshIndex {
+public:
+    struct Params {
+        unsigned sampleBits = 12; // bits per key, 1-32
+        unsigned tables = 16;     // 1-kMaxTables
+
+        bool operator==(Params const&) const = default;
+    };
+
+    static constexpr unsigned kMaxTables = 64;
+    // tables for_recall derives on its own; each costs ~15 bytes per hash
+    static constexpr unsigned kDefaultTableBudget = 32;
+
+    // Expected fraction of the neighbours exactly `radius` bits away that a
+    // search finds (closer ones are found more often).
+    static double recall(unsigned bits, unsigned radius, Params const& p);
+
+    // Longest keys for which `targetRecall` at `radius` takes no more than
+    // kDefaultTableBudget tables, then as few tables as reach it.  A non-zero
+    // `sampleBits` or `tables` fixes that half instead.
+    static Params for_recall(unsigned bits, unsigned radius, double targetRecall,
+        unsigned sampleBits = 0, unsigned tables = 0);
+
+    // `bits` is 64, 128 or 256; the sampled positions are a fixed function
+    // of `seed`, so two indexes built alike agree.
+    LshIndex(unsigned bits, Params const& p, std::uint64_t seed = 0x6e64762d6c7368ULL);
+
+    // `hash` is bits / 64 words.
+    void insert(int id, std::uint64_t const* hash);
+
+    // Appends the id of every stored hash within `radius` of `hash` that
+    // shares a key with it, once per stored hash.  Returns the number of
+    // distinct candidates compared.
+    std::size_t search(std::uint64_t const* hash, std::uint64_t radius, std::vector<int>& out) const;
+
+    Params const& params() const { return p_; }
+    bool scans() const { return tables_.empty(); }
+    std::size_t size() const { return ids_.size(); }
+
+private:
+    // Open-addressed key → newest slot with that key; older ones are
+    // chained through next_.  One allocation per table instead of one per
+    // distinct key, which is most keys at the longer sample sizes.
+    struct Table {
+        std::vector<std::uint64_t> heads; // key << 32 | slot + 1, 0 = empty
+        std::size_t used = 0;
+    };
+
+    static constexpr std::uint32_t kNone = ~0u;
+    // a candidate (chain step, dedupe, scattered compare) costs about as
+    // much as scanning this many hashes
+    static constexpr double kCandidateCost = 512.0;
+
+    std::uint32_t key(std::size_t table, std::uint64_t const* hash) const;
+    static std::uint64_t* find(Table& t, std::uint32_t key);
+    static std::uint64_t const* find(Table const& t, std::uint32_t key);
+
+    unsigned bits_;
+    std::size_t words_;
+    Params p_;
+    std::vector<std::uint16_t> positions_; // sampleBits per table
+    std::vector<Table> tables_;
+    std::vector<std::uint32_t> next_;      // per slot, per table: next slot with the same key
+    std::vector<std::uint64_t> full_;      // words_ per slot
+    std::vector<int> ids_;                 // slot → id
+};
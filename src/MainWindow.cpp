@@ -53,6 +53,10 @@ MainWindow::MainWindow(DatabaseManager* db, QWidget* parent)
     // force correct initial state
     updateThresholdWidgetsSlow(ui->fixedNumThresholdRadio->isChecked());
 
+    connect(ui->approximateSearchCheckBox, &QCheckBox::toggled,
+        ui->approximateRecallSpin, &QWidget::setEnabled);
+    ui->approximateRecallSpin->setEnabled(ui->approximateSearchCheckBox->isChecked());
+
     connect(ui->hashMethodCombo,
         QOverload<int>::of(&QComboBox::currentIndexChanged),
         ui->hashMethodStack, &QStackedWidget::setCurrentIndex);
@@ -67,6 +71,7 @@ MainWindow::MainWindow(DatabaseManager* db, QWidget* parent)
     view->setItemDelegate(delegate);
 
     view->viewport()->installEventFilter(this);
+    view->setMouseTracking(true); // hover-scrub over the screenshot column
 
     // allow user drag-resize of rows
     view->verticalHeader()->setSectionResizeMode(QHeaderView::Interactive);
@@ -109,6 +114,11 @@ MainWindow::MainWindow(DatabaseManager* db, QWidget* parent)
 
     connect(ui->tableView, &QTableView::activated, this, &MainWindow::onRowActivated);
 
+    // narrows the groups on every keystroke (VideoFilterIndex)
+    connect(ui->filterEdit, &QLineEdit::textChanged, this, [this](QString const& text) {
+        m_model->setFilter(text.toStdString());
+    });
+
     connect(ui->toggleDirectoryButton, &QToolButton::clicked, this, [this](bool checked) {
         ui->directoryPanel->setVisible(checked);
         ui->toggleDirectoryButton->setText(checked ? tr("▼ Search Directories")
@@ -130,6 +140,7 @@ MainWindow::MainWindow(DatabaseManager* db, QWidget* parent)
     connect(ui->sortGroupsButton, &QPushButton::clicked, this, &MainWindow::onSortGroupsClicked);
     connect(ui->deleteButton, &QPushButton::clicked, this, &MainWindow::onDeleteClicked);
     connect(ui->hardlinkButton, &QPushButton::clicked, this, &MainWindow::onHardlinkClicked);
+    connect(ui->findMatchesButton, &QPushButton::clicked, this, &MainWindow::onFindMatchesClicked);
 
     // ---------- Patterns & DB utilities -------------------------------------
     connect(ui->validatePatternsButton, &QPushButton::clicked, this, &MainWindow::onValidatePatternsClicked);
@@ -168,17 +179,15 @@ MainWindow::~MainWindow()
 }
 
 // UI table helper
-void MainWindow::setDuplicateVideoGroups(
-    std::vector<std::vector<VideoInfo>> const& groups)
+void MainWindow::setDuplicateVideoGroups(GroupsSnapshot groups)
 {
-    m_model->setGroupedVideos(groups);
+    m_model->setGroupedVideos(std::move(groups));
     ui->tableView->resizeColumnToContents( // NEW
         VideoModel::Col_Screenshot);
 }
-void MainWindow::onDuplicateGroupsUpdated(
-    std::vector<std::vector<VideoInfo>> const& groups)
+void MainWindow::onDuplicateGroupsUpdated(GroupsSnapshot const& groups)
 {
-    spdlog::debug("[MainWindow] got {} duplicate groups", groups.size());
+    spdlog::debug("[MainWindow] got {} duplicate groups", groups ? groups->size() : 0);
     setDuplicateVideoGroups(groups);
 }
 
@@ -248,6 +257,14 @@ void MainWindow::onDeleteClicked()
 
 void MainWindow::onHardlinkClicked() { emit hardlinkTriggered(); }
 
+void MainWindow::onFindMatchesClicked()
+{
+    QStringList const files = QFileDialog::getOpenFileNames(this, tr("Find Matches For"), QString(),
+        QString(), nullptr, QFileDialog::DontUseNativeDialog);
+    if (!files.isEmpty())
+        emit matchQueryRequested(files, collectSearchSettings());
+}
+
 /*──────────────────────────────────────────────────────────────
  *  DIRECTORY PANEL
  *────────────────────────────────────────────────────────────*/
@@ -309,10 +326,22 @@ void MainWindow::onRowActivated(QModelIndex const& ix)
 }
 
 // ─────────────────────────────────────────────────────────────────────────────
-//  Event filter: suppress clicks on separator rows
+//  Event filter: suppress clicks on separator rows, hover-scrub thumbnails
 // ─────────────────────────────────────────────────────────────────────────────
 bool MainWindow::eventFilter(QObject* w, QEvent* ev)
 {
+    if (w == ui->tableView->viewport() && ev->type() == QEvent::MouseMove) {
+        auto* me = static_cast<QMouseEvent*>(ev);
+        QModelIndex const ix = ui->tableView->indexAt(me->pos());
+        if (ix.isValid() && ix.column() == VideoModel::Col_Screenshot) {
+            QRect const r = ui->tableView->visualRect(ix);
+            m_model->setScrub(ix.row(), r.width() > 0 ? double(me->pos().x() - r.left()) / r.width() : 0.0);
+        } else {
+            m_model->setScrub(-1, 0.0);
+        }
+    } else if (w == ui->tableView->viewport() && ev->type() == QEvent::Leave) {
+        m_model->setScrub(-1, 0.0);
+    }
     if (w == ui->tableView->viewport() && (ev->type() == QEvent::MouseButtonPress || ev->type() == QEvent::MouseButtonRelease || ev->type() == QEvent::MouseButtonDblClick)) {
         auto* me = static_cast<QMouseEvent*>(ev);
         if (QModelIndex ix = ui->tableView->indexAt(me->pos()); ix.isValid() && m_model->rowEntry(ix.row()).type == RowType::Separator)
@@ -400,6 +429,16 @@ SearchSettings MainWindow::collectSearchSettings() const
     // --- Fast / Slow selection ---
     bool fast = ui->hashMethodCombo->currentIndex() == 0;
     s.method = fast ? HashMethod::Fast : HashMethod::Slow;
+    s.matchFlipsRotations = ui->matchFlipsRotationsCheckBox->isChecked();
+    s.toneMapHdr = ui->toneMapHdrCheckBox->isChecked();
+    s.reducedDecode = ui->reducedDecodeCheckBox->isChecked();
+    s.fileTimeBudgetSec = ui->fileTimeBudgetSpin->value();
+    s.hashWorkerProcesses = ui->hashWorkerProcessesSpin->value();
+    s.hashBits = ui->hashBitsCombo->currentText().toInt();
+    s.approximateSearch = ui->approximateSearchCheckBox->isChecked();
+    s.approximateRecall = ui->approximateRecallSpin->value();
+    s.twoStageSearch = ui->twoStageSearchCheckBox->isChecked();
+    s.audioMatching = ui->audioMatchingCheckBox->isChecked();
 
     if (fast) {
         s.fastHash.maxFrames = ui->maxFramesSpinFast->value();
@@ -413,6 +452,7 @@ SearchSettings MainWindow::collectSearchSettings() const
         s.slowHash.hammingDistance = ui->hammingDistanceThresholdSpin->value();
         s.slowHash.usePercentThreshold = ui->percentThresholdRadio->isChecked();
         s.slowHash.useKeyframesOnly = ui->keyframesOnlyCheckBoxSlow->isChecked();
+        s.slowHash.spriteIntervalSec = ui->spriteIntervalSpin->value();
         if (s.slowHash.usePercentThreshold)
             s.slowHash.matchingThresholdPct = ui->matchingThresholdPercentSpinBox->value();
         else
@@ -515,6 +555,16 @@ void MainWindow::applySearchSettings(SearchSettings const& s)
     // --- hash method selection ---
     bool fast = s.method == HashMethod::Fast;
     ui->hashMethodCombo->setCurrentIndex(fast ? 0 : 1);
+    ui->matchFlipsRotationsCheckBox->setChecked(s.matchFlipsRotations);
+    ui->toneMapHdrCheckBox->setChecked(s.toneMapHdr);
+    ui->reducedDecodeCheckBox->setChecked(s.reducedDecode);
+    ui->fileTimeBudgetSpin->setValue(s.fileTimeBudgetSec);
+    ui->hashWorkerProcessesSpin->setValue(s.hashWorkerProcesses);
+    ui->hashBitsCombo->setCurrentText(QString::number(s.hashBits));
+    ui->approximateSearchCheckBox->setChecked(s.approximateSearch);
+    ui->approximateRecallSpin->setValue(s.approximateRecall);
+    ui->twoStageSearchCheckBox->setChecked(s.twoStageSearch);
+    ui->audioMatchingCheckBox->setChecked(s.audioMatching);
 
     // --- fast-hash widgets ---
     ui->maxFramesSpinFast->setValue(s.fastHash.maxFrames);
@@ -534,6 +584,7 @@ void MainWindow::applySearchSettings(SearchSettings const& s)
         ui->matchingThresholdNumSpinBox->setValue(s.slowHash.matchingThresholdNum);
     }
     ui->keyframesOnlyCheckBoxSlow->setChecked(s.slowHash.useKeyframesOnly);
+    ui->spriteIntervalSpin->setValue(s.slowHash.spriteIntervalSec);
 }
 void MainWindow::onSearchSettingsLoaded(SearchSettings const& s)
 {
@@ -24,7 +24,7 @@ public:
     explicit MainWindow(DatabaseManager* db, QWidget* parent = nullptr);
     ~MainWindow() override;
 
-    void setDuplicateVideoGroups(const std::vector<std::vector<VideoInfo>>& groups);
+    void setDuplicateVideoGroups(GroupsSnapshot groups);
     VideoModel* model() const { return m_model.get(); }
 
     enum DeleteOptions { List, ListDB, Disk };
@@ -41,13 +41,14 @@ signals:                                       // emitted by MainWindow
     void sortGroupsOptionChosen(SortOptions option);
     void deleteOptionChosen(DeleteOptions option);
     void hardlinkTriggered();
+    void matchQueryRequested(QStringList const& files, SearchSettings cfg);
     void addDirectoryRequested(QString const& path);
     void removeSelectedDirectoriesRequested(QStringList const& paths);
     void databaseLoadRequested(QString const& path);
     void databaseCreateRequested(QString const& path);
 
 public slots:                                   // receive from controller
-    void onDuplicateGroupsUpdated(const std::vector<std::vector<VideoInfo>>& groups);
+    void onDuplicateGroupsUpdated(GroupsSnapshot const& groups);
     void onDirectoryListUpdated(const QStringList& dirs);
     void setCurrentDatabase(QString const& path);
     void onSearchSettingsLoaded(const SearchSettings& settings);
@@ -59,6 +60,7 @@ private slots:
     void onSortGroupsClicked();
     void onDeleteClicked();
     void onHardlinkClicked();
+    void onFindMatchesClicked();
     void onRowActivated(const QModelIndex&);
 
     void onAddDirectoryButtonClicked();
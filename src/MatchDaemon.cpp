@@ -0,0 +1,470 @@
+#include "MatchDaemon.h"
+#include "ConfigManager.h"
+#include "DatabaseManager.h"
+#include "FileSystemSearch.h"
+#include "MatchIndex.h"
+#include "MatchQuery.h"
+#include "VideoProcessorFactory.h"
+
+#include <nlohmann/json.hpp>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <semaphore>
+#include <shared_mutex>
+#include <thread>
+#include <unordered_map>
+
+#if defined(__unix__)
+#    include <poll.h>
+#    include <sys/socket.h>
+#    include <sys/stat.h>
+#    include <sys/un.h>
+#    include <unistd.h>
+#endif
+
+namespace matchd {
+
+namespace {
+
+constexpr std::size_t kDefaultLimit = 50;
+constexpr std::size_t kMaxRequestBytes = 64u << 20;
+constexpr int kMaxHashers = 64; // semaphore bound; the processor says how many
+
+std::atomic<bool> g_stop { false };
+
+extern "C" void on_signal(int) { g_stop.store(true); }
+
+using Json = nlohmann::json;
+using Clock = std::chrono::steady_clock;
+
+double ms_since(Clock::time_point t0)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - t0).count();
+}
+
+// One hash as `words` words: a number (64-bit only) or hex, word 0 first;
+// wider hashes need all of their 16 * words digits.
+void parse_hash(Json const& j, std::size_t words, std::vector<std::uint64_t>& out)
+{
+    if (j.is_number_unsigned() && words == 1) {
+        out.push_back(j.get<std::uint64_t>());
+        return;
+    }
+    std::string_view s = j.get_ref<std::string const&>();
+    if (s.starts_with("0x") || s.starts_with("0X"))
+        s.remove_prefix(2);
+    if (words > 1 && s.size() != 16 * words)
+        throw std::invalid_argument("bad hash (want " + std::to_string(16 * words) + " hex digits): " + std::string(s));
+    for (std::size_t w = 0; w < words; ++w) {
+        std::string_view const digits = words == 1 ? s : s.substr(16 * w, 16);
+        std::uint64_t v = 0;
+        auto [end, ec] = std::from_chars(digits.data(), digits.data() + digits.size(), v, 16);
+        if (ec != std::errc {} || end != digits.data() + digits.size())
+            throw std::invalid_argument("bad hash: " + std::string(s));
+        out.push_back(v);
+    }
+}
+
+std::vector<std::uint64_t> parse_hashes(Json const& j, std::size_t words)
+{
+    std::vector<std::uint64_t> out;
+    out.reserve(j.size() * words);
+    for (auto const& h : j)
+        parse_hash(h, words, out);
+    return out;
+}
+
+// Index, video paths and settings; the DB connection is shared with the
+// client threads under its own lock.
+class Resident {
+public:
+    explicit Resident(DatabaseManager& db)
+        : db_(db)
+    {
+    }
+
+    // Index whatever other connections hashed since the last call.
+    void sync()
+    {
+        std::lock_guard syncLk(syncMutex_); // one loader at a time, or groups get added twice
+        std::int64_t version;
+        {
+            std::lock_guard lk(dbMutex_);
+            version = db_.dataVersion();
+        }
+        if (version == version_.load() && version != -1)
+            return;
+
+        auto const t0 = Clock::now();
+        std::unique_lock dbLk(dbMutex_);
+        SearchSettings const cfg = db_.loadSettings();
+        auto const videos = db_.getAllVideos();
+        unsigned const bits = static_cast<unsigned>(cfg.hashBits);
+        auto const approximate = query::approximate_params(cfg);
+        std::vector<HashGroup> fresh;
+        bool firstLoad;
+        {
+            // a width or search-mode change starts the index over
+            std::shared_lock lk(m_);
+            firstLoad = index_->videos() == 0 || index_->bits() != bits
+                || index_->approximate() != approximate;
+        }
+        if (firstLoad) {
+            fresh = db_.getAllHashGroups();
+            // matched as stored; the next scan re-hashes them
+            if (auto const stale = db_.getStaleHashIds(bits).size())
+                spdlog::warn("[daemon] {} videos have hashes from another width or an older "
+                             "hash pipeline than version {}; rescan to re-hash them",
+                    stale, kPHashAlgoVersion);
+        } else {
+            std::vector<int> missing;
+            {
+                std::shared_lock lk(m_);
+                for (auto const& [id, rowBits] : db_.getHashBits())
+                    if (rowBits == bits && !index_->contains(id))
+                        missing.push_back(id);
+            }
+            for (int id : missing)
+                if (auto g = db_.getHashGroup(id))
+                    fresh.push_back(std::move(*g));
+        }
+        dbLk.unlock();
+
+        std::unique_lock lk(m_);
+        // the trie only grows; a deleted video just stops resolving to a path
+        paths_.clear();
+        ids_.clear();
+        for (auto const& v : videos) {
+            paths_.emplace(v.id, v.path);
+            ids_.emplace(v.path, v.id);
+        }
+        if (firstLoad)
+            index_ = std::make_unique<MatchIndex>(bits, approximate);
+        for (auto const& g : fresh)
+            index_->add(g);
+        if (!hasher_ || cfg.method != cfg_.method || cfg.hashWorkerProcesses != cfg_.hashWorkerProcesses) {
+            hasher_ = makeVideoProcessor(cfg);
+            slots_ = std::make_shared<std::counting_semaphore<kMaxHashers>>(
+                static_cast<std::ptrdiff_t>(std::clamp<std::size_t>(hasher_->concurrency(), 1, kMaxHashers)));
+        }
+        cfg_ = cfg;
+        version_.store(version);
+
+        if (!fresh.empty())
+            spdlog::info("[daemon] indexed {} {} videos in {:.0f} ms ({} videos, {} hashes resident)",
+                fresh.size(), firstLoad ? "stored" : "new", ms_since(t0), index_->videos(), index_->hashes());
+    }
+
+    Json handle(Json const& req)
+    {
+        auto const t0 = Clock::now();
+        std::string const op = req.value("op", "");
+        Json reply;
+        if (op == "stats") {
+            std::shared_lock lk(m_);
+            reply = { { "videos", index_->videos() }, { "hashes", index_->hashes() }, { "bits", index_->bits() } };
+        } else if (op == "query") {
+            sync();
+            reply = query(req);
+        } else {
+            throw std::invalid_argument("unknown op '" + op + "'");
+        }
+        reply["ok"] = true;
+        reply["ms"] = ms_since(t0);
+        return reply;
+    }
+
+private:
+    Json query(Json const& req)
+    {
+        SearchSettings cfg;
+        {
+            std::shared_lock lk(m_);
+            cfg = cfg_;
+        }
+        MatchIndex::Criteria c = query::match_criteria(cfg);
+        if (req.contains("hamming"))
+            c.searchRange = std::clamp<std::uint64_t>(req.at("hamming").get<std::uint64_t>(), 0,
+                static_cast<std::uint64_t>(cfg.hashBits));
+        std::size_t const limit = req.value("limit", kDefaultLimit);
+
+        Json reply = Json::object();
+        HashGroup group;
+        if (req.contains("hashes")) {
+            group.bits = static_cast<unsigned>(cfg.hashBits);
+            group.hashes = parse_hashes(req.at("hashes"), group.words());
+            if (req.contains("variants"))
+                group.variants = parse_hashes(req.at("variants"), group.words());
+        } else if (req.contains("path")) {
+            group = groupForFile(req.at("path").get<std::string>(), req.value("insert", false), cfg, reply);
+        } else {
+            throw std::invalid_argument("query needs \"path\" or \"hashes\"");
+        }
+
+        std::shared_lock lk(m_);
+        auto matches = index_->matches(group, c);
+        std::erase_if(matches, [&](MatchIndex::Match const& m) { return !paths_.contains(m.videoId); });
+        std::ranges::sort(matches, std::greater {}, &MatchIndex::Match::matched);
+        if (matches.size() > limit)
+            matches.resize(limit);
+
+        Json out = Json::array();
+        for (auto const& m : matches)
+            out.push_back({ { "id", m.videoId }, { "path", paths_.at(m.videoId) },
+                { "matched", m.matched }, { "of", group.count() } });
+        reply["matches"] = std::move(out);
+        return reply;
+    }
+
+    // Stored hashes of a known file, or hash it now (and keep it if asked).
+    HashGroup groupForFile(std::string const& path, bool insert, SearchSettings const& cfg, Json& reply)
+    {
+        auto video = getVideoFromFile(path);
+        if (!video)
+            throw std::invalid_argument("not a readable file: " + path);
+
+        // a stored path whose hashes are not in the index (another width,
+        // or none yet) is hashed again, but keeps its row
+        std::optional<int> knownId, storedId;
+        {
+            std::shared_lock lk(m_);
+            if (auto it = ids_.find(video->path); it != ids_.end()) {
+                storedId = it->second;
+                if (index_->contains(it->second))
+                    knownId = it->second;
+            }
+        }
+        if (knownId) {
+            reply["id"] = *knownId;
+            std::lock_guard lk(dbMutex_);
+            if (auto g = db_.getHashGroup(*knownId))
+                return std::move(*g);
+            throw std::runtime_error("stored hashes of '" + video->path + "' could not be read");
+        }
+
+        std::vector<std::uint64_t> phashes;
+        {
+            // copies: a settings change may swap them while this file hashes
+            std::shared_lock lk(m_);
+            auto const slots = slots_;
+            auto const hasher = hasher_;
+            lk.unlock();
+            slots->acquire();
+            try {
+                phashes = query::hash_file(*video, *hasher, cfg);
+            } catch (...) {
+                slots->release();
+                throw;
+            }
+            slots->release();
+        }
+        auto group = make_hash_group(-1, phashes, cfg.matchFlipsRotations, static_cast<unsigned>(cfg.hashBits));
+        if (!group)
+            throw std::runtime_error("processor returned a partial frame of orientations");
+        reply["hashed"] = group->count();
+
+        if (insert) {
+            std::lock_guard dbLk(dbMutex_);
+            std::optional<int> id = storedId;
+            if (!id) {
+                video->thumbnail_path = { "./sneed.png" };
+                id = db_.insertVideo(*video);
+            }
+            if (!id || !db_.insertAllHashes(*id, phashes, cfg.matchFlipsRotations, static_cast<unsigned>(cfg.hashBits)))
+                throw std::runtime_error("could not store '" + video->path + "'");
+            db_.recordDecodeOutcome(*video, true, "decode");
+            group->fk_hash_video = *id;
+
+            std::unique_lock lk(m_);
+            index_->add(*group);
+            paths_.emplace(*id, video->path);
+            ids_.emplace(video->path, *id); // no-ops for a stored path
+            reply["id"] = *id;
+        }
+        return std::move(*group);
+    }
+
+    DatabaseManager& db_;
+    std::mutex dbMutex_;
+    std::mutex syncMutex_;
+
+    std::shared_mutex m_; // guards everything below except version_
+    std::unique_ptr<MatchIndex> index_ = std::make_unique<MatchIndex>();
+    std::unordered_map<int, std::string> paths_;
+    std::unordered_map<std::string, int> ids_;
+    SearchSettings cfg_;
+    std::shared_ptr<IVideoProcessor> hasher_;
+    std::shared_ptr<std::counting_semaphore<kMaxHashers>> slots_; // concurrent decodeAndHash calls
+    std::atomic<std::int64_t> version_ { -1 };
+};
+
+#if defined(__unix__)
+bool send_all(int fd, std::string_view s)
+{
+    while (!s.empty()) {
+        ssize_t const n = ::send(fd, s.data(), s.size(), MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        s.remove_prefix(static_cast<std::size_t>(n));
+    }
+    return true;
+}
+
+void serve_client(int fd, Resident& resident)
+{
+    std::string buf;
+    char chunk[64 * 1024];
+    for (;;) {
+        std::size_t nl;
+        while ((nl = buf.find('\n')) != std::string::npos) {
+            std::string const line = buf.substr(0, nl);
+            buf.erase(0, nl + 1);
+            if (line.empty())
+                continue;
+            Json reply;
+            try {
+                reply = resident.handle(Json::parse(line));
+            } catch (std::exception const& ex) {
+                reply = { { "ok", false }, { "error", ex.what() } };
+            }
+            if (!send_all(fd, reply.dump(-1, ' ', false, Json::error_handler_t::replace) + '\n'))
+                return;
+        }
+        if (buf.size() > kMaxRequestBytes) {
+            send_all(fd, R"({"ok":false,"error":"request too large"})" "\n");
+            return;
+        }
+        ssize_t const n = ::recv(fd, chunk, sizeof chunk, 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return;
+        buf.append(chunk, static_cast<std::size_t>(n));
+    }
+}
+#endif
+
+} // namespace
+
+std::string defaultSocketPath()
+{
+    if (char const* dir = std::getenv("XDG_RUNTIME_DIR"); dir && *dir)
+        return std::string(dir) + "/ndvdetector.sock";
+#if defined(__unix__)
+    return "/tmp/ndvdetector-" + std::to_string(::getuid()) + ".sock";
+#else
+    return "ndvdetector.sock";
+#endif
+}
+
+int runDaemon(std::vector<std::string_view> const& args)
+{
+#if defined(__unix__)
+    std::string dbPath = cfg::loadDatabasePath().value_or(cfg::defaultDatabasePath());
+    std::string sockPath = defaultSocketPath();
+    for (std::size_t i = 0; i < args.size(); ++i) {
+        if (args[i] == "--db" && i + 1 < args.size())
+            dbPath = args[++i];
+        else if (args[i] == "--socket" && i + 1 < args.size())
+            sockPath = args[++i];
+        else {
+            std::fprintf(stderr, "usage: --daemon [--db <file>] [--socket <path>]\n");
+            return 2;
+        }
+    }
+
+    sockaddr_un addr {};
+    addr.sun_family = AF_UNIX;
+    if (sockPath.size() >= sizeof addr.sun_path) {
+        spdlog::error("[daemon] socket path too long: {}", sockPath);
+        return 1;
+    }
+    std::memcpy(addr.sun_path, sockPath.c_str(), sockPath.size() + 1);
+
+    DatabaseManager db(dbPath);
+    Resident resident(db);
+    resident.sync();
+
+    int const lfd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (lfd < 0) {
+        spdlog::error("[daemon] socket failed: {}", std::strerror(errno));
+        return 1;
+    }
+    // a socket file left behind by a daemon that did not shut down cleanly
+    if (struct stat st; ::lstat(sockPath.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+        ::unlink(sockPath.c_str());
+    mode_t const oldMask = ::umask(0077); // owner only
+    int const bound = ::bind(lfd, reinterpret_cast<sockaddr const*>(&addr), sizeof addr);
+    ::umask(oldMask);
+    if (bound != 0 || ::listen(lfd, 16) != 0) {
+        spdlog::error("[daemon] cannot listen on {}: {}", sockPath, std::strerror(errno));
+        ::close(lfd);
+        return 1;
+    }
+
+    std::signal(SIGINT, on_signal);
+    std::signal(SIGTERM, on_signal);
+    spdlog::info("[daemon] serving {} on {}", dbPath, sockPath);
+
+    struct Client {
+        int fd;
+        std::atomic<bool> done { false };
+        std::jthread thread;
+    };
+    std::list<Client> clients;
+
+    while (!g_stop.load()) {
+        std::erase_if(clients, [](Client& c) {
+            if (!c.done.load())
+                return false;
+            c.thread.join();
+            ::close(c.fd);
+            return true;
+        });
+
+        pollfd p { lfd, POLLIN, 0 };
+        if (::poll(&p, 1, 500) <= 0)
+            continue;
+        int const cfd = ::accept4(lfd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (cfd < 0)
+            continue;
+        Client& c = clients.emplace_back();
+        c.fd = cfd;
+        c.thread = std::jthread([&c, &resident] {
+            serve_client(c.fd, resident);
+            c.done.store(true);
+        });
+    }
+
+    spdlog::info("[daemon] shutting down");
+    ::close(lfd);
+    ::unlink(sockPath.c_str());
+    for (Client& c : clients)
+        ::shutdown(c.fd, SHUT_RDWR); // wakes recv(); a running hash still finishes
+    for (Client& c : clients) {
+        c.thread.join();
+        ::close(c.fd);
+    }
+    return 0;
+#else
+    (void)args;
+    std::fprintf(stderr, "--daemon needs Unix domain sockets\n");
+    return 1;
+#endif
+}
+
+} // namespace matchd
@@ -0,0 +1,30 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Resident matcher: loads the video table and every stored hash into a
+// MatchIndex once, then answers "is this a duplicate?" over a Unix domain
+// socket without reloading anything.  Videos hashed by another process
+// (a GUI scan) are picked up incrementally before the next query, and
+// files queried with "insert" are hashed, stored and indexed in place.
+// Matching uses the database's saved search settings.
+//
+//   --daemon [--db <file>] [--socket <path>]
+//
+// One JSON object per line each way:
+//   {"op":"query","path":"/v/a.mp4"}                  hash unless already stored
+//   {"op":"query","path":"/v/a.mp4","insert":true}    ... and keep it
+//   {"op":"query","hashes":["8f3a…",…],"variants":[…]} raw pHashes (hex or numbers;
+//                                                      wider hashes as 32/64 hex digits)
+//   {"op":"stats"}
+// Optional on queries: "hamming" (radius), "limit" (default 50).  With
+// approximate search on, the index is tuned for the saved radius; a larger
+// "hamming" still works but finds fewer of the far neighbours.
+// Replies: {"ok":true,"matches":[{"id":…,"path":…,"matched":…,"of":…}],"ms":…}
+//      or  {"ok":false,"error":"…"}
+namespace matchd
+{
+    std::string                        defaultSocketPath();
+    int                                runDaemon(std::vector<std::string_view> const& args);
+} // namespace matchd
@@ -0,0 +1,130 @@
+#include "MatchIndex.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <cmath>
+
+void MatchIndex::add(HashGroup const& group)
+{
+    if (group.bits != bits_) {
+        spdlog::debug("[index] skipping video {}: {}-bit hashes in a {}-bit index",
+            group.fk_hash_video, group.bits, bits_);
+        return;
+    }
+    std::size_t const words = group.words();
+    for (std::size_t i = 0; i < group.count(); ++i) {
+        std::uint64_t const* h = group.hashes.data() + i * words;
+        if (lsh_) {
+            lsh_->insert(group.fk_hash_video, h);
+            continue;
+        }
+        if (words == 1) {
+            trie_.Insert({ group.fk_hash_video, h[0] });
+            continue;
+        }
+        trie_.Insert({ static_cast<int>(owner_.size()), h[0] });
+        owner_.push_back(group.fk_hash_video);
+        full_.insert(full_.end(), h, h + words);
+    }
+    hashCount_[group.fk_hash_video] += group.count();
+    hashes_ += group.count();
+}
+
+template <std::size_t Bits>
+void MatchIndex::countNeighbours(std::uint64_t const* hash, std::uint64_t searchRange,
+    std::unordered_map<int, int>& counts) const
+{
+    // videos with a neighbour of `hash`, each once however many of its
+    // hashes are near: counts are of query hashes, so they stay <= the
+    // query's length
+    std::vector<int> ids;
+    if (lsh_) {
+        lsh_->search(hash, searchRange, ids);
+    } else {
+        auto const results = [&] {
+            std::lock_guard lk(trieMutex_);
+            return trie_.RangeSearchFast(hash[0], searchRange);
+        }();
+        if constexpr (Bits == 64) {
+            for (auto const& r : results)
+                ids.push_back(r.id); // the fk_hash_video from insertion
+        } else {
+            constexpr std::size_t words = PHashT<Bits>::kWords;
+            PHashT<Bits> q, stored;
+            std::copy_n(hash, words, q.w.begin());
+            for (auto const& r : results) {
+                std::size_t const slot = static_cast<std::size_t>(r.id);
+                std::copy_n(full_.data() + slot * words, words, stored.w.begin());
+                if (hamming(q, stored) <= searchRange)
+                    ids.push_back(owner_[slot]);
+            }
+        }
+    }
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+    for (int id : ids)
+        counts[id]++;
+}
+
+std::unordered_map<int, int>
+MatchIndex::matchCounts(HashGroup const& group, std::uint64_t searchRange) const
+{
+    if (group.bits != bits_)
+        return {};
+    return visit_hash_bits(bits_, [&](auto width) {
+        return matchCountsAt<decltype(width)::value>(group, searchRange);
+    });
+}
+
+template <std::size_t Bits>
+std::unordered_map<int, int>
+MatchIndex::matchCountsAt(HashGroup const& group, std::uint64_t searchRange) const
+{
+    constexpr std::size_t words = PHashT<Bits>::kWords;
+    std::size_t const n = group.count();
+
+    std::unordered_map<int, int> counts;
+    for (std::size_t i = 0; i < n; ++i)
+        countNeighbours<Bits>(group.hashes.data() + i * words, searchRange, counts);
+
+    constexpr std::size_t nVariants = kPHashOrientations - 1;
+    if (group.variants.size() == group.hashes.size() * nVariants) {
+        for (std::size_t o = 0; o < nVariants; ++o) {
+            std::unordered_map<int, int> orientCounts;
+            for (std::size_t i = 0; i < n; ++i)
+                countNeighbours<Bits>(group.variants.data() + (i * nVariants + o) * words,
+                    searchRange, orientCounts);
+            for (auto const& [videoId, count] : orientCounts) {
+                int& best = counts[videoId];
+                best = std::max(best, count);
+            }
+        }
+    }
+    return counts;
+}
+
+std::vector<MatchIndex::Match>
+MatchIndex::matches(HashGroup const& group, Criteria const& c) const
+{
+    std::vector<Match> out;
+    for (auto const& [videoId, count] : matchCounts(group, c.searchRange)) {
+        if (videoId == group.fk_hash_video)
+            continue;
+
+        auto it = hashCount_.find(videoId);
+        std::size_t const required = requiredMatches(c, group.count(),
+            it != hashCount_.end() ? it->second : 0);
+        if (count >= static_cast<int>(required))
+            out.push_back({ videoId, count });
+    }
+    return out;
+}
+
+std::size_t MatchIndex::requiredMatches(Criteria const& c, std::size_t queryHashes, std::size_t storedHashes)
+{
+    if (!c.usePercentThreshold)
+        return c.numberThreshold;
+    std::size_t const longer = std::max(queryHashes, storedHashes);
+    return static_cast<std::size_t>(std::ceil(longer * c.percentThreshold / 100.0));
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "Hash.h"
+#include "LshIndex.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+#include <hft/hftrie.hpp>
+
+// Searchable set of stored pHashes: every original hash in an HFTrie keyed
+// by its video id, plus each video's hash count for percentage thresholds.
+// findDuplicates builds one per pass; MatchDaemon keeps one resident and
+// adds videos to it as they are hashed.  Searches (matches, matchCounts)
+// may run concurrently with each other; add() needs exclusive access.
+//
+// An index holds one hash width.  The trie is 64-bit, so for 128/256-bit
+// hashes it indexes word 0 (the lowest frequencies) by slot, and every hit
+// is confirmed over the full width: word 0's distance never exceeds the
+// full one, so the prefilter loses nothing.
+//
+// With LSH parameters the index is approximate instead: hashes go into an
+// LshIndex rather than the trie, which stays cheap at radii where a range
+// search visits most of the trie, at the cost of missing a small, tunable
+// fraction of neighbours (see LshIndex.h).
+class MatchIndex {
+public:
+    explicit MatchIndex(unsigned bits = 64, std::optional<LshIndex::Params> approximate = std::nullopt)
+        : bits_(bits)
+    {
+        if (approximate)
+            lsh_.emplace(bits, *approximate);
+    }
+
+    struct Criteria {
+        std::uint64_t searchRange = 4;    // Hamming radius per hash
+        bool usePercentThreshold = false;
+        double percentThreshold = 50.0;   // 1-100, of the longer video
+        std::uint64_t numberThreshold = 2; // absolute count
+    };
+
+    struct Match {
+        int videoId;
+        int matched; // hashes of the query within searchRange of this video
+    };
+
+    // Groups of another width are ignored.
+    void add(HashGroup const& group);
+
+    unsigned bits() const { return bits_; }
+    std::optional<LshIndex::Params> approximate() const
+    {
+        return lsh_ ? std::optional { lsh_->params() } : std::nullopt;
+    }
+    bool contains(int videoId) const { return hashCount_.contains(videoId); }
+    std::size_t videos() const { return hashCount_.size(); }
+    std::size_t hashes() const { return hashes_; }
+
+    // Video id → number of the group's hashes that have a neighbour within
+    // `searchRange` in that video.  Groups that carry flipped/rotated
+    // variants search once per orientation and keep the best count, so a
+    // match needs one consistent transform rather than a mix of them.
+    std::unordered_map<int, int> matchCounts(HashGroup const& group, std::uint64_t searchRange) const;
+
+    // Videos other than the group's own that meet the threshold.
+    std::vector<Match> matches(HashGroup const& group, Criteria const& c) const;
+
+    // Matching hashes a pair needs: the number threshold, or the percentage
+    // of the longer of the two videos.
+    static std::size_t requiredMatches(Criteria const& c, std::size_t queryHashes, std::size_t storedHashes);
+
+private:
+    template <std::size_t Bits>
+    void countNeighbours(std::uint64_t const* hash, std::uint64_t searchRange,
+        std::unordered_map<int, int>& counts) const;
+    template <std::size_t Bits>
+    std::unordered_map<int, int> matchCountsAt(HashGroup const& group, std::uint64_t searchRange) const;
+
+    unsigned bits_;
+    // HFTrie's search is non-const and not documented as safe to share, so
+    // searches of it take turns; the full-width confirmation runs unlocked
+    mutable hft::HFTrie trie_;
+    mutable std::mutex trieMutex_;
+    std::unordered_map<int, std::size_t> hashCount_;
+    std::size_t hashes_ = 0;
+    // wider than 64 bits: trie ids are slots into these
+    std::vector<std::uint64_t> full_; // bits_ / 64 words per slot
+    std::vector<int> owner_;          // slot → video id
+    std::optional<LshIndex> lsh_;     // set: used instead of all of the above
+};
@@ -0,0 +1,189 @@
+#include "MatchQuery.h"
+#include "ConfigManager.h"
+#include "DatabaseManager.h"
+#include "FFProbeExtractor.h"
+#include "FileSystemSearch.h"
+#include "IVideoProcessor.h"
+#include "SearchSettings.h"
+#include "VideoProcessorFactory.h"
+
+#include <nlohmann/json.hpp>
+#include <spdlog/sinks/stdout_color_sinks.h>
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <optional>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace query {
+
+MatchIndex::Criteria match_criteria(SearchSettings const& s)
+{
+    bool const fast = s.method == HashMethod::Fast;
+    MatchIndex::Criteria c;
+    c.searchRange = static_cast<std::uint64_t>(fast ? s.fastHash.hammingDistance : s.slowHash.hammingDistance);
+    c.usePercentThreshold = !fast && s.slowHash.usePercentThreshold;
+    c.percentThreshold = s.slowHash.matchingThresholdPct;
+    c.numberThreshold = fast ? s.fastHash.matchingThreshold : s.slowHash.matchingThresholdNum;
+    return c;
+}
+
+std::optional<LshIndex::Params> approximate_params(SearchSettings const& s)
+{
+    if (!s.approximateSearch)
+        return std::nullopt;
+    auto const radius = static_cast<unsigned>(match_criteria(s).searchRange);
+    auto const p = LshIndex::for_recall(static_cast<unsigned>(s.hashBits), radius, s.approximateRecall,
+        static_cast<unsigned>(s.lshSampleBits), static_cast<unsigned>(s.lshTables));
+    spdlog::debug("[index] LSH at radius {}: {} tables x {} bits, expected recall {:.3f}",
+        radius, p.tables, p.sampleBits, LshIndex::recall(static_cast<unsigned>(s.hashBits), radius, p));
+    return p;
+}
+
+std::vector<std::uint64_t> hash_file(VideoInfo& video, IVideoProcessor& proc, SearchSettings const& cfg)
+{
+    if (!extract_info(video))
+        throw std::runtime_error("could not probe '" + video.path + "'");
+    auto phashes = proc.decodeAndHash(video, cfg);
+    if (phashes.empty())
+        throw std::runtime_error("no hashes generated for '" + video.path + "'");
+    return phashes;
+}
+
+std::vector<FileResult> query_files(DatabaseManager& db, std::vector<std::string> const& paths,
+    SearchSettings const& cfg, std::function<void(int, int)> const& progress)
+{
+    int const total = static_cast<int>(paths.size());
+    if (progress)
+        progress(0, total);
+
+    auto videos = db.getAllVideos();
+    std::unordered_map<int, std::size_t> byId;
+    std::unordered_map<std::string, int> byPath;
+    for (std::size_t i = 0; i < videos.size(); ++i) {
+        byId.emplace(videos[i].id, i);
+        byPath.emplace(videos[i].path, videos[i].id);
+    }
+
+    unsigned const bits = static_cast<unsigned>(cfg.hashBits);
+    // rows from an older pipeline are neither searched nor reused
+    auto const stale = db.getStaleHashIds(bits);
+    MatchIndex index(bits, approximate_params(cfg));
+    for (auto const& g : db.getAllHashGroups())
+        if (!stale.contains(g.fk_hash_video))
+            index.add(g);
+    auto const criteria = match_criteria(cfg);
+    auto proc = makeVideoProcessor(cfg);
+
+    std::vector<FileResult> results;
+    results.reserve(paths.size());
+    for (auto const& path : paths) {
+        FileResult& r = results.emplace_back();
+        r.path = path;
+        try {
+            auto video = getVideoFromFile(path);
+            if (!video)
+                throw std::runtime_error("not a readable file");
+            r.path = video->path;
+
+            auto const known = byPath.find(video->path);
+            int const knownId = known != byPath.end() ? known->second : 0;
+            std::optional<HashGroup> group;
+            if (knownId && index.contains(knownId)) {
+                r.videoId = knownId;
+                group = db.getHashGroup(r.videoId);
+            }
+            if (!group) {
+                if (knownId)
+                    video->keyframes = db.keyframesFor(videos[byId.at(knownId)], *video);
+                auto const phashes = hash_file(*video, *proc, cfg);
+                group = make_hash_group(r.videoId > 0 ? r.videoId : -1, phashes, cfg.matchFlipsRotations, bits);
+                if (!group)
+                    throw std::runtime_error("processor returned a partial frame of orientations");
+            }
+            r.hashes = group->count();
+
+            for (auto const& m : index.matches(*group, criteria)) {
+                auto it = byId.find(m.videoId);
+                if (it == byId.end())
+                    continue;
+                r.matches.push_back({ videos[it->second], m.matched, r.hashes,
+                    r.hashes ? static_cast<double>(m.matched) / static_cast<double>(r.hashes) : 0.0 });
+            }
+            std::ranges::sort(r.matches, [](FileMatch const& a, FileMatch const& b) {
+                return a.score != b.score ? a.score > b.score : a.matched > b.matched;
+            });
+        } catch (std::exception const& ex) {
+            r.error = ex.what();
+            spdlog::warn("[query] '{}': {}", path, r.error);
+        }
+        if (progress)
+            progress(static_cast<int>(results.size()), total);
+    }
+    return results;
+}
+
+int runQuery(std::vector<std::string_view> const& args)
+{
+    std::string dbPath = cfg::loadDatabasePath().value_or(cfg::defaultDatabasePath());
+    bool json = false;
+    std::vector<std::string> files;
+    for (std::size_t i = 0; i < args.size(); ++i) {
+        if (args[i] == "--db" && i + 1 < args.size())
+            dbPath = args[++i];
+        else if (args[i] == "--json")
+            json = true;
+        else
+            files.emplace_back(args[i]);
+    }
+    if (files.empty()) {
+        std::fprintf(stderr, "usage: --query [--db <file>] [--json] <video>...\n");
+        return 2;
+    }
+
+    // results go to stdout; keep the log out of them
+    spdlog::set_default_logger(spdlog::stderr_color_mt("query"));
+
+    auto const t0 = std::chrono::steady_clock::now();
+    DatabaseManager db(dbPath);
+    auto const results = query_files(db, files, db.loadSettings());
+    double const secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    bool anyFailed = false;
+    if (json) {
+        nlohmann::json out = nlohmann::json::array();
+        for (auto const& r : results) {
+            nlohmann::json m = nlohmann::json::array();
+            for (auto const& fm : r.matches)
+                m.push_back({ { "id", fm.video.id }, { "path", fm.video.path },
+                    { "matched", fm.matched }, { "of", fm.of }, { "score", fm.score } });
+            nlohmann::json j { { "path", r.path }, { "hashes", r.hashes }, { "matches", std::move(m) } };
+            if (r.videoId > 0)
+                j["id"] = r.videoId;
+            if (!r.error.empty())
+                j["error"] = r.error;
+            out.push_back(std::move(j));
+            anyFailed |= !r.error.empty();
+        }
+        std::printf("%s\n", out.dump(2, ' ', false, nlohmann::json::error_handler_t::replace).c_str());
+    } else {
+        for (auto const& r : results) {
+            if (!r.error.empty()) {
+                std::printf("%s: %s\n", r.path.c_str(), r.error.c_str());
+                anyFailed = true;
+                continue;
+            }
+            std::printf("%s (%zu hashes%s): %zu match%s\n", r.path.c_str(), r.hashes,
+                r.videoId > 0 ? ", in library" : "", r.matches.size(), r.matches.size() == 1 ? "" : "es");
+            for (auto const& m : r.matches)
+                std::printf("  %5.1f%%  %3d/%-3zu  %s\n", 100.0 * m.score, m.matched, m.of, m.video.path.c_str());
+        }
+        std::printf("%zu files queried in %.2f s\n", results.size(), secs);
+    }
+    return anyFailed ? 1 : 0;
+}
+
+} // namespace query
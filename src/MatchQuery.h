@@ -0,0 +1,56 @@
+#pragma once
+#include "MatchIndex.h"
+#include "VideoInfo.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class DatabaseManager;
+class IVideoProcessor;
+struct SearchSettings;
+
+// "Which library videos match this file?" without a scan: the given files
+// are probed and hashed with the configured processor (or their stored
+// hashes reused if they are already in the library), then range-searched
+// against every stored hash.  Nothing is written; stored duplicate groups
+// are left alone.
+//
+//   --query [--db <file>] [--json] <video>...
+namespace query
+{
+    struct FileMatch {
+        VideoInfo                      video;
+        int                            matched = 0; // query hashes with a neighbour in this video
+        std::size_t                    of = 0;      // query hashes in total
+        double                         score = 0.0; // matched / of
+    };
+
+    struct FileResult {
+        std::string                    path;
+        int                            videoId = 0; // > 0: already in the library
+        std::size_t                    hashes = 0;
+        std::vector<FileMatch>         matches;     // best first
+        std::string                    error;       // non-empty: probing or hashing failed
+    };
+
+    // Thresholds of the selected hash method, as the full search applies them.
+    MatchIndex::Criteria               match_criteria(SearchSettings const& cfg);
+
+    // LSH parameters for the configured radius and recall, or nullopt for
+    // an exact index.
+    std::optional<LshIndex::Params>    approximate_params(SearchSettings const& cfg);
+
+    // Probe `video` (path set) and hash it; throws std::runtime_error on failure.
+    std::vector<std::uint64_t>         hash_file(VideoInfo& video, IVideoProcessor& proc, SearchSettings const& cfg);
+
+    std::vector<FileResult>            query_files(DatabaseManager& db, std::vector<std::string> const& paths,
+                                           SearchSettings const& cfg,
+                                           std::function<void(int done, int total)> const& progress = {});
+
+    int                                runQuery(std::vector<std::string_view> const& args);
+} // namespace query
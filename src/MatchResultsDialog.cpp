@@ -0,0 +1,67 @@
+#include "MatchResultsDialog.h"
+
+#include <QDesktopServices>
+#include <QDialogButtonBox>
+#include <QHeaderView>
+#include <QUrl>
+#include <QVBoxLayout>
+
+namespace {
+constexpr int PathRole = Qt::UserRole;
+}
+
+MatchResultsDialog::MatchResultsDialog(std::vector<query::FileResult> const& results, QWidget* parent)
+    : QDialog(parent)
+{
+    setWindowTitle(tr("Matches"));
+    resize(760, 420);
+
+    m_tree = new QTreeWidget(this);
+    m_tree->setColumnCount(3);
+    m_tree->setHeaderLabels({ tr("File"), tr("Score"), tr("Matched") });
+    m_tree->header()->setSectionResizeMode(0, QHeaderView::Stretch);
+    m_tree->header()->setStretchLastSection(false);
+    m_tree->setUniformRowHeights(true);
+
+    for (auto const& r : results) {
+        auto* top = new QTreeWidgetItem(m_tree);
+        QString const path = QString::fromStdString(r.path);
+        top->setText(0, path);
+        top->setData(0, PathRole, path);
+        if (!r.error.empty()) {
+            top->setText(1, tr("failed"));
+            top->setToolTip(0, QString::fromStdString(r.error));
+            top->setForeground(1, Qt::red);
+            continue;
+        }
+        top->setText(1, r.matches.empty() ? tr("no matches")
+                                          : tr("%n match(es)", nullptr, static_cast<int>(r.matches.size())));
+        top->setText(2, tr("%1 hashes%2").arg(r.hashes).arg(r.videoId > 0 ? tr(", in library") : QString()));
+
+        for (auto const& m : r.matches) {
+            auto* child = new QTreeWidgetItem(top);
+            QString const mp = QString::fromStdString(m.video.path);
+            child->setText(0, mp);
+            child->setData(0, PathRole, mp);
+            child->setText(1, QString::number(100.0 * m.score, 'f', 1) + '%');
+            child->setText(2, QStringLiteral("%1 / %2").arg(m.matched).arg(m.of));
+        }
+        top->setExpanded(true);
+    }
+
+    auto* buttons = new QDialogButtonBox(QDialogButtonBox::Close, this);
+    connect(buttons, &QDialogButtonBox::rejected, this, &QDialog::reject);
+    connect(m_tree, &QTreeWidget::itemActivated, this, &MatchResultsDialog::onItemActivated);
+
+    auto* lay = new QVBoxLayout(this);
+    lay->addWidget(m_tree);
+    lay->addWidget(buttons);
+}
+
+void MatchResultsDialog::onItemActivated(QTreeWidgetItem* item, int)
+{
+    if (!item)
+        return;
+    if (QString const path = item->data(0, PathRole).toString(); !path.isEmpty())
+        QDesktopServices::openUrl(QUrl::fromLocalFile(path));
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "MatchQuery.h"
+
+#include <QDialog>
+#include <QTreeWidget>
+
+#include <vector>
+
+// Results of a single-file match query: one top-level row per queried file,
+// its library matches (best first) underneath.  Double-click opens a video.
+class MatchResultsDialog : public QDialog
+{
+    Q_OBJECT
+public:
+    explicit MatchResultsDialog(std::vector<query::FileResult> const& results, QWidget* parent = nullptr);
+    ~MatchResultsDialog() override = default;
+
+private slots:
+    void onItemActivated(QTreeWidgetItem* item, int column);
+
+private:
+    QTreeWidget* m_tree {};
+};
@@ -0,0 +1,237 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stop_token>
+#include <thread>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+#    include <immintrin.h>
+#endif
+
+// Bounded lock-free multi-producer / multi-consumer ring (Vyukov's
+// sequence-numbered cells).  The fast path is one CAS on the head or tail
+// index; a thread that finds the ring full/empty spins briefly, then
+// yields, then parks on a futex (std::atomic::wait) until the other side
+// makes progress, the ring is closed, or its stop token fires.
+//
+// close() ends the stream: pushes fail from then on, pops drain what is
+// left and then return false / 0.
+template<class T>
+class MpmcRing {
+public:
+    explicit MpmcRing(std::size_t minCapacity)
+        : mask_(std::bit_ceil(std::max<std::size_t>(minCapacity, 2)) - 1)
+        , cells_(std::make_unique<Cell[]>(mask_ + 1))
+    {
+        for (std::size_t i = 0; i <= mask_; ++i)
+            cells_[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    MpmcRing(MpmcRing const&) = delete;
+    MpmcRing& operator=(MpmcRing const&) = delete;
+
+    std::size_t capacity() const noexcept { return mask_ + 1; }
+
+    // Non-blocking; v is only moved from on success.
+    bool try_push(T& v)
+    {
+        std::size_t pos = head_.load(std::memory_order_relaxed);
+        Cell* c;
+        for (;;) {
+            c = &cells_[pos & mask_];
+            std::size_t const seq = c->seq.load(std::memory_order_acquire);
+            auto const diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+            if (diff == 0) {
+                if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                return false; // full
+            } else {
+                pos = head_.load(std::memory_order_relaxed);
+            }
+        }
+        c->val = std::move(v);
+        c->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_pop(T& out)
+    {
+        std::size_t pos = tail_.load(std::memory_order_relaxed);
+        Cell* c;
+        for (;;) {
+            c = &cells_[pos & mask_];
+            std::size_t const seq = c->seq.load(std::memory_order_acquire);
+            auto const diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1);
+            if (diff == 0) {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            } else if (diff < 0) {
+                return false; // empty
+            } else {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+        out = std::move(c->val);
+        c->seq.store(pos + mask_ + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Blocks while full.  False if the ring was closed or tk fired.
+    bool push(T&& v, std::stop_token const& tk)
+    {
+        for (int spin = 0;; ++spin) {
+            if (closed_.load(std::memory_order_acquire) || tk.stop_requested())
+                return false;
+            if (try_push(v)) {
+                signal(pushed_, waitingPoppers_, false);
+                return true;
+            }
+            if (!backoff(spin, popped_, waitingPushers_, tk, [&] { return try_push(v); }))
+                continue;
+            signal(pushed_, waitingPoppers_, false);
+            return true;
+        }
+    }
+
+    // Blocks while empty.  False once closed and drained, or if tk fired.
+    bool pop(T& out, std::stop_token const& tk)
+    {
+        return pop_bulk(&out, 1, tk) == 1;
+    }
+
+    // Waits for at least one element, then takes up to maxItems without
+    // blocking again.  Returns how many were written to out (0 = closed
+    // and drained, or tk fired).
+    std::size_t pop_bulk(T* out, std::size_t maxItems, std::stop_token const& tk)
+    {
+        if (maxItems == 0)
+            return 0;
+
+        std::size_t n = 0;
+        for (int spin = 0;; ++spin) {
+            if (try_pop(out[0])) {
+                n = 1;
+                break;
+            }
+            if (tk.stop_requested())
+                return 0;
+            if (closed_.load(std::memory_order_acquire)) {
+                // everything pushed before close() is visible now
+                if (!try_pop(out[0]))
+                    return 0;
+                n = 1;
+                break;
+            }
+            if (backoff(spin, pushed_, waitingPoppers_, tk, [&] { return try_pop(out[0]); })) {
+                n = 1;
+                break;
+            }
+        }
+        while (n < maxItems && try_pop(out[n]))
+            ++n;
+
+        signal(popped_, waitingPushers_, n > 1);
+        return n;
+    }
+
+    // Ends the stream and wakes every parked thread.
+    void close()
+    {
+        closed_.store(true, std::memory_order_release);
+        wake_all();
+    }
+
+    bool closed() const noexcept { return closed_.load(std::memory_order_acquire); }
+
+private:
+    static constexpr int kSpins = 64;
+    static constexpr int kYields = 16;
+
+    // Spinning only pays off when the other side runs on another core.
+    static int spin_limit() noexcept
+    {
+        static int const limit = std::thread::hardware_concurrency() > 1 ? kSpins : 0;
+        return limit;
+    }
+
+    struct alignas(64) Cell {
+        std::atomic<std::size_t> seq;
+        T val {};
+    };
+
+    static void cpu_relax() noexcept
+    {
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__)
+        _mm_pause();
+#else
+        std::this_thread::yield();
+#endif
+    }
+
+    // Bump an epoch the other side may be parked on; only pay for the
+    // futex wake when somebody is actually waiting.
+    static void signal(std::atomic<std::uint32_t>& epoch,
+        std::atomic<std::uint32_t>& waiters, bool all)
+    {
+        epoch.fetch_add(1, std::memory_order_seq_cst);
+        if (waiters.load(std::memory_order_seq_cst) != 0) {
+            if (all)
+                epoch.notify_all();
+            else
+                epoch.notify_one();
+        }
+    }
+
+    void wake_all()
+    {
+        pushed_.fetch_add(1, std::memory_order_seq_cst);
+        popped_.fetch_add(1, std::memory_order_seq_cst);
+        pushed_.notify_all();
+        popped_.notify_all();
+    }
+
+    // Spin → yield → park.  Returns true if `attempt` succeeded while
+    // getting ready to park; false means "go round again".
+    template<class Attempt>
+    bool backoff(int spin, std::atomic<std::uint32_t>& epoch,
+        std::atomic<std::uint32_t>& waiters, std::stop_token const& tk, Attempt&& attempt)
+    {
+        int const spins = spin_limit();
+        if (spin < spins) {
+            cpu_relax();
+            return false;
+        }
+        if (spin < spins + kYields) {
+            std::this_thread::yield();
+            return false;
+        }
+
+        std::uint32_t const seen = epoch.load(std::memory_order_seq_cst);
+        waiters.fetch_add(1, std::memory_order_seq_cst);
+        bool got = attempt(); // re-check after announcing ourselves
+        if (!got && !closed_.load(std::memory_order_acquire) && !tk.stop_requested()) {
+            std::stop_callback wake(tk, [this] { wake_all(); });
+            epoch.wait(seen, std::memory_order_seq_cst);
+        }
+        waiters.fetch_sub(1, std::memory_order_relaxed);
+        return got;
+    }
+
+    std::size_t const mask_;
+    std::unique_ptr<Cell[]> cells_;
+
+    alignas(64) std::atomic<std::size_t> head_ { 0 };
+    alignas(64) std::atomic<std::size_t> tail_ { 0 };
+
+    alignas(64) std::atomic<std::uint32_t> pushed_ { 0 };
+    std::atomic<std::uint32_t> waitingPoppers_ { 0 };
+    alignas(64) std::atomic<std::uint32_t> popped_ { 0 };
+    std::atomic<std::uint32_t> waitingPushers_ { 0 };
+    std::atomic_bool closed_ { false };
+};
@@ -0,0 +1,227 @@
+#include "Prefetcher.h"
+#include "VideoInfo.h"
+
+#include <spdlog/spdlog.h>
+
+#include <algorithm>
+
+#if defined(__linux__)
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <unistd.h>
+#endif
+
+namespace {
+
+constexpr std::int64_t kHeadBytes = 2 << 20;   // container header, first GOP
+constexpr std::int64_t kTailBytes = 1 << 20;   // moov-at-end, idx1, cues
+constexpr std::int64_t kBeforeTarget = 1 << 20; // keyframe usually precedes the target
+constexpr std::int64_t kAfterTarget = 3 << 20;
+
+#if defined(__linux__)
+struct Fd {
+    int fd;
+    explicit Fd(std::string const& path) : fd(::open(path.c_str(), O_RDONLY | O_CLOEXEC)) { }
+    ~Fd()
+    {
+        if (fd >= 0)
+            ::close(fd);
+    }
+    Fd(Fd const&) = delete;
+    Fd& operator=(Fd const&) = delete;
+};
+
+// Resident bytes of [off, off + len) according to mincore().
+std::int64_t resident_bytes(int fd, std::int64_t off, std::int64_t len)
+{
+    static long const page = sysconf(_SC_PAGESIZE);
+    std::int64_t const start = off / page * page;
+    std::size_t const mapLen = static_cast<std::size_t>(off + len - start);
+    void* p = mmap(nullptr, mapLen, PROT_READ, MAP_SHARED, fd, start);
+    if (p == MAP_FAILED)
+        return 0;
+    std::vector<unsigned char> vec((mapLen + page - 1) / page);
+    std::int64_t bytes = 0;
+    if (mincore(p, mapLen, vec.data()) == 0)
+        for (unsigned char r : vec)
+            bytes += (r & 1) ? page : 0;
+    munmap(p, mapLen);
+    return std::min(bytes, len);
+}
+#endif
+
+} // namespace
+
+Prefetcher::Prefetcher(std::size_t depth, std::size_t budgetBytes, std::span<double const> targets)
+    : depth_(depth)
+    , budget_(static_cast<std::int64_t>(budgetBytes))
+    , targets_(targets.begin(), targets.end())
+{
+#if defined(__linux__)
+    if (depth_ > 0)
+        worker_ = std::jthread([this](std::stop_token tk) { run(tk); });
+#endif
+}
+
+Prefetcher::~Prefetcher() = default; // jthread stops and joins the worker
+
+Prefetcher::Plan Prefetcher::planFor(VideoInfo const& v) const
+{
+    Plan plan;
+    std::int64_t const size = v.size;
+    if (size <= 0)
+        return plan;
+
+    std::vector<Range> raw;
+    raw.push_back({ 0, kHeadBytes });
+    raw.push_back({ size - kTailBytes, kTailBytes });
+    // without a keyframe index the best guess is a constant bit rate
+    for (double t : targets_) {
+        auto const at = static_cast<std::int64_t>(t * static_cast<double>(size));
+        raw.push_back({ at - kBeforeTarget, kBeforeTarget + kAfterTarget });
+    }
+
+    for (Range& r : raw) {
+        std::int64_t const lo = std::clamp<std::int64_t>(r.off, 0, size);
+        std::int64_t const hi = std::clamp<std::int64_t>(r.off + r.len, 0, size);
+        r = { lo, hi - lo };
+    }
+    std::ranges::sort(raw, {}, &Range::off);
+    for (Range const& r : raw) {
+        if (r.len <= 0)
+            continue;
+        if (!plan.ranges.empty() && r.off <= plan.ranges.back().off + plan.ranges.back().len) {
+            Range& last = plan.ranges.back();
+            last.len = std::max(last.off + last.len, r.off + r.len) - last.off;
+        } else {
+            plan.ranges.push_back(r);
+        }
+    }
+    for (Range const& r : plan.ranges)
+        plan.bytes += r.len;
+    return plan;
+}
+
+void Prefetcher::ahead(std::span<VideoInfo const> videos, std::size_t current)
+{
+    if (!worker_.joinable())
+        return;
+
+    std::size_t const end = std::min(videos.size(), current + 1 + depth_);
+    bool queued = false;
+    {
+        std::lock_guard lk(m_);
+        for (std::size_t i = current + 1; i < end; ++i) {
+            VideoInfo const& v = videos[i];
+            if (plans_.contains(v.path))
+                continue;
+            Plan plan = planFor(v);
+            if (plan.bytes == 0)
+                continue;
+            if (inFlight_ + plan.bytes > budget_) {
+                if (v.path != lastOverBudget_) {
+                    ++filesOverBudget_;
+                    lastOverBudget_ = v.path;
+                }
+                break; // keep queue order; retry on the next call
+            }
+            inFlight_ += plan.bytes;
+            plans_.emplace(v.path, std::move(plan));
+            queue_.push_back(v.path);
+            queued = true;
+        }
+    }
+    if (queued)
+        cv_.notify_one();
+}
+
+void Prefetcher::run(std::stop_token tk)
+{
+#if defined(__linux__)
+    for (;;) {
+        std::string path;
+        std::vector<Range> ranges;
+        {
+            std::unique_lock lk(m_);
+            if (!cv_.wait(lk, tk, [&] { return !queue_.empty(); }))
+                return;
+            path = std::move(queue_.front());
+            queue_.pop_front();
+            auto it = plans_.find(path);
+            if (it == plans_.end())
+                continue;
+            ranges = it->second.ranges;
+        }
+
+        std::int64_t bytes = 0;
+        if (Fd f(path); f.fd >= 0)
+            for (Range const& r : ranges)
+                if (posix_fadvise(f.fd, r.off, r.len, POSIX_FADV_WILLNEED) == 0)
+                    bytes += r.len;
+
+        std::lock_guard lk(m_);
+        if (auto it = plans_.find(path); it != plans_.end())
+            it->second.issued = true; // even on failure: the decode is not "late"
+        if (bytes > 0) {
+            ++filesAdvised_;
+            bytesAdvised_ += bytes;
+        }
+    }
+#else
+    (void)tk;
+#endif
+}
+
+void Prefetcher::begin(VideoInfo const& v)
+{
+#if defined(__linux__)
+    std::vector<Range> ranges;
+    {
+        std::lock_guard lk(m_);
+        auto it = plans_.find(v.path);
+        if (it == plans_.end())
+            return;
+        if (!it->second.issued) {
+            std::erase(queue_, v.path);
+            ++filesLate_;
+            return;
+        }
+        ranges = it->second.ranges;
+    }
+
+    Fd f(v.path);
+    if (f.fd < 0)
+        return;
+    std::int64_t measured = 0, resident = 0;
+    for (Range const& r : ranges) {
+        measured += r.len;
+        resident += resident_bytes(f.fd, r.off, r.len);
+    }
+
+    std::lock_guard lk(m_);
+    bytesMeasured_ += measured;
+    bytesResident_ += resident;
+#else
+    (void)v;
+#endif
+}
+
+void Prefetcher::finish(VideoInfo const& v)
+{
+    std::lock_guard lk(m_);
+    if (auto it = plans_.find(v.path); it != plans_.end()) {
+        inFlight_ -= it->second.bytes;
+        plans_.erase(it);
+    }
+}
+
+void Prefetcher::logStats(char const* tag) const
+{
+    std::lock_guard lk(m_);
+    if (!worker_.joinable())
+        return;
+    double const hitPct = bytesMeasured_ ? 100.0 * static_cast<double>(bytesResident_) / static_cast<double>(bytesMeasured_) : 0.0;
+    spdlog::info("[prefetch] {}: {} files advised ({} MiB), {:.1f}% resident at decode start, "
+                 "{} late, {} deferred by the {} MiB budget",
+        tag, filesAdvised_, bytesAdvised_ >> 20, hitPct, filesLate_, filesOverBudget_, budget_ >> 20);
+}
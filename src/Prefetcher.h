@@ -0,0 +1,88 @@
+#pragma once
+
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct VideoInfo;
+
+// Fractions of the duration the fast processor seeks to and hashes; also
+// the targets a fast pass prefetches around.
+inline constexpr std::array<double, 2> kFastHashTargets = { 0.30, 0.70 };
+
+// Warms the page cache for the next few files of a sequential decode pass,
+// so a file does not start with a burst of synchronous cold reads (which
+// hurts most on NAS mounts).  For each upcoming file a background thread
+// issues posix_fadvise(WILLNEED) for the container head and tail (moov /
+// idx1 / cues live at either end) and for a window around the estimated
+// byte offset of every sample target.
+//
+// Depth is bounded twice: at most `depth` files ahead, and at most
+// `budgetBytes` of advised-but-not-yet-decoded ranges.  When a file's
+// decode starts, mincore() measures how much of its plan is resident;
+// logStats() reports that as the hit rate.  Linux only; elsewhere every
+// call is a no-op.
+class Prefetcher {
+public:
+    // targets: fractions of the duration the processor will seek to
+    // (empty for a sequential pass, which only needs the head).
+    Prefetcher(std::size_t depth, std::size_t budgetBytes, std::span<double const> targets);
+    ~Prefetcher();
+
+    Prefetcher(Prefetcher const&) = delete;
+    Prefetcher& operator=(Prefetcher const&) = delete;
+
+    // Queue videos[current + 1 .. current + depth] that are not queued yet.
+    void ahead(std::span<VideoInfo const> videos, std::size_t current);
+
+    // The decode of `v` starts now: record the hit rate, drop stale requests.
+    void begin(VideoInfo const& v);
+
+    // The decode of `v` is over: give its ranges back to the budget.
+    void finish(VideoInfo const& v);
+
+    void logStats(char const* tag) const;
+
+private:
+    struct Range {
+        std::int64_t off;
+        std::int64_t len;
+    };
+    struct Plan {
+        std::vector<Range> ranges;
+        std::int64_t bytes = 0;
+        bool issued = false;
+    };
+
+    Plan planFor(VideoInfo const& v) const;
+    void run(std::stop_token tk);
+
+    std::size_t const depth_;
+    std::int64_t const budget_;
+    std::vector<double> const targets_;
+
+    mutable std::mutex m_;
+    std::condition_variable_any cv_;
+    std::deque<std::string> queue_;
+    std::unordered_map<std::string, Plan> plans_; // queued or in flight
+    std::int64_t inFlight_ = 0;
+
+    // stats, guarded by m_
+    std::uint64_t filesAdvised_ = 0;
+    std::uint64_t filesLate_ = 0;   // decode started before the advice went out
+    std::uint64_t filesOverBudget_ = 0;
+    std::string lastOverBudget_;    // ahead() retries it until it fits; count it once
+    std::int64_t bytesAdvised_ = 0;
+    std::int64_t bytesMeasured_ = 0;
+    std::int64_t bytesResident_ = 0;
+
+    std::jthread worker_; // last: joins before the members above go away
+};
@@ -0,0 +1,81 @@
+#include "ProgressAggregator.h"
+
+#include <algorithm>
+
+#include <spdlog/spdlog.h>
+
+namespace {
+// weight of the newest interval in the smoothed rate; at ~15 samples a
+// second this averages over roughly the last half second
+constexpr double kRateSmoothing = 0.15;
+}
+
+void ProgressAggregator::begin(Stage stage, std::int64_t total)
+{
+    // the per-stage summary goes to the log once, when the stage ends
+    if (Stage const previous = stage_.load(std::memory_order_relaxed); previous != Stage::Idle) {
+        Clock::time_point const start { Clock::duration { stageStart_.load(std::memory_order_relaxed) } };
+        double const secs = std::chrono::duration<double>(Clock::now() - start).count();
+        std::int64_t const done = done_.load(std::memory_order_relaxed);
+        spdlog::info("[progress] {}: {} in {:.1f} s ({:.1f}/s)", name(previous), done, secs,
+            secs > 0.0 ? static_cast<double>(done) / secs : 0.0);
+    }
+    done_.store(0, std::memory_order_relaxed);
+    total_.store(total, std::memory_order_relaxed);
+    stageStart_.store(Clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+    stage_.store(stage, std::memory_order_release);
+}
+
+ProgressAggregator::Snapshot ProgressAggregator::sample()
+{
+    Snapshot s;
+    s.stage = stage_.load(std::memory_order_acquire);
+    s.done = done_.load(std::memory_order_relaxed);
+    s.total = total_.load(std::memory_order_relaxed);
+
+    auto const now = Clock::now();
+    Clock::time_point const start { Clock::duration { stageStart_.load(std::memory_order_relaxed) } };
+    s.elapsedSec = std::chrono::duration<double>(now - start).count();
+
+    if (s.stage != lastStage_ || s.done < lastDone_) {
+        lastStage_ = s.stage;
+        lastDone_ = 0;
+        lastSample_ = start;
+        rate_ = 0.0;
+    }
+    double const dt = std::chrono::duration<double>(now - lastSample_).count();
+    if (dt > 0.0) {
+        double const recent = static_cast<double>(s.done - lastDone_) / dt;
+        rate_ = rate_ > 0.0 ? rate_ + kRateSmoothing * (recent - rate_) : recent;
+        lastDone_ = s.done;
+        lastSample_ = now;
+    }
+    s.rate = rate_;
+    if (s.elapsedSec > 0.0)
+        s.averageRate = static_cast<double>(s.done) / s.elapsedSec;
+
+    // per-file times vary a lot (one long video stalls the recent rate),
+    // so the ETA goes by the stage average
+    if (s.total > 0 && s.averageRate > 0.0)
+        s.etaSec = static_cast<double>(std::max<std::int64_t>(s.total - s.done, 0)) / s.averageRate;
+    return s;
+}
+
+char const* ProgressAggregator::name(Stage stage)
+{
+    switch (stage) {
+    case Stage::Idle:
+        return "Starting";
+    case Stage::Discovering:
+        return "Searching for videos";
+    case Stage::Metadata:
+        return "Generating metadata/thumbnails";
+    case Stage::Hashing:
+        return "Generating hashes";
+    case Stage::Audio:
+        return "Fingerprinting audio";
+    case Stage::Matching:
+        return "Matching";
+    }
+    return "";
+}
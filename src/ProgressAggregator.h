@@ -0,0 +1,58 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <optional>
+
+// Scan progress shared between SearchWorker and the GUI without a signal
+// per file: the worker bumps atomic counters, and a GUI-side timer calls
+// sample() a dozen times a second for the current stage's counts, rates
+// and ETA.  Writers are any worker threads; sample() belongs to one reader
+// thread.  A sample taken while a stage begins may mix the two stages'
+// counters for one tick.
+class ProgressAggregator {
+public:
+    enum class Stage : int {
+        Idle,
+        Discovering, // walking the directories; no total
+        Metadata,    // probing and thumbnails
+        Hashing,
+        Audio,       // audio fingerprints
+        Matching,    // findDuplicates; no per-item progress
+    };
+
+    struct Snapshot {
+        Stage stage = Stage::Idle;
+        std::int64_t done = 0;
+        std::int64_t total = 0;            // 0 = unknown
+        double elapsedSec = 0.0;           // in this stage
+        double rate = 0.0;                 // items/s, smoothed over recent samples
+        double averageRate = 0.0;          // items/s since the stage began
+        std::optional<double> etaSec;      // needs a total; by the average rate
+    };
+
+    // Start a stage (Idle to end the last one); counts restart from zero
+    // and the stage that ends is summarised in the log.
+    void begin(Stage stage, std::int64_t total = 0);
+    void setTotal(std::int64_t total) noexcept { total_.store(total, std::memory_order_relaxed); }
+    void advance(std::int64_t n = 1) noexcept { done_.fetch_add(n, std::memory_order_relaxed); }
+
+    Snapshot sample();
+
+    static char const* name(Stage stage);
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    std::atomic<Stage> stage_ { Stage::Idle };
+    std::atomic<std::int64_t> done_ { 0 };
+    std::atomic<std::int64_t> total_ { 0 };
+    std::atomic<Clock::rep> stageStart_ { Clock::now().time_since_epoch().count() };
+
+    // reader state
+    Stage lastStage_ = Stage::Idle;
+    std::int64_t lastDone_ = 0;
+    Clock::time_point lastSample_ {};
+    double rate_ = 0.0;
+};
@@ -0,0 +1,184 @@
+#include "ScratchArena.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <new>
+
+#include <spdlog/spdlog.h>
+
+#if defined(__linux__)
+#    include <sys/mman.h>
+#endif
+
+namespace {
+
+std::atomic<std::size_t> g_reserved { 0 };
+std::atomic<std::size_t> g_highWater { 0 };
+std::atomic<std::size_t> g_huge { 0 };
+std::atomic<std::uint64_t> g_acquires { 0 };
+std::atomic<std::uint64_t> g_reuses { 0 };
+
+constexpr std::align_val_t kAlign { 64 };
+
+int size_class(std::size_t bytes)
+{
+    std::size_t const n = std::max(bytes, ScratchArena::kMinBlock);
+    int const cls = std::bit_width(n - 1) - std::bit_width(ScratchArena::kMinBlock - 1);
+    return cls;
+}
+
+std::size_t class_bytes(int cls) { return ScratchArena::kMinBlock << cls; }
+
+void note_reserved(std::ptrdiff_t delta)
+{
+    std::size_t const now = g_reserved.fetch_add(static_cast<std::size_t>(delta),
+                                std::memory_order_relaxed)
+        + static_cast<std::size_t>(delta);
+    if (delta <= 0)
+        return;
+    std::size_t hw = g_highWater.load(std::memory_order_relaxed);
+    while (now > hw && !g_highWater.compare_exchange_weak(hw, now, std::memory_order_relaxed)) { }
+}
+
+void* allocate_block(std::size_t bytes)
+{
+#if defined(__linux__)
+    if (bytes >= ScratchArena::kHugeThreshold) {
+        void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED)
+            throw std::bad_alloc();
+#    ifdef MADV_HUGEPAGE
+        madvise(p, bytes, MADV_HUGEPAGE); // best effort; THP may be disabled
+#    endif
+        g_huge.fetch_add(bytes, std::memory_order_relaxed);
+        return p;
+    }
+#endif
+    return ::operator new(bytes, kAlign);
+}
+
+void free_block(void* p, std::size_t bytes) noexcept
+{
+#if defined(__linux__)
+    if (bytes >= ScratchArena::kHugeThreshold) {
+        munmap(p, bytes);
+        g_huge.fetch_sub(bytes, std::memory_order_relaxed);
+        return;
+    }
+#endif
+    ::operator delete(p, kAlign);
+}
+
+} // namespace
+
+// ---------------------------------------------------------------------
+// ScratchBuffer
+// ---------------------------------------------------------------------
+ScratchBuffer::ScratchBuffer(ScratchBuffer&& o) noexcept
+    : arena_(o.arena_), data_(o.data_), size_(o.size_), cls_(o.cls_)
+{
+    o.arena_ = nullptr;
+    o.data_ = nullptr;
+}
+
+ScratchBuffer& ScratchBuffer::operator=(ScratchBuffer&& o) noexcept
+{
+    if (this != &o) {
+        if (arena_ && data_)
+            arena_->release(data_, cls_);
+        arena_ = o.arena_;
+        data_ = o.data_;
+        size_ = o.size_;
+        cls_ = o.cls_;
+        o.arena_ = nullptr;
+        o.data_ = nullptr;
+    }
+    return *this;
+}
+
+ScratchBuffer::~ScratchBuffer()
+{
+    if (arena_ && data_)
+        arena_->release(data_, cls_);
+}
+
+// ---------------------------------------------------------------------
+// ScratchArena
+// ---------------------------------------------------------------------
+ScratchArena& ScratchArena::local()
+{
+    static thread_local ScratchArena arena;
+    return arena;
+}
+
+ScratchBuffer ScratchArena::acquire(std::size_t bytes)
+{
+    int const cls = size_class(bytes);
+    if (cls >= kClasses)
+        throw std::bad_alloc();
+
+    g_acquires.fetch_add(1, std::memory_order_relaxed);
+
+    auto& fl = free_[cls];
+    if (!fl.empty()) {
+        void* p = fl.back();
+        fl.pop_back();
+        g_reuses.fetch_add(1, std::memory_order_relaxed);
+        return ScratchBuffer { this, p, class_bytes(cls), cls };
+    }
+
+    std::size_t const n = class_bytes(cls);
+    void* p = allocate_block(n);
+    note_reserved(static_cast<std::ptrdiff_t>(n));
+    return ScratchBuffer { this, p, n, cls };
+}
+
+void ScratchArena::release(void* p, int cls) noexcept
+{
+    auto& fl = free_[cls];
+    if (fl.size() < kMaxFreePerClass) {
+        try {
+            fl.push_back(p);
+            return;
+        } catch (...) {
+            // fall through and hand the block back to the system
+        }
+    }
+    std::size_t const n = class_bytes(cls);
+    free_block(p, n);
+    note_reserved(-static_cast<std::ptrdiff_t>(n));
+}
+
+ScratchArena::~ScratchArena()
+{
+    for (int cls = 0; cls < kClasses; ++cls) {
+        std::size_t const n = class_bytes(cls);
+        for (void* p : free_[cls]) {
+            free_block(p, n);
+            note_reserved(-static_cast<std::ptrdiff_t>(n));
+        }
+    }
+}
+
+ScratchStats ScratchArena::stats()
+{
+    ScratchStats s;
+    s.bytesReserved = g_reserved.load(std::memory_order_relaxed);
+    s.highWater = g_highWater.load(std::memory_order_relaxed);
+    s.hugeBytes = g_huge.load(std::memory_order_relaxed);
+    s.acquires = g_acquires.load(std::memory_order_relaxed);
+    s.reuses = g_reuses.load(std::memory_order_relaxed);
+    return s;
+}
+
+void ScratchArena::logStats(char const* tag)
+{
+    ScratchStats const s = stats();
+    double const hitPct = s.acquires ? 100.0 * static_cast<double>(s.reuses) / s.acquires : 0.0;
+    spdlog::info("[arena] {}: reserved {} KiB (high-water {} KiB, huge-page {} KiB), "
+                 "{} acquires, {:.1f}% reused",
+        tag, s.bytesReserved / 1024, s.highWater / 1024, s.hugeBytes / 1024,
+        s.acquires, hitPct);
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Per-thread pool of scratch blocks for per-frame work (luma rows, filter
+// and down-scale temporaries).  Blocks are bucketed into power-of-two size
+// classes and go back to the owning thread's free list when the handle
+// dies, so a steady stream of same-sized frames never touches the heap.
+// Blocks of kHugeThreshold and up are mmap'd and advised for transparent
+// huge pages where the platform supports it.
+//
+// A ScratchBuffer must be released on the thread that acquired it.
+
+class ScratchArena;
+
+class ScratchBuffer {
+public:
+    ScratchBuffer() = default;
+    ScratchBuffer(ScratchBuffer&& o) noexcept;
+    ScratchBuffer& operator=(ScratchBuffer&& o) noexcept;
+    ScratchBuffer(ScratchBuffer const&) = delete;
+    ScratchBuffer& operator=(ScratchBuffer const&) = delete;
+    ~ScratchBuffer();
+
+    template<class T>
+    T* as() const noexcept { return static_cast<T*>(data_); }
+    void* data() const noexcept { return data_; }
+    std::size_t size() const noexcept { return size_; }
+
+private:
+    friend class ScratchArena;
+    ScratchBuffer(ScratchArena* a, void* p, std::size_t n, int cls) noexcept
+        : arena_(a), data_(p), size_(n), cls_(cls) { }
+
+    ScratchArena* arena_ = nullptr;
+    void* data_ = nullptr;
+    std::size_t size_ = 0; // usable bytes (the size class, not the request)
+    int cls_ = -1;
+};
+
+struct ScratchStats {
+    std::size_t bytesReserved = 0;  // held by all arenas, in use or free
+    std::size_t highWater = 0;      // peak of bytesReserved
+    std::size_t hugeBytes = 0;      // part of bytesReserved that is huge-page backed
+    std::uint64_t acquires = 0;
+    std::uint64_t reuses = 0;       // acquires served from a free list
+};
+
+class ScratchArena {
+public:
+    static constexpr std::size_t kMinBlock = 4 * 1024;
+    static constexpr std::size_t kHugeThreshold = 2 * 1024 * 1024;
+    static constexpr int kClasses = 20;           // 4 KB … 2 GB
+    static constexpr std::size_t kMaxFreePerClass = 4;
+
+    // The calling thread's arena.
+    static ScratchArena& local();
+
+    // Block of at least `bytes`, 64-byte aligned, contents unspecified.
+    ScratchBuffer acquire(std::size_t bytes);
+
+    // Process-wide totals over all threads.
+    static ScratchStats stats();
+    static void logStats(char const* tag);
+
+    ~ScratchArena();
+
+private:
+    friend class ScratchBuffer;
+    ScratchArena() = default;
+
+    void release(void* p, int cls) noexcept;
+
+    std::array<std::vector<void*>, kClasses> free_ {};
+};
+
+// Shorthand for ScratchArena::local().acquire(n * sizeof(T)).
+template<class T>
+inline ScratchBuffer scratch_for(std::size_t n)
+{
+    return ScratchArena::local().acquire(n * sizeof(T));
+}
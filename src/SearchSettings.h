@@ -25,6 +25,10 @@ struct SlowHashSettings {
     double matchingThresholdPct = 50.0;     // 1-100
     std::uint64_t matchingThresholdNum = 5; // 1-10000
     bool useKeyframesOnly = true;
+    // every this many seconds a decoded frame also becomes a tile of the
+    // video's hover-scrub sprite sheet (SpriteSheet.h); 0 = no sheet.  A
+    // sheet needs full-quality frames, so it turns reducedDecode off.
+    int spriteIntervalSec = 0;
 };
 
 /* json helpers */
@@ -46,7 +50,7 @@ inline void from_json(nlohmann::json const& j, FastHashSettings& f)
         f.useKeyframesOnly = true;
 
     f.maxFrames = (f.maxFrames == 2 || f.maxFrames == 10) ? f.maxFrames : 2; // Only allow 2 or 10
-    f.hammingDistance = std::clamp(f.hammingDistance, 0, 64);
+    f.hammingDistance = std::clamp(f.hammingDistance, 0, 256); // up to the widest hash
     f.matchingThreshold = std::clamp<std::uint64_t>(f.matchingThreshold, 1, 10'000);
 }
 inline void to_json(nlohmann::json& j, SlowHashSettings const& s)
@@ -57,7 +61,8 @@ inline void to_json(nlohmann::json& j, SlowHashSettings const& s)
         { "usePercentThreshold", s.usePercentThreshold },
         { "matchingThresholdPct", s.matchingThresholdPct },
         { "matchingThresholdNum", s.matchingThresholdNum },
-        { "useKeyframesOnly", s.useKeyframesOnly } };
+        { "useKeyframesOnly", s.useKeyframesOnly },
+        { "spriteIntervalSec", s.spriteIntervalSec } };
 }
 inline void from_json(nlohmann::json const& j, SlowHashSettings& s)
 {
@@ -71,12 +76,15 @@ inline void from_json(nlohmann::json const& j, SlowHashSettings& s)
         j.at("useKeyframesOnly").get_to(s.useKeyframesOnly);
     else
         s.useKeyframesOnly = false;
+    if (j.contains("spriteIntervalSec"))
+        j.at("spriteIntervalSec").get_to(s.spriteIntervalSec);
 
     s.skipPercent = std::clamp(s.skipPercent, 0, 40);
     // No clamping for slow mode - user can choose any value
-    s.hammingDistance = std::clamp(s.hammingDistance, 0, 64);
+    s.hammingDistance = std::clamp(s.hammingDistance, 0, 256);
     s.matchingThresholdPct = std::clamp(s.matchingThresholdPct, 1.0, 100.0);
     s.matchingThresholdNum = std::clamp<std::uint64_t>(s.matchingThresholdNum, 1, 10'000);
+    s.spriteIntervalSec = std::clamp(s.spriteIntervalSec, 0, 600);
 }
 
 extern "C" {
@@ -119,6 +127,51 @@ struct SearchSettings {
     HashMethod method = HashMethod::Fast;
     FastHashSettings fastHash;
     SlowHashSettings slowHash;
+
+    // also hash flipped/rotated orientations and search them at query time
+    bool matchFlipsRotations = false;
+
+    // pHash width in bits (64, 128 or 256, see Hash.h).  Saved with the
+    // database; videos hashed at another width are re-hashed by the next scan
+    int hashBits = 64;
+
+    // map PQ/HLG luma to SDR before hashing so HDR and SDR encodes match
+    bool toneMapHdr = true;
+
+    // let each codec skip chroma / decode at low resolution where the
+    // golden-hash check says hashes survive it (see DecodeProfile.h)
+    bool reducedDecode = true;
+
+    // per-file hashing budget (0 = unlimited); files that run over it are
+    // retried once after the rest of the scan with four times the budget
+    int fileTimeBudgetSec = 300;
+    int fileReadBudgetPct = 300; // bytes read, as % of the file size
+
+    // hash in this many child processes (0 = in-process), so a decoder
+    // crash costs one file instead of the whole application
+    int hashWorkerProcesses = 0;
+
+    // match with bit-sampling LSH instead of the exact trie (LshIndex.h):
+    // much faster at Hamming radii above ~10, but a neighbour at the radius
+    // is only found with probability approximateRecall.  lshTables and
+    // lshSampleBits fix the derived parameters when non-zero
+    bool approximateSearch = false;
+    double approximateRecall = 0.95; // 0.5-0.999
+    int lshTables = 0;               // 0-64
+    int lshSampleBits = 0;           // 0-32
+
+    // shortlist candidate videos by a per-video signature (VideoSignature.h)
+    // and count matching hashes only for shortlisted pairs; far fewer
+    // queries in slow mode, at the risk of missing short partial overlaps
+    bool twoStageSearch = false;
+
+    // fingerprint each video's soundtrack (AudioFingerprint.h) and also
+    // group videos whose audio matches, e.g. re-encodes with a crop or an
+    // overlay.  A pair matches when audioMatchPct % of the longer track's
+    // audio hashes have a neighbour within audioHammingDistance (of 64)
+    bool audioMatching = false;
+    int audioHammingDistance = 12; // 0-32
+    double audioMatchPct = 30.0;   // 1-100
 };
 
 inline void to_json(nlohmann::json& j, SearchSettings const& s)
@@ -141,6 +194,21 @@ inline void to_json(nlohmann::json& j, SearchSettings const& s)
     j["method"] = static_cast<int>(s.method);
     j["fastHash"] = s.fastHash;
     j["slowHash"] = s.slowHash;
+    j["matchFlipsRotations"] = s.matchFlipsRotations;
+    j["hashBits"] = s.hashBits;
+    j["toneMapHdr"] = s.toneMapHdr;
+    j["reducedDecode"] = s.reducedDecode;
+    j["fileTimeBudgetSec"] = s.fileTimeBudgetSec;
+    j["fileReadBudgetPct"] = s.fileReadBudgetPct;
+    j["hashWorkerProcesses"] = s.hashWorkerProcesses;
+    j["approximateSearch"] = s.approximateSearch;
+    j["approximateRecall"] = s.approximateRecall;
+    j["lshTables"] = s.lshTables;
+    j["lshSampleBits"] = s.lshSampleBits;
+    j["twoStageSearch"] = s.twoStageSearch;
+    j["audioMatching"] = s.audioMatching;
+    j["audioHammingDistance"] = s.audioHammingDistance;
+    j["audioMatchPct"] = s.audioMatchPct;
 }
 
 inline void from_json(nlohmann::json const& j, SearchSettings& s)
@@ -176,6 +244,46 @@ inline void from_json(nlohmann::json const& j, SearchSettings& s)
         j.at("fastHash").get_to(s.fastHash);
     if (j.contains("slowHash"))
         j.at("slowHash").get_to(s.slowHash);
+    if (j.contains("matchFlipsRotations"))
+        j.at("matchFlipsRotations").get_to(s.matchFlipsRotations);
+    if (j.contains("hashBits"))
+        j.at("hashBits").get_to(s.hashBits);
+    if (s.hashBits != 128 && s.hashBits != 256)
+        s.hashBits = 64;
+    if (j.contains("toneMapHdr"))
+        j.at("toneMapHdr").get_to(s.toneMapHdr);
+    if (j.contains("reducedDecode"))
+        j.at("reducedDecode").get_to(s.reducedDecode);
+    if (j.contains("fileTimeBudgetSec"))
+        j.at("fileTimeBudgetSec").get_to(s.fileTimeBudgetSec);
+    if (j.contains("fileReadBudgetPct"))
+        j.at("fileReadBudgetPct").get_to(s.fileReadBudgetPct);
+    s.fileTimeBudgetSec = std::clamp(s.fileTimeBudgetSec, 0, 24 * 3600);
+    s.fileReadBudgetPct = std::clamp(s.fileReadBudgetPct, 0, 10'000);
+    if (j.contains("hashWorkerProcesses"))
+        j.at("hashWorkerProcesses").get_to(s.hashWorkerProcesses);
+    s.hashWorkerProcesses = std::clamp(s.hashWorkerProcesses, 0, 64);
+    if (j.contains("approximateSearch"))
+        j.at("approximateSearch").get_to(s.approximateSearch);
+    if (j.contains("approximateRecall"))
+        j.at("approximateRecall").get_to(s.approximateRecall);
+    if (j.contains("lshTables"))
+        j.at("lshTables").get_to(s.lshTables);
+    if (j.contains("lshSampleBits"))
+        j.at("lshSampleBits").get_to(s.lshSampleBits);
+    s.approximateRecall = std::clamp(s.approximateRecall, 0.5, 0.999);
+    s.lshTables = std::clamp(s.lshTables, 0, 64);
+    s.lshSampleBits = std::clamp(s.lshSampleBits, 0, 32);
+    if (j.contains("twoStageSearch"))
+        j.at("twoStageSearch").get_to(s.twoStageSearch);
+    if (j.contains("audioMatching"))
+        j.at("audioMatching").get_to(s.audioMatching);
+    if (j.contains("audioHammingDistance"))
+        j.at("audioHammingDistance").get_to(s.audioHammingDistance);
+    if (j.contains("audioMatchPct"))
+        j.at("audioMatchPct").get_to(s.audioMatchPct);
+    s.audioHammingDistance = std::clamp(s.audioHammingDistance, 0, 32);
+    s.audioMatchPct = std::clamp(s.audioMatchPct, 1.0, 100.0);
 }
 
 namespace detail {
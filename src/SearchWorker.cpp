@@ -1,22 +1,61 @@
 // SearchWorker.cpp
 #include "SearchWorker.h"
+#include "AudioFingerprint.h"
 #include "DuplicateDetector.h"
 #include "FFProbeExtractor.h"
 #include "FileSystemSearch.h"
+#include "KeyframeIndex.h"
+#include "MatchQuery.h"
+#include "Prefetcher.h"
+#include "ScratchArena.h"
 #include "Thumbnail.h"
+#include "VideoProcessingUtils.h"
 #include "VideoProcessorFactory.h"
 
 #include <QDebug>
 #include <QRegularExpression>
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
+#include <atomic>
 #include <filesystem>
 #include <future>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
 #include <unordered_map>
 #include <unordered_set>
 
 using enum HashMethod;
 
+namespace {
+constexpr std::size_t kPrefetchDepth = 3;          // files ahead of the decoder
+constexpr std::size_t kPrefetchBudget = 64u << 20; // advised, not yet decoded
+
+// A codec / pix_fmt / profile / level combination that failed this often,
+// and more often than it worked, is decoded the conservative way upfront.
+constexpr int kTroubledMinFailures = 3;
+
+// Files over the per-file budget get one more try at the end of the scan.
+constexpr int kRetryBudgetScale = 4;
+
+// An overrun says as much about the machine's load as about the file, so an
+// unchanged file that ran over is hashed again on this many later scans
+// before it is skipped like any other failure.
+constexpr int kBudgetRescans = 3;
+
+std::string codecKey(std::string_view codec, std::string_view pixFmt,
+    std::string_view profile, std::string_view level)
+{
+    return fmt::format("{}|{}|{}|{}", codec, pixFmt, profile, level);
+}
+std::string codecKey(VideoInfo const& v)
+{
+    return codecKey(v.video_codec, v.pix_fmt, v.profile, std::to_string(v.level));
+}
+}
+
 // helper ─ pick the right hash-config depending on method chosen
 inline auto const& activeSlow(SearchSettings const& c) { return c.slowHash; }
 inline auto const& activeFast(SearchSettings const& c) { return c.fastHash; }
@@ -24,11 +63,13 @@ inline bool isFast(SearchSettings const& c) { return c.method == Fast; }
 
 SearchWorker::SearchWorker(DatabaseManager& db,
     SearchSettings cfg,
+    std::shared_ptr<ProgressAggregator> progress,
     QObject* parent)
     : QObject(parent)
     , m_db(db)
     , m_cfg(std::move(cfg))
     , m_proc(makeVideoProcessor(m_cfg))
+    , m_progress(progress ? std::move(progress) : std::make_shared<ProgressAggregator>())
 {
 }
 
@@ -36,7 +77,8 @@ void SearchWorker::process()
 {
     spdlog::set_level(spdlog::level::debug);
 
-    emit searchProgress(0);
+    using Stage = ProgressAggregator::Stage;
+    m_progress->begin(Stage::Discovering);
 
     try {
         spdlog::info("[worker] Starting search task");
@@ -53,31 +95,82 @@ void SearchWorker::process()
                 continue;
             }
 
-            auto vids = getVideosFromPath(dir.path, m_cfg);
-            for (auto const& v : vids) { // iterate *each* file
-                allVideos.push_back(v);  // keep in master list
-                emit searchProgress(static_cast<int>(allVideos.size()));
-            }
+            auto vids = getVideosFromPath(dir.path, m_cfg, m_progress.get());
+            allVideos.insert(allVideos.end(), vids.begin(), vids.end());
         }
 
         spdlog::info("[worker] found {} videos", allVideos.size());
 
         // --- Filter videos already known to the DB (equal paths) ---
-        std::unordered_set<std::string> known;
+        auto const failed = m_db.getFailedFiles();
+        auto unchangedFailure = [&](VideoInfo const& v) {
+            auto it = failed.find(v.path);
+            if (it == failed.end())
+                return false;
+            if (it->second.stage.starts_with("budget:") && it->second.failures <= kBudgetRescans)
+                return false;
+            return it->second.size == v.size && it->second.modified_at == v.modified_at;
+        };
+
+        std::unordered_map<std::string, int> known;
         auto dbVideos = m_db.getAllVideos();
         known.reserve(dbVideos.size());
         for (auto const& dv : dbVideos)
-            known.insert(dv.path);
+            known.emplace(dv.path, dv.id);
+
+        // what the scan found for known paths, to tell unchanged files
+        std::unordered_map<std::string, VideoInfo> onDisk;
 
         auto prev_size = allVideos.size();
-        std::erase_if(allVideos, [&](VideoInfo const& v) { return known.contains(v.path); });
+        std::erase_if(allVideos, [&](VideoInfo const& v) {
+            auto it = known.find(v.path);
+            if (it == known.end())
+                return false;
+            onDisk.emplace(v.path, v);
+            // a file that failed to hash and has changed since (or only ran
+            // over the budget) gets another go
+            if (failed.contains(v.path) && !unchangedFailure(v)) {
+                m_db.deleteVideo(it->second);
+                return false;
+            }
+            return true;
+        });
         spdlog::info("[worker] {} videos already found in the DB", prev_size - allVideos.size());
         spdlog::info("[worker] {} new videos to process", allVideos.size());
 
+        // --- Skip files whose last probe/decode failed, unless they changed since ---
+        prev_size = allVideos.size();
+        std::erase_if(allVideos, unchangedFailure);
+        if (prev_size != allVideos.size())
+            spdlog::info("[worker] skipping {} unchanged videos that failed before",
+                prev_size - allVideos.size());
+
         // --- Generate metadata and thumbnails and DB insertion ---
         spdlog::info("[worker] Generating video metadata and thumbnails");
         generateMetadataAndThumbnails(allVideos);
 
+        // --- Library videos hashed at another width or by an older pipeline
+        //     are hashed again ---
+        std::size_t rehashed = 0;
+        auto const stale = m_db.getStaleHashIds(static_cast<unsigned>(m_cfg.hashBits));
+        for (auto& dv : dbVideos) {
+            if (!stale.contains(dv.id))
+                continue;
+            std::error_code ec;
+            if (!std::filesystem::exists(dv.path, ec))
+                continue;
+            // an unchanged file seeks through the keyframes stored last time
+            auto const disk = onDisk.find(dv.path);
+            dv.keyframes = disk != onDisk.end() ? m_db.keyframesFor(dv, disk->second)
+                                                : std::make_shared<KeyframeIndex>();
+            allVideos.push_back(std::move(dv));
+            ++rehashed;
+        }
+        if (rehashed)
+            spdlog::info("[worker] re-hashing {} videos stored at another width than {} bits "
+                         "or by an older hash pipeline (version < {})",
+                rehashed, m_cfg.hashBits, kPHashAlgoVersion);
+
         // --- pHash extraction & DB insertion ---
         decodeAndHashVideos(allVideos);
 
@@ -85,6 +178,17 @@ void SearchWorker::process()
         auto all = m_db.getAllVideos();
         auto hashes = m_db.getAllHashGroups();
 
+        // --- Audio fingerprints, for any video that has none yet ---
+        std::vector<HashGroup> audio;
+        if (m_cfg.audioMatching) {
+            fingerprintAudio(all);
+            for (auto const& [id, subs] : m_db.getAudioFingerprints())
+                audio.push_back(audiofp::hash_group(id, subs));
+        }
+        MatchIndex::Criteria const audioCriteria {
+            static_cast<std::uint64_t>(m_cfg.audioHammingDistance), true, m_cfg.audioMatchPct, 0
+        };
+
         // --- Setup variables to be used depending on the hashing method chosen (fast or slow) ---
         bool const fast = isFast(m_cfg);
         int hamming = fast ? activeFast(m_cfg).hammingDistance
@@ -95,14 +199,21 @@ void SearchWorker::process()
                                     : activeSlow(m_cfg).matchingThresholdNum;
 
         // --- Compare video's pHashes to detect duplicates ---
+        m_progress->begin(Stage::Matching);
         auto groups = findDuplicates(std::move(all), hashes,
             hamming,
             usePct,
             pctThr,
-            numThr);
+            numThr,
+            static_cast<unsigned>(m_cfg.hashBits),
+            query::approximate_params(m_cfg),
+            m_cfg.twoStageSearch,
+            audio,
+            audioCriteria);
         m_db.storeDuplicateGroups(groups);
+        m_progress->begin(Stage::Idle);
 
-        emit finished(std::move(groups));
+        emit finished(std::make_shared<DuplicateGroups const>(std::move(groups)));
         spdlog::info("[worker] Search task completed");
 
     } catch (std::exception const& e) {
@@ -116,9 +227,7 @@ void SearchWorker::process()
 
 void SearchWorker::generateMetadataAndThumbnails(std::vector<VideoInfo>& videos)
 {
-    int metaDone = 0;
-    int metaTotal = static_cast<int>(videos.size());
-    emit metadataProgress(0, metaTotal);
+    m_progress->begin(ProgressAggregator::Stage::Metadata, static_cast<std::int64_t>(videos.size()));
 
     spdlog::info("Thumbnail/FFprobe started");
 
@@ -134,11 +243,14 @@ void SearchWorker::generateMetadataAndThumbnails(std::vector<VideoInfo>& videos)
 
         if (!extract_info(v)) {
             spdlog::warn("[FFprobe] Failed extraction, skipping '{}'", v.path);
-            ++metaDone;
-            emit metadataProgress(metaDone, metaTotal);
+            m_db.recordDecodeOutcome(v, false, "probe");
+            m_progress->advance();
             continue;
         }
 
+        // recorded by the thumbnail pass, reused and extended by hashing
+        v.keyframes = std::make_shared<KeyframeIndex>();
+
         VideoInfo vCopy = v; // copy for async task
         thumbTasks.emplace_back(std::async(std::launch::async,
             [vid = std::move(vCopy), nThumbs = m_cfg.thumbnailsPerVideo]() mutable -> std::pair<std::string, std::vector<QString>> {
@@ -146,9 +258,7 @@ void SearchWorker::generateMetadataAndThumbnails(std::vector<VideoInfo>& videos)
                 return { vid.path, opt ? *opt : std::vector<QString> {} };
             }));
         filtered.push_back(std::move(v));
-
-        ++metaDone;
-        emit metadataProgress(metaDone, metaTotal);
+        m_progress->advance();
     }
 
     std::unordered_map<std::string, std::vector<QString>> thumbMap;
@@ -181,35 +291,194 @@ void SearchWorker::decodeAndHashVideos(std::vector<VideoInfo>& videos)
     spdlog::info("Hashing started");
 
     int hashedCount = 0;
-    int totalToHash = static_cast<int>(videos.size());
-    emit hashProgress(0, totalToHash);
-
-    for (auto const& v : videos) {
+    m_progress->begin(ProgressAggregator::Stage::Hashing, static_cast<std::int64_t>(videos.size()));
+
+    // fast hashing seeks to its targets; slow hashing streams from the start
+    Prefetcher prefetch(kPrefetchDepth, kPrefetchBudget,
+        isFast(m_cfg) ? std::span<double const> { kFastHashTargets } : std::span<double const> {});
+
+    // Combinations that keep failing skip the reduced-work decode profile;
+    // anything that fails with it gets one retry without it.
+    std::unordered_set<std::string> troubled;
+    for (auto const& c : m_db.getCodecOutcomes())
+        if (c.failed >= kTroubledMinFailures && c.failed > c.ok)
+            troubled.insert(codecKey(c.codec, c.pix_fmt, c.profile, c.level));
+
+    // With worker processes, one lane (thread) per worker keeps them all
+    // busy; the lanes share the DB connection, the retry queue and the
+    // progress count under this lock.
+    std::mutex dbMutex;
+    std::size_t const lanes = std::clamp<std::size_t>(m_proc->concurrency(), 1, std::max<std::size_t>(videos.size(), 1));
+
+    // BudgetExceeded is let through: the file goes on the retry-later queue
+    auto decode = [&](VideoInfo const& v, SearchSettings const& cfg) {
         try {
-            spdlog::info("[hash] Processing '{}'", v.path);
-
-            auto phashes = m_proc->decodeAndHash(v, m_cfg);
-
-            if (phashes.empty()) {
-                spdlog::warn("[hash] No hashes generated for '{}'", v.path);
-            } else if (!m_db.insertAllHashes(v.id, phashes)) {
-                spdlog::error("[DB] Failed to insert {} hashes for '{}'",
-                    phashes.size(), v.path);
-            } else {
-                spdlog::info("[hash] Successfully stored {} hashes for '{}'",
-                    phashes.size(), v.path);
-            }
+            return m_proc->decodeAndHash(v, cfg);
+        } catch (vpu::BudgetExceeded const&) {
+            throw;
         } catch (std::exception const& ex) {
-            spdlog::error("[worker] Exception while processing '{}': {}",
-                v.path, ex.what());
+            spdlog::error("[worker] Exception while processing '{}': {}", v.path, ex.what());
         } catch (...) {
-            spdlog::error("[worker] Unknown exception while processing '{}'",
-                v.path);
+            spdlog::error("[worker] Unknown exception while processing '{}'", v.path);
+        }
+        return std::vector<std::uint64_t> {};
+    };
+
+    auto hashOne = [&](VideoInfo const& v, SearchSettings const& cfg) {
+        spdlog::info("[hash] Processing '{}'", v.path);
+
+        SearchSettings safeCfg = cfg;
+        safeCfg.reducedDecode = false;
+        bool const safeFirst = cfg.reducedDecode && troubled.contains(codecKey(v));
+        if (safeFirst)
+            spdlog::info("[hash] {} has failed repeatedly, decoding '{}' without reductions",
+                codecKey(v), v.path);
+        auto phashes = decode(v, safeFirst ? safeCfg : cfg);
+        if (phashes.empty() && cfg.reducedDecode && !safeFirst) {
+            spdlog::info("[hash] retrying '{}' without reduced decoding", v.path);
+            phashes = decode(v, safeCfg);
+        }
+        std::lock_guard lk(dbMutex);
+        m_db.recordDecodeOutcome(v, !phashes.empty(), "decode");
+
+        if (phashes.empty()) {
+            spdlog::warn("[hash] No hashes generated for '{}'", v.path);
+        } else if (!m_db.insertAllHashes(v.id, phashes, cfg.matchFlipsRotations, static_cast<unsigned>(cfg.hashBits))) {
+            spdlog::error("[DB] Failed to insert {} hashes for '{}'",
+                phashes.size(), v.path);
+        } else {
+            spdlog::info("[hash] Successfully stored {} hashes for '{}'",
+                phashes.size(), v.path);
+        }
+    };
+
+    auto storeKeyframes = [&](VideoInfo const& v) {
+        std::lock_guard lk(dbMutex);
+        if (v.keyframes && v.keyframes->dirty() && v.id > 0) {
+            if (m_db.storeKeyframeIndex(v.id, *v.keyframes))
+                v.keyframes->markClean();
+        }
+    };
+
+    struct OverBudget {
+        std::size_t index;
+        std::string stage;
+        std::string reason;
+    };
+    std::vector<OverBudget> retryLater;
+
+    auto hashAt = [&](std::size_t i) {
+        auto const& v = videos[i];
+        prefetch.ahead(videos, i);
+        prefetch.begin(v);
+        try {
+            hashOne(v, m_cfg);
+        } catch (vpu::BudgetExceeded const& ex) {
+            spdlog::warn("[budget] '{}' {}; retrying after the scan", v.path, ex.what());
+            std::lock_guard lk(dbMutex);
+            retryLater.push_back({ i, ex.stage, ex.reason });
         }
+        prefetch.finish(v);
+        storeKeyframes(v);
 
+        std::lock_guard lk(dbMutex);
         ++hashedCount;
-        emit hashProgress(hashedCount, totalToHash);
+        m_progress->advance();
+    };
+
+    if (lanes == 1) {
+        for (std::size_t i = 0; i < videos.size(); ++i)
+            hashAt(i);
+    } else {
+        spdlog::info("[hash-worker] hashing in {} worker processes", lanes);
+        std::atomic<std::size_t> next { 0 };
+        std::vector<std::jthread> pool;
+        pool.reserve(lanes);
+        for (std::size_t l = 0; l < lanes; ++l)
+            pool.emplace_back([&] {
+                for (std::size_t i; (i = next.fetch_add(1)) < videos.size();)
+                    hashAt(i);
+            });
+        pool.clear(); // join
+        std::ranges::sort(retryLater, {}, &OverBudget::index);
+    }
+
+    // --- retry-later queue: nothing is waiting behind these any more ---
+    if (!retryLater.empty()) {
+        SearchSettings relaxed = m_cfg;
+        relaxed.fileTimeBudgetSec *= kRetryBudgetScale;
+        relaxed.fileReadBudgetPct *= kRetryBudgetScale;
+
+        std::size_t recovered = 0;
+        for (auto& r : retryLater) {
+            auto const& v = videos[r.index];
+            try {
+                hashOne(v, relaxed);
+                ++recovered;
+                r.stage.clear();
+            } catch (vpu::BudgetExceeded const& ex) {
+                r.stage = ex.stage;
+                r.reason = ex.reason;
+                m_db.recordDecodeOutcome(v, false, "budget:" + ex.stage);
+            }
+            storeKeyframes(v);
+        }
+
+        spdlog::warn("[budget] {} videos ran over the per-file budget ({} s, {}% of size read), "
+                     "{} finished on retry with {}x",
+            retryLater.size(), m_cfg.fileTimeBudgetSec, m_cfg.fileReadBudgetPct,
+            recovered, kRetryBudgetScale);
+        for (auto const& r : retryLater)
+            if (!r.stage.empty())
+                spdlog::warn("[budget]   gave up on '{}' during {}: {}",
+                    videos[r.index].path, r.stage, r.reason);
     }
 
     spdlog::info("Hashing finished: {} videos processed", hashedCount);
+    prefetch.logStats("hashing");
+    ScratchArena::logStats("hashing");
+}
+
+void SearchWorker::fingerprintAudio(std::vector<VideoInfo> const& videos)
+{
+    auto const done = m_db.getAudioFingerprintedIds();
+    std::unordered_set<int> const have(done.begin(), done.end());
+    std::vector<VideoInfo const*> todo;
+    for (auto const& v : videos)
+        if (!have.contains(v.id))
+            todo.push_back(&v);
+    if (todo.empty())
+        return;
+    spdlog::info("[audio] fingerprinting {} videos", todo.size());
+    m_progress->begin(ProgressAggregator::Stage::Audio, static_cast<std::int64_t>(todo.size()));
+
+    // decoding audio is cheap next to video; one lane per core
+    std::mutex dbMutex;
+    std::atomic<std::size_t> next { 0 };
+    std::size_t stored = 0;
+    auto work = [&] {
+        for (std::size_t i; (i = next.fetch_add(1)) < todo.size();) {
+            auto const& v = *todo[i];
+            std::optional<std::vector<std::uint32_t>> subs;
+            std::error_code ec;
+            if (v.audio_codec.empty())
+                subs.emplace(); // no audio track: stored empty so it is not probed again
+            else if (std::filesystem::exists(v.path, ec))
+                subs = audiofp::extract(v.path, m_cfg.fileTimeBudgetSec);
+            m_progress->advance();
+            if (!subs)
+                continue;
+            std::lock_guard lk(dbMutex);
+            if (m_db.storeAudioFingerprint(v.id, *subs))
+                ++stored;
+        }
+    };
+    std::size_t const lanes = std::clamp<std::size_t>(std::thread::hardware_concurrency(), 1, todo.size());
+    std::vector<std::jthread> pool;
+    pool.reserve(lanes);
+    for (std::size_t l = 0; l < lanes; ++l)
+        pool.emplace_back(work);
+    pool.clear(); // join
+
+    spdlog::info("[audio] stored fingerprints of {} of {} videos", stored, todo.size());
 }
@@ -5,6 +5,7 @@
 #include "SearchSettings.h"
 #include <memory>
 #include "IVideoProcessor.h"
+#include "ProgressAggregator.h"
 #include <QObject>
 #include <QString>
 #include <vector>
@@ -13,23 +14,28 @@ class SearchWorker : public QObject {
     Q_OBJECT
 
 public:
-    explicit SearchWorker(DatabaseManager& db, SearchSettings cfg, QObject* parent = nullptr);
+    // Progress goes to `progress` (a fresh aggregator if null) rather than
+    // through signals; the GUI polls it.
+    explicit SearchWorker(DatabaseManager& db, SearchSettings cfg,
+                          std::shared_ptr<ProgressAggregator> progress = nullptr,
+                          QObject* parent = nullptr);
     void process();
 
+    std::shared_ptr<ProgressAggregator> progress() const { return m_progress; }
+
 signals:
-    void searchProgress(int found);            
-    void metadataProgress(int done, int total); 
-    void hashProgress(int done, int total);    
     void error(QString message);
-    void finished(std::vector<std::vector<VideoInfo>> duplicates);
+    void finished(GroupsSnapshot duplicates);
 
 private:
     DatabaseManager& m_db;
     SearchSettings   m_cfg;
     std::unique_ptr<IVideoProcessor> m_proc;   // strategy
+    std::shared_ptr<ProgressAggregator> m_progress;
 
     void doExtractionAndDetection(std::vector<VideoInfo>& videos);
     void generateMetadataAndThumbnails(std::vector<VideoInfo>& videos);
     void decodeAndHashVideos(std::vector<VideoInfo>& videos);
+    void fingerprintAudio(std::vector<VideoInfo> const& videos);
 };
 
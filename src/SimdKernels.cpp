@@ -0,0 +1,878 @@
+#include "SimdKernels.h"
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <string_view>
+
+#include <spdlog/spdlog.h>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#    define NDV_SIMD_X86 1
+#    include <immintrin.h>
+#    define NDV_TARGET(isa) __attribute__((target(isa)))
+#else
+#    define NDV_SIMD_X86 0
+#endif
+
+namespace simd {
+
+namespace {
+
+// Rows 1..16 of the orthonormal 32-point DCT-II basis – the only ones the
+// hashes read (the 64-bit hash only rows 1..8).
+struct DctRows {
+    alignas(64) float c[16][32];
+    DctRows()
+    {
+        double const pi = std::acos(-1.0);
+        float const c1 = std::sqrt(2.0f / 32);
+        for (int v = 1; v <= 16; ++v)
+            for (int x = 0; x < 32; ++x)
+                c[v - 1][x] = c1 * static_cast<float>(std::cos((pi / 2 / 32) * v * (2 * x + 1)));
+    }
+};
+DctRows const kDct;
+
+// pshufb controls for expand_nonzero_bytes: entry m moves the popcount(m)
+// leading bytes of a vector to the set bit positions of m, zeroing the rest.
+struct ExpandShuffles {
+    alignas(16) std::uint8_t s[256][8];
+    ExpandShuffles()
+    {
+        for (unsigned m = 0; m < 256; ++m) {
+            std::uint8_t next = 0;
+            for (unsigned b = 0; b < 8; ++b)
+                s[m][b] = (m >> b & 1) ? next++ : 0x80;
+        }
+    }
+};
+ExpandShuffles const kExpand;
+
+// ---------------------------------------------------------------------
+// scalar (baseline x86-64 / any architecture)
+// ---------------------------------------------------------------------
+void rows32_scalar(float const* src, int rows, int stride, float* dst, Taps32 const& t)
+{
+    for (int y = 0; y < rows; ++y) {
+        float const* row = src + static_cast<std::ptrdiff_t>(y) * stride;
+        float* out = dst + y * 32;
+        for (int d = 0; d < 32; ++d)
+            out[d] = row[t.idx0[d]] * t.w0[d] + row[t.idx1[d]] * t.w1[d];
+    }
+}
+
+void cols32_scalar(float const* src, float* dst, Taps32 const& t)
+{
+    for (int y = 0; y < 32; ++y) {
+        float const* r0 = src + t.idx0[y] * 32;
+        float const* r1 = src + t.idx1[y] * 32;
+        for (int x = 0; x < 32; ++x)
+            dst[y * 32 + x] = r0[x] * t.w0[y] + r1[x] * t.w1[y];
+    }
+}
+
+void dct_scalar(float const* img, float* block)
+{
+    float rows[8][32]; // C[1..8] · img
+    for (int v = 0; v < 8; ++v) {
+        for (int x = 0; x < 32; ++x)
+            rows[v][x] = 0.f;
+        for (int y = 0; y < 32; ++y) {
+            float const cv = kDct.c[v][y];
+            float const* src = img + y * 32;
+            for (int x = 0; x < 32; ++x)
+                rows[v][x] += cv * src[x];
+        }
+    }
+    for (int v = 0; v < 8; ++v) {
+        for (int u = 0; u < 8; ++u) {
+            float acc = 0.f;
+            for (int x = 0; x < 32; ++x)
+                acc += rows[v][x] * kDct.c[u][x];
+            block[v * 8 + u] = acc;
+        }
+    }
+}
+
+void dct16_scalar(float const* img, float* block)
+{
+    float rows[16][32]; // C[1..16] · img
+    for (int v = 0; v < 16; ++v) {
+        for (int x = 0; x < 32; ++x)
+            rows[v][x] = 0.f;
+        for (int y = 0; y < 32; ++y) {
+            float const cv = kDct.c[v][y];
+            float const* src = img + y * 32;
+            for (int x = 0; x < 32; ++x)
+                rows[v][x] += cv * src[x];
+        }
+    }
+    for (int v = 0; v < 16; ++v) {
+        for (int u = 0; u < 16; ++u) {
+            float acc = 0.f;
+            for (int x = 0; x < 32; ++x)
+                acc += rows[v][x] * kDct.c[u][x];
+            block[v * 16 + u] = acc;
+        }
+    }
+}
+
+std::size_t hamming_scalar(std::uint64_t q, std::uint64_t const* h, std::size_t n,
+    unsigned maxDist, std::uint32_t* out)
+{
+    std::size_t k = 0;
+    for (std::size_t i = 0; i < n; ++i)
+        if (static_cast<unsigned>(std::popcount(q ^ h[i])) <= maxDist)
+            out[k++] = static_cast<std::uint32_t>(i);
+    return k;
+}
+
+std::size_t hamming128_scalar(std::uint64_t const* q, std::uint64_t const* h, std::size_t n,
+    unsigned maxDist, std::uint32_t* out)
+{
+    std::size_t k = 0;
+    for (std::size_t i = 0; i < n; ++i, h += 2) {
+        unsigned const d = std::popcount(q[0] ^ h[0]) + std::popcount(q[1] ^ h[1]);
+        if (d <= maxDist)
+            out[k++] = static_cast<std::uint32_t>(i);
+    }
+    return k;
+}
+
+std::size_t hamming256_scalar(std::uint64_t const* q, std::uint64_t const* h, std::size_t n,
+    unsigned maxDist, std::uint32_t* out)
+{
+    std::size_t k = 0;
+    for (std::size_t i = 0; i < n; ++i, h += 4) {
+        unsigned const d = std::popcount(q[0] ^ h[0]) + std::popcount(q[1] ^ h[1])
+            + std::popcount(q[2] ^ h[2]) + std::popcount(q[3] ^ h[3]);
+        if (d <= maxDist)
+            out[k++] = static_cast<std::uint32_t>(i);
+    }
+    return k;
+}
+
+void expand_scalar(std::uint8_t const* ctrl, std::size_t n, std::uint8_t const* data,
+    std::size_t, std::uint64_t* out)
+{
+    for (std::size_t i = 0; i < n; ++i) {
+        std::uint64_t w = 0;
+        for (unsigned m = ctrl[i]; m; m &= m - 1)
+            w |= std::uint64_t { *data++ } << (8 * std::countr_zero(m));
+        out[i] = w;
+    }
+}
+
+#if NDV_SIMD_X86
+// ---------------------------------------------------------------------
+// SSE4.2 (+POPCNT)
+// ---------------------------------------------------------------------
+NDV_TARGET("sse4.2")
+void cols32_sse42(float const* src, float* dst, Taps32 const& t)
+{
+    for (int y = 0; y < 32; ++y) {
+        float const* r0 = src + t.idx0[y] * 32;
+        float const* r1 = src + t.idx1[y] * 32;
+        __m128 const w0 = _mm_set1_ps(t.w0[y]);
+        __m128 const w1 = _mm_set1_ps(t.w1[y]);
+        for (int x = 0; x < 32; x += 4) {
+            __m128 v = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(r0 + x), w0),
+                _mm_mul_ps(_mm_loadu_ps(r1 + x), w1));
+            _mm_storeu_ps(dst + y * 32 + x, v);
+        }
+    }
+}
+
+NDV_TARGET("sse4.2")
+float hsum128(__m128 v)
+{
+    __m128 s = _mm_add_ps(v, _mm_movehl_ps(v, v));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    return _mm_cvtss_f32(s);
+}
+
+NDV_TARGET("sse4.2")
+void dct_sse42(float const* img, float* block)
+{
+    alignas(16) float rows[8][32];
+    for (int v = 0; v < 8; ++v) {
+        __m128 acc[8];
+        for (auto& a : acc)
+            a = _mm_setzero_ps();
+        for (int y = 0; y < 32; ++y) {
+            __m128 const cv = _mm_set1_ps(kDct.c[v][y]);
+            float const* src = img + y * 32;
+            for (int j = 0; j < 8; ++j)
+                acc[j] = _mm_add_ps(acc[j], _mm_mul_ps(cv, _mm_loadu_ps(src + 4 * j)));
+        }
+        for (int j = 0; j < 8; ++j)
+            _mm_store_ps(&rows[v][4 * j], acc[j]);
+    }
+    for (int v = 0; v < 8; ++v) {
+        for (int u = 0; u < 8; ++u) {
+            __m128 acc = _mm_setzero_ps();
+            for (int x = 0; x < 32; x += 4)
+                acc = _mm_add_ps(acc, _mm_mul_ps(_mm_load_ps(&rows[v][x]), _mm_load_ps(&kDct.c[u][x])));
+            block[v * 8 + u] = hsum128(acc);
+        }
+    }
+}
+
+NDV_TARGET("sse4.2,popcnt")
+std::size_t hamming_sse42(std::uint64_t q, std::uint64_t const* h, std::size_t n,
+    unsigned maxDist, std::uint32_t* out)
+{
+    std::size_t k = 0;
+    for (std::size_t i = 0; i < n; ++i)
+        if (static_cast<unsigned>(_mm_popcnt_u64(q ^ h[i])) <= maxDist)
+            out[k++] = static_cast<std::uint32_t>(i);
+    return k;
+}
+
+NDV_TARGET("sse4.2,popcnt")
+std::size_t hamming128_sse42(std::uint64_t const* q, std::uint64_t const* h, std::size_t n,
+    unsigned maxDist, std::uint32_t* out)
+{
+    std::size_t k = 0;
+    for (std::size_t i = 0; i < n; ++i, h += 2) {
+        auto const d = _mm_popcnt_u64(q[0] ^ h[0]) + _mm_popcnt_u64(q[1] ^ h[1]);
+        if (static_cast<unsigned>(d) <= maxDist)
+            out[k++] = static_cast<std::uint32_t>(i);
+    }
+    return k;
+}
+
+NDV_TARGET("sse4.2,popcnt")
+std::size_t hamming256_sse42(std::uint64_t const* q, std::uint64_t const* h, std::size_t n,
+    unsigned maxDist, std::uint32_t* out)
+{
+    std::size_t k = 0;
+    for (std::size_t i = 0; i < n; ++i, h += 4) {
+        auto const d = _mm_popcnt_u64(q[0] ^ h[0]) + _mm_popcnt_u64(q[1] ^ h[1])
+            + _mm_popcnt_u64(q[2] ^ h[2]) + _mm_popcnt_u64(q[3] ^ h[3]);
+        if (static_cast<unsigned>(d) <= maxDist)
+            out[k++] = static_cast<std::uint32_t>(i);
+    }
+    return k;
+}
+
+// Two words per step: one 16-byte load, the second word's shuffle offset
+// by the first's byte count (0x80 + 8 still has the zeroing bit set).
+NDV_TARGET("sse4.2,popcnt")
+void expand_sse42(std::uint8_t const* ctrl, std::size_t n, std::uint8_t const* data,
+    std::size_t dataLen, std::uint64_t* out)
+{
+    std::uint8_t const* const end = data + dataLen;
+    std::size_t i = 0;
+    for (; i + 2 <= n && end - data >= 16; i += 2) {
+        unsigned const c0 = ctrl[i], c1 = ctrl[i + 1];
+        int const n0 = _mm_popcnt_u32(c0);
+        __m128i const lo = _mm_loadl_epi64(reinterpret_cast<__m128i const*>(kExpand.s[c0]));
+        __m128i const hi = _mm_add_epi8(_mm_loadl_epi64(reinterpret_cast<__m128i const*>(kExpand.s[c1])),
+            _mm_set1_epi8(static_cast<char>(n0)));
+        __m128i const v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(data));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_shuffle_epi8(v, _mm_unpacklo_epi64(lo, hi)));
+        data += n0 + _mm_popcnt_u32(c1);
+    }
+    expand_scalar(ctrl + i, n - i, data, static_cast<std::size_t>(end - data), out + i);
+}
+
+// ---------------------------------------------------------------------
+// AVX2 + FMA
+// ---------------------------------------------------------------------
+NDV_TARGET("avx2,fma")
+void rows32_avx2(float const* src, int rows, int stride, float* dst, Taps32 const& t)
+{
+    for (int y = 0; y < rows; ++y) {
+        float const* row = src + static_cast<std::ptrdiff_t>(y) * stride;
+        float* out = dst + y * 32;
+        for (int d = 0; d < 32; d += 8) {
+            __m256i const i0 = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(t.idx0 + d));
+            __m256i const i1 = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(t.idx1 + d));
+            __m256 const p0 = _mm256_i32gather_ps(row, i0, 4);
+            __m256 const p1 = _mm256_i32gather_ps(row, i1, 4);
+            __m256 v = _mm256_fmadd_ps(p1, _mm256_loadu_ps(t.w1 + d),
+                _mm256_mul_ps(p0, _mm256_loadu_ps(t.w0 + d)));
+            _mm256_storeu_ps(out + d, v);
+        }
+    }
+}
+
+NDV_TARGET("avx2,fma")
+void cols32_avx2(float const* src, float* dst, Taps32 const& t)
+{
+    for (int y = 0; y < 32; ++y) {
+        float const* r0 = src + t.idx0[y] * 32;
+        float const* r1 = src + t.idx1[y] * 32;
+        __m256 const w0 = _mm256_set1_ps(t.w0[y]);
+        __m256 const w1 = _mm256_set1_ps(t.w1[y]);
+        for (int x = 0; x < 32; x += 8) {
+            __m256 v = _mm256_fmadd_ps(_mm256_loadu_ps(r1 + x), w1,
+                _mm256_mul_ps(_mm256_loadu_ps(r0 + x), w0));
+            _mm256_storeu_ps(dst + y * 32 + x, v);
+        }
+    }
+}
+
+NDV_TARGET("avx2,fma")
+float hsum256(__m256 v)
+{
+    __m128 s = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));
+    return _mm_cvtss_f32(s);
+}
+
+NDV_TARGET("avx2,fma")
+void dct_avx2(float const* img, float* block)
+{
+    alignas(32) float rows[8][32];
+    for (int v = 0; v < 8; ++v) {
+        __m256 a0 = _mm256_setzero_ps(), a1 = a0, a2 = a0, a3 = a0;
+        for (int y = 0; y < 32; ++y) {
+            __m256 const cv = _mm256_set1_ps(kDct.c[v][y]);
+            float const* src = img + y * 32;
+            a0 = _mm256_fmadd_ps(cv, _mm256_loadu_ps(src + 0), a0);
+            a1 = _mm256_fmadd_ps(cv, _mm256_loadu_ps(src + 8), a1);
+            a2 = _mm256_fmadd_ps(cv, _mm256_loadu_ps(src + 16), a2);
+            a3 = _mm256_fmadd_ps(cv, _mm256_loadu_ps(src + 24), a3);
+        }
+        _mm256_store_ps(&rows[v][0], a0);
+        _mm256_store_ps(&rows[v][8], a1);
+        _mm256_store_ps(&rows[v][16], a2);
+        _mm256_store_ps(&rows[v][24], a3);
+    }
+    for (int v = 0; v < 8; ++v) {
+        for (int u = 0; u < 8; ++u) {
+            __m256 acc = _mm256_mul_ps(_mm256_load_ps(&rows[v][0]), _mm256_load_ps(&kDct.c[u][0]));
+            for (int x = 8; x < 32; x += 8)
+                acc = _mm256_fmadd_ps(_mm256_load_ps(&rows[v][x]), _mm256_load_ps(&kDct.c[u][x]), acc);
+            block[v * 8 + u] = hsum256(acc);
+        }
+    }
+}
+
+// Nibble-LUT popcount of four 64-bit lanes (Muła et al.).
+NDV_TARGET("avx2")
+__m256i popcnt_epi64_avx2(__m256i v)
+{
+    __m256i const lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    __m256i const low = _mm256_set1_epi8(0x0f);
+    __m256i const lo = _mm256_shuffle_epi8(lut, _mm256_and_si256(v, low));
+    __m256i const hi = _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), low));
+    return _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256());
+}
+
+NDV_TARGET("avx2,popcnt")
+std::size_t hamming_avx2(std::uint64_t q, std::uint64_t const* h, std::size_t n,
+    unsigned maxDist, std::uint32_t* out)
+{
+    __m256i const qv = _mm256_set1_epi64x(static_cast<long long>(q));
+    __m256i const limit = _mm256_set1_epi64x(maxDist);
+    std::size_t k = 0, i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i const x = _mm256_xor_si256(qv, _mm256_loadu_si256(reinterpret_cast<__m256i const*>(h + i)));
+        __m256i const far = _mm256_cmpgt_epi64(popcnt_epi64_avx2(x), limit);
+        unsigned m = ~static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(far))) & 0xfu;
+        while (m) {
+            out[k++] = static_cast<std::uint32_t>(i + std::countr_zero(m));
+            m &= m - 1;
+        }
+    }
+    for (; i < n; ++i)
+        if (static_cast<unsigned>(_mm_popcnt_u64(q ^ h[i])) <= maxDist)
+            out[k++] = static_cast<std::uint32_t>(i);
+    return k;
+}
+
+NDV_TARGET("avx2,fma")
+void dct16_avx2(float const* img, float* block)
+{
+    alignas(32) float rows[16][32];
+    for (int v = 0; v < 16; ++v) {
+        __m256 a0 = _mm256_setzero_ps(), a1 = a0, a2 = a0, a3 = a0;
+        for (int y = 0; y < 32; ++y) {
+            __m256 const cv = _mm256_set1_ps(kDct.c[v][y]);
+            float const* src = img + y * 32;
+            a0 = _mm256_fmadd_ps(cv, _mm256_loadu_ps(src + 0), a0);
+            a1 = _mm256_fmadd_ps(cv, _mm256_loadu_ps(src + 8), a1);
+            a2 = _mm256_fmadd_ps(cv, _mm256_loadu_ps(src + 16), a2);
+            a3 = _mm256_fmadd_ps(cv, _mm256_loadu_ps(src + 24), a3);
+        }
+        _mm256_store_ps(&rows[v][0], a0);
+        _mm256_store_ps(&rows[v][8], a1);
+        _mm256_store_ps(&rows[v][16], a2);
+        _mm256_store_ps(&rows[v][24], a3);
+    }
+    for (int v = 0; v < 16; ++v) {
+        for (int u = 0; u < 16; ++u) {
+            __m256 acc = _mm256_mul_ps(_mm256_load_ps(&rows[v][0]), _mm256_load_ps(&kDct.c[u][0]));
+            for (int x = 8; x < 32; x += 8)
+                acc = _mm256_fmadd_ps(_mm256_load_ps(&rows[v][x]), _mm256_load_ps(&kDct.c[u][x]), acc);
+            block[v * 16 + u] = hsum256(acc);
+        }
+    }
+}
+
+// Lane i of the result is the number of set bits in hash i of the four
+// 128-bit hashes held by a (0, 1) and b (2, 3).
+NDV_TARGET("avx2")
+__m256i popcnt4x128_avx2(__m256i a, __m256i b)
+{
+    __m256i const pa = popcnt_epi64_avx2(a);
+    __m256i const pb = popcnt_epi64_avx2(b);
+    // (a0, b0, a1, b1) per hash pair → (h0, h2, h1, h3)
+    __m256i const t = _mm256_add_epi64(_mm256_unpacklo_epi64(pa, pb), _mm256_unpackhi_epi64(pa, pb));
+    return _mm256_permute4x64_epi64(t, _MM_SHUFFLE(3, 1, 2, 0));
+}
+
+// Collects the lanes of a 4 × 64-bit distance vector that are within limit.
+NDV_TARGET("avx2")
+std::size_t emit_within_avx2(__m256i dist, __m256i limit, std::size_t base,
+    std::uint32_t* out, std::size_t k)
+{
+    __m256i const far = _mm256_cmpgt_epi64(dist, limit);
+    unsigned m = ~static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(far))) & 0xfu;
+    while (m) {
+        out[k++] = static_cast<std::uint32_t>(base + std::countr_zero(m));
+        m &= m - 1;
+    }
+    return k;
+}
+
+NDV_TARGET("avx2,popcnt")
+std::size_t hamming128_avx2(std::uint64_t const* q, std::uint64_t const* h, std::size_t n,
+    unsigned maxDist, std::uint32_t* out)
+{
+    __m256i const qv = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<__m128i const*>(q)));
+    __m256i const limit = _mm256_set1_epi64x(maxDist);
+    std::size_t k = 0, i = 0;
+    for (; i + 4 <= n; i += 4) {
+        auto const* p = reinterpret_cast<__m256i const*>(h + 2 * i);
+        __m256i const a = _mm256_xor_si256(qv, _mm256_loadu_si256(p));
+        __m256i const b = _mm256_xor_si256(qv, _mm256_loadu_si256(p + 1));
+        k = emit_within_avx2(popcnt4x128_avx2(a, b), limit, i, out, k);
+    }
+    for (; i < n; ++i) {
+        auto const d = _mm_popcnt_u64(q[0] ^ h[2 * i]) + _mm_popcnt_u64(q[1] ^ h[2 * i + 1]);
+        if (static_cast<unsigned>(d) <= maxDist)
+            out[k++] = static_cast<std::uint32_t>(i);
+    }
+    return k;
+}
+
+NDV_TARGET("avx2,popcnt")
+std::size_t hamming256_avx2(std::uint64_t const* q, std::uint64_t const* h, std::size_t n,
+    unsigned maxDist, std::uint32_t* out)
+{
+    __m256i const qv = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(q));
+    __m256i const limit = _mm256_set1_epi64x(maxDist);
+    std::size_t k = 0, i = 0;
+    for (; i + 4 <= n; i += 4) {
+        auto const* p = reinterpret_cast<__m256i const*>(h + 4 * i);
+        __m256i const p0 = popcnt_epi64_avx2(_mm256_xor_si256(qv, _mm256_loadu_si256(p)));
+        __m256i const p1 = popcnt_epi64_avx2(_mm256_xor_si256(qv, _mm256_loadu_si256(p + 1)));
+        __m256i const p2 = popcnt_epi64_avx2(_mm256_xor_si256(qv, _mm256_loadu_si256(p + 2)));
+        __m256i const p3 = popcnt_epi64_avx2(_mm256_xor_si256(qv, _mm256_loadu_si256(p + 3)));
+        // pairwise sums within 128-bit halves, then fold the halves:
+        // lane i ends up as the total of hash i
+        __m256i const t01 = _mm256_add_epi64(_mm256_unpacklo_epi64(p0, p1), _mm256_unpackhi_epi64(p0, p1));
+        __m256i const t23 = _mm256_add_epi64(_mm256_unpacklo_epi64(p2, p3), _mm256_unpackhi_epi64(p2, p3));
+        __m256i const d = _mm256_add_epi64(_mm256_permute2x128_si256(t01, t23, 0x20),
+            _mm256_permute2x128_si256(t01, t23, 0x31));
+        k = emit_within_avx2(d, limit, i, out, k);
+    }
+    for (; i < n; ++i) {
+        std::uint64_t const* e = h + 4 * i;
+        auto const d = _mm_popcnt_u64(q[0] ^ e[0]) + _mm_popcnt_u64(q[1] ^ e[1])
+            + _mm_popcnt_u64(q[2] ^ e[2]) + _mm_popcnt_u64(q[3] ^ e[3]);
+        if (static_cast<unsigned>(d) <= maxDist)
+            out[k++] = static_cast<std::uint32_t>(i);
+    }
+    return k;
+}
+
+// ---------------------------------------------------------------------
+// AVX-512 (F; VPOPCNTDQ for the Hamming kernel, VBMI2 for the byte
+// expand when present)
+// ---------------------------------------------------------------------
+// GCC 12's AVX-512 headers build the "undefined" source operand of many
+// intrinsics from a self-initialised local, and -Wall then reports it at
+// every caller (GCC PR 105593, fixed in 13).  No kernel reads those lanes.
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ == 12
+#    pragma GCC diagnostic push
+#    pragma GCC diagnostic ignored "-Wuninitialized"
+#    pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+NDV_TARGET("avx512f")
+void rows32_avx512(float const* src, int rows, int stride, float* dst, Taps32 const& t)
+{
+    for (int y = 0; y < rows; ++y) {
+        float const* row = src + static_cast<std::ptrdiff_t>(y) * stride;
+        float* out = dst + y * 32;
+        for (int d = 0; d < 32; d += 16) {
+            __m512i const i0 = _mm512_loadu_si512(t.idx0 + d);
+            __m512i const i1 = _mm512_loadu_si512(t.idx1 + d);
+            __m512 const p0 = _mm512_i32gather_ps(i0, row, 4);
+            __m512 const p1 = _mm512_i32gather_ps(i1, row, 4);
+            __m512 v = _mm512_fmadd_ps(p1, _mm512_loadu_ps(t.w1 + d),
+                _mm512_mul_ps(p0, _mm512_loadu_ps(t.w0 + d)));
+            _mm512_storeu_ps(out + d, v);
+        }
+    }
+}
+
+NDV_TARGET("avx512f")
+void cols32_avx512(float const* src, float* dst, Taps32 const& t)
+{
+    for (int y = 0; y < 32; ++y) {
+        float const* r0 = src + t.idx0[y] * 32;
+        float const* r1 = src + t.idx1[y] * 32;
+        __m512 const w0 = _mm512_set1_ps(t.w0[y]);
+        __m512 const w1 = _mm512_set1_ps(t.w1[y]);
+        for (int x = 0; x < 32; x += 16) {
+            __m512 v = _mm512_fmadd_ps(_mm512_loadu_ps(r1 + x), w1,
+                _mm512_mul_ps(_mm512_loadu_ps(r0 + x), w0));
+            _mm512_storeu_ps(dst + y * 32 + x, v);
+        }
+    }
+}
+
+NDV_TARGET("avx512f")
+void dct_avx512(float const* img, float* block)
+{
+    alignas(64) float rows[8][32];
+    for (int v = 0; v < 8; ++v) {
+        __m512 a0 = _mm512_setzero_ps(), a1 = a0;
+        for (int y = 0; y < 32; ++y) {
+            __m512 const cv = _mm512_set1_ps(kDct.c[v][y]);
+            float const* src = img + y * 32;
+            a0 = _mm512_fmadd_ps(cv, _mm512_loadu_ps(src + 0), a0);
+            a1 = _mm512_fmadd_ps(cv, _mm512_loadu_ps(src + 16), a1);
+        }
+        _mm512_store_ps(&rows[v][0], a0);
+        _mm512_store_ps(&rows[v][16], a1);
+    }
+    for (int v = 0; v < 8; ++v) {
+        for (int u = 0; u < 8; ++u) {
+            __m512 acc = _mm512_mul_ps(_mm512_load_ps(&rows[v][0]), _mm512_load_ps(&kDct.c[u][0]));
+            acc = _mm512_fmadd_ps(_mm512_load_ps(&rows[v][16]), _mm512_load_ps(&kDct.c[u][16]), acc);
+            block[v * 8 + u] = _mm512_reduce_add_ps(acc);
+        }
+    }
+}
+
+NDV_TARGET("avx512f,avx512vpopcntdq,popcnt")
+std::size_t hamming_avx512(std::uint64_t q, std::uint64_t const* h, std::size_t n,
+    unsigned maxDist, std::uint32_t* out)
+{
+    __m512i const qv = _mm512_set1_epi64(static_cast<long long>(q));
+    __m512i const limit = _mm512_set1_epi64(maxDist);
+    std::size_t k = 0, i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m512i const x = _mm512_xor_si512(qv, _mm512_loadu_si512(h + i));
+        unsigned m = _mm512_cmple_epu64_mask(_mm512_popcnt_epi64(x), limit);
+        while (m) {
+            out[k++] = static_cast<std::uint32_t>(i + std::countr_zero(m));
+            m &= m - 1;
+        }
+    }
+    for (; i < n; ++i)
+        if (static_cast<unsigned>(_mm_popcnt_u64(q ^ h[i])) <= maxDist)
+            out[k++] = static_cast<std::uint32_t>(i);
+    return k;
+}
+NDV_TARGET("avx512f,avx512vpopcntdq,popcnt")
+std::size_t hamming128_avx512(std::uint64_t const* q, std::uint64_t const* h, std::size_t n,
+    unsigned maxDist, std::uint32_t* out)
+{
+    __m512i const qv = _mm512_broadcast_i32x4(_mm_loadu_si128(reinterpret_cast<__m128i const*>(q)));
+    __m512i const limit = _mm512_set1_epi64(maxDist);
+    std::size_t k = 0, i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m512i const p = _mm512_popcnt_epi64(_mm512_xor_si512(qv, _mm512_loadu_si512(h + 2 * i)));
+        // both words of each hash now hold its total
+        __m512i const d = _mm512_add_epi64(p, _mm512_shuffle_epi32(p, _MM_PERM_BADC));
+        unsigned m = _mm512_cmple_epu64_mask(d, limit) & 0x55u;
+        while (m) {
+            out[k++] = static_cast<std::uint32_t>(i + std::countr_zero(m) / 2);
+            m &= m - 1;
+        }
+    }
+    for (; i < n; ++i) {
+        auto const d = _mm_popcnt_u64(q[0] ^ h[2 * i]) + _mm_popcnt_u64(q[1] ^ h[2 * i + 1]);
+        if (static_cast<unsigned>(d) <= maxDist)
+            out[k++] = static_cast<std::uint32_t>(i);
+    }
+    return k;
+}
+
+NDV_TARGET("avx512f,avx512vpopcntdq,popcnt")
+std::size_t hamming256_avx512(std::uint64_t const* q, std::uint64_t const* h, std::size_t n,
+    unsigned maxDist, std::uint32_t* out)
+{
+    __m512i const qv = _mm512_broadcast_i64x4(_mm256_loadu_si256(reinterpret_cast<__m256i const*>(q)));
+    __m512i const limit = _mm512_set1_epi64(maxDist);
+    std::size_t k = 0, i = 0;
+    for (; i + 2 <= n; i += 2) {
+        __m512i const p = _mm512_popcnt_epi64(_mm512_xor_si512(qv, _mm512_loadu_si512(h + 4 * i)));
+        __m512i d = _mm512_add_epi64(p, _mm512_shuffle_epi32(p, _MM_PERM_BADC));
+        d = _mm512_add_epi64(d, _mm512_shuffle_i64x2(d, d, _MM_SHUFFLE(2, 3, 0, 1)));
+        unsigned const m = _mm512_cmple_epu64_mask(d, limit);
+        if (m & 0x01u)
+            out[k++] = static_cast<std::uint32_t>(i);
+        if (m & 0x10u)
+            out[k++] = static_cast<std::uint32_t>(i + 1);
+    }
+    for (; i < n; ++i) {
+        std::uint64_t const* e = h + 4 * i;
+        auto const d = _mm_popcnt_u64(q[0] ^ e[0]) + _mm_popcnt_u64(q[1] ^ e[1])
+            + _mm_popcnt_u64(q[2] ^ e[2]) + _mm_popcnt_u64(q[3] ^ e[3]);
+        if (static_cast<unsigned>(d) <= maxDist)
+            out[k++] = static_cast<std::uint32_t>(i);
+    }
+    return k;
+}
+
+// Eight words per step: the eight control bytes are exactly VPEXPANDB's
+// byte mask, and the masked load reads no byte past the packed ones.
+NDV_TARGET("avx512f,avx512bw,avx512vbmi2,popcnt")
+void expand_avx512(std::uint8_t const* ctrl, std::size_t n, std::uint8_t const* data,
+    std::size_t dataLen, std::uint64_t* out)
+{
+    std::uint8_t const* const end = data + dataLen;
+    std::size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        std::uint64_t m;
+        std::memcpy(&m, ctrl + i, sizeof m);
+        _mm512_storeu_si512(out + i, _mm512_maskz_expandloadu_epi8(m, data));
+        data += _mm_popcnt_u64(m);
+    }
+    expand_scalar(ctrl + i, n - i, data, static_cast<std::size_t>(end - data), out + i);
+}
+
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ == 12
+#    pragma GCC diagnostic pop
+#endif
+#endif // NDV_SIMD_X86
+
+// ---------------------------------------------------------------------
+// dispatch
+// ---------------------------------------------------------------------
+struct Kernels {
+    Isa isa = Isa::Scalar;
+    decltype(&rows32_scalar) rows32 = rows32_scalar;
+    decltype(&cols32_scalar) cols32 = cols32_scalar;
+    decltype(&dct_scalar) dct = dct_scalar;
+    decltype(&dct16_scalar) dct16 = dct16_scalar;
+    decltype(&hamming_scalar) hamming = hamming_scalar;
+    decltype(&hamming128_scalar) hamming128 = hamming128_scalar;
+    decltype(&hamming256_scalar) hamming256 = hamming256_scalar;
+    decltype(&expand_scalar) expand = expand_scalar;
+};
+
+Isa detect_isa()
+{
+#if NDV_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return Isa::Avx512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return Isa::Avx2;
+    if (__builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt"))
+        return Isa::Sse42;
+#endif
+    return Isa::Scalar;
+}
+
+// NDV_SIMD may only lower the level, never raise it past the hardware.
+Isa apply_env_cap(Isa detected)
+{
+    char const* env = std::getenv("NDV_SIMD");
+    if (!env || !*env)
+        return detected;
+
+    std::string_view const want = env;
+    Isa cap = detected;
+    if (want == "scalar")
+        cap = Isa::Scalar;
+    else if (want == "sse4.2" || want == "sse42")
+        cap = Isa::Sse42;
+    else if (want == "avx2")
+        cap = Isa::Avx2;
+    else if (want == "avx512")
+        cap = Isa::Avx512;
+    else
+        spdlog::warn("[simd] ignoring unknown NDV_SIMD value '{}'", want);
+
+    return cap < detected ? cap : detected;
+}
+
+Kernels kernels_for(Isa isa)
+{
+    Kernels k;
+    k.isa = isa;
+#if NDV_SIMD_X86
+    switch (isa) {
+    case Isa::Avx512:
+        k.rows32 = rows32_avx512;
+        k.cols32 = cols32_avx512;
+        k.dct = dct_avx512;
+        k.dct16 = dct16_avx2;
+        if (__builtin_cpu_supports("avx512vpopcntdq")) {
+            k.hamming = hamming_avx512;
+            k.hamming128 = hamming128_avx512;
+            k.hamming256 = hamming256_avx512;
+        } else {
+            k.hamming = hamming_avx2;
+            k.hamming128 = hamming128_avx2;
+            k.hamming256 = hamming256_avx2;
+        }
+        k.expand = __builtin_cpu_supports("avx512vbmi2") ? expand_avx512 : expand_sse42;
+        break;
+    case Isa::Avx2:
+        k.rows32 = rows32_avx2;
+        k.cols32 = cols32_avx2;
+        k.dct = dct_avx2;
+        k.dct16 = dct16_avx2;
+        k.hamming = hamming_avx2;
+        k.hamming128 = hamming128_avx2;
+        k.hamming256 = hamming256_avx2;
+        k.expand = expand_sse42;
+        break;
+    case Isa::Sse42:
+        k.cols32 = cols32_sse42;
+        k.dct = dct_sse42;
+        k.hamming = hamming_sse42;
+        k.hamming128 = hamming128_sse42;
+        k.hamming256 = hamming256_sse42;
+        k.expand = expand_sse42;
+        break;
+    case Isa::Scalar:
+        break;
+    }
+#endif
+    return k;
+}
+
+// One immutable table per level, so switching levels swaps a pointer and
+// a thread mid-call keeps the table it loaded.
+Kernels const& table_for(Isa isa)
+{
+    static std::array<Kernels, 4> const tables = [] {
+        detected_isa(); // CPUID before kernels_for asks about extensions
+        std::array<Kernels, 4> t;
+        for (std::size_t i = 0; i < t.size(); ++i)
+            t[i] = kernels_for(static_cast<Isa>(i));
+        return t;
+    }();
+    return tables[static_cast<std::size_t>(isa)];
+}
+
+Kernels const* select_kernels()
+{
+    Isa const detected = detected_isa();
+    Kernels const& k = table_for(apply_env_cap(detected));
+
+    if (k.isa != detected)
+        spdlog::info("[simd] using {} kernels (CPU supports {}, capped by NDV_SIMD)",
+            isa_name(k.isa), isa_name(detected));
+    else
+        spdlog::info("[simd] using {} kernels", isa_name(k.isa));
+    return &k;
+}
+
+std::atomic<Kernels const*>& active_kernels()
+{
+    static std::atomic<Kernels const*> k { select_kernels() };
+    return k;
+}
+
+Kernels const& kernels()
+{
+    return *active_kernels().load(std::memory_order_acquire);
+}
+
+} // namespace
+
+Isa active_isa() { return kernels().isa; }
+
+Isa detected_isa()
+{
+    static Isa const isa = detect_isa();
+    return isa;
+}
+
+bool force_isa(Isa isa)
+{
+    if (isa > detected_isa())
+        return false;
+    active_kernels().store(&table_for(isa), std::memory_order_release);
+    return true;
+}
+
+char const* isa_name(Isa isa)
+{
+    switch (isa) {
+    case Isa::Scalar:
+        return "scalar";
+    case Isa::Sse42:
+        return "SSE4.2";
+    case Isa::Avx2:
+        return "AVX2";
+    case Isa::Avx512:
+        return "AVX-512";
+    }
+    return "?";
+}
+
+void resample_rows32(float const* src, int rows, int srcStride, float* dst, Taps32 const& tx)
+{
+    kernels().rows32(src, rows, srcStride, dst, tx);
+}
+
+void resample_cols32(float const* src, float* dst, Taps32 const& ty)
+{
+    kernels().cols32(src, dst, ty);
+}
+
+void dct_low8x8(float const* img32, float* block)
+{
+    kernels().dct(img32, block);
+}
+
+void dct_low16x16(float const* img32, float* block)
+{
+    kernels().dct16(img32, block);
+}
+
+std::size_t hamming_within(std::uint64_t query, std::uint64_t const* hashes,
+    std::size_t n, unsigned maxDist, std::uint32_t* outIdx)
+{
+    return kernels().hamming(query, hashes, n, maxDist, outIdx);
+}
+
+std::size_t hamming_within128(std::uint64_t const* query, std::uint64_t const* hashes,
+    std::size_t n, unsigned maxDist, std::uint32_t* outIdx)
+{
+    return kernels().hamming128(query, hashes, n, maxDist, outIdx);
+}
+
+std::size_t hamming_within256(std::uint64_t const* query, std::uint64_t const* hashes,
+    std::size_t n, unsigned maxDist, std::uint32_t* outIdx)
+{
+    return kernels().hamming256(query, hashes, n, maxDist, outIdx);
+}
+
+void expand_nonzero_bytes(std::uint8_t const* ctrl, std::size_t n,
+    std::uint8_t const* data, std::size_t dataLen, std::uint64_t* out)
+{
+    kernels().expand(ctrl, n, data, dataLen, out);
+}
+
+} // namespace simd
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Hot loops of the hashing / matching pipeline, built once per ISA level
+// (scalar, SSE4.2, AVX2+FMA, AVX-512) with per-function target attributes
+// so the binary does not need -march.  The best level the CPU supports is
+// picked through CPUID on first use and logged; NDV_SIMD=scalar|sse4.2|
+// avx2|avx512 in the environment caps it (for A/B runs and bug reports).
+namespace simd {
+
+enum class Isa : std::uint8_t {
+    Scalar,
+    Sse42,
+    Avx2,
+    Avx512
+};
+
+Isa active_isa();
+Isa detected_isa(); // best level the CPU supports, ignoring NDV_SIMD
+char const* isa_name(Isa isa);
+
+// Switch every kernel to `isa` (false if the CPU lacks it).  For
+// verification tools; calls already running finish on the old kernels.
+bool force_isa(Isa isa);
+
+// Coefficients of a separable 2-tap resampler to 32 outputs: output d is
+// src[idx0[d]] * w0[d] + src[idx1[d]] * w1[d].
+struct Taps32 {
+    int idx0[32];
+    int idx1[32];
+    float w0[32];
+    float w1[32];
+};
+
+// Horizontal pass: rows × srcStride floats → rows × 32 floats.
+void resample_rows32(float const* src, int rows, int srcStride,
+    float* dst, Taps32 const& tx);
+
+// Vertical pass: (any height) × 32 floats → 32 × 32 floats.
+void resample_cols32(float const* src, float* dst, Taps32 const& ty);
+
+// Rows/cols 1..8 of the 32×32 DCT-II of a row-major 32×32 image, written
+// row-major (horizontal frequency fastest) into block[64].
+void dct_low8x8(float const* img32, float* block);
+
+// Rows/cols 1..16 of the same DCT into block[256] (for the 128/256-bit
+// hashes).
+void dct_low16x16(float const* img32, float* block);
+
+// Writes the indices of hashes[i] within maxDist bits of query to outIdx
+// (which must have room for n entries) and returns how many there were.
+std::size_t hamming_within(std::uint64_t query, std::uint64_t const* hashes,
+    std::size_t n, unsigned maxDist, std::uint32_t* outIdx);
+
+// The same for 128- and 256-bit hashes: query and every entry of hashes
+// are 2 (resp. 4) consecutive words, and the distance is over all of them.
+std::size_t hamming_within128(std::uint64_t const* query, std::uint64_t const* hashes,
+    std::size_t n, unsigned maxDist, std::uint32_t* outIdx);
+std::size_t hamming_within256(std::uint64_t const* query, std::uint64_t const* hashes,
+    std::size_t n, unsigned maxDist, std::uint32_t* outIdx);
+
+// Inverse of packing each word's non-zero bytes (HashBlob.h): bit b of
+// ctrl[i] says whether byte b of out[i] is the next byte of data or zero.
+// data must hold exactly the popcount of ctrl[0..n) bytes (dataLen).
+void expand_nonzero_bytes(std::uint8_t const* ctrl, std::size_t n,
+    std::uint8_t const* data, std::size_t dataLen, std::uint64_t* out);
+
+} // namespace simd
@@ -1,4 +1,7 @@
 #include "SlowVideoProcessor.h"
+#include "DecodeProfile.h"
+#include "KeyframeIndex.h"
+#include "SpriteSheet.h"
 #include "Hash.h"
 #include "VideoProcessingUtils.h"
 
@@ -23,11 +26,49 @@ extern "C" {
         }                                                              \
     } while (false)
 
+// TilePool implementation
+void TileReturner::operator()(LumaTile* t) const noexcept
+{
+    if (!t)
+        return;
+    if (pool)
+        pool->release(t);
+    else
+        delete t;
+}
+
+TilePtr TilePool::acquire()
+{
+    {
+        std::lock_guard lk(m_);
+        if (!free_.empty()) {
+            LumaTile* t = free_.back().release();
+            free_.pop_back();
+            return TilePtr { t, TileReturner { this } };
+        }
+    }
+    return TilePtr { new LumaTile, TileReturner { this } };
+}
+
+void TilePool::release(LumaTile* t) noexcept
+{
+    std::unique_ptr<LumaTile> owned { t };
+    try {
+        std::lock_guard lk(m_);
+        free_.push_back(std::move(owned));
+    } catch (...) {
+        // out of memory growing the free list – just drop the tile
+    }
+}
+
 // HashPool implementation
-HashPool::HashPool(std::size_t nWorkers, BoundedQueue<FrmPtr>& q,
-    std::vector<uint64_t>& outHashes, std::atomic_bool& fatal)
+HashPool::HashPool(std::size_t nWorkers, MpmcRing<TilePtr>& q,
+    std::vector<uint64_t>& outHashes, bool withVariants,
+    unsigned hashBits, std::atomic_bool& fatal)
     : q_(q)
     , hashes_(outHashes)
+    , withVariants_(withVariants)
+    , hashBits_(hashBits)
     , fatal_(fatal)
 {
     for (std::size_t i = 0; i < nWorkers; ++i) {
@@ -37,24 +78,32 @@ HashPool::HashPool(std::size_t nWorkers, BoundedQueue<FrmPtr>& q,
 
 HashPool::~HashPool() = default;
 
+void HashPool::join()
+{
+    for (auto& w : workers_)
+        if (w.joinable())
+            w.join();
+}
+
 void HashPool::worker_loop(std::stop_token tk)
 {
-    thread_local std::vector<uint8_t> scratch;
-
-    while (!tk.stop_requested()) {
-        FrmPtr frame;
-        if (!q_.pop(frame, tk))
-            break; // cancelled
-        if (!frame)
-            break; // poison pill
-
-        bool local_fatal = false;
-        if (auto h = vpu::hash_frame(frame.get(), scratch, local_fatal)) {
-            hashes_.push_back(*h);
-        }
-        if (local_fatal) {
-            fatal_.store(true, std::memory_order_relaxed);
-            break;
+    constexpr std::size_t kBatch = 4;
+    TilePtr batch[kBatch];
+
+    while (std::size_t const n = q_.pop_bulk(batch, kBatch, tk)) {
+        for (std::size_t i = 0; i < n; ++i) {
+            bool local_fatal = false;
+            if (auto h = vpu::hash_tile(batch[i]->data(), local_fatal, hashBits_)) {
+                // a frame's variants must stay contiguous
+                std::lock_guard lk(hashesMtx_);
+                append_phash(hashes_, *h, withVariants_);
+            }
+            batch[i].reset(); // back to the pool
+            if (local_fatal) {
+                fatal_.store(true, std::memory_order_relaxed);
+                q_.close(); // unblock the decoder
+                return;
+            }
         }
     }
 }
@@ -68,30 +117,38 @@ SlowVideoProcessor::decodeAndHash(VideoInfo const& info, SearchSettings const& c
     }
 
     constexpr std::size_t kQueueCap = 64;
-    BoundedQueue<FrmPtr> frameQ { kQueueCap };
+    TilePool tiles; // declared first: queued tiles return to it on teardown
+    MpmcRing<TilePtr> tileQ { kQueueCap };
     std::vector<uint64_t> hashes;
-    hashes.reserve(cfg.slowHash.maxFrames);
+    hashes.reserve(std::min<std::size_t>(cfg.slowHash.maxFrames, info.duration + 1)
+        * (cfg.matchFlipsRotations ? kPHashOrientations : 1));
     std::atomic_bool fatal { false };
+    std::exception_ptr overBudget;
 
     // Hash workers
     std::size_t const poolSize = std::max(1u, std::thread::hardware_concurrency() - 2u);
-    HashPool pool { poolSize, frameQ, hashes, fatal };
+    HashPool pool { poolSize, tileQ, hashes, cfg.matchFlipsRotations, cfg.hashBits, fatal };
 
     // Demux + decode thread
     std::jthread ddThr([&](std::stop_token tk) {
         try {
-            demux_decode_loop(info, cfg, tk, frameQ, fatal);
+            demux_decode_loop(info, cfg, tk, tiles, tileQ, fatal);
+        } catch (vpu::BudgetExceeded const&) {
+            overBudget = std::current_exception();
+            fatal = true;
         } catch (std::exception const& e) {
             spdlog::error("[hasher] demux/decode fatal: {}", e.what());
             fatal = true;
         }
     });
 
-    // Wait for demux thread to finish then stop workers
+    // Wait for demux thread to finish, then let the workers drain the queue
     ddThr.join();
-    for (std::size_t i = 0; i < poolSize; ++i)
-        frameQ.push(nullptr, std::stop_token {}); // poison pills
+    tileQ.close();
+    pool.join();
 
+    if (overBudget)
+        std::rethrow_exception(overBudget);
     if (fatal) {
         spdlog::error("[hasher] Aborted – {} hashes produced", hashes.size());
         hashes.clear();
@@ -102,9 +159,21 @@ SlowVideoProcessor::decodeAndHash(VideoInfo const& info, SearchSettings const& c
 void SlowVideoProcessor::demux_decode_loop(VideoInfo const& info,
     SearchSettings const& cfg,
     std::stop_token tk,
-    BoundedQueue<FrmPtr>& frameQ,
+    TilePool& tiles,
+    MpmcRing<TilePtr>& tileQ,
     std::atomic_bool& fatal)
 {
+    auto budget = vpu::DecodeBudget::for_file(cfg.fileTimeBudgetSec, cfg.fileReadBudgetPct, info.size);
+
+    // Every FFmpeg failure below may really be the budget interrupting a read.
+    auto check = [&](int rc, char const* what) {
+        if (rc >= 0)
+            return;
+        budget.throw_if_exceeded();
+        spdlog::error("{} failed: {}", what, vpu::err2str(rc));
+        throw std::runtime_error("FFmpeg call failed");
+    };
+
     // Open container
     FmtPtr fmt;
     {
@@ -112,17 +181,22 @@ void SlowVideoProcessor::demux_decode_loop(VideoInfo const& info,
         av_dict_set_int(&opts, "probesize", 10 * 1024 * 1024, 0);
         av_dict_set_int(&opts, "analyzeduration", 10'000'000, 0);
         AVFormatContext* raw = nullptr;
-        AVCHECK(avformat_open_input(&raw, info.path.c_str(), nullptr, &opts));
-        fmt.reset(raw);
+        int rc = budget.open_input(raw, info.path.c_str(), &opts);
         av_dict_free(&opts);
+        check(rc, "avformat_open_input");
+        fmt.reset(raw);
     }
-    AVCHECK(avformat_find_stream_info(fmt.get(), nullptr));
+    budget.enter("probe");
+    check(avformat_find_stream_info(fmt.get(), nullptr), "avformat_find_stream_info");
 
     int vStream = av_find_best_stream(fmt.get(), AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
     if (vStream < 0)
         throw std::runtime_error("No video stream");
     AVStream* st = fmt->streams[vStream];
 
+    // The slow pass reads every packet, so it sees every keyframe.
+    KeyframeIndex* keyframes = info.keyframes.get();
+
     // Setup PTS tracking
     int64_t const stepPts = vpu::sec_to_pts(kSamplePeriodSec, st->time_base);
     int64_t nextPts = 0;
@@ -146,6 +220,15 @@ void SlowVideoProcessor::demux_decode_loop(VideoInfo const& info,
     }
     decCtx->skip_loop_filter = AVDISCARD_ALL;
     decCtx->flags2 |= AV_CODEC_FLAG2_FAST;
+    // Hover-scrub tiles come from the frames sampled for hashing
+    std::optional<SpriteSheetBuilder> sprite;
+    if (cfg.slowHash.spriteIntervalSec > 0)
+        sprite.emplace(cfg.slowHash.spriteIntervalSec, static_cast<double>(info.duration), st->time_base);
+
+    // A sprite sheet is shown to the user, so its frames decode at full
+    // quality: in colour, at full size and with every B-frame's residual.
+    if (cfg.reducedDecode && !sprite)
+        decode::apply_profile(decCtx.get(), dec, decode::profile_for(dec));
 
     AVCHECK(avcodec_open2(decCtx.get(), dec, nullptr));
     spdlog::info("Decoder threads {} (mode = {})", decCtx->thread_count,
@@ -176,12 +259,19 @@ void SlowVideoProcessor::demux_decode_loop(VideoInfo const& info,
                 ? frm.get()->pts
                 : frm.get()->best_effort_timestamp;
 
-            // Only process frame if it's time for a sample
+            // Only process frame if it's time for a sample.  Reduce it to a
+            // luma tile here so the decoder gets its surface back right away.
             if (vpu::sample_due(pts, nextPts)) {
-                FrmPtr clone { av_frame_clone(frm.get()) };
-                if (!frameQ.push(std::move(clone), tk)) {
-                    fatal = true;
-                    return;
+                if (sprite && sprite->due(pts))
+                    sprite->add(frm.get(), pts);
+                TilePtr tile = tiles.acquire();
+                if (vpu::extract_luma_tile(frm.get(), tile->data(), cfg.toneMapHdr)) {
+                    if (!tileQ.push(std::move(tile), tk)) {
+                        fatal = true;
+                        return;
+                    }
+                } else {
+                    spdlog::warn("[hasher] luma extraction failed at pts {}", pts);
                 }
                 nextPts += stepPts;
             }
@@ -189,10 +279,14 @@ void SlowVideoProcessor::demux_decode_loop(VideoInfo const& info,
         }
     };
 
+    budget.enter("decode");
     while (!tk.stop_requested() && !fatal) {
         if (av_read_frame(fmt.get(), pkt.get()) >= 0) {
-            if (pkt->stream_index == vStream)
+            if (pkt->stream_index == vStream) {
+                if (keyframes)
+                    keyframes->observe(fmt.get(), pkt.get());
                 send_pkt(pkt.get());
+            }
             av_packet_unref(pkt.get());
         } else {
             send_pkt(nullptr);
@@ -201,4 +295,10 @@ void SlowVideoProcessor::demux_decode_loop(VideoInfo const& info,
         }
         receive_frames();
     }
+    // a read cut short by the interrupt callback looks like EOF
+    budget.throw_if_exceeded();
+    if (keyframes)
+        keyframes->capture(fmt.get(), vStream);
+    if (sprite && !fatal)
+        sprite->save(info.path);
 }
@@ -1,15 +1,17 @@
 #pragma once
 
+#include "Hash.h"
 #include "IVideoProcessor.h"
+#include "MpmcRing.h"
 #include "SearchSettings.h"
 #include "VideoInfo.h"
+#include <array>
 #include <atomic>
-#include <condition_variable>
-#include <deque>
 #include <memory>
 #include <mutex>
 #include <stop_token>
 #include <thread>
+#include <vector>
 
 extern "C" {
 #include <libavcodec/avcodec.h>
@@ -34,52 +36,52 @@ using CtxPtr = std::unique_ptr<AVCodecContext, AvDeleter<&avcodec_free_context>>
 using FrmPtr = std::unique_ptr<AVFrame, AvDeleter<&av_frame_free>>;
 using PktPtr = std::unique_ptr<AVPacket, AvDeleter<&av_packet_free>>;
 
-// Thread-safe bounded queue
-template<class T>
-class BoundedQueue {
+// Downscaled luma of one sampled frame; the only thing that crosses from
+// the decode thread to the hash workers.
+using LumaTile = std::array<uint8_t, kPHashTile * kPHashTile>;
+
+class TilePool;
+
+struct TileReturner {
+    TilePool* pool = nullptr;
+    void operator()(LumaTile* t) const noexcept;
+};
+using TilePtr = std::unique_ptr<LumaTile, TileReturner>;
+
+// Free list of tiles so steady-state sampling does not allocate.  Must
+// outlive every TilePtr it hands out.
+class TilePool {
 public:
-    explicit BoundedQueue(std::size_t cap) : cap_(cap) {}
-
-    bool push(T&& v, std::stop_token const& tk) {
-        std::unique_lock lk(m_);
-        cv_not_full_.wait(lk, [&] { return q_.size() < cap_ || tk.stop_requested(); });
-        if (tk.stop_requested())
-            return false;
-        q_.emplace_back(std::move(v));
-        cv_not_empty_.notify_one();
-        return true;
-    }
-
-    bool pop(T& out, std::stop_token const& tk) {
-        std::unique_lock lk(m_);
-        cv_not_empty_.wait(lk, [&] { return !q_.empty() || tk.stop_requested(); });
-        if (tk.stop_requested())
-            return false;
-        out = std::move(q_.front());
-        q_.pop_front();
-        cv_not_full_.notify_one();
-        return true;
-    }
+    TilePtr acquire();
 
 private:
+    friend struct TileReturner;
+    void release(LumaTile* t) noexcept;
+
     std::mutex m_;
-    std::condition_variable cv_not_empty_, cv_not_full_;
-    std::deque<T> q_;
-    std::size_t const cap_;
+    std::vector<std::unique_ptr<LumaTile>> free_;
 };
 
-// Thread pool for parallel frame hashing
+// Thread pool for parallel frame hashing.  Workers run until the queue is
+// closed and drained (or they are stopped).
 class HashPool {
 public:
-    HashPool(std::size_t nWorkers, BoundedQueue<FrmPtr>& q,
-             std::vector<uint64_t>& outHashes, std::atomic_bool& fatal);
+    HashPool(std::size_t nWorkers, MpmcRing<TilePtr>& q,
+             std::vector<uint64_t>& outHashes, bool withVariants,
+             unsigned hashBits, std::atomic_bool& fatal);
     ~HashPool();
 
+    // Wait for the workers to drain the queue; call after closing it.
+    void join();
+
 private:
     void worker_loop(std::stop_token tk);
 
-    BoundedQueue<FrmPtr>& q_;
+    MpmcRing<TilePtr>& q_;
     std::vector<uint64_t>& hashes_;
+    std::mutex hashesMtx_;
+    bool const withVariants_;
+    unsigned const hashBits_;
     std::atomic_bool& fatal_;
     std::vector<std::jthread> workers_;
 };
@@ -94,6 +96,7 @@ private:
     void demux_decode_loop(VideoInfo const& info,
                           SearchSettings const& cfg,
                           std::stop_token tk,
-                          BoundedQueue<FrmPtr>& frameQ,
+                          TilePool& tiles,
+                          MpmcRing<TilePtr>& tileQ,
                           std::atomic_bool& fatal);
 };
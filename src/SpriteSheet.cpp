@@ -0,0 +1,95 @@
+#include "SpriteSheet.h"
+#include "Thumbnail.h"
+#include "VideoProcessingUtils.h"
+
+#include <QDir>
+#include <QFileInfo>
+
+#include <algorithm>
+#include <cmath>
+
+extern "C" {
+#include <libavutil/frame.h>
+#include <libswscale/swscale.h>
+}
+
+void SpriteSheetBuilder::SwsFree::operator()(SwsContext* c) const noexcept
+{
+    sws_freeContext(c);
+}
+
+SpriteSheetBuilder::SpriteSheetBuilder(int intervalSec, double durationSec, AVRational timeBase)
+{
+    double interval = std::max(intervalSec, 1);
+    if (durationSec > 0.0)
+        interval = std::max(interval, std::ceil(durationSec / kMaxSpriteTiles));
+    stepPts_ = std::max<std::int64_t>(vpu::sec_to_pts(interval, timeBase), 1);
+    capacity_ = durationSec > 0.0
+        ? std::clamp(static_cast<int>(durationSec / interval) + 1, 1, kMaxSpriteTiles)
+        : kMaxSpriteTiles;
+    strip_ = QImage(capacity_ * kSpriteTileW, kSpriteTileH, QImage::Format_RGB888);
+    strip_.fill(Qt::black);
+}
+
+SpriteSheetBuilder::~SpriteSheetBuilder() = default;
+
+bool SpriteSheetBuilder::due(std::int64_t pts) const
+{
+    return tiles_ < capacity_ && pts != AV_NOPTS_VALUE && pts >= nextPts_;
+}
+
+void SpriteSheetBuilder::add(AVFrame const* frame, std::int64_t pts)
+{
+    if (!due(pts) || frame->hw_frames_ctx || frame->width <= 0 || frame->height <= 0)
+        return;
+
+    // letterbox: fit the frame into the tile, keeping its aspect
+    double const scale = std::min(static_cast<double>(kSpriteTileW) / frame->width,
+        static_cast<double>(kSpriteTileH) / frame->height);
+    int const w = std::clamp(static_cast<int>(std::lround(frame->width * scale)), 2, kSpriteTileW);
+    int const h = std::clamp(static_cast<int>(std::lround(frame->height * scale)), 2, kSpriteTileH);
+
+    sws_.reset(sws_getCachedContext(sws_.release(), frame->width, frame->height,
+        static_cast<AVPixelFormat>(frame->format), w, h, AV_PIX_FMT_RGB24,
+        SWS_BILINEAR, nullptr, nullptr, nullptr));
+    if (!sws_)
+        return;
+
+    // scale straight into the strip
+    int const x = tiles_ * kSpriteTileW + (kSpriteTileW - w) / 2;
+    int const y = (kSpriteTileH - h) / 2;
+    std::uint8_t* dst[4] = { strip_.scanLine(y) + 3 * x, nullptr, nullptr, nullptr };
+    int const dstStride[4] = { static_cast<int>(strip_.bytesPerLine()), 0, 0, 0 };
+    if (sws_scale(sws_.get(), frame->data, frame->linesize, 0, frame->height, dst, dstStride) <= 0)
+        return;
+
+    ++tiles_;
+    nextPts_ = pts + stepPts_;
+}
+
+bool SpriteSheetBuilder::save(std::string const& videoPath) const
+{
+    if (tiles_ == 0)
+        return false;
+    QString const path = sprite_sheet_path(videoPath);
+    QDir const dir = QFileInfo(path).dir();
+    if (!dir.exists() && !dir.mkpath(".")) {
+        spdlog::error("[sprite] Failed to create directory: {}", dir.absolutePath().toStdString());
+        return false;
+    }
+    if (!strip_.copy(0, 0, tiles_ * kSpriteTileW, kSpriteTileH).save(path, "JPEG", 80)) {
+        spdlog::warn("[sprite] Could not write '{}'", path.toStdString());
+        return false;
+    }
+    spdlog::info("[sprite] {} tiles for '{}'", tiles_, videoPath);
+    return true;
+}
+
+QImage sprite_tile(QImage const& sheet, double fraction)
+{
+    int const n = sheet.width() / kSpriteTileW;
+    if (sheet.isNull() || n == 0)
+        return {};
+    int const i = std::clamp(static_cast<int>(fraction * n), 0, n - 1);
+    return sheet.copy(i * kSpriteTileW, 0, kSpriteTileW, sheet.height());
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <QImage>
+#include <QString>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+extern "C" {
+#include <libavutil/rational.h>
+}
+
+struct AVFrame;
+struct SwsContext;
+
+// Hover-scrub preview of one video: a strip of colour tiles, one every few
+// seconds, taken from the frames the slow hasher decodes anyway and saved
+// next to the video's thumbnails (sprite_sheet_path).  Tiles are
+// kSpriteTileW × kSpriteTileH, letterboxed, left to right in playback
+// order and evenly spaced, so the tile count is the strip width over
+// kSpriteTileW and tile i of n shows the video at (i + 0.5) / n of its
+// length, roughly.
+constexpr int kSpriteTileW = 160;
+constexpr int kSpriteTileH = 90;
+constexpr int kMaxSpriteTiles = 120; // longer videos space their tiles out
+
+class SpriteSheetBuilder {
+public:
+    // A tile every intervalSec (more on long videos, see kMaxSpriteTiles)
+    // of a stream with the given time base.
+    SpriteSheetBuilder(int intervalSec, double durationSec, AVRational timeBase);
+    ~SpriteSheetBuilder();
+
+    SpriteSheetBuilder(SpriteSheetBuilder const&) = delete;
+    SpriteSheetBuilder& operator=(SpriteSheetBuilder const&) = delete;
+
+    // Whether a decoded frame at `pts` should become the next tile.
+    bool due(std::int64_t pts) const;
+
+    // Scale the (software) frame into the next tile.
+    void add(AVFrame const* frame, std::int64_t pts);
+
+    int tiles() const { return tiles_; }
+
+    // Write the strip to sprite_sheet_path(videoPath); false if it has no
+    // tiles or could not be written.
+    bool save(std::string const& videoPath) const;
+
+private:
+    struct SwsFree {
+        void operator()(SwsContext* c) const noexcept;
+    };
+
+    std::int64_t stepPts_;
+    std::int64_t nextPts_ = 0;
+    int capacity_;
+    int tiles_ = 0;
+    QImage strip_;
+    std::unique_ptr<SwsContext, SwsFree> sws_;
+};
+
+// The strip's tile nearest to `fraction` (0-1) of the video; null if the
+// sheet is.
+QImage sprite_tile(QImage const& sheet, double fraction);
@@ -0,0 +1,49 @@
+#include "StringPool.h"
+
+#include <mutex>
+#include <unordered_set>
+
+namespace {
+
+struct Hash {
+    using is_transparent = void;
+    std::size_t operator()(std::string_view s) const noexcept { return std::hash<std::string_view> {}(s); }
+};
+
+struct Pool {
+    std::mutex mutex;
+    // node-based: an element's address never changes
+    std::unordered_set<std::string, Hash, std::equal_to<>> strings;
+};
+
+Pool& pool()
+{
+    static Pool p;
+    return p;
+}
+
+std::string const& empty_string()
+{
+    static std::string const s;
+    return s;
+}
+
+} // namespace
+
+InternedString::InternedString() noexcept
+    : s_(&empty_string())
+{
+}
+
+InternedString::InternedString(std::string_view s)
+    : s_(&empty_string())
+{
+    if (s.empty())
+        return;
+    Pool& p = pool();
+    std::lock_guard lock(p.mutex);
+    auto it = p.strings.find(s);
+    if (it == p.strings.end())
+        it = p.strings.emplace(s).first;
+    s_ = &*it;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+// A string kept once in a process-wide pool and referred to by address.
+// VideoInfo's codec names, pixel formats and profiles repeat a few dozen
+// values across a whole library; as InternedStrings each field is one
+// pointer instead of a std::string, copying a VideoInfo allocates nothing
+// for them, and equality is a pointer compare.  Pooled strings live until
+// exit.  Interning takes a lock; reading does not.
+class InternedString {
+public:
+    InternedString() noexcept;
+    InternedString(std::string_view s);
+    InternedString(std::string const& s)
+        : InternedString(std::string_view(s))
+    {
+    }
+    InternedString(char const* s) // null is ""
+        : InternedString(std::string_view(s ? s : ""))
+    {
+    }
+
+    std::string const& str() const noexcept { return *s_; }
+    char const* c_str() const noexcept { return s_->c_str(); }
+    bool empty() const noexcept { return s_->empty(); }
+
+    operator std::string const&() const noexcept { return *s_; }
+    operator std::string_view() const noexcept { return *s_; }
+
+    friend bool operator==(InternedString a, InternedString b) noexcept { return a.s_ == b.s_; }
+
+private:
+    std::string const* s_;
+};
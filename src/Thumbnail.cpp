@@ -1,4 +1,5 @@
 #include "Thumbnail.h"
+#include "KeyframeIndex.h"
 #include "VideoInfo.h"
 
 #include <QCryptographicHash>
@@ -75,6 +76,13 @@ inline bool copyFrameToImage(AVFrame const* frame, QImage& image, int width, int
 
 } // namespace
 
+QString sprite_sheet_path(std::string const& videoPath)
+{
+    QString const file = QString::fromStdString(videoPath);
+    return QDir(QDir::current().filePath("thumbnails"))
+        .filePath(QFileInfo(file).baseName() + "_" + hashPath(file).left(8) + "_sprite.jpg");
+}
+
 std::optional<std::vector<QString>>
 extract_color_thumbnails(VideoInfo const& info,
     int thumbnailsToGenerate)
@@ -176,6 +184,9 @@ extract_color_thumbnails(VideoInfo const& info,
         }
 
         AVStream* vStream = fmtCtx->streams[videoStreamIdx];
+        KeyframeIndex* keyframes = info.keyframes.get();
+        if (keyframes)
+            keyframes->prime(fmtCtx.get(), videoStreamIdx);
         if (!vStream) {
             spdlog::error("[Thumbnail] Stream pointer is null after lookup");
             return std::nullopt;
@@ -283,11 +294,10 @@ extract_color_thumbnails(VideoInfo const& info,
             bool gotFrameForIdx = false;
 
             // seek to closest key-frame around target pts
-            if (av_seek_frame(fmtCtx.get(),
-                    videoStreamIdx,
-                    targets[idx],
-                    AVSEEK_FLAG_ANY)
-                < 0) {
+            int seekResult = keyframes
+                ? keyframes->seek(fmtCtx.get(), videoStreamIdx, targets[idx], AVSEEK_FLAG_ANY)
+                : av_seek_frame(fmtCtx.get(), videoStreamIdx, targets[idx], AVSEEK_FLAG_ANY);
+            if (seekResult < 0) {
                 spdlog::warn("[Thumbnail] seek failed for thumb {}", idx);
                 continue;
             }
@@ -300,6 +310,8 @@ extract_color_thumbnails(VideoInfo const& info,
                     av_packet_unref(pkt.get());
                     continue;
                 }
+                if (keyframes)
+                    keyframes->observe(fmtCtx.get(), pkt.get());
                 if (avcodec_send_packet(codecCtx.get(), pkt.get()) < 0) {
                     av_packet_unref(pkt.get());
                     continue;
@@ -337,6 +349,8 @@ extract_color_thumbnails(VideoInfo const& info,
             if (!gotFrameForIdx)
                 spdlog::warn("[Thumbnail] Could not create thumbnail {} for '{}'", idx, filePath);
         }
+        if (keyframes)
+            keyframes->capture(fmtCtx.get(), videoStreamIdx);
 
         return results.empty() ? std::nullopt
                                : std::optional<std::vector<QString>>(std::move(results));
@@ -449,6 +463,9 @@ extract_color_thumbnails_precise(VideoInfo const& info,
         }
 
         AVStream* vStream = fmtCtx->streams[videoStreamIdx];
+        KeyframeIndex* keyframes = info.keyframes.get();
+        if (keyframes)
+            keyframes->prime(fmtCtx.get(), videoStreamIdx);
         if (!vStream) {
             spdlog::error("[Thumbnail] Stream pointer is null after lookup");
             return std::nullopt;
@@ -556,11 +573,10 @@ extract_color_thumbnails_precise(VideoInfo const& info,
             bool gotFrameForIdx = false;
 
             // seek to closest key-frame around target pts
-            if (av_seek_frame(fmtCtx.get(),
-                    videoStreamIdx,
-                    targets[idx],
-                    AVSEEK_FLAG_ANY)
-                < 0) {
+            int seekResult = keyframes
+                ? keyframes->seek(fmtCtx.get(), videoStreamIdx, targets[idx], AVSEEK_FLAG_ANY)
+                : av_seek_frame(fmtCtx.get(), videoStreamIdx, targets[idx], AVSEEK_FLAG_ANY);
+            if (seekResult < 0) {
                 spdlog::warn("[Thumbnail] seek failed for thumb {}", idx);
                 continue;
             }
@@ -573,6 +589,8 @@ extract_color_thumbnails_precise(VideoInfo const& info,
                     av_packet_unref(pkt.get());
                     continue;
                 }
+                if (keyframes)
+                    keyframes->observe(fmtCtx.get(), pkt.get());
                 if (avcodec_send_packet(codecCtx.get(), pkt.get()) < 0) {
                     av_packet_unref(pkt.get());
                     continue;
@@ -610,6 +628,8 @@ extract_color_thumbnails_precise(VideoInfo const& info,
             if (!gotFrameForIdx)
                 spdlog::warn("[Thumbnail] Could not create thumbnail {} for '{}'", idx, filePath);
         }
+        if (keyframes)
+            keyframes->capture(fmtCtx.get(), videoStreamIdx);
 
         return results.empty() ? std::nullopt
                                : std::optional<std::vector<QString>>(std::move(results));
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <optional>
+#include <string>
 #include <vector>
 #include <QString>
 
@@ -14,3 +15,7 @@ extract_color_thumbnails(VideoInfo const& info, int thumbnailsToGenerate);
 std::optional<std::vector<QString>>
 extract_color_thumbnails_precise(VideoInfo const& info, int thumbnailsToGenerate);
 
+
+// Where the video's hover-scrub sprite sheet lives, next to its thumbnails
+// (see SpriteSheet.h); the file may not exist.
+QString sprite_sheet_path(std::string const& videoPath);
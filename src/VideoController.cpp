@@ -1,16 +1,50 @@
 // VideoController.cpp
 #include "VideoController.h"
 #include "HardlinkWorker.h"
+#include "MatchQuery.h"
+#include "MatchResultsDialog.h"
+#include "ProgressAggregator.h"
 #include "SearchSettings.h"
 #include "SearchWorker.h"
 #include "VideoModel.h"
 
+#include <algorithm>
+#include <climits>
 #include <filesystem>
+#include <memory>
 
 #include <QDebug>
 #include <QMessageBox>
 #include <QProgressDialog>
 #include <QThread>
+#include <QTimer>
+
+namespace {
+
+// GUI refresh rate of the search progress dialog
+constexpr int kProgressPollMs = 66;
+
+QString formatDuration(double secs)
+{
+    auto const s = static_cast<long long>(secs + 0.5);
+    return s >= 3600 ? QString("%1:%2:%3").arg(s / 3600).arg(s / 60 % 60, 2, 10, QLatin1Char('0')).arg(s % 60, 2, 10, QLatin1Char('0'))
+                     : QString("%1:%2").arg(s / 60).arg(s % 60, 2, 10, QLatin1Char('0'));
+}
+
+QString describe(ProgressAggregator::Snapshot const& p)
+{
+    QString text = QString("%1…").arg(ProgressAggregator::name(p.stage));
+    if (p.stage == ProgressAggregator::Stage::Matching || p.stage == ProgressAggregator::Stage::Idle)
+        return text;
+    text += p.total > 0 ? QString(" %1/%2").arg(p.done).arg(p.total) : QString(" %1 found").arg(p.done);
+    if (p.rate > 0.0)
+        text += QString("\n%1/s").arg(p.rate, 0, 'f', p.rate < 10.0 ? 1 : 0);
+    if (p.etaSec)
+        text += QString(", about %1 left").arg(formatDuration(*p.etaSec));
+    return text;
+}
+
+} // namespace
 
 VideoController::VideoController(DatabaseManager& db, QObject* parent)
     : QObject(parent)
@@ -39,37 +73,27 @@ void VideoController::startSearch()
     progressDialog->show();
 
     QThread* thread = new QThread(this); // parent is this, so it cleans up
-    SearchWorker* worker = new SearchWorker(m_db, m_cfg);
+    auto progress = std::make_shared<ProgressAggregator>();
+    SearchWorker* worker = new SearchWorker(m_db, m_cfg, progress);
     worker->moveToThread(thread);
 
     // Connect signals/slots
     connect(thread, &QThread::started, worker, &SearchWorker::process);
 
-    connect(worker, &SearchWorker::searchProgress,
-        progressDialog, [progressDialog](int found) {
-            progressDialog->setLabelText(
-                QString("Searching for videos… %1 found").arg(found));
-        });
-
-    connect(worker, &SearchWorker::metadataProgress,
-        progressDialog, [progressDialog](int done, int total) {
-            progressDialog->setRange(0, total);
-            progressDialog->setValue(done);
-            progressDialog->setLabelText(
-                QString("Generating metadata/thumbnails… %1/%2")
-                    .arg(done)
-                    .arg(total));
-        });
-
-    connect(worker, &SearchWorker::hashProgress,
-        progressDialog, [progressDialog](int done, int total) {
-            progressDialog->setRange(0, total);
-            progressDialog->setValue(done);
-            progressDialog->setLabelText(
-                QString("Generating hashes… %1/%2")
-                    .arg(done)
-                    .arg(total));
-        });
+    // The worker only bumps counters; the dialog samples them on a timer,
+    // so a million files cost a few updates a second, not a million.
+    auto* progressTimer = new QTimer(progressDialog);
+    connect(progressTimer, &QTimer::timeout, progressDialog, [progressDialog, progress] {
+        auto const p = progress->sample();
+        int const total = static_cast<int>(std::min<std::int64_t>(p.total, INT_MAX));
+        if (progressDialog->maximum() != total)
+            progressDialog->setRange(0, total); // 0: indeterminate
+        if (total > 0)
+            progressDialog->setValue(static_cast<int>(std::min<std::int64_t>(p.done, total)));
+        if (QString const text = describe(p); text != progressDialog->labelText())
+            progressDialog->setLabelText(text);
+    });
+    progressTimer->start(kProgressPollMs);
 
     // On error
     connect(worker, &SearchWorker::error, progressDialog,
@@ -79,7 +103,8 @@ void VideoController::startSearch()
 
     // On finished
     connect(worker, &SearchWorker::finished, this,
-        [=, this](std::vector<std::vector<VideoInfo>> duplicates) {
+        [=, this](GroupsSnapshot duplicates) {
+            progressTimer->stop();
             progressDialog->close();
             progressDialog->deleteLater();
 
@@ -96,6 +121,7 @@ void VideoController::startSearch()
     connect(progressDialog, &QProgressDialog::canceled, this, [=]() {
         // **should requestStop for the worker or forcibly kill the thread**
         thread->requestInterruption();
+        progressTimer->stop();
         progressDialog->setLabelText("Canceling...");
     });
 
@@ -286,13 +312,13 @@ void VideoController::handleHardlink()
     connect(wk, &HardlinkWorker::progress, dlg, &QProgressDialog::setValue);
 
     connect(wk, &HardlinkWorker::finished, this,
-        [=, this](std::vector<std::vector<VideoInfo>> updatedGroups,
+        [=, this](GroupsSnapshot updatedGroups,
             int links, int errs) {
             dlg->close();
             dlg->deleteLater();
 
             //  UI update
-            m_model->fromGroups(updatedGroups);
+            m_model->setGroupedVideos(std::move(updatedGroups));
 
             QString msg = tr("Hard‑linking complete.\n%1 file(s) hard‑linked.\n%2 error(s).")
                               .arg(links)
@@ -313,6 +339,47 @@ void VideoController::handleHardlink()
     t->start();
 }
 
+void VideoController::handleMatchQuery(QStringList const& files, SearchSettings cfg)
+{
+    if (files.isEmpty())
+        return;
+
+    std::vector<std::string> paths;
+    paths.reserve(files.size());
+    for (auto const& f : files)
+        paths.push_back(f.toStdString());
+
+    auto* dlg = new QProgressDialog("Hashing query files...", QString(), 0,
+        static_cast<int>(paths.size()), nullptr);
+    dlg->setWindowTitle("Find Matches");
+    dlg->setWindowModality(Qt::ApplicationModal);
+    dlg->setMinimumDuration(0);
+    dlg->setAutoClose(false);
+    dlg->show();
+
+    // hashing a file can take a while; keep it off the GUI thread
+    auto results = std::make_shared<std::vector<query::FileResult>>();
+    QThread* t = QThread::create([this, dlg, results, paths = std::move(paths), cfg = std::move(cfg)] {
+        *results = query::query_files(m_db, paths, cfg, [dlg](int done, int) {
+            QMetaObject::invokeMethod(dlg, [dlg, done] { dlg->setValue(done); }, Qt::QueuedConnection);
+        });
+    });
+    t->setParent(this);
+
+    connect(t, &QThread::finished, this, [=] {
+        dlg->close();
+        dlg->deleteLater();
+
+        auto* view = new MatchResultsDialog(*results);
+        view->setAttribute(Qt::WA_DeleteOnClose);
+        view->show();
+
+        t->deleteLater();
+    });
+
+    t->start();
+}
+
 void VideoController::loadDatabase(QString const& path)
 {
     if (!m_db.open(path, /*createIfMissing*/ false)) {
@@ -320,12 +387,12 @@ void VideoController::loadDatabase(QString const& path)
         return;
     }
 
-    auto groups = m_db.loadDuplicateGroups();
+    auto groups = std::make_shared<DuplicateGroups const>(m_db.loadDuplicateGroups());
     auto settings = m_db.loadSettings();
     m_cfg = settings; // keep controller copy
 
     if (m_model)
-        m_model->setGroupedVideos(groups);
+        m_model->setGroupedVideos(std::move(groups));
 
     emit searchSettingsLoaded(settings);
     emit databaseOpened(path);
@@ -339,7 +406,7 @@ void VideoController::createDatabase(QString const& path)
     }
 
     if (m_model)
-        m_model->setGroupedVideos({});
+        m_model->setGroupedVideos(nullptr);
 
     emit databaseOpened(path);
 }
@@ -37,12 +37,13 @@ public slots:
     void handleSortGroupsOption(MainWindow::SortOptions option, bool ascending);
     void handleDeleteOption(MainWindow::DeleteOptions option);
     void handleHardlink();
+    void handleMatchQuery(QStringList const& files, SearchSettings cfg);
     void loadDatabase(QString const& path);
     void createDatabase(QString const& path);
 
 
 signals:
-    void duplicateGroupsUpdated(std::vector<std::vector<VideoInfo>> const& groups);
+    void duplicateGroupsUpdated(GroupsSnapshot const& groups);
 
     void directoryListUpdated(const QStringList& directories);
 
@@ -57,7 +58,6 @@ signals:
 private:
     DatabaseManager& m_db;
     VideoModel* m_model = nullptr;
-    std::vector<std::vector<VideoInfo>> m_currentGroups;
 
     SearchSettings m_cfg; 
 
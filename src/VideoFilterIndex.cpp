@@ -0,0 +1,327 @@
+#include "VideoFilterIndex.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <span>
+
+namespace {
+
+char lower(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+std::string lowered(std::string_view s)
+{
+    std::string out(s);
+    std::transform(out.begin(), out.end(), out.begin(), lower);
+    return out;
+}
+
+// `b` is lower case already
+bool equals_icase(std::string_view a, std::string_view b)
+{
+    return std::equal(a.begin(), a.end(), b.begin(), b.end(),
+        [](char x, char y) { return lower(x) == y; });
+}
+
+// `needle` is lower case already
+bool contains_icase(std::string_view haystack, std::string_view needle)
+{
+    return std::search(haystack.begin(), haystack.end(), needle.begin(), needle.end(),
+               [](char a, char b) { return lower(a) == b; })
+        != haystack.end();
+}
+
+// Trigrams are hashed into 2^kTrigramBucketBits lists; a collision only
+// adds candidates, which the full check drops.
+constexpr int kTrigramBucketBits = 18;
+
+std::uint32_t trigram_bucket(char a, char b, char c)
+{
+    std::uint32_t const g = static_cast<std::uint32_t>(static_cast<unsigned char>(lower(a))) << 16
+        | static_cast<std::uint32_t>(static_cast<unsigned char>(lower(b))) << 8
+        | static_cast<unsigned char>(lower(c));
+    return (g * 2654435761u) >> (32 - kTrigramBucketBits);
+}
+
+// distinct trigram buckets of `s`, ascending
+void buckets_of(std::string_view s, std::vector<std::uint32_t>& out)
+{
+    out.clear();
+    for (std::size_t i = 0; i + 3 <= s.size(); ++i)
+        out.push_back(trigram_bucket(s[i], s[i + 1], s[i + 2]));
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+// "1.5G" -> 1.5 * 2^30 with units {suffix, factor}; nullopt if malformed
+template<std::size_t N>
+std::optional<std::int64_t> parse_amount(std::string_view s,
+    std::pair<char, double> const (&units)[N])
+{
+    double value = 0.0;
+    auto const [end, ec] = std::from_chars(s.data(), s.data() + s.size(), value);
+    if (ec != std::errc {} || value < 0.0)
+        return std::nullopt;
+    std::string_view unit(end, s.data() + s.size() - end);
+    if (!unit.empty() && unit.size() <= 2 && (unit.size() == 1 || lower(unit[1]) == 'b')) {
+        auto const it = std::find_if(std::begin(units), std::end(units),
+            [c = lower(unit[0])](auto const& u) { return u.first == c; });
+        if (it == std::end(units))
+            return std::nullopt;
+        value *= it->second;
+    } else if (!unit.empty()) {
+        return std::nullopt;
+    }
+    if (value >= 9.2e18)
+        return std::nullopt;
+    return static_cast<std::int64_t>(std::llround(value));
+}
+
+template<std::size_t N>
+std::optional<VideoFilter::Range> parse_range(std::string_view s,
+    std::pair<char, double> const (&units)[N])
+{
+    auto amount = [&](std::string_view a) { return parse_amount(a, units); };
+    VideoFilter::Range r;
+    if (s.starts_with(">=") || s.starts_with("<=")) {
+        auto const v = amount(s.substr(2));
+        if (!v)
+            return std::nullopt;
+        (s[0] == '>' ? r.lo : r.hi) = *v;
+    } else if (s.starts_with('>') || s.starts_with('<')) {
+        auto const v = amount(s.substr(1));
+        if (!v)
+            return std::nullopt;
+        (s[0] == '>' ? r.lo : r.hi) = s[0] == '>' ? *v + 1 : *v - 1;
+    } else if (auto const dash = s.find('-'); dash != std::string_view::npos) {
+        auto const lo = amount(s.substr(0, dash));
+        auto const hi = amount(s.substr(dash + 1));
+        if (!lo || !hi)
+            return std::nullopt;
+        r.lo = *lo;
+        r.hi = *hi;
+    } else {
+        auto const v = amount(s);
+        if (!v)
+            return std::nullopt;
+        r.lo = r.hi = *v;
+    }
+    return r;
+}
+
+constexpr std::pair<char, double> kHeightUnits[] = { { 'p', 1.0 } }; // res:1080p
+constexpr std::pair<char, double> kByteUnits[] = {
+    { 'k', 1024.0 }, { 'm', 1024.0 * 1024 }, { 'g', 1024.0 * 1024 * 1024 }, { 't', 1024.0 * 1024 * 1024 * 1024 }
+};
+constexpr std::pair<char, double> kTimeUnits[] = { { 's', 1.0 }, { 'm', 60.0 }, { 'h', 3600.0 } };
+
+} // namespace
+
+VideoFilter parse_video_filter(std::string_view text)
+{
+    VideoFilter f;
+    std::size_t pos = 0;
+    while (pos < text.size()) {
+        pos = text.find_first_not_of(" \t", pos);
+        if (pos == std::string_view::npos)
+            break;
+        std::size_t end = text.find_first_of(" \t", pos);
+        if (end == std::string_view::npos)
+            end = text.size();
+        std::string_view const token = text.substr(pos, end - pos);
+        pos = end;
+
+        auto const colon = token.find(':');
+        std::string const key = colon == std::string_view::npos ? "" : lowered(token.substr(0, colon));
+        std::string_view const value = colon == std::string_view::npos ? "" : token.substr(colon + 1);
+        if (key == "codec") {
+            f.codec = lowered(value);
+        } else if (key == "res") {
+            if (auto const r = parse_range(value, kHeightUnits))
+                f.height = *r;
+        } else if (key == "size") {
+            if (auto const r = parse_range(value, kByteUnits))
+                f.size = *r;
+        } else if (key == "dur") {
+            if (auto const r = parse_range(value, kTimeUnits))
+                f.duration = *r;
+        } else {
+            f.words.push_back(lowered(token));
+        }
+    }
+    return f;
+}
+
+bool VideoFilter::empty() const
+{
+    return words.empty() && codec.empty() && height.any() && size.any() && duration.any();
+}
+
+bool VideoFilter::matches(VideoInfo const& v) const
+{
+    if (!size.contains(v.size) || !duration.contains(v.duration) || !height.contains(v.height))
+        return false;
+    if (!codec.empty() && !equals_icase(v.video_codec, codec))
+        return false;
+    return std::all_of(words.begin(), words.end(),
+        [&](std::string const& w) { return contains_icase(v.path, w); });
+}
+
+bool VideoFilter::narrows(VideoFilter const& wider) const
+{
+    if (!size.within(wider.size) || !duration.within(wider.duration) || !height.within(wider.height))
+        return false;
+    if (!wider.codec.empty() && codec != wider.codec)
+        return false;
+    // each of the wider filter's words is part of one of ours
+    return std::all_of(wider.words.begin(), wider.words.end(), [&](std::string const& w) {
+        return std::any_of(words.begin(), words.end(),
+            [&](std::string const& mine) { return mine.find(w) != std::string::npos; });
+    });
+}
+
+VideoFilterIndex::VideoFilterIndex(std::vector<VideoInfo const*> videos)
+    : videos_(std::move(videos))
+{
+    auto const n = static_cast<std::uint32_t>(videos_.size());
+    bySize_.reserve(n);
+    byDuration_.reserve(n);
+    byHeight_.reserve(n);
+    for (std::uint32_t slot = 0; slot < n; ++slot) {
+        VideoInfo const& v = *videos_[slot];
+        bySize_.emplace_back(v.size, slot);
+        byDuration_.emplace_back(v.duration, slot);
+        byHeight_.emplace_back(v.height, slot);
+    }
+    std::sort(bySize_.begin(), bySize_.end());
+    std::sort(byDuration_.begin(), byDuration_.end());
+    std::sort(byHeight_.begin(), byHeight_.end());
+
+    // two passes: count each bucket's paths, then lay the slots out in
+    // one array, ascending per bucket; seen[] keeps a path from entering a
+    // bucket twice
+    std::size_t const buckets = std::size_t { 1 } << kTrigramBucketBits;
+    std::vector<std::uint32_t> seen(buckets, UINT32_MAX);
+    auto each_bucket = [&](std::uint32_t slot, auto&& fn) {
+        std::string_view const p = videos_[slot]->path;
+        for (std::size_t i = 0; i + 3 <= p.size(); ++i) {
+            std::uint32_t const b = trigram_bucket(p[i], p[i + 1], p[i + 2]);
+            if (seen[b] != slot) {
+                seen[b] = slot;
+                fn(b);
+            }
+        }
+    };
+    offsets_.assign(buckets + 1, 0);
+    for (std::uint32_t slot = 0; slot < n; ++slot)
+        each_bucket(slot, [&](std::uint32_t b) { ++offsets_[b + 1]; });
+    for (std::size_t i = 1; i < offsets_.size(); ++i)
+        offsets_[i] += offsets_[i - 1];
+    postings_.resize(offsets_.back());
+    std::vector<std::uint32_t> cursor(offsets_.begin(), offsets_.end() - 1);
+    std::fill(seen.begin(), seen.end(), UINT32_MAX);
+    for (std::uint32_t slot = 0; slot < n; ++slot)
+        each_bucket(slot, [&](std::uint32_t b) { postings_[cursor[b]++] = slot; });
+}
+
+void VideoFilterIndex::replace(std::uint32_t slot, VideoInfo const* video)
+{
+    videos_[slot] = video;
+    auto const it = std::lower_bound(edited_.begin(), edited_.end(), slot);
+    if (it == edited_.end() || *it != slot)
+        edited_.insert(it, slot);
+}
+
+std::vector<std::uint32_t> const& VideoFilterIndex::query(VideoFilter const& filter)
+{
+    std::vector<std::uint32_t> candidates;
+    std::size_t best = videos_.size();
+    enum class Source { All, Previous, Path, Size, Duration, Height } source = Source::All;
+
+    bool const incremental = last_ && filter.narrows(*last_);
+    if (incremental && matches_.size() < best) {
+        best = matches_.size();
+        source = Source::Previous;
+    }
+
+    // path: the slots under each of the words' trigrams, shortest list first
+    std::vector<std::span<std::uint32_t const>> lists;
+    std::vector<std::uint32_t> grams;
+    for (auto const& w : filter.words) {
+        buckets_of(w, grams);
+        for (std::uint32_t g : grams)
+            lists.emplace_back(postings_.data() + offsets_[g], offsets_[g + 1] - offsets_[g]);
+    }
+    std::sort(lists.begin(), lists.end(), [](auto const& a, auto const& b) { return a.size() < b.size(); });
+    if (!lists.empty() && lists.front().size() < best) {
+        best = lists.front().size();
+        source = Source::Path;
+    }
+
+    auto bounds = [](Column const& col, VideoFilter::Range r) {
+        auto const lo = std::lower_bound(col.begin(), col.end(), std::pair { r.lo, std::uint32_t { 0 } });
+        auto const hi = std::upper_bound(lo, col.end(), std::pair { r.hi, UINT32_MAX });
+        return std::pair { lo, hi };
+    };
+    auto const sizeRange = bounds(bySize_, filter.size);
+    auto const durationRange = bounds(byDuration_, filter.duration);
+    auto const heightRange = bounds(byHeight_, filter.height);
+    for (auto [range, s] : { std::pair { sizeRange, Source::Size },
+             std::pair { durationRange, Source::Duration }, std::pair { heightRange, Source::Height } }) {
+        if (static_cast<std::size_t>(range.second - range.first) < best) {
+            best = static_cast<std::size_t>(range.second - range.first);
+            source = s;
+        }
+    }
+
+    switch (source) {
+    case Source::All:
+        candidates.resize(videos_.size());
+        for (std::uint32_t i = 0; i < candidates.size(); ++i)
+            candidates[i] = i;
+        break;
+    case Source::Previous:
+        candidates = std::move(matches_);
+        break;
+    case Source::Path: {
+        candidates.assign(lists.front().begin(), lists.front().end());
+        std::vector<std::uint32_t> next;
+        for (std::size_t i = 1; i < lists.size() && !candidates.empty(); ++i) {
+            next.clear();
+            std::set_intersection(candidates.begin(), candidates.end(),
+                lists[i].begin(), lists[i].end(), std::back_inserter(next));
+            candidates.swap(next);
+        }
+        break;
+    }
+    case Source::Size:
+    case Source::Duration:
+    case Source::Height: {
+        auto const [lo, hi] = source == Source::Size ? sizeRange
+            : source == Source::Duration             ? durationRange
+                                                     : heightRange;
+        candidates.reserve(static_cast<std::size_t>(hi - lo));
+        for (auto it = lo; it != hi; ++it)
+            candidates.push_back(it->second);
+        std::sort(candidates.begin(), candidates.end());
+        break;
+    }
+    }
+
+    // the indexes still hold an edited slot's old values
+    if (!edited_.empty()) {
+        std::vector<std::uint32_t> merged;
+        merged.reserve(candidates.size() + edited_.size());
+        std::set_union(candidates.begin(), candidates.end(), edited_.begin(), edited_.end(),
+            std::back_inserter(merged));
+        candidates.swap(merged);
+    }
+
+    std::erase_if(candidates, [&](std::uint32_t slot) { return !filter.matches(*videos_[slot]); });
+    matches_ = std::move(candidates);
+    last_ = filter;
+    return matches_;
+}
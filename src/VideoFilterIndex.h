@@ -0,0 +1,85 @@
+#pragma once
+
+#include "VideoInfo.h"
+
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// What the results view's filter bar asks for.  Plain words must all occur
+// in the path (ASCII case-insensitive); key:value tokens narrow a column:
+//
+//   codec:hevc     video codec
+//   res:1080       frame height; res:>=720, res:720-1080
+//   size:>1.5G     bytes, with K/M/G/T suffixes (1024-based)
+//   dur:10m-1h     seconds, with s/m/h suffixes
+//
+// A value is A, A-B, >A, >=A, <B or <=B.  A token that is still being
+// typed ("size:", "size:>") constrains nothing.
+struct VideoFilter {
+    struct Range {
+        std::int64_t lo = std::numeric_limits<std::int64_t>::min();
+        std::int64_t hi = std::numeric_limits<std::int64_t>::max();
+
+        bool any() const { return *this == Range {}; }
+        bool contains(std::int64_t v) const { return lo <= v && v <= hi; }
+        bool within(Range const& o) const { return o.lo <= lo && hi <= o.hi; }
+        bool operator==(Range const&) const = default;
+    };
+
+    std::vector<std::string> words; // lower case
+    std::string codec;              // lower case; empty = any
+    Range height;
+    Range size;
+    Range duration;
+
+    bool empty() const;
+    bool matches(VideoInfo const& v) const;
+    // Whether everything this filter accepts is accepted by `wider` too.
+    bool narrows(VideoFilter const& wider) const;
+    bool operator==(VideoFilter const&) const = default;
+};
+
+VideoFilter parse_video_filter(std::string_view text);
+
+// Column indexes over a fixed list of videos, numbered by their position
+// in it (slot): (value, slot) pairs sorted by size, duration and height,
+// and per lower-cased byte trigram (hashed into buckets) the slots of the
+// paths holding it.  A query starts from whichever index yields the fewest
+// candidates and checks only those against the whole filter; a query that
+// just narrows the previous one (another character typed) re-checks the
+// previous matches instead.
+class VideoFilterIndex {
+public:
+    explicit VideoFilterIndex(std::vector<VideoInfo const*> videos);
+
+    std::size_t size() const { return videos_.size(); }
+
+    // `slot` now shows `video` (an edit).  Its column and trigram entries
+    // keep the old values, so from here on every query re-checks the slot
+    // by hand instead of trusting them.
+    void replace(std::uint32_t slot, VideoInfo const* video);
+
+    // Slots of the videos `filter` accepts, ascending; valid until the next
+    // query.
+    std::vector<std::uint32_t> const& query(VideoFilter const& filter);
+
+private:
+    using Column = std::vector<std::pair<std::int64_t, std::uint32_t>>;
+
+    std::vector<VideoInfo const*> videos_;
+    Column bySize_;
+    Column byDuration_;
+    Column byHeight_;
+    // slots of trigram bucket b: postings_[offsets_[b], offsets_[b + 1])
+    std::vector<std::uint32_t> offsets_;
+    std::vector<std::uint32_t> postings_;
+    std::vector<std::uint32_t> edited_; // replaced slots, ascending
+
+    std::optional<VideoFilter> last_;
+    std::vector<std::uint32_t> matches_;
+};
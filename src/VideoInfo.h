@@ -1,8 +1,14 @@
 #pragma once
 
+#include "StringPool.h"
+
+#include <cstdint>
+#include <memory>
 #include <string>
 #include <vector>
 
+class KeyframeIndex;
+
 //   path
 //   size
 //   inode
@@ -20,11 +26,11 @@ struct VideoInfo {
     int num_hard_links = 0;
 
     // set by extract_info
-    std::string modified_at="";
-    std::string video_codec="";
-    std::string audio_codec="";
-    std::string pix_fmt=""; 
-    std::string profile=""; 
+    std::int64_t modified_at = 0; // mtime, ns since the epoch; 0 = unknown
+    InternedString video_codec;
+    InternedString audio_codec;
+    InternedString pix_fmt;
+    InternedString profile;
     int level = 0; 
     int width = 0;
     int height = 0;
@@ -34,8 +40,19 @@ struct VideoInfo {
     double avg_frame_rate = 0.0;
 
     std::vector<std::string> thumbnail_path=std::vector<std::string>();
+
+    // set by SearchWorker: empty for new videos, the stored one for known,
+    // unchanged files (DatabaseManager::keyframesFor);
+    // filled in by whichever pass decodes the file and shared by its copies
+    std::shared_ptr<KeyframeIndex> keyframes;
 };
 
+// Duplicate groups as handed from a search to the view: built once, then
+// shared read-only, so queued signals and the model pass a pointer instead
+// of deep-copying every VideoInfo.
+using DuplicateGroups = std::vector<std::vector<VideoInfo>>;
+using GroupsSnapshot = std::shared_ptr<DuplicateGroups const>;
+
 struct FractionFloat64 {
     double numerator = 0.0;
     double denominator = 0.0;
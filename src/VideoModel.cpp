@@ -1,5 +1,7 @@
 // VideoModel.cpp
 #include "VideoModel.h"
+#include "SpriteSheet.h"
+#include "Thumbnail.h"
 #include <QColor>
 #include <QDebug>
 #include <QFont>
@@ -7,40 +9,77 @@
 #include <QPainter>
 #include <QPixmap>
 #include <QTableView>
+#include <QtConcurrent/QtConcurrentRun>
 #include <algorithm>
 #include <climits>
 #include <numeric>
 #include <qnamespace.h>
 
+namespace {
+// A filter change that hides or reveals more runs of rows than this resets
+// the model instead of signalling each range.
+constexpr std::size_t kMaxFilterRangeSignals = 64;
+} // namespace
+
 VideoModel::VideoModel(QObject* parent)
     : QAbstractTableModel(parent)
 {
 }
 
-void VideoModel::setGroupedVideos(std::vector<std::vector<VideoInfo>> const& groups)
+void VideoModel::setGroupedVideos(GroupsSnapshot groups)
 {
-    // Filter out any groups that have fewer than 2 videos.
-    std::vector<std::vector<VideoInfo>> filteredGroups;
-    filteredGroups.reserve(groups.size());
-    for (auto const& g : groups) {
-        if (g.size() >= 2) {
-            filteredGroups.push_back(g);
+    // Skip any groups that have fewer than 2 videos.
+    RowGroups shown;
+    std::vector<VideoInfo const*> slots;
+    if (groups) {
+        shown.reserve(groups->size());
+        for (auto const& g : *groups) {
+            if (g.size() < 2)
+                continue;
+            auto& rows = shown.emplace_back();
+            rows.reserve(g.size());
+            for (auto const& v : g) {
+                RowEntry row;
+                row.type = RowType::Video;
+                row.video = &v;
+                row.slot = static_cast<int>(slots.size());
+                slots.push_back(&v);
+                rows.push_back(std::move(row));
+            }
         }
     }
 
     beginResetModel();
+    buildRows(shown);
+    m_edited.clear();
+    m_groups = std::move(groups);
+    m_slots = std::move(slots);
+    m_filterIndex.reset();
+    m_editedSlots.clear();
+    // ~0.7 s at a million videos: off the GUI thread, ready by the time the
+    // user types.  The snapshot the slots point into rides along.
+    m_filterBuild = QtConcurrent::run([keep = m_groups, slots = m_slots]() mutable {
+        return std::make_unique<VideoFilterIndex>(std::move(slots));
+    });
+    refilter();
+    endResetModel();
+}
+
+// Rows of `groups`, a separator before each; the caller resets the model.
+void VideoModel::buildRows(RowGroups const& groups)
+{
     m_rows.clear();
     m_groupBoundaries.clear();
 
     int groupIndex = 0;
-    for (auto const& grp : filteredGroups) {
+    for (auto const& grp : groups) {
 
         RowEntry sep;
         sep.type = RowType::Separator;
 
         int64_t totalSize = 0;
         for (auto const& v : grp) {
-            totalSize += v.size;
+            totalSize += v.video->size;
         }
         double sizeGB = static_cast<double>(totalSize) / (1024.0 * 1024.0 * 1024.0);
 
@@ -53,22 +92,18 @@ void VideoModel::setGroupedVideos(std::vector<std::vector<VideoInfo>> const& gro
         m_rows.push_back(std::move(sep));
 
         // Add each video row
-        for (auto const& v : grp) {
-            RowEntry row;
-            row.type = RowType::Video;
-            row.video = v;
+        for (auto row : grp) {
             row.selected = false;
             m_rows.push_back(std::move(row));
         }
     }
-    endResetModel();
 }
 
 int VideoModel::rowCount(QModelIndex const& parent) const
 {
     if (parent.isValid())
         return 0;
-    return static_cast<int>(m_rows.size());
+    return static_cast<int>(m_filtered ? m_visible.size() : m_rows.size());
 }
 
 int VideoModel::columnCount(QModelIndex const& parent) const
@@ -83,7 +118,7 @@ QVariant VideoModel::data(QModelIndex const& index, int role) const
     if (!index.isValid() || index.row() >= rowCount())
         return {};
 
-    auto const& row = m_rows[index.row()];
+    auto const& row = m_rows[sourceRow(index.row())];
     if (row.type == RowType::Separator) {
         if (role == Qt::DisplayRole)
             return row.label;
@@ -106,7 +141,7 @@ QVariant VideoModel::data(QModelIndex const& index, int role) const
     }
 
     if (role == Qt::DisplayRole) {
-        auto const& vid = row.video.value();
+        auto const& vid = *row.video;
         switch (index.column()) {
         case Col_Path:
             return QString::fromStdString(vid.path);
@@ -133,13 +168,20 @@ QVariant VideoModel::data(QModelIndex const& index, int role) const
             return vid.num_hard_links;
         }
     } else if (role == Qt::DecorationRole && index.column() == Col_Screenshot) {
-        auto const& vid = row.video.value();
+        auto const& vid = *row.video;
+        auto* view = qobject_cast<QTableView const*>(parent());
+        int kCell = view ? view->iconSize().height() : 128;
+
+        // rows move on resets and removals; the sheet must still be this video's
+        if (index.row() == m_scrubRow && sprite_sheet_path(vid.path) == m_scrubSheetPath) {
+            QImage const tile = sprite_tile(m_scrubSheet, m_scrubFraction);
+            if (!tile.isNull())
+                return QIcon(QPixmap::fromImage(tile).scaledToHeight(kCell, Qt::SmoothTransformation));
+        }
 
         if (vid.thumbnail_path.empty())
             return QIcon("./placeholder.png");
 
-        auto* view = qobject_cast<QTableView const*>(parent());
-        int kCell = view ? view->iconSize().height() : 128;
         int nThumbs = std::min<std::size_t>(vid.thumbnail_path.size(),
             static_cast<size_t>(m_thumbnailsPerVideo));
 
@@ -208,7 +250,7 @@ Qt::ItemFlags VideoModel::flags(QModelIndex const& index) const
     if (!index.isValid())
         return Qt::NoItemFlags;
 
-    auto const& row = m_rows[index.row()];
+    auto const& row = m_rows[sourceRow(index.row())];
     if (row.type == RowType::Separator) {
         // Make separator rows enabled but not selectable or activatable
         return Qt::ItemIsEnabled;
@@ -225,10 +267,10 @@ Qt::ItemFlags VideoModel::flags(QModelIndex const& index) const
 
 bool VideoModel::setData(QModelIndex const& index, QVariant const& value, int role)
 {
-    if (!index.isValid() || index.row() >= (int)m_rows.size())
+    if (!index.isValid() || index.row() >= rowCount())
         return false;
 
-    auto& row = m_rows[index.row()];
+    auto& row = m_rows[sourceRow(index.row())];
     if (row.type != RowType::Video)
         return false;
 
@@ -245,10 +287,10 @@ bool VideoModel::setData(QModelIndex const& index, QVariant const& value, int ro
 
 void VideoModel::selectRow(int row)
 {
-    if (row < 0 || row >= (int)m_rows.size())
+    if (row < 0 || row >= rowCount())
         return;
 
-    auto& entry = m_rows[row];
+    auto& entry = m_rows[sourceRow(row)];
     if (entry.type != RowType::Video)
         return;
 
@@ -336,7 +378,7 @@ void VideoModel::selectAllExceptSmallest()
 
 void VideoModel::markAllExceptLargestInRange(int startRow, int endRow)
 {
-    if (startRow > endRow)
+    if (startRow > endRow || !rowShown(startRow))
         return;
     int largestRow = -1;
     int64_t largestSize = -1;
@@ -346,7 +388,7 @@ void VideoModel::markAllExceptLargestInRange(int startRow, int endRow)
         auto& row = m_rows[r];
         if (row.type != RowType::Video)
             continue;
-        auto const& vid = row.video.value();
+        auto const& vid = *row.video;
         if (vid.size > largestSize) {
             largestSize = vid.size;
             largestRow = r;
@@ -366,7 +408,7 @@ void VideoModel::markAllExceptLargestInRange(int startRow, int endRow)
 
 void VideoModel::markAllExceptSmallestInRange(int startRow, int endRow)
 {
-    if (startRow > endRow)
+    if (startRow > endRow || !rowShown(startRow))
         return;
     int smallestRow = -1;
     int64_t smallestSize = LLONG_MAX;
@@ -376,7 +418,7 @@ void VideoModel::markAllExceptSmallestInRange(int startRow, int endRow)
         auto& row = m_rows[r];
         if (row.type != RowType::Video)
             continue;
-        auto const& vid = row.video.value();
+        auto const& vid = *row.video;
         if (vid.size < smallestSize) {
             smallestSize = vid.size;
             smallestRow = r;
@@ -403,46 +445,55 @@ void VideoModel::deleteSelectedVideosFromList()
                          return (re.type == RowType::Video && re.selected);
                      }),
         m_rows.end());
+    refilter();
     endResetModel();
 }
 
 void VideoModel::sortVideosWithinGroupsBySize(bool ascending)
 {
-    // Flatten each group, sort within group by size, rebuild
-    auto groups = toGroups();
+    // Sort each group's rows by size, rebuild
+    auto groups = rowGroups();
 
     for (auto& g : groups) {
         std::sort(g.begin(), g.end(),
-            [ascending](VideoInfo const& a, VideoInfo const& b) {
-                return ascending ? a.size < b.size : a.size > b.size;
+            [ascending](RowEntry const& a, RowEntry const& b) {
+                return ascending ? a.video->size < b.video->size : a.video->size > b.video->size;
             });
     }
-    setGroupedVideos(groups);
+    beginResetModel();
+    buildRows(groups);
+    refilter();
+    endResetModel();
 }
 
 void VideoModel::sortGroupsBySize(bool ascending)
 {
-    auto groups = toGroups();
+    auto groups = rowGroups();
+    auto total = [](auto const& g) {
+        return std::accumulate(g.begin(), g.end(), int64_t { 0 },
+            [](int64_t s, RowEntry const& r) { return s + r.video->size; });
+    };
     std::sort(groups.begin(), groups.end(),
-        [ascending](auto const& g1, auto const& g2) {
-            auto sum1 = std::accumulate(g1.begin(), g1.end(), int64_t { 0 },
-                [](int64_t s, auto const& v) { return s + v.size; });
-            auto sum2 = std::accumulate(g2.begin(), g2.end(), int64_t { 0 },
-                [](int64_t s, auto const& v) { return s + v.size; });
+        [ascending, &total](auto const& g1, auto const& g2) {
+            auto sum1 = total(g1);
+            auto sum2 = total(g2);
             return ascending ? sum1 < sum2 : sum1 > sum2;
         });
-    setGroupedVideos(groups);
+    beginResetModel();
+    buildRows(groups);
+    refilter();
+    endResetModel();
 }
 
 RowEntry const& VideoModel::rowEntry(int row) const
 {
-    return m_rows.at(row);
+    return m_rows.at(m_filtered ? m_visible.at(row) : row);
 }
 
-// helper to flatten the model's row structure into a vector-of-groups
-std::vector<std::vector<VideoInfo>> VideoModel::toGroups() const
+// helper to flatten the model's row structure into groups of row videos
+VideoModel::RowGroups VideoModel::rowGroups() const
 {
-    std::vector<std::vector<VideoInfo>> result;
+    RowGroups result;
     int currentGroupStart = -1;
 
     for (int row = 0; row < (int)m_rows.size(); ++row) {
@@ -459,16 +510,22 @@ std::vector<std::vector<VideoInfo>> VideoModel::toGroups() const
                 currentGroupStart = (int)result.size() - 1;
             }
 
-            auto const& v = m_rows[row].video.value();
-            result[currentGroupStart].push_back(v);
+            result[currentGroupStart].push_back(m_rows[row]);
         }
     }
     return result;
 }
 
-void VideoModel::fromGroups(std::vector<std::vector<VideoInfo>> const& groups)
+std::vector<std::vector<VideoInfo>> VideoModel::toGroups() const
 {
-    setGroupedVideos(groups);
+    std::vector<std::vector<VideoInfo>> result;
+    for (auto const& g : rowGroups()) {
+        auto& out = result.emplace_back();
+        out.reserve(g.size());
+        for (auto const& r : g)
+            out.push_back(*r.video);
+    }
+    return result;
 }
 
 std::vector<VideoInfo> VideoModel::selectedVideos() const
@@ -476,7 +533,7 @@ std::vector<VideoInfo> VideoModel::selectedVideos() const
     std::vector<VideoInfo> vids;
     for (auto const& row : m_rows) {
         if (row.type == RowType::Video && row.selected) {
-            vids.push_back(row.video.value());
+            vids.push_back(*row.video);
         }
     }
 
@@ -490,11 +547,12 @@ void VideoModel::removeVideosFromModel(std::vector<int> const& videoIds)
         std::remove_if(m_rows.begin(), m_rows.end(), [&](RowEntry const& re) {
             if (re.type != RowType::Video)
                 return false;
-            auto const& vid = re.video.value();
+            auto const& vid = *re.video;
             // Erase it if it matches any ID in videoIds
             return (std::find(videoIds.begin(), videoIds.end(), vid.id) != videoIds.end());
         }),
         m_rows.end());
+    refilter();
     endResetModel();
 }
 QSize VideoModel::span(QModelIndex const& index) const
@@ -502,7 +560,7 @@ QSize VideoModel::span(QModelIndex const& index) const
     if (!index.isValid())
         return {};
 
-    auto const& row = m_rows[index.row()];
+    auto const& row = m_rows[sourceRow(index.row())];
 
     // Make the *first* cell of a separator row occupy the whole row.
     if (row.type == RowType::Separator) {
@@ -522,14 +580,28 @@ void VideoModel::updateVideoInfo(VideoInfo const& updated)
             continue;
 
         if (row.video->id == updated.id) {
-            row.video = updated;
+            // the snapshot is shared and read-only; the row gets its own copy,
+            // which the filter index checks in place of the original
+            row.video = &m_edited.emplace_back(updated);
+            if (row.slot >= 0) {
+                m_slots[row.slot] = row.video;
+                if (m_filterIndex)
+                    m_filterIndex->replace(static_cast<std::uint32_t>(row.slot), row.video);
+                else
+                    m_editedSlots.push_back(row.slot);
+            }
 
+            if (!rowShown(i))
+                break;
+            int const shown = m_filtered
+                ? static_cast<int>(std::lower_bound(m_visible.begin(), m_visible.end(), i) - m_visible.begin())
+                : i;
             for (int col = 0; col < Col_Count; ++col) {
                 QVector<int> roles = { Qt::DisplayRole, Qt::CheckStateRole };
                 if (col == Col_Screenshot)
                     // force thumbnail to be refreshed
                     roles.append(Qt::DecorationRole);
-                emit dataChanged(index(i, col), index(i, col), roles);
+                emit dataChanged(index(shown, col), index(shown, col), roles);
             }
 
             break;
@@ -552,8 +624,186 @@ void VideoModel::setThumbnailsPerVideo(int n)
 
     // --- repaint all thumbnail cells ---
     for (int r = 0; r < rowCount(); ++r)
-        if (m_rows[r].type == RowType::Video)
+        if (m_rows[sourceRow(r)].type == RowType::Video)
             emit dataChanged(index(r, Col_Screenshot),
                 index(r, Col_Screenshot),
                 { Qt::DecorationRole });
 }
+
+void VideoModel::setScrub(int row, double fraction)
+{
+    if (row >= 0 && (row >= rowCount() || m_rows[sourceRow(row)].type != RowType::Video))
+        row = -1;
+
+    int const previous = m_scrubRow;
+    if (row != m_scrubRow) {
+        m_scrubRow = row;
+        m_scrubTile = -1;
+        if (row >= 0) {
+            QString const path = sprite_sheet_path(m_rows[sourceRow(row)].video->path);
+            if (path != m_scrubSheetPath) {
+                m_scrubSheetPath = path;
+                m_scrubSheet = QImage(path); // null when the video has none
+            }
+        }
+    }
+    m_scrubFraction = std::clamp(fraction, 0.0, 1.0);
+
+    // repaint only when the visible tile changes
+    int const tiles = m_scrubSheet.width() / kSpriteTileW;
+    int const tile = row >= 0 && tiles > 0 ? std::min(static_cast<int>(m_scrubFraction * tiles), tiles - 1) : -1;
+    if (previous >= 0 && previous != row)
+        emit dataChanged(index(previous, Col_Screenshot), index(previous, Col_Screenshot), { Qt::DecorationRole });
+    if (row >= 0 && tile != m_scrubTile) {
+        m_scrubTile = tile;
+        emit dataChanged(index(row, Col_Screenshot), index(row, Col_Screenshot), { Qt::DecorationRole });
+    }
+}
+
+bool VideoModel::rowShown(int source) const
+{
+    return !m_filtered || std::binary_search(m_visible.begin(), m_visible.end(), source);
+}
+
+void VideoModel::setFilter(std::string_view text)
+{
+    VideoFilter filter = parse_video_filter(text);
+    if (filter == m_filter)
+        return;
+    m_filter = std::move(filter);
+    std::vector<int> const next = filteredRows();
+
+    // from here on m_visible is what the view shows, all rows if unfiltered
+    if (!m_filtered) {
+        m_visible.resize(m_rows.size());
+        std::iota(m_visible.begin(), m_visible.end(), 0);
+        m_filtered = true;
+    }
+
+    // Typing usually hides or reveals a few runs of groups: tell the view
+    // about those ranges rather than resetting it, unless there are so many
+    // that one reset is cheaper than the signals.
+    std::size_t runs = 0;
+    enum { Both, OldOnly, NewOnly } last = Both;
+    for (std::size_t i = 0, j = 0; i < m_visible.size() || j < next.size();) {
+        auto kind = Both;
+        if (i < m_visible.size() && j < next.size() && m_visible[i] == next[j])
+            ++i, ++j;
+        else if (j == next.size() || (i < m_visible.size() && m_visible[i] < next[j]))
+            kind = OldOnly, ++i;
+        else
+            kind = NewOnly, ++j;
+        runs += kind != Both && kind != last;
+        last = kind;
+    }
+
+    m_scrubRow = m_scrubTile = -1; // view rows are about to mean other videos
+    if (runs > kMaxFilterRangeSignals) {
+        beginResetModel();
+        m_visible = next;
+        m_filtered = !m_filter.empty();
+        if (!m_filtered)
+            m_visible.clear();
+        endResetModel();
+        return;
+    }
+
+    // removals back to front, so the earlier view rows keep their numbers
+    std::vector<char> keep(m_rows.size(), 0);
+    for (int r : next)
+        keep[r] = 1;
+    for (int end = static_cast<int>(m_visible.size()); end > 0;) {
+        if (keep[m_visible[end - 1]]) {
+            --end;
+            continue;
+        }
+        int begin = end - 1;
+        while (begin > 0 && !keep[m_visible[begin - 1]])
+            --begin;
+        beginRemoveRows({}, begin, end - 1);
+        m_visible.erase(m_visible.begin() + begin, m_visible.begin() + end);
+        endRemoveRows();
+        end = begin;
+    }
+
+    // m_visible is now a subsequence of next: insert the rest front to back
+    std::size_t pos = 0;
+    for (std::size_t i = 0; i < next.size();) {
+        if (pos < m_visible.size() && m_visible[pos] == next[i]) {
+            ++pos, ++i;
+            continue;
+        }
+        std::size_t j = i;
+        while (j < next.size() && (pos == m_visible.size() || next[j] != m_visible[pos]))
+            ++j;
+        beginInsertRows({}, static_cast<int>(pos), static_cast<int>(pos + (j - i)) - 1);
+        m_visible.insert(m_visible.begin() + static_cast<std::ptrdiff_t>(pos), next.begin() + i, next.begin() + j);
+        endInsertRows();
+        pos += j - i;
+        i = j;
+    }
+
+    // unfiltered, m_visible lists every row: the count stays the same
+    m_filtered = !m_filter.empty();
+    if (!m_filtered)
+        m_visible.clear();
+}
+
+// The index over m_slots, waiting for setGroupedVideos' build if the
+// first filter comes before it is done.
+VideoFilterIndex& VideoModel::filterIndex()
+{
+    if (!m_filterIndex) {
+        m_filterIndex = m_filterBuild.isValid() ? m_filterBuild.takeResult()
+                                                : std::make_unique<VideoFilterIndex>(m_slots);
+        for (int slot : m_editedSlots)
+            m_filterIndex->replace(static_cast<std::uint32_t>(slot), m_slots[slot]);
+        m_editedSlots.clear();
+    }
+    return *m_filterIndex;
+}
+
+// Source rows m_filter shows, ascending (every row when it is empty); rows
+// it hides lose their check marks.
+std::vector<int> VideoModel::filteredRows()
+{
+    std::vector<int> rows;
+    if (m_filter.empty()) {
+        rows.resize(m_rows.size());
+        std::iota(rows.begin(), rows.end(), 0);
+        return rows;
+    }
+
+    VideoFilterIndex& index = filterIndex();
+    std::vector<char> hit(index.size(), 0);
+    for (std::uint32_t slot : index.query(m_filter))
+        hit[slot] = 1;
+
+    // whole groups: shown if any of their videos matches
+    int const n = static_cast<int>(m_rows.size());
+    for (int start = 0; start < n;) {
+        int end = start + 1;
+        while (end < n && m_rows[end].type != RowType::Separator)
+            ++end;
+        bool const shown = std::any_of(m_rows.begin() + start, m_rows.begin() + end,
+            [&](RowEntry const& r) { return r.slot >= 0 && hit[r.slot]; });
+        for (int r = start; r < end; ++r) {
+            if (shown)
+                rows.push_back(r);
+            else
+                m_rows[r].selected = false;
+        }
+        start = end;
+    }
+    return rows;
+}
+
+// Recompute m_visible from m_filter; the caller resets the model.
+void VideoModel::refilter()
+{
+    m_scrubRow = m_scrubTile = -1; // view rows are about to mean other videos
+    m_filtered = !m_filter.empty();
+    m_visible.clear();
+    if (m_filtered)
+        m_visible = filteredRows();
+}
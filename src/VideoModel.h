@@ -1,9 +1,14 @@
 #pragma once
 
 #include <QAbstractTableModel>
+#include <QFuture>
+#include <QImage>
 #include <vector>
-#include <optional>
 #include <QString>
+#include <deque>
+#include <memory>
+#include <string_view>
+#include "VideoFilterIndex.h"
 #include "VideoInfo.h"
 
 enum class RowType {
@@ -13,7 +18,8 @@ enum class RowType {
 
 struct RowEntry {
     RowType type;
-    std::optional<VideoInfo> video;
+    VideoInfo const* video = nullptr; // into the model's snapshot (or an edited copy)
+    int slot = -1;                    // in the filter index; -1 for separators
     QString label;
     bool selected = false;  
 };
@@ -34,7 +40,9 @@ public:
 
     explicit VideoModel(QObject* parent = nullptr);
 
-    void setGroupedVideos(std::vector<std::vector<VideoInfo>> const& groups);
+    // Show `groups` (null for none); rows point into the snapshot, which
+    // the model keeps alive, instead of copying it.
+    void setGroupedVideos(GroupsSnapshot groups);
 
     QSize span(const QModelIndex& index) const override;
 
@@ -66,11 +74,12 @@ public:
     const RowEntry& rowEntry(int row) const;
     std::vector<VideoInfo> selectedVideos() const;
 
-    void fromGroups(std::vector<std::vector<VideoInfo>> const& groups);
-
 private:
     std::vector<RowEntry> m_rows;
 
+    GroupsSnapshot m_groups;
+    std::deque<VideoInfo> m_edited; // updateVideoInfo's copies; stable addresses
+
     // store the row index of each group’s separator row
     // used if you want to know where each group starts
     std::vector<int> m_groupBoundaries;
@@ -80,11 +89,52 @@ private:
     void markAllExceptLargestInRange(int startRow, int endRow);
     void markAllExceptSmallestInRange(int startRow, int endRow);
 
+    using RowGroups = std::vector<std::vector<RowEntry>>; // video rows
+    RowGroups rowGroups() const;
+    void buildRows(RowGroups const& groups);
+
 
     bool setData(const QModelIndex &index, const QVariant &value, int role) override;
 
 public:
     void setThumbnailsPerVideo(int n);
 
+    // Hover-scrub: the screenshot cell of `row` shows the tile of its sprite
+    // sheet (SpriteSheet.h) at `fraction` of the video; row < 0 stops.
+    void setScrub(int row, double fraction);
+
+    // Show only the groups with a video the filter-bar text accepts (see
+    // VideoFilter), whole; "" shows all.  Rows of hidden groups lose their
+    // check marks, so select/delete/hardlink act on what is visible.  The
+    // view is told which row ranges appear and disappear; only a change
+    // touching many runs of rows resets it.
+    void setFilter(std::string_view text);
+
+private:
+    int m_scrubRow = -1;
+    int m_scrubTile = -1;
+    double m_scrubFraction = 0.0;
+    QString m_scrubSheetPath; // sheet of the scrubbed row, loaded once
+    QImage m_scrubSheet;
+
+    // filtering: the index is built over m_slots (slot → the video as
+    // shown, edits included) on a pool thread as soon as the groups are
+    // set, so slots survive sorting and deleting; edits replace their slot
+    // in it (m_editedSlots holds those made before it was ready); m_visible
+    // lists the shown rows of m_rows
+    std::vector<VideoInfo const*> m_slots;
+    QFuture<std::unique_ptr<VideoFilterIndex>> m_filterBuild;
+    std::unique_ptr<VideoFilterIndex> m_filterIndex;
+    std::vector<int> m_editedSlots;
+    VideoFilter m_filter;
+    bool m_filtered = false;
+    std::vector<int> m_visible;
+
+    int sourceRow(int row) const { return m_filtered ? m_visible[row] : row; }
+    bool rowShown(int source) const;
+    VideoFilterIndex& filterIndex();
+    std::vector<int> filteredRows();
+    void refilter();
+
 };
 
@@ -1,10 +1,21 @@
 #pragma once
 #include "Hash.h"
+#include "ScratchArena.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <format>
 #include <memory>
+#include <stdexcept>
+#include <string>
 #include <vector>
 #include <cstdint>
 #include <functional>
 #include <cmath>
+#include <algorithm>
+#include <cstring>
+#include <optional>
+#include <immintrin.h>
 
 #include <spdlog/spdlog.h>
 
@@ -16,6 +27,7 @@ extern "C" {
 #include <libavcodec/avcodec.h>
 #include <libavutil/frame.h>
 #include <libavutil/avutil.h>
+#include <libavutil/pixdesc.h>
 }
 
 namespace vpu      
@@ -62,63 +74,300 @@ inline bool sample_due(int64_t framePts, int64_t nextPts)
     return framePts == AV_NOPTS_VALUE || framePts >= nextPts;
 }
 
-// full-resolution Y-plane extractor  (AVFrame → GRAY8 contiguous buf)
-inline bool extract_luma_full(AVFrame const* src,
-                              std::vector<uint8_t>& dst,
-                              int& outW, int& outH)
+// -----------------------------------------------------------------
+// per-file budget
+// -----------------------------------------------------------------
+
+// Thrown by a processor whose file ran over its DecodeBudget, so the
+// caller can queue the file for later instead of counting it as broken.
+struct BudgetExceeded : std::runtime_error {
+    BudgetExceeded(std::string stage_, std::string reason_)
+        : std::runtime_error("budget exceeded during " + stage_ + ": " + reason_)
+        , stage(std::move(stage_)), reason(std::move(reason_)) { }
+    std::string stage;  // "open", "probe", "seek", "decode"
+    std::string reason; // which limit, and by how much
+};
+
+// Wall-time and bytes-read limit for one file.  Installed as the demuxer's
+// interrupt callback, which FFmpeg polls inside every blocking read, so a
+// read-to-EOF or a decode-everything loop on a pathological file is cut
+// off at the next I/O instead of running for minutes.  Once tripped it
+// stays tripped.  Zero limits disable the corresponding check.
+class DecodeBudget {
+public:
+    DecodeBudget(std::chrono::seconds wall, int64_t maxBytes)
+        : deadline_(wall.count() > 0 ? std::chrono::steady_clock::now() + wall
+                                     : std::chrono::steady_clock::time_point::max())
+        , start_(std::chrono::steady_clock::now())
+        , maxBytes_(maxBytes) { }
+
+    // readPct is relative to the file size, plus slack for probing tiny files
+    static DecodeBudget for_file(int timeSec, int readPct, int64_t fileSize)
+    {
+        int64_t const bytes = readPct > 0 && fileSize > 0
+            ? fileSize / 100 * readPct + (int64_t { 64 } << 20)
+            : 0;
+        return DecodeBudget(std::chrono::seconds(timeSec), bytes);
+    }
+
+    // avformat_open_input on a context that polls this budget.  Reads
+    // during the open count against it; on failure FFmpeg frees the
+    // context, so the budget forgets it before anyone polls again.
+    int open_input(AVFormatContext*& out, char const* url, AVDictionary** opts)
+    {
+        out = avformat_alloc_context();
+        if (!out)
+            return AVERROR(ENOMEM);
+        out->interrupt_callback = { &DecodeBudget::interrupt, this };
+        fmt_ = out;
+        int const rc = avformat_open_input(&out, url, nullptr, opts);
+        fmt_ = rc < 0 ? nullptr : out;
+        return rc;
+    }
+
+    void enter(char const* stage) { stage_.store(stage, std::memory_order_relaxed); }
+
+    bool exceeded()
+    {
+        if (tripped_.load(std::memory_order_relaxed))
+            return true;
+        auto const now = std::chrono::steady_clock::now();
+        if (now >= deadline_)
+            return trip(std::format("{} s wall time",
+                std::chrono::duration_cast<std::chrono::seconds>(now - start_).count()));
+        if (maxBytes_ > 0 && fmt_ && fmt_->pb && fmt_->pb->bytes_read > maxBytes_)
+            return trip(std::format("{} MiB read (limit {} MiB)",
+                fmt_->pb->bytes_read >> 20, maxBytes_ >> 20));
+        return false;
+    }
+
+    void throw_if_exceeded()
+    {
+        if (exceeded())
+            throw BudgetExceeded(stage_.load(std::memory_order_relaxed), reason_);
+    }
+
+private:
+    static int interrupt(void* self) { return static_cast<DecodeBudget*>(self)->exceeded() ? 1 : 0; }
+
+    bool trip(std::string reason)
+    {
+        if (!tripped_.exchange(true))
+            reason_ = std::move(reason);
+        return true;
+    }
+
+    std::chrono::steady_clock::time_point const deadline_;
+    std::chrono::steady_clock::time_point const start_;
+    int64_t const maxBytes_;
+    AVFormatContext const* fmt_ = nullptr;
+    std::atomic<char const*> stage_ { "open" };
+    std::atomic_bool tripped_ { false };
+    std::string reason_;
+};
+
+// -----------------------------------------------------------------
+// luma extraction
+// -----------------------------------------------------------------
+
+// Shift that brings the Y plane of a planar/semi-planar YUV (or gray)
+// format down to 8 bits, or nullopt if the plane cannot be read directly
+// (RGB, palette, packed YUYV, big-endian, float, hw surfaces).
+inline std::optional<int> direct_luma_shift(AVPixelFormat fmt, int& bytesPerSample)
 {
-    if (!src) return false;
+    AVPixFmtDescriptor const* d = av_pix_fmt_desc_get(fmt);
+    if (!d || d->nb_components < 1)
+        return std::nullopt;
+    constexpr uint64_t kRejected = AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_PAL
+        | AV_PIX_FMT_FLAG_BITSTREAM | AV_PIX_FMT_FLAG_HWACCEL
+        | AV_PIX_FMT_FLAG_FLOAT | AV_PIX_FMT_FLAG_BE;
+    if (d->flags & kRejected)
+        return std::nullopt;
+
+    AVComponentDescriptor const& y = d->comp[0];
+    if (y.plane != 0 || y.offset != 0 || y.depth < 8 || y.depth > 16)
+        return std::nullopt;
 
-    outW = src->width;
-    outH = src->height;
-    dst.resize(static_cast<std::size_t>(outW) * outH);
+    bytesPerSample = y.depth > 8 ? 2 : 1;
+    if (y.step != bytesPerSample)
+        return std::nullopt;
+    return y.shift + (y.depth - 8); // P010 etc. keep samples in the MSBs
+}
 
-    static thread_local SwsContext* sws = nullptr;
-    static thread_local int lastW = 0, lastH = 0, lastFmt = AV_PIX_FMT_NONE;
-
-    if (!sws || lastW != outW || lastH != outH || lastFmt != src->format) {
-        if (sws) sws_freeContext(sws);
-        sws = sws_getContext(outW, outH,
-                             static_cast<AVPixelFormat>(src->format),
-                             outW, outH, AV_PIX_FMT_GRAY8,
-                             SWS_FAST_BILINEAR, nullptr, nullptr, nullptr);
-        if (!sws) {
-            spdlog::error("[sws] context init failed");
-            return false;
+// Code value → 8-bit SDR luma for PQ / HLG sources.  Luma-only and
+// deliberately cheap: EOTF to nits, extended Reinhard with a 1000 nit
+// white point, then a 2.4 display gamma.  Enough to put HDR and SDR
+// encodes of the same content into the same pHash neighbourhood.
+inline std::vector<uint8_t> build_hdr_tonemap_lut(int depth,
+    AVColorTransferCharacteristic trc, bool fullRange)
+{
+    int const codes = 1 << depth;
+    std::vector<uint8_t> lut(static_cast<std::size_t>(codes));
+
+    double const scale = static_cast<double>(1 << (depth - 8));
+    double const lo = fullRange ? 0.0 : 16.0 * scale;
+    double const hi = fullRange ? (codes - 1.0) : 235.0 * scale;
+
+    constexpr double kSdrWhiteNits = 100.0;
+    constexpr double kWhitePoint = 1000.0 / kSdrWhiteNits;
+
+    for (int c = 0; c < codes; ++c) {
+        double e = std::clamp((c - lo) / (hi - lo), 0.0, 1.0);
+
+        double nits = 0.0;
+        if (trc == AVCOL_TRC_SMPTE2084) {
+            constexpr double m1 = 2610.0 / 16384.0, m2 = 2523.0 / 4096.0 * 128.0;
+            constexpr double c1 = 3424.0 / 4096.0, c2 = 2413.0 / 4096.0 * 32.0;
+            constexpr double c3 = 2392.0 / 4096.0 * 32.0;
+            double p = std::pow(e, 1.0 / m2);
+            nits = 10000.0 * std::pow(std::max(p - c1, 0.0) / (c2 - c3 * p), 1.0 / m1);
+        } else { // AVCOL_TRC_ARIB_STD_B67 (HLG), 1000 nit reference display
+            constexpr double a = 0.17883277, b = 0.28466892, cc = 0.55991073;
+            double scene = e <= 0.5 ? (e * e) / 3.0 : (std::exp((e - cc) / a) + b) / 12.0;
+            nits = 1000.0 * std::pow(scene, 1.2);
         }
-        lastW = outW;  lastH = outH;  lastFmt = src->format;
+
+        double x = nits / kSdrWhiteNits;
+        double mapped = x * (1.0 + x / (kWhitePoint * kWhitePoint)) / (1.0 + x);
+        double sdr = std::pow(std::clamp(mapped, 0.0, 1.0), 1.0 / 2.4);
+        lut[c] = static_cast<uint8_t>(std::lround(sdr * 255.0));
+    }
+    return lut;
+}
+
+inline bool is_hdr_transfer(AVColorTransferCharacteristic trc)
+{
+    return trc == AVCOL_TRC_SMPTE2084 || trc == AVCOL_TRC_ARIB_STD_B67;
+}
+
+// One Y-plane row → GRAY8.  16-bit samples are narrowed with SIMD shifts,
+// or looked up in the tone-map LUT (indexed by the sample's code value,
+// i.e. raw >> lutShift) for HDR input.  The LUT has lutMax + 1 entries; a
+// stray bit above the sample depth clamps to the last one.
+inline void luma_row_to_u8(uint8_t const* row, int w, int bytesPerSample,
+    int shift, int lutShift, int lutMax, uint8_t const* lut, uint8_t* out)
+{
+    if (bytesPerSample == 1) {
+        std::memcpy(out, row, static_cast<std::size_t>(w));
+        return;
     }
 
-    uint8_t* dstData[1] = { dst.data() };
-    int      dstLines[1] = { outW };
+    auto const* px = reinterpret_cast<uint16_t const*>(row);
+    int x = 0;
+    if (lut) {
+        for (; x < w; ++x)
+            out[x] = lut[std::min(px[x] >> lutShift, lutMax)];
+        return;
+    }
+#if defined(__SSE2__)
+    __m128i const cnt = _mm_cvtsi32_si128(shift);
+    for (; x + 16 <= w; x += 16) {
+        __m128i a = _mm_srl_epi16(_mm_loadu_si128(reinterpret_cast<__m128i const*>(px + x)), cnt);
+        __m128i b = _mm_srl_epi16(_mm_loadu_si128(reinterpret_cast<__m128i const*>(px + x + 8)), cnt);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), _mm_packus_epi16(a, b));
+    }
+#endif
+    for (; x < w; ++x)
+        out[x] = static_cast<uint8_t>(std::min(px[x] >> shift, 255));
+}
 
-    return sws_scale(sws, src->data, src->linesize, 0, outH,
-                     dstData, dstLines) > 0;
+// PQ/HLG tone-map LUT for this frame, cached per thread, or nullptr when
+// the frame is SDR / 8-bit or tone-mapping is off.
+inline uint8_t const* hdr_lut_for(AVFrame const* src, AVComponentDescriptor const& yc,
+    int bytesPerSample, bool toneMapHdr)
+{
+    if (!toneMapHdr || bytesPerSample != 2 || !is_hdr_transfer(src->color_trc))
+        return nullptr;
+
+    static thread_local std::vector<uint8_t> cachedLut;
+    static thread_local int lutKey = -1;
+    bool const fullRange = src->color_range == AVCOL_RANGE_JPEG;
+    int const key = (yc.depth << 16)
+        | (static_cast<int>(src->color_trc) << 1) | (fullRange ? 1 : 0);
+    if (key != lutKey) {
+        cachedLut = build_hdr_tonemap_lut(yc.depth, src->color_trc, fullRange);
+        lutKey = key;
+    }
+    return cachedLut.data();
 }
 
-// Convert frame → hash.  Returns std::nullopt on failure.
-inline std::optional<uint64_t>
-hash_frame(AVFrame const* frm, std::vector<uint8_t>& buf, bool& fatal_error)
+// Y plane → kPHashTile×kPHashTile GRAY8 tile (area average).  This is all
+// the hash needs from a frame, so the decoder's surface can be released as
+// soon as it returns.  Planar YUV is read directly; everything else goes
+// through swscale with area scaling.  The affine difference between
+// limited-range Y and swscale's full-range GRAY8 does not move the pHash
+// (it only scales the DCT coefficients).
+inline bool extract_luma_tile(AVFrame const* src, uint8_t* tile,
+                              bool toneMapHdr = true)
 {
-    try {
-        int w = 0, h = 0;
-        if (!vpu::extract_luma_full(frm, buf, w, h)) {
-            spdlog::info("rejecting");
-            return std::nullopt;
+    if (!src || src->width <= 0 || src->height <= 0)
+        return false;
+
+    int const w = src->width;
+    int const h = src->height;
+    constexpr int T = kPHashTile;
+
+    auto const fmt = static_cast<AVPixelFormat>(src->format);
+    int bytesPerSample = 1;
+    if (auto shift = direct_luma_shift(fmt, bytesPerSample)) {
+        AVComponentDescriptor const& yc = av_pix_fmt_desc_get(fmt)->comp[0];
+        uint8_t const* lut = hdr_lut_for(src, yc, bytesPerSample, toneMapHdr);
+
+        ScratchBuffer row8Buf = scratch_for<uint8_t>(static_cast<std::size_t>(w));
+        ScratchBuffer colSumBuf = scratch_for<uint32_t>(static_cast<std::size_t>(w));
+        uint8_t* const row8 = row8Buf.as<uint8_t>();
+        uint32_t* const colSum = colSumBuf.as<uint32_t>();
+
+        for (int ty = 0; ty < T; ++ty) {
+            int const y0 = ty * h / T;
+            int const y1 = std::max(y0 + 1, (ty + 1) * h / T);
+
+            std::fill_n(colSum, w, 0u);
+            for (int y = y0; y < y1; ++y) {
+                luma_row_to_u8(src->data[0] + static_cast<std::ptrdiff_t>(y) * src->linesize[0],
+                    w, bytesPerSample, *shift, yc.shift, (1 << yc.depth) - 1, lut, row8);
+                for (int x = 0; x < w; ++x)
+                    colSum[x] += row8[x];
+            }
+
+            for (int tx = 0; tx < T; ++tx) {
+                int const x0 = tx * w / T;
+                int const x1 = std::max(x0 + 1, (tx + 1) * w / T);
+                uint32_t sum = 0;
+                for (int x = x0; x < x1; ++x)
+                    sum += colSum[x];
+                uint32_t const n = static_cast<uint32_t>((x1 - x0) * (y1 - y0));
+                tile[ty * T + tx] = static_cast<uint8_t>((sum + n / 2) / n);
+            }
         }
+        return true;
+    }
 
-        /*
-        // Early flat frame detection before expensive hash computation
-        if (vpu::is_flat_frame(buf.data(), w, h, w)) {
-            spdlog::info("[hash] Detected flat frame, generating random hash as placeholder");
-            return generate_random_phash();
-        }
-        */
+    static thread_local SwsContext* sws = nullptr;
+    sws = sws_getCachedContext(sws, w, h, fmt,
+                               T, T, AV_PIX_FMT_GRAY8,
+                               SWS_AREA, nullptr, nullptr, nullptr);
+    if (!sws) {
+        spdlog::error("[sws] context init failed");
+        return false;
+    }
+
+    uint8_t* dstData[1] = { tile };
+    int      dstLines[1] = { T };
+
+    return sws_scale(sws, src->data, src->linesize, 0, h,
+                     dstData, dstLines) > 0;
+}
 
-        // mean-average  → 32×32 down-scale  → Phash
-        auto hval = compute_phash_full(buf.data(), w, h);
+// Luma tile → `bits`-wide hash and its orientation variants (see
+// PHashOrientation).  Returns std::nullopt for flat tiles and on failure.
+inline std::optional<PHashFrame>
+hash_tile(uint8_t const* tile, bool& fatal_error, unsigned bits = 64)
+{
+    try {
+        auto hval = compute_phash_frame(tile, bits);
 
-        if (!hval || *hval == vpu::PHASH_ALL_ONE_COLOUR) {
+        if (!hval || hval->flat()) {
             spdlog::info("rejecting");
             return std::nullopt;
         }
@@ -135,6 +384,28 @@ hash_frame(AVFrame const* frm, std::vector<uint8_t>& buf, bool& fatal_error)
     }
 }
 
+// Convert frame → hash and its orientation variants (see PHashOrientation).
+// Returns std::nullopt on failure.
+inline std::optional<PHashFrame>
+hash_frame(AVFrame const* frm, bool toneMapHdr, bool& fatal_error, unsigned bits = 64)
+{
+    std::array<uint8_t, kPHashTile * kPHashTile> buf;
+    if (!vpu::extract_luma_tile(frm, buf.data(), toneMapHdr)) {
+        spdlog::info("rejecting");
+        return std::nullopt;
+    }
+
+    /*
+    // Early flat frame detection before expensive hash computation
+    if (vpu::is_flat_frame(buf.data(), w, h, w)) {
+        spdlog::info("[hash] Detected flat frame, generating random hash as placeholder");
+        return generate_random_phash();
+    }
+    */
+
+    return hash_tile(buf.data(), fatal_error, bits);
+}
+
 /*
 // Detects frames that are:
 // 1. Solid color (all sampled pixels identical)
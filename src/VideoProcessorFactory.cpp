@@ -2,11 +2,21 @@
 #include "VideoProcessorFactory.h"
 #include "FastVideoProcessor.h"
 #include "SlowVideoProcessor.h"
+#include "WorkerProcessVideoProcessor.h"
+
+#include <spdlog/spdlog.h>
 
 std::unique_ptr<IVideoProcessor>
 makeVideoProcessor(SearchSettings const& cfg)
 {
     using enum HashMethod;
+    if (cfg.hashWorkerProcesses > 0) {
+#if defined(__linux__)
+        return std::make_unique<WorkerProcessVideoProcessor>(cfg.hashWorkerProcesses);
+#else
+        spdlog::warn("[hash-worker] worker processes are not supported on this platform, hashing in-process");
+#endif
+    }
     if (cfg.method == Fast)
         return std::make_unique<FastVideoProcessor>();
     return std::make_unique<SlowVideoProcessor>();
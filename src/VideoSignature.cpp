@@ -0,0 +1,139 @@
+#include "VideoSignature.h"
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+namespace {
+
+constexpr std::size_t kVariants = kPHashOrientations - 1;
+
+template <std::size_t Words>
+unsigned distance(std::uint64_t const* a, std::uint64_t const* b)
+{
+    unsigned d = 0;
+    for (std::size_t w = 0; w < Words; ++w)
+        d += static_cast<unsigned>(std::popcount(a[w] ^ b[w]));
+    return d;
+}
+
+// Bit-wise majority per cluster of the hashes `at(i)` points to; ties
+// (even clusters) resolve to 0 like a median split would.
+template <std::size_t Bits, class At>
+void majority(std::vector<std::size_t> const& member, std::size_t clusters, At at,
+    std::uint64_t* out, std::size_t outStride)
+{
+    constexpr std::size_t words = Bits / 64;
+    std::vector<std::uint32_t> ones(clusters * Bits), size(clusters);
+    for (std::size_t i = 0; i < member.size(); ++i) {
+        std::size_t const c = member[i];
+        ++size[c];
+        std::uint64_t const* h = at(i);
+        for (std::size_t b = 0; b < Bits; ++b)
+            ones[c * Bits + b] += static_cast<std::uint32_t>(h[b / 64] >> (b % 64) & 1);
+    }
+    for (std::size_t c = 0; c < clusters; ++c) {
+        std::uint64_t* o = out + c * outStride;
+        std::fill_n(o, words, 0);
+        for (std::size_t b = 0; b < Bits; ++b)
+            if (2 * ones[c * Bits + b] > size[c])
+                o[b / 64] |= std::uint64_t { 1 } << (b % 64);
+    }
+}
+
+template <std::size_t Bits>
+HashGroup signature_at(HashGroup const& group)
+{
+    constexpr std::size_t words = Bits / 64;
+    constexpr unsigned join = kSignatureJoinBits * (Bits / 64);
+    std::size_t const n = group.count();
+    std::size_t const maxClusters = std::clamp<std::size_t>(
+        (n + kHashesPerCentroid - 1) / kHashesPerCentroid, 1, kMaxCentroids);
+
+    // leader clustering in playback order: scenes come in runs
+    std::vector<std::size_t> leaders, member(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        std::uint64_t const* h = group.hashes.data() + i * words;
+        std::size_t best = 0;
+        unsigned bestDist = std::numeric_limits<unsigned>::max();
+        for (std::size_t c = 0; c < leaders.size(); ++c) {
+            unsigned const d = distance<words>(h, group.hashes.data() + leaders[c] * words);
+            if (d < bestDist) {
+                bestDist = d;
+                best = c;
+            }
+        }
+        if (bestDist > join && leaders.size() < maxClusters) {
+            best = leaders.size();
+            leaders.push_back(i);
+        }
+        member[i] = best;
+    }
+
+    HashGroup sig;
+    sig.fk_hash_video = group.fk_hash_video;
+    sig.bits = group.bits;
+    sig.hashes.resize(leaders.size() * words);
+    majority<Bits>(member, leaders.size(),
+        [&](std::size_t i) { return group.hashes.data() + i * words; }, sig.hashes.data(), words);
+
+    if (group.variants.size() == group.hashes.size() * kVariants) {
+        sig.variants.resize(sig.hashes.size() * kVariants);
+        for (std::size_t o = 0; o < kVariants; ++o)
+            majority<Bits>(member, leaders.size(),
+                [&](std::size_t i) { return group.variants.data() + (i * kVariants + o) * words; },
+                sig.variants.data() + o * words, kVariants * words);
+    }
+    return sig;
+}
+
+std::size_t within(unsigned bits, std::uint64_t const* query, HashGroup const& stored,
+    unsigned maxDist, std::uint32_t* idx)
+{
+    std::size_t const n = stored.count();
+    switch (bits) {
+    case 128:
+        return simd::hamming_within128(query, stored.hashes.data(), n, maxDist, idx);
+    case 256:
+        return simd::hamming_within256(query, stored.hashes.data(), n, maxDist, idx);
+    default:
+        return simd::hamming_within(query[0], stored.hashes.data(), n, maxDist, idx);
+    }
+}
+
+} // namespace
+
+HashGroup make_signature(HashGroup const& group)
+{
+    return visit_hash_bits(group.bits, [&](auto width) {
+        return signature_at<decltype(width)::value>(group);
+    });
+}
+
+std::uint64_t signature_radius(unsigned bits, std::uint64_t searchRange)
+{
+    return std::min<std::uint64_t>(searchRange + kSignatureJoinBits * (bits / 64), bits);
+}
+
+int count_pair_matches(HashGroup const& query, HashGroup const& stored, std::uint64_t searchRange)
+{
+    if (query.bits != stored.bits || stored.hashes.empty())
+        return 0;
+    unsigned const bits = query.bits;
+    std::size_t const words = query.words();
+    unsigned const maxDist = static_cast<unsigned>(std::min<std::uint64_t>(searchRange, bits));
+    std::vector<std::uint32_t> idx(stored.count());
+
+    auto count = [&](std::uint64_t const* hashes, std::size_t stride) {
+        int total = 0;
+        for (std::size_t i = 0; i < query.count(); ++i)
+            total += static_cast<int>(within(bits, hashes + i * stride, stored, maxDist, idx.data()));
+        return total;
+    };
+
+    int best = count(query.hashes.data(), words);
+    if (query.variants.size() == query.hashes.size() * kVariants)
+        for (std::size_t o = 0; o < kVariants; ++o)
+            best = std::max(best, count(query.variants.data() + o * words, kVariants * words));
+    return best;
+}
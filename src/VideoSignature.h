@@ -0,0 +1,34 @@
+#pragma once
+
+#include "Hash.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// Coarse per-video signatures for a two-stage search (findDuplicates).
+//
+// A video's hashes are clustered in playback order (a hash joins the
+// nearest cluster within kSignatureJoinBits/64 of the width, else starts a
+// new one) and each cluster is summarised by the bit-wise majority of its
+// members: one centroid per scene, roughly, and at most one per
+// kHashesPerCentroid hashes.  Two videos whose centroids come close are
+// shortlisted; only shortlisted pairs have their hashes compared one by
+// one.  Flipped/rotated variants are summarised per orientation over the
+// same clusters, so the shortlist keeps mirrored copies.
+constexpr std::size_t kHashesPerCentroid = 32;
+constexpr std::size_t kMaxCentroids = 64;
+constexpr unsigned kSignatureJoinBits = 8; // per 64 bits of width
+
+// The video's signature as a HashGroup of the same id and width: hashes are
+// the centroids, variants (when the group has them) their orientations.
+HashGroup make_signature(HashGroup const& group);
+
+// Centroid distance that shortlists a pair for per-hash matching at
+// `searchRange`: majority votes drift less than single frames, so this is
+// the hash radius plus the clustering slack.
+std::uint64_t signature_radius(unsigned bits, std::uint64_t searchRange);
+
+// What MatchIndex::matchCounts reports for `stored` when queried with
+// `query`: (query hash, stored hash) pairs within searchRange, best over the
+// query's orientations.  0 for groups of different widths.
+int count_pair_matches(HashGroup const& query, HashGroup const& stored, std::uint64_t searchRange);
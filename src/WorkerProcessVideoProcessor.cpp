@@ -0,0 +1,224 @@
+// WorkerProcessVideoProcessor.cpp
+#include "WorkerProcessVideoProcessor.h"
+
+#if defined(__linux__)
+
+#    include "HashWorker.h"
+#    include "KeyframeIndex.h"
+#    include "VideoProcessingUtils.h"
+
+#    include <spdlog/spdlog.h>
+
+#    include <cerrno>
+#    include <chrono>
+#    include <cstring>
+#    include <format>
+#    include <stdexcept>
+
+#    include <poll.h>
+#    include <signal.h>
+#    include <spawn.h>
+#    include <sys/socket.h>
+#    include <sys/wait.h>
+#    include <unistd.h>
+
+extern char** environ;
+
+namespace {
+constexpr char const* kSelfExe = "/proc/self/exe"; // still runnable if the binary was replaced
+}
+
+WorkerProcessVideoProcessor::WorkerProcessVideoProcessor(std::size_t workers)
+    : size_(workers > 0 ? workers : 1)
+{
+}
+
+WorkerProcessVideoProcessor::~WorkerProcessVideoProcessor()
+{
+    // closing its stdin makes an idle worker exit on its own
+    for (auto& c : idle_)
+        reap(*c, false);
+    if (created_ > 0)
+        spdlog::info("[hash-worker] {} worker processes used, {} restarted", created_, restarts_);
+}
+
+std::unique_ptr<WorkerProcessVideoProcessor::Child> WorkerProcessVideoProcessor::checkout()
+{
+    std::unique_lock lk(m_);
+    cv_.wait(lk, [&] { return !idle_.empty() || created_ < size_; });
+    if (!idle_.empty()) {
+        auto c = std::move(idle_.back());
+        idle_.pop_back();
+        return c;
+    }
+    ++created_;
+    return std::make_unique<Child>(); // spawned by the caller, outside the lock
+}
+
+void WorkerProcessVideoProcessor::checkin(std::unique_ptr<Child> c)
+{
+    {
+        std::lock_guard lk(m_);
+        idle_.push_back(std::move(c));
+    }
+    cv_.notify_one();
+}
+
+bool WorkerProcessVideoProcessor::spawn(Child& c)
+{
+    // one socket for both directions; send(MSG_NOSIGNAL) turns a dead child
+    // into EPIPE instead of a SIGPIPE for the whole application
+    int sv[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) != 0) {
+        spdlog::error("[hash-worker] socketpair failed: {}", std::strerror(errno));
+        return false;
+    }
+
+    posix_spawn_file_actions_t fa;
+    posix_spawn_file_actions_init(&fa);
+    posix_spawn_file_actions_adddup2(&fa, sv[1], STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&fa, sv[1], STDOUT_FILENO);
+
+    char* argv[] = { const_cast<char*>(kSelfExe), const_cast<char*>("--hash-worker"), nullptr };
+    pid_t pid = -1;
+    int const rc = ::posix_spawn(&pid, kSelfExe, &fa, nullptr, argv, environ);
+    posix_spawn_file_actions_destroy(&fa);
+    ::close(sv[1]);
+    if (rc != 0) {
+        ::close(sv[0]);
+        spdlog::error("[hash-worker] could not start a worker: {}", std::strerror(rc));
+        return false;
+    }
+
+    c.pid = pid;
+    c.fd = sv[0];
+    c.pending.clear();
+    spdlog::debug("[hash-worker] started worker {}", pid);
+    return true;
+}
+
+void WorkerProcessVideoProcessor::reap(Child& c, bool kill, std::string* how)
+{
+    if (c.fd >= 0) {
+        ::close(c.fd);
+        c.fd = -1;
+    }
+    if (c.pid <= 0)
+        return;
+    if (kill)
+        ::kill(c.pid, SIGKILL);
+
+    int st = 0;
+    while (::waitpid(c.pid, &st, 0) < 0 && errno == EINTR) { }
+    if (how)
+        *how = WIFSIGNALED(st)
+            ? std::format("was killed by signal {} ({})", WTERMSIG(st), ::strsignal(WTERMSIG(st)))
+            : std::format("exited with status {}", WEXITSTATUS(st));
+    c.pid = -1;
+}
+
+WorkerProcessVideoProcessor::Outcome
+WorkerProcessVideoProcessor::roundTrip(Child& c, std::string const& request, int timeoutMs, std::string& reply)
+{
+    for (std::size_t off = 0; off < request.size();) {
+        ssize_t const n = ::send(c.fd, request.data() + off, request.size() - off, MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return off == 0 ? Outcome::Dead : Outcome::Crashed;
+        }
+        off += static_cast<std::size_t>(n);
+    }
+
+    using namespace std::chrono;
+    auto const deadline = steady_clock::now() + milliseconds(timeoutMs);
+    char buf[64 * 1024];
+    for (;;) {
+        if (auto nl = c.pending.find('\n'); nl != std::string::npos) {
+            reply.assign(c.pending, 0, nl);
+            c.pending.erase(0, nl + 1);
+            return Outcome::Reply;
+        }
+
+        int wait = -1;
+        if (timeoutMs > 0) {
+            auto const left = duration_cast<milliseconds>(deadline - steady_clock::now()).count();
+            if (left <= 0)
+                return Outcome::Hung;
+            wait = static_cast<int>(left);
+        }
+        pollfd p { c.fd, POLLIN, 0 };
+        int const r = ::poll(&p, 1, wait);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r < 0)
+            return Outcome::Crashed;
+        if (r == 0)
+            return Outcome::Hung;
+
+        ssize_t const n = ::recv(c.fd, buf, sizeof buf, 0);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return Outcome::Crashed; // EOF: the worker is gone
+        c.pending.append(buf, static_cast<std::size_t>(n));
+    }
+}
+
+std::vector<std::uint64_t>
+WorkerProcessVideoProcessor::decodeAndHash(VideoInfo const& video, SearchSettings const& cfg)
+{
+    std::string const request = worker::encode_request(video, cfg);
+    // the worker enforces the budget itself; this only catches one that hangs
+    int const timeoutMs = cfg.fileTimeBudgetSec > 0 ? 2 * cfg.fileTimeBudgetSec * 1000 : -1;
+
+    auto c = checkout();
+    std::string line;
+    Outcome out = Outcome::Dead;
+    // a worker that died while idle has not seen the file; one more go
+    for (int attempt = 0; attempt < 2 && out == Outcome::Dead; ++attempt) {
+        if (c->pid < 0 && !spawn(*c)) {
+            checkin(std::move(c));
+            throw std::runtime_error("could not start a hash worker process");
+        }
+        out = roundTrip(*c, request, timeoutMs, line);
+        if (out == Outcome::Dead)
+            reap(*c, false);
+    }
+
+    if (out != Outcome::Reply) {
+        int const pid = c->pid;
+        std::string how;
+        reap(*c, out == Outcome::Hung, &how);
+        {
+            std::lock_guard lk(m_);
+            ++restarts_;
+        }
+        checkin(std::move(c)); // respawned by whoever checks it out next
+        spdlog::warn("[hash-worker] worker {} {} on '{}'; restarting it", pid, how, video.path);
+
+        if (out == Outcome::Hung)
+            throw vpu::BudgetExceeded("decode",
+                std::format("worker did not answer within {} s and was killed", timeoutMs / 1000));
+        if (out == Outcome::Dead)
+            throw std::runtime_error("hash worker exits before taking requests");
+        throw std::runtime_error("hash worker " + how + " while hashing this file");
+    }
+    checkin(std::move(c));
+
+    worker::Reply r = worker::decode_reply(line);
+    if (!r.budgetStage.empty())
+        throw vpu::BudgetExceeded(r.budgetStage, r.budgetReason);
+    if (!r.error.empty())
+        throw std::runtime_error(r.error);
+
+    if (!r.keyframes.empty() && video.keyframes) {
+        if (auto idx = KeyframeIndex::deserialize(r.keyframes)) {
+            *video.keyframes = std::move(*idx);
+            video.keyframes->markDirty(); // the worker added to it; ours still needs storing
+        }
+    }
+    return std::move(r.hashes);
+}
+
+#endif // __linux__
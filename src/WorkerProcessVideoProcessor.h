@@ -0,0 +1,63 @@
+#pragma once
+
+#include "IVideoProcessor.h"
+
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Hashes each file in a child process (this executable, run with
+// --hash-worker, see HashWorker.h) instead of in the application, so a
+// decoder that crashes on a malformed file takes down one worker and fails
+// one file.  Up to `workers` children are started on demand and reused;
+// decodeAndHash() is thread-safe and blocks until a child is free, so the
+// caller runs one thread per worker to keep them all busy.
+//
+// A child that dies mid-request is reaped and restarted for the next file,
+// and the request fails with an exception naming the signal.  A child that
+// stops answering for twice the per-file time budget is killed and the
+// request fails with vpu::BudgetExceeded, like an in-process overrun.
+// Linux only (see makeVideoProcessor).
+class WorkerProcessVideoProcessor : public IVideoProcessor {
+public:
+    explicit WorkerProcessVideoProcessor(std::size_t workers);
+    ~WorkerProcessVideoProcessor() override;
+
+    WorkerProcessVideoProcessor(WorkerProcessVideoProcessor const&) = delete;
+    WorkerProcessVideoProcessor& operator=(WorkerProcessVideoProcessor const&) = delete;
+
+    std::vector<std::uint64_t>
+    decodeAndHash(VideoInfo const& video, SearchSettings const& cfg) override;
+
+    std::size_t concurrency() const override { return size_; }
+
+private:
+    struct Child {
+        int pid = -1;
+        int fd = -1;         // our end of the socketpair: child's stdin and stdout
+        std::string pending; // bytes read past the last reply
+    };
+
+    enum class Outcome { Reply,
+        Dead,    // was gone before it saw the request
+        Crashed, // died while working on it
+        Hung };
+
+    std::unique_ptr<Child> checkout();
+    void checkin(std::unique_ptr<Child> c);
+
+    bool spawn(Child& c);
+    void reap(Child& c, bool kill, std::string* how = nullptr);
+    Outcome roundTrip(Child& c, std::string const& request, int timeoutMs, std::string& reply);
+
+    std::size_t const size_;
+
+    std::mutex m_;
+    std::condition_variable cv_;
+    std::vector<std::unique_ptr<Child>> idle_;
+    std::size_t created_ = 0;
+    std::size_t restarts_ = 0;
+};
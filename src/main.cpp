@@ -1,3 +1,4 @@
+#include "CommandLine.h"
 #include "ConfigManager.h"
 #include "DatabaseManager.h"
 #include "MainWindow.h"
@@ -12,6 +13,9 @@
 
 int main(int argc, char* argv[])
 {
+    if (auto rc = cli::runHeadless(argc, argv))
+        return *rc;
+
     QApplication app(argc, argv);
 
     // -- Qt meta types for signal/slot compatibility --
@@ -19,6 +23,7 @@ int main(int argc, char* argv[])
     qRegisterMetaType<MainWindow::SelectOptions>("MainWindow::SelectOptions");
     qRegisterMetaType<MainWindow::SortOptions>("MainWindow::SortOptions");
     qRegisterMetaType<SearchSettings>("SearchSettings");
+    qRegisterMetaType<GroupsSnapshot>("GroupsSnapshot");
 
     // --- determine which database to open ---
     std::string dbPath = cfg::loadDatabasePath().value_or(cfg::defaultDatabasePath());
@@ -75,6 +80,9 @@ int main(int argc, char* argv[])
     QObject::connect(&w, &MainWindow::hardlinkTriggered,
         &controller, &VideoController::handleHardlink);
 
+    QObject::connect(&w, &MainWindow::matchQueryRequested,
+        &controller, &VideoController::handleMatchQuery);
+
     QObject::connect(&w, &MainWindow::addDirectoryRequested,
         &controller, &VideoController::onAddDirectoryRequested);
 